@@ -1013,6 +1013,8 @@ typedef int	(Tk_ItemAreaProc)(Tk_Canvas canvas, Tk_Item *itemPtr,
 		    double *rectPtr);
 typedef int	(Tk_ItemPostscriptProc)(Tcl_Interp *interp, Tk_Canvas canvas,
 		    Tk_Item *itemPtr, int prepass);
+typedef int	(Tk_ItemExportProc)(Tcl_Interp *interp, Tk_Canvas canvas,
+		    Tk_Item *itemPtr, int prepass);
 typedef void	(Tk_ItemRotateProc)(Tk_Canvas canvas, Tk_Item *itemPtr,
 		    double originX, double originY, double angleRadians);
 typedef void	(Tk_ItemScaleProc)(Tk_Canvas canvas, Tk_Item *itemPtr,
@@ -1082,7 +1084,10 @@ typedef struct Tk_ItemType {
 				/* Procedure to rotate an item's coordinates
 				 * about a point. */
     int reserved2;		/* Carefully compatible with */
-    char *reserved3;		/* Jan Nijtmans dash patch */
+    Tk_ItemExportProc *exportProc;
+				/* Procedure to describe items of this type
+				 * for the "export" widget command. NULL if
+				 * the items can't be exported. */
     char *reserved4;
 } Tk_ItemType;
 
@@ -203,6 +203,8 @@ static double		ArcToPoint(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *coordPtr);
 static int		ArcToPostscript(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static int		ArcToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
 static void		ScaleArc(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double originX, double originY,
 			    double scaleX, double scaleY);
@@ -247,7 +249,9 @@ Tk_ItemType tkArcType = {
     NULL,			/* dTextProc */
     NULL,			/* nextPtr */
     RotateArc,			/* rotateProc */
-    0, NULL, NULL
+    0,				/* reserved2 */
+    ArcToExport,		/* exportProc */
+    NULL			/* reserved4 */
 };
 
 /*
@@ -2173,6 +2177,81 @@ ArcToPostscript(
     return TCL_OK;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * ArcToExport --
+ *
+ *	This function is called to describe an arc item for the "export"
+ *	widget command of canvases. Unlike on the screen and in Postscript,
+ *	the straight parts of the outline are stroked together with the
+ *	curved part, so they are joined properly.
+ *
+ * Results:
+ *	The return value is a standard Tcl result.
+ *
+ * Side effects:
+ *	The item is added to the SVG or PDF output being generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ArcToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    TCL_UNUSED(int))		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    ArcItem *arcPtr = (ArcItem *) itemPtr;
+    XColor *fillColor;
+    Pixmap fillStipple;
+    Tk_State state = itemPtr->state;
+    int style;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    fillColor = arcPtr->fillColor;
+    fillStipple = arcPtr->fillStipple;
+    if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	if (arcPtr->activeFillColor!=NULL) {
+	    fillColor = arcPtr->activeFillColor;
+	}
+	if (arcPtr->activeFillStipple!=None) {
+	    fillStipple = arcPtr->activeFillStipple;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (arcPtr->disabledFillColor!=NULL) {
+	    fillColor = arcPtr->disabledFillColor;
+	}
+	if (arcPtr->disabledFillStipple!=None) {
+	    fillStipple = arcPtr->disabledFillStipple;
+	}
+    }
+    if (arcPtr->fillGC == NULL) {
+	fillColor = NULL;
+    }
+    if ((fillColor == NULL) && (arcPtr->outline.gc == NULL)) {
+	return TCL_OK;
+    }
+
+    if (arcPtr->style == PIESLICE_STYLE) {
+	style = TK_EXPORT_ARC_PIESLICE;
+    } else if (arcPtr->style == CHORD_STYLE) {
+	style = TK_EXPORT_ARC_CHORD;
+    } else {
+	style = TK_EXPORT_ARC_OPEN;
+    }
+    TkCanvExportArcPath(canvas, arcPtr->bbox, arcPtr->start, arcPtr->extent,
+	    style);
+    return TkCanvExportPaint(canvas, itemPtr, fillColor, fillStipple,
+	    (arcPtr->outline.gc != NULL) ? &arcPtr->outline : NULL, CapButt,
+	    JoinMiter);
+}
+
 /*
  *--------------------------------------------------------------
  *
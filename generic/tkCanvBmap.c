@@ -93,6 +93,8 @@ static double		BitmapToPoint(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *coordPtr);
 static int		BitmapToPostscript(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static int		BitmapToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
 static void		ComputeBitmapBbox(Tk_Canvas canvas,
 			    BitmapItem *bmapPtr);
 static int		ConfigureBitmap(Tcl_Interp *interp,
@@ -141,7 +143,9 @@ Tk_ItemType tkBitmapType = {
     NULL,			/* dTextProc */
     NULL,			/* nextPtr */
     RotateBitmap,		/* rotateProc */
-    0, NULL, NULL
+    0,				/* reserved2 */
+    BitmapToExport,		/* exportProc */
+    NULL			/* reserved4 */
 };
 
 /*
@@ -1029,6 +1033,97 @@ BitmapToPostscript(
     return TCL_ERROR;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * BitmapToExport --
+ *
+ *	This function is called to describe a bitmap item for the "export"
+ *	widget command of canvases.
+ *
+ * Results:
+ *	The return value is a standard Tcl result.
+ *
+ * Side effects:
+ *	The item is added to the SVG or PDF output being generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+BitmapToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    TCL_UNUSED(int))		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    BitmapItem *bmapPtr = (BitmapItem *) itemPtr;
+    double x, y;
+    int width, height;
+    XColor *fgColor;
+    XColor *bgColor;
+    Pixmap bitmap;
+    Tk_State state = itemPtr->state;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    fgColor = bmapPtr->fgColor;
+    bgColor = bmapPtr->bgColor;
+    bitmap = bmapPtr->bitmap;
+    if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	if (bmapPtr->activeFgColor!=NULL) {
+	    fgColor = bmapPtr->activeFgColor;
+	}
+	if (bmapPtr->activeBgColor!=NULL) {
+	    bgColor = bmapPtr->activeBgColor;
+	}
+	if (bmapPtr->activeBitmap!=None) {
+	    bitmap = bmapPtr->activeBitmap;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (bmapPtr->disabledFgColor!=NULL) {
+	    fgColor = bmapPtr->disabledFgColor;
+	}
+	if (bmapPtr->disabledBgColor!=NULL) {
+	    bgColor = bmapPtr->disabledBgColor;
+	}
+	if (bmapPtr->disabledBitmap!=None) {
+	    bitmap = bmapPtr->disabledBitmap;
+	}
+    }
+
+    if (bitmap == None) {
+	return TCL_OK;
+    }
+
+    /*
+     * Compute the coordinates of the upper-left corner of the bitmap, taking
+     * into account the anchor position for the bitmap.
+     */
+
+    x = bmapPtr->x;
+    y = bmapPtr->y;
+    Tk_SizeOfBitmap(Tk_Display(Tk_CanvasTkwin(canvas)), bitmap,
+	    &width, &height);
+    switch (bmapPtr->anchor) {
+    case TK_ANCHOR_NW:						break;
+    case TK_ANCHOR_N:	   x -= width/2.0;			break;
+    case TK_ANCHOR_NE:	   x -= width;				break;
+    case TK_ANCHOR_E:	   x -= width;	   y -= height/2.0;	break;
+    case TK_ANCHOR_SE:	   x -= width;	   y -= height;		break;
+    case TK_ANCHOR_S:	   x -= width/2.0; y -= height;		break;
+    case TK_ANCHOR_SW:			   y -= height;		break;
+    case TK_ANCHOR_W:			   y -= height/2.0;	break;
+    default: x -= width/2.0; y -= height/2.0;	break;
+    }
+
+    return TkCanvExportBitmap(canvas, bitmap, x, y, width, height, fgColor,
+	    bgColor);
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -0,0 +1,2061 @@
+/*
+ * tkCanvExport.c --
+ *
+ *	This module provides SVG and PDF output support for canvases,
+ *	including the "export" widget command plus the utility functions that
+ *	item types call from their exportProc to describe themselves.
+ *
+ *	Output is generated one item at a time and handed to the destination
+ *	channel as soon as each item is complete, so the memory needed does
+ *	not grow with the number of items. Fonts, images, stipples and bitmaps
+ *	are collected in a pre-pass over the items (just like fonts are for
+ *	Postscript) and written only once, no matter how many items use them.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#include "tkInt.h"
+#include "tkCanvas.h"
+#include "tkFont.h"
+
+/*
+ * See tkCanvas.h for key data structures used to implement canvases.
+ */
+
+/*
+ * Output formats understood by the "export" widget command.
+ */
+
+static const char *const formatStrings[] = {
+    "pdf", "svg", NULL
+};
+enum formats {
+    EXPORT_PDF, EXPORT_SVG
+};
+
+/*
+ * Pending output is handed to the destination after each item, and in
+ * between whenever it grows past the following number of bytes.
+ */
+
+#define EXPORT_FLUSH_SIZE	65536
+
+/*
+ * PDF objects with a fixed number. The objects for fonts, images, stipples
+ * and bitmaps are numbered upwards from PDF_FIRST_FREE_OBJ as they are
+ * written.
+ */
+
+#define PDF_CATALOG_OBJ		1
+#define PDF_PAGES_OBJ		2
+#define PDF_PAGE_OBJ		3
+#define PDF_RESOURCES_OBJ	4
+#define PDF_CONTENTS_OBJ	5
+#define PDF_LENGTH_OBJ		6
+#define PDF_FIRST_FREE_OBJ	7
+
+/*
+ * One of the following structures is kept for each distinct font, image,
+ * stipple or bitmap used by the exported items.
+ */
+
+typedef struct ExportResource {
+    int id;			/* Number used to name the resource in the
+				 * output, e.g. "F3" in PDF or "i3" in SVG. */
+    int objNum;			/* PDF object number of the resource, or 0 if
+				 * it could not be written. SVG output sets it
+				 * to 1 once the resource has been defined. */
+} ExportResource;
+
+/*
+ * One of the following structures is created to keep track of the output
+ * being generated by the "export" widget command. It consists mostly of
+ * information provided on the widget command line.
+ */
+
+typedef struct TkExportInfo {
+    int format;			/* EXPORT_PDF or EXPORT_SVG. */
+    int x, y, width, height;	/* Area to export, in canvas pixel
+				 * coordinates. */
+    int x2, y2;			/* x+width and y+height. */
+    double scale;		/* PDF only: each canvas pixel maps into this
+				 * many points. */
+    Tcl_Obj *formatObj;		/* Value of the "-format" option or NULL. */
+    Tcl_Obj *fileNameObj;	/* Name of file in which to write the output;
+				 * NULL means return it as result. */
+    Tcl_Obj *channelNameObj;	/* If -channel is specified, the name of the
+				 * channel to use. */
+    Tcl_Channel chan;		/* Open channel corresponding to fileName or
+				 * channelName, NULL if none. */
+    Tcl_DString result;		/* Output collected for the result when there
+				 * is no channel. */
+    Tcl_WideInt offset;		/* Number of bytes handed to the destination
+				 * so far. Needed for the PDF xref table. */
+    int writeError;		/* Errno of the first failed write to chan, or
+				 * 0. */
+    Tcl_Obj *bufObj;		/* Output that has not been handed to the
+				 * destination yet. */
+    Tcl_Obj *pathObj;		/* Path built by TkCanvExportPath and
+				 * TkCanvExportArcPath, in the syntax of the
+				 * output format, waiting to be painted. */
+    Tcl_ZlibStream zstream;	/* PDF only: compressor for the page contents
+				 * while they are generated, NULL otherwise. */
+    Tcl_Obj *zbufObj;		/* Compressed bytes taken from zstream. */
+    Tcl_Encoding encoding;	/* PDF only: encoding of the standard fonts. */
+    int prepass;		/* Non-zero means that we're currently in the
+				 * pre-pass that collects the resources used
+				 * by the items, so nothing is output. */
+    Tcl_HashTable fontTable;	/* Fonts used in the output, keyed by CSS
+				 * declaration (SVG) or Postscript font name
+				 * (PDF). Values are ExportResources. */
+    Tcl_HashTable imageTable;	/* Photo images used in the output, keyed by
+				 * image name. */
+    Tcl_HashTable stippleTable;	/* Stipples used in the output, keyed by
+				 * Pixmap. */
+    Tcl_HashTable bitmapTable;	/* Bitmaps drawn by items, keyed by Pixmap. */
+    int numResources;		/* Number of resources created so far. */
+    int numObjs;		/* PDF only: number of objects allocated,
+				 * including the free object 0. */
+    int objSpace;		/* Number of slots in objOffsets. */
+    Tcl_WideInt *objOffsets;	/* PDF only: byte offset of each object. */
+    Tk_Window tkwin;		/* Window to get font pixel/point transform
+				 * from. */
+    Tcl_Interp *interp;		/* Interpreter for image lookups. */
+} TkExportInfo;
+
+/*
+ * The table below provides a template that's used to process arguments to the
+ * canvas "export" command and fill in TkExportInfo structures.
+ */
+
+static const Tk_ConfigSpec configSpecs[] = {
+    {TK_CONFIG_STRING, "-channel", NULL, NULL,
+	"", offsetof(TkExportInfo, channelNameObj), TK_CONFIG_OBJS, NULL},
+    {TK_CONFIG_STRING, "-file", NULL, NULL,
+	"", offsetof(TkExportInfo, fileNameObj), TK_CONFIG_OBJS, NULL},
+    {TK_CONFIG_STRING, "-format", NULL, NULL,
+	"", offsetof(TkExportInfo, formatObj), TK_CONFIG_OBJS, NULL},
+    {TK_CONFIG_PIXELS, "-height", NULL, NULL,
+	"", offsetof(TkExportInfo, height), 0, NULL},
+    {TK_CONFIG_PIXELS, "-width", NULL, NULL,
+	"", offsetof(TkExportInfo, width), 0, NULL},
+    {TK_CONFIG_PIXELS, "-x", NULL, NULL,
+	"", offsetof(TkExportInfo, x), 0, NULL},
+    {TK_CONFIG_PIXELS, "-y", NULL, NULL,
+	"", offsetof(TkExportInfo, y), 0, NULL},
+    {TK_CONFIG_END, NULL, NULL, NULL, NULL, 0, 0, NULL}
+};
+
+/*
+ * Forward declarations for functions defined later in this file:
+ */
+
+static void		AppendBitmapPath(Tcl_Obj *bufObj, XImage *imagePtr,
+			    int width, int height);
+static void		AppendColor(TkExportInfo *infoPtr, XColor *colorPtr,
+			    const char *pdfOperator);
+static void		AppendEscapedText(TkExportInfo *infoPtr,
+			    const char *string, Tcl_Size numBytes);
+static int		AllocObject(TkExportInfo *infoPtr);
+static void		BeginObject(TkExportInfo *infoPtr, int objNum);
+static void		DrainCompressor(TkExportInfo *infoPtr);
+static void		FlushOutput(TkExportInfo *infoPtr);
+static void		MaybeFlushOutput(TkExportInfo *infoPtr);
+static XImage *		GetBitmapImage(TkExportInfo *infoPtr, Pixmap bitmap,
+			    int *widthPtr, int *heightPtr);
+static ExportResource *	GetResource(TkExportInfo *infoPtr,
+			    Tcl_HashTable *tablePtr, const void *key);
+static void		WriteOutput(TkExportInfo *infoPtr, const char *bytes,
+			    Tcl_Size length);
+static void		WritePdfHeader(TkExportInfo *infoPtr);
+static void		WritePdfTrailer(TkExportInfo *infoPtr);
+static void		WriteResources(TkExportInfo *infoPtr);
+static void		WriteStream(TkExportInfo *infoPtr, const char *dict,
+			    const unsigned char *bytes, Tcl_Size length);
+static void		WriteSvgHeader(TkExportInfo *infoPtr,
+			    Tk_Window tkwin);
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvExportObjCmd --
+ *
+ *	This function is invoked to process the "export" options of the
+ *	widget command for canvas widgets. See the user documentation for
+ *	details on what it does.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the user documentation.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkCanvExportObjCmd(
+    TkCanvas *canvasPtr,	/* Information about canvas widget. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,		/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument strings. Caller has already parsed
+				 * this command enough to know that objv[1] is
+				 * "export". */
+{
+    TkExportInfo info, *infoPtr = &info;
+    struct TkExportInfo *oldInfoPtr;
+    Tk_Window tkwin = canvasPtr->tkwin;
+    Tk_Item *itemPtr;
+    Tcl_HashTable *tables[4];
+    Tcl_HashSearch search;
+    Tcl_HashEntry *hPtr;
+    Tcl_DString buffer;
+    const char *p;
+    Tcl_WideInt streamStart = 0;
+    int result, format = EXPORT_SVG, i;
+
+    /*
+     * Initialize the data structure describing the output, then process all
+     * the arguments to fill the data structure in.
+     */
+
+    memset(&info, 0, sizeof(info));
+    info.x = canvasPtr->xOrigin;
+    info.y = canvasPtr->yOrigin;
+    info.width = -1;
+    info.height = -1;
+    info.tkwin = tkwin;
+    info.interp = interp;
+    Tcl_DStringInit(&info.result);
+    info.bufObj = Tcl_NewObj();
+    Tcl_IncrRefCount(info.bufObj);
+    info.pathObj = Tcl_NewObj();
+    Tcl_IncrRefCount(info.pathObj);
+    Tcl_InitHashTable(&info.fontTable, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&info.imageTable, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&info.stippleTable, TCL_ONE_WORD_KEYS);
+    Tcl_InitHashTable(&info.bitmapTable, TCL_ONE_WORD_KEYS);
+    tables[0] = &info.fontTable;
+    tables[1] = &info.imageTable;
+    tables[2] = &info.stippleTable;
+    tables[3] = &info.bitmapTable;
+    oldInfoPtr = canvasPtr->exportInfo;
+    canvasPtr->exportInfo = infoPtr;
+
+    result = Tk_ConfigureWidget(interp, tkwin, configSpecs, objc-2, objv+2,
+	    &info, TK_CONFIG_ARGV_ONLY);
+    if (result != TCL_OK) {
+	goto cleanup;
+    }
+    if (info.formatObj != NULL) {
+	result = Tcl_GetIndexFromObj(interp, info.formatObj, formatStrings,
+		"format", 0, &format);
+	if (result != TCL_OK) {
+	    goto cleanup;
+	}
+    }
+    info.format = format;
+
+    if (info.width == -1) {
+	info.width = Tk_Width(tkwin);
+    }
+    if (info.height == -1) {
+	info.height = Tk_Height(tkwin);
+    }
+    info.x2 = info.x + info.width;
+    info.y2 = info.y + info.height;
+    info.scale = (72.0/25.4)*WidthMMOfScreen(Tk_Screen(tkwin));
+    info.scale /= WidthOfScreen(Tk_Screen(tkwin));
+
+    if (info.fileNameObj != NULL) {
+	/*
+	 * Check that -file and -channel are not both specified.
+	 */
+
+	if (info.channelNameObj != NULL) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "can't specify both -file and -channel", TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "CANVAS", "EXPORT", "USAGE",
+		    (char *)NULL);
+	    result = TCL_ERROR;
+	    goto cleanup;
+	}
+
+	/*
+	 * Check that we are not in a safe interpreter. If we are, disallow
+	 * the -file specification.
+	 */
+
+	if (Tcl_IsSafe(interp)) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "can't specify -file in a safe interpreter", TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "SAFE", "EXPORT_FILE", (char *)NULL);
+	    result = TCL_ERROR;
+	    goto cleanup;
+	}
+
+	p = Tcl_TranslateFileName(interp, Tcl_GetString(info.fileNameObj),
+		&buffer);
+	if (p == NULL) {
+	    result = TCL_ERROR;
+	    goto cleanup;
+	}
+	info.chan = Tcl_OpenFileChannel(interp, p, "wb", 0666);
+	Tcl_DStringFree(&buffer);
+	if (info.chan == NULL) {
+	    result = TCL_ERROR;
+	    goto cleanup;
+	}
+    }
+
+    if (info.channelNameObj != NULL) {
+	int mode;
+
+	/*
+	 * Check that the channel is found in this interpreter and that it is
+	 * open for writing.
+	 */
+
+	info.chan = Tcl_GetChannel(interp, Tcl_GetString(info.channelNameObj),
+		&mode);
+	if (info.chan == NULL) {
+	    result = TCL_ERROR;
+	    goto cleanup;
+	}
+	if (!(mode & TCL_WRITABLE)) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "channel \"%s\" wasn't opened for writing",
+		    Tcl_GetString(info.channelNameObj)));
+	    Tcl_SetErrorCode(interp, "TK", "CANVAS", "EXPORT", "UNWRITABLE",
+		    (char *)NULL);
+	    result = TCL_ERROR;
+	    goto cleanup;
+	}
+    }
+
+    if (format == EXPORT_PDF) {
+	info.encoding = Tcl_GetEncoding(NULL, "cp1252");
+    }
+
+    /*
+     * Make a pre-pass over all of the items, collecting the fonts, images,
+     * stipples and bitmaps they use, so that each of them can be written
+     * once before the items that refer to it.
+     */
+
+    info.prepass = 1;
+    for (itemPtr = canvasPtr->firstItemPtr; itemPtr != NULL;
+	    itemPtr = itemPtr->nextPtr) {
+	if ((itemPtr->x1 >= info.x2) || (itemPtr->x2 < info.x)
+		|| (itemPtr->y1 >= info.y2) || (itemPtr->y2 < info.y)) {
+	    continue;
+	}
+	if ((itemPtr->typePtr->exportProc == NULL)
+		|| (itemPtr->state == TK_STATE_HIDDEN)) {
+	    continue;
+	}
+	result = itemPtr->typePtr->exportProc(interp, (Tk_Canvas) canvasPtr,
+		itemPtr, 1);
+	Tcl_ResetResult(interp);
+	if (result != TCL_OK) {
+	    /*
+	     * The error can be reported by the second pass.
+	     */
+
+	    break;
+	}
+    }
+    info.prepass = 0;
+    Tcl_SetObjLength(info.pathObj, 0);
+
+    /*
+     * Generate the document header and the shared resources.
+     */
+
+    if (format == EXPORT_PDF) {
+	WritePdfHeader(infoPtr);
+    } else {
+	WriteSvgHeader(infoPtr, tkwin);
+    }
+    WriteResources(infoPtr);
+
+    if (format == EXPORT_PDF) {
+	BeginObject(infoPtr, PDF_CONTENTS_OBJ);
+	Tcl_AppendPrintfToObj(info.bufObj,
+		"<< /Length %d 0 R /Filter /FlateDecode >>\nstream\n",
+		PDF_LENGTH_OBJ);
+	FlushOutput(infoPtr);
+	streamStart = info.offset;
+	if (Tcl_ZlibStreamInit(NULL, TCL_ZLIB_STREAM_DEFLATE,
+		TCL_ZLIB_FORMAT_ZLIB, TCL_ZLIB_COMPRESS_DEFAULT, NULL,
+		&info.zstream) != TCL_OK) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "can't initialize compressor", TCL_INDEX_NONE));
+	    result = TCL_ERROR;
+	    goto cleanup;
+	}
+	info.zbufObj = Tcl_NewObj();
+	Tcl_IncrRefCount(info.zbufObj);
+
+	/*
+	 * Count the compressed bytes of the stream from here on; the offset is
+	 * made absolute again when the stream is complete.
+	 */
+
+	info.offset = 0;
+
+	/*
+	 * Map canvas coordinates onto the page and clip to the exported area.
+	 */
+
+	Tcl_AppendPrintfToObj(info.bufObj,
+		"q %.10g 0 0 %.10g %.10g %.10g cm\n"
+		"%d %d %d %d re W n\n",
+		info.scale, -info.scale, -info.x * info.scale,
+		info.y2 * info.scale, info.x, info.y, info.width, info.height);
+    } else {
+	Tcl_AppendToObj(info.bufObj, "<g fill-rule=\"evenodd\">\n",
+		TCL_INDEX_NONE);
+    }
+
+    /*
+     * Iterate through all the items, having each relevant one describe
+     * itself. Quit if any of the items returns an error.
+     */
+
+    result = TCL_OK;
+    for (itemPtr = canvasPtr->firstItemPtr; itemPtr != NULL;
+	    itemPtr = itemPtr->nextPtr) {
+	if ((itemPtr->x1 >= info.x2) || (itemPtr->x2 < info.x)
+		|| (itemPtr->y1 >= info.y2) || (itemPtr->y2 < info.y)) {
+	    continue;
+	}
+	if ((itemPtr->typePtr->exportProc == NULL)
+		|| (itemPtr->state == TK_STATE_HIDDEN)) {
+	    continue;
+	}
+
+	if (format == EXPORT_PDF) {
+	    Tcl_AppendToObj(info.bufObj, "q\n", TCL_INDEX_NONE);
+	}
+	result = itemPtr->typePtr->exportProc(interp, (Tk_Canvas) canvasPtr,
+		itemPtr, 0);
+	if (result != TCL_OK) {
+	    Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf(
+		    "\n    (exporting item %d)", (int)itemPtr->id));
+	    goto cleanup;
+	}
+	Tcl_SetObjLength(info.pathObj, 0);
+	if (format == EXPORT_PDF) {
+	    Tcl_AppendToObj(info.bufObj, "Q\n", TCL_INDEX_NONE);
+	}
+	FlushOutput(infoPtr);
+	if (info.writeError) {
+	    goto writeFailed;
+	}
+    }
+
+    /*
+     * Output the end of the document.
+     */
+
+    if (format == EXPORT_PDF) {
+	Tcl_WideInt length;
+	Tcl_Obj *emptyObj = Tcl_NewObj();
+
+	Tcl_AppendToObj(info.bufObj, "Q\n", TCL_INDEX_NONE);
+	FlushOutput(infoPtr);
+	Tcl_IncrRefCount(emptyObj);
+	Tcl_ZlibStreamPut(info.zstream, emptyObj, TCL_ZLIB_FINALIZE);
+	Tcl_DecrRefCount(emptyObj);
+	DrainCompressor(infoPtr);
+	Tcl_ZlibStreamClose(info.zstream);
+	info.zstream = NULL;
+
+	length = info.offset;
+	info.offset = streamStart + length;
+	Tcl_AppendToObj(info.bufObj, "\nendstream\nendobj\n", TCL_INDEX_NONE);
+	BeginObject(infoPtr, PDF_LENGTH_OBJ);
+	Tcl_AppendPrintfToObj(info.bufObj,
+		"%" TCL_LL_MODIFIER "d\nendobj\n", (long long) length);
+	WritePdfTrailer(infoPtr);
+    } else {
+	Tcl_AppendToObj(info.bufObj, "</g>\n</svg>\n", TCL_INDEX_NONE);
+    }
+    FlushOutput(infoPtr);
+    if (info.writeError) {
+	goto writeFailed;
+    }
+
+    if (info.chan == NULL) {
+	if (format == EXPORT_PDF) {
+	    Tcl_SetObjResult(interp, Tcl_NewByteArrayObj(
+		    (unsigned char *) Tcl_DStringValue(&info.result),
+		    Tcl_DStringLength(&info.result)));
+	} else {
+	    Tcl_DStringResult(interp, &info.result);
+	}
+    } else {
+	Tcl_ResetResult(interp);
+    }
+    goto cleanup;
+
+  writeFailed:
+    Tcl_SetErrno(info.writeError);
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+	    "problem writing export data to channel: %s",
+	    Tcl_PosixError(interp)));
+    result = TCL_ERROR;
+
+    /*
+     * Clean up info to release malloc'ed stuff.
+     */
+
+  cleanup:
+    if (info.zstream != NULL) {
+	Tcl_ZlibStreamClose(info.zstream);
+    }
+    if (info.zbufObj != NULL) {
+	Tcl_DecrRefCount(info.zbufObj);
+    }
+    if (info.formatObj != NULL) {
+	Tcl_DecrRefCount(info.formatObj);
+    }
+    if (info.fileNameObj != NULL) {
+	Tcl_DecrRefCount(info.fileNameObj);
+    }
+    if ((info.chan != NULL) && (info.channelNameObj == NULL)) {
+	Tcl_Close(interp, info.chan);
+    }
+    if (info.channelNameObj != NULL) {
+	Tcl_DecrRefCount(info.channelNameObj);
+    }
+    if (info.encoding != NULL) {
+	Tcl_FreeEncoding(info.encoding);
+    }
+    for (i = 0; i < 4; i++) {
+	for (hPtr = Tcl_FirstHashEntry(tables[i], &search); hPtr != NULL;
+		hPtr = Tcl_NextHashEntry(&search)) {
+	    ckfree(Tcl_GetHashValue(hPtr));
+	}
+	Tcl_DeleteHashTable(tables[i]);
+    }
+    if (info.objOffsets != NULL) {
+	ckfree(info.objOffsets);
+    }
+    Tcl_DStringFree(&info.result);
+    Tcl_DecrRefCount(info.bufObj);
+    Tcl_DecrRefCount(info.pathObj);
+    canvasPtr->exportInfo = oldInfoPtr;
+    return result;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * WriteOutput, FlushOutput, MaybeFlushOutput, DrainCompressor --
+ *
+ *	Hand generated output over to the destination of the export. The
+ *	destination is either the channel or, when there is none, the buffer
+ *	that becomes the result of the command. FlushOutput moves the pending
+ *	text in bufObj, routing it through the compressor while the PDF page
+ *	contents are generated. MaybeFlushOutput does so only once enough
+ *	text is pending.
+ *
+ * Results:
+ *	None. Write errors are remembered in the writeError field.
+ *
+ * Side effects:
+ *	Output is written.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+WriteOutput(
+    TkExportInfo *infoPtr,
+    const char *bytes,
+    Tcl_Size length)
+{
+    if (length <= 0) {
+	return;
+    }
+    if (infoPtr->chan == NULL) {
+	Tcl_DStringAppend(&infoPtr->result, bytes, length);
+    } else if (!infoPtr->writeError
+	    && Tcl_Write(infoPtr->chan, bytes, length) == TCL_IO_FAILURE) {
+	infoPtr->writeError = Tcl_GetErrno();
+	if (infoPtr->writeError == 0) {
+	    infoPtr->writeError = EIO;
+	}
+    }
+    infoPtr->offset += length;
+}
+
+static void
+FlushOutput(
+    TkExportInfo *infoPtr)
+{
+    Tcl_Size length;
+    const char *bytes = Tcl_GetStringFromObj(infoPtr->bufObj, &length);
+
+    if (length == 0) {
+	return;
+    }
+    if (infoPtr->zstream != NULL) {
+	Tcl_Obj *dataObj = Tcl_NewByteArrayObj((const unsigned char *) bytes,
+		length);
+
+	Tcl_IncrRefCount(dataObj);
+	Tcl_ZlibStreamPut(infoPtr->zstream, dataObj, TCL_ZLIB_NO_FLUSH);
+	Tcl_DecrRefCount(dataObj);
+	DrainCompressor(infoPtr);
+    } else {
+	WriteOutput(infoPtr, bytes, length);
+    }
+    Tcl_SetObjLength(infoPtr->bufObj, 0);
+}
+
+static void
+MaybeFlushOutput(
+    TkExportInfo *infoPtr)
+{
+    Tcl_Size length;
+
+    (void) Tcl_GetStringFromObj(infoPtr->bufObj, &length);
+    if (length > EXPORT_FLUSH_SIZE) {
+	FlushOutput(infoPtr);
+    }
+}
+
+static void
+DrainCompressor(
+    TkExportInfo *infoPtr)
+{
+    Tcl_Size length;
+    unsigned char *bytes;
+
+    Tcl_ZlibStreamGet(infoPtr->zstream, infoPtr->zbufObj, TCL_INDEX_NONE);
+    bytes = Tcl_GetByteArrayFromObj(infoPtr->zbufObj, &length);
+    WriteOutput(infoPtr, (const char *) bytes, length);
+    Tcl_SetByteArrayLength(infoPtr->zbufObj, 0);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * AllocObject, BeginObject, WriteStream --
+ *
+ *	Utilities for writing the objects of a PDF file. AllocObject reserves
+ *	an object number, BeginObject records the position of an object for
+ *	the xref table and starts it, and WriteStream completes an object
+ *	that was started with BeginObject as a stream object holding the
+ *	given bytes.
+ *
+ * Results:
+ *	AllocObject returns the new object number.
+ *
+ * Side effects:
+ *	Output is written.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+AllocObject(
+    TkExportInfo *infoPtr)
+{
+    if (infoPtr->numObjs >= infoPtr->objSpace) {
+	infoPtr->objSpace = (infoPtr->objSpace == 0) ? 32
+		: 2 * infoPtr->objSpace;
+	infoPtr->objOffsets = (Tcl_WideInt *)ckrealloc(infoPtr->objOffsets,
+		infoPtr->objSpace * sizeof(Tcl_WideInt));
+    }
+    infoPtr->objOffsets[infoPtr->numObjs] = 0;
+    return infoPtr->numObjs++;
+}
+
+static void
+BeginObject(
+    TkExportInfo *infoPtr,
+    int objNum)
+{
+    FlushOutput(infoPtr);
+    infoPtr->objOffsets[objNum] = infoPtr->offset;
+    Tcl_AppendPrintfToObj(infoPtr->bufObj, "%d 0 obj\n", objNum);
+}
+
+static void
+WriteStream(
+    TkExportInfo *infoPtr,
+    const char *dict,		/* Entries for the stream dictionary, other
+				 * than /Length. */
+    const unsigned char *bytes,
+    Tcl_Size length)
+{
+    Tcl_AppendPrintfToObj(infoPtr->bufObj,
+	    "<< %s /Length %" TCL_SIZE_MODIFIER "d >>\nstream\n", dict, length);
+    FlushOutput(infoPtr);
+    WriteOutput(infoPtr, (const char *) bytes, length);
+    Tcl_AppendToObj(infoPtr->bufObj, "\nendstream\nendobj\n", TCL_INDEX_NONE);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * WritePdfHeader, WritePdfTrailer --
+ *
+ *	Output the fixed objects at the start of a PDF document (catalog, page
+ *	tree and page), and the xref table and trailer at its end.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Output is written.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+WritePdfHeader(
+    TkExportInfo *infoPtr)
+{
+    int i;
+
+    for (i = 0; i < PDF_FIRST_FREE_OBJ; i++) {
+	AllocObject(infoPtr);
+    }
+
+    /*
+     * The comment on the second line contains bytes above 127, marking the
+     * file as binary for transfer programs.
+     */
+
+    Tcl_AppendToObj(infoPtr->bufObj, "%PDF-1.4\n%", TCL_INDEX_NONE);
+    FlushOutput(infoPtr);
+    WriteOutput(infoPtr, "\342\343\317\323\n", 5);
+
+    BeginObject(infoPtr, PDF_CATALOG_OBJ);
+    Tcl_AppendPrintfToObj(infoPtr->bufObj,
+	    "<< /Type /Catalog /Pages %d 0 R >>\nendobj\n", PDF_PAGES_OBJ);
+    BeginObject(infoPtr, PDF_PAGES_OBJ);
+    Tcl_AppendPrintfToObj(infoPtr->bufObj,
+	    "<< /Type /Pages /Kids [%d 0 R] /Count 1 >>\nendobj\n",
+	    PDF_PAGE_OBJ);
+    BeginObject(infoPtr, PDF_PAGE_OBJ);
+    Tcl_AppendPrintfToObj(infoPtr->bufObj,
+	    "<< /Type /Page /Parent %d 0 R /MediaBox [0 0 %.10g %.10g]\n"
+	    "   /Resources %d 0 R /Contents %d 0 R >>\nendobj\n",
+	    PDF_PAGES_OBJ, infoPtr->width * infoPtr->scale,
+	    infoPtr->height * infoPtr->scale, PDF_RESOURCES_OBJ,
+	    PDF_CONTENTS_OBJ);
+}
+
+static void
+WritePdfTrailer(
+    TkExportInfo *infoPtr)
+{
+    Tcl_WideInt xrefOffset;
+    int i;
+
+    FlushOutput(infoPtr);
+    xrefOffset = infoPtr->offset;
+    Tcl_AppendPrintfToObj(infoPtr->bufObj,
+	    "xref\n0 %d\n0000000000 65535 f \n", infoPtr->numObjs);
+    for (i = 1; i < infoPtr->numObjs; i++) {
+	Tcl_AppendPrintfToObj(infoPtr->bufObj,
+		"%010" TCL_LL_MODIFIER "d 00000 n \n",
+		(long long) infoPtr->objOffsets[i]);
+    }
+    Tcl_AppendPrintfToObj(infoPtr->bufObj,
+	    "trailer\n<< /Size %d /Root %d 0 R >>\n"
+	    "startxref\n%" TCL_LL_MODIFIER "d\n%%%%EOF\n",
+	    infoPtr->numObjs, PDF_CATALOG_OBJ, (long long) xrefOffset);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * WriteSvgHeader --
+ *
+ *	Output the XML declaration and the opening tag of an SVG document.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Output is written.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+WriteSvgHeader(
+    TkExportInfo *infoPtr,
+    Tk_Window tkwin)
+{
+    Tcl_AppendPrintfToObj(infoPtr->bufObj,
+	    "<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
+	    "<svg xmlns=\"http://www.w3.org/2000/svg\""
+	    " xmlns:xlink=\"http://www.w3.org/1999/xlink\" version=\"1.1\"\n"
+	    "     width=\"%d\" height=\"%d\" viewBox=\"%d %d %d %d\">\n"
+	    "<desc>Created by Tk Canvas Widget: ",
+	    infoPtr->width, infoPtr->height, infoPtr->x, infoPtr->y,
+	    infoPtr->width, infoPtr->height);
+    AppendEscapedText(infoPtr, Tk_PathName(tkwin), TCL_INDEX_NONE);
+    Tcl_AppendToObj(infoPtr->bufObj, "</desc>\n", TCL_INDEX_NONE);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetBitmapImage --
+ *
+ *	Fetch the bits of a bitmap used as stipple or drawn by a bitmap item.
+ *
+ * Results:
+ *	An XImage holding the bitmap, which the caller must free with
+ *	XDestroyImage, or NULL if the bits aren't available.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static XImage *
+GetBitmapImage(
+    TkExportInfo *infoPtr,
+    Pixmap bitmap,
+    int *widthPtr,
+    int *heightPtr)
+{
+    Window dummyRoot;
+    int dummyX, dummyY;
+    unsigned width, height, dummyBorderwidth, dummyDepth;
+
+    /*
+     * As in tkCanvPs.c, XGetGeometry is used rather than Tk_SizeOfBitmap
+     * because custom item types may use bitmaps not registered with Tk.
+     */
+
+    XGetGeometry(Tk_Display(infoPtr->tkwin), bitmap, &dummyRoot,
+	    &dummyX, &dummyY, &width, &height, &dummyBorderwidth,
+	    &dummyDepth);
+    *widthPtr = (int) width;
+    *heightPtr = (int) height;
+    return XGetImage(Tk_Display(infoPtr->tkwin), bitmap, 0, 0, width,
+	    height, 1, XYPixmap);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetResource --
+ *
+ *	Look up the resource for a font, image, stipple or bitmap. During the
+ *	pre-pass, resources are created as they are encountered; afterwards
+ *	only resources that were written successfully are returned.
+ *
+ * Results:
+ *	The resource, or NULL if it can't be used.
+ *
+ * Side effects:
+ *	A new resource may be created.
+ *
+ *--------------------------------------------------------------
+ */
+
+static ExportResource *
+GetResource(
+    TkExportInfo *infoPtr,
+    Tcl_HashTable *tablePtr,
+    const void *key)
+{
+    Tcl_HashEntry *hPtr;
+    ExportResource *resPtr;
+    int isNew;
+
+    if (!infoPtr->prepass) {
+	hPtr = Tcl_FindHashEntry(tablePtr, key);
+	if (hPtr == NULL) {
+	    return NULL;
+	}
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	return (resPtr->objNum != 0) ? resPtr : NULL;
+    }
+    hPtr = Tcl_CreateHashEntry(tablePtr, key, &isNew);
+    if (isNew) {
+	resPtr = (ExportResource *)ckalloc(sizeof(ExportResource));
+	resPtr->id = ++infoPtr->numResources;
+	resPtr->objNum = 0;
+	Tcl_SetHashValue(hPtr, resPtr);
+    }
+    return (ExportResource *)Tcl_GetHashValue(hPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * AppendBitmapPath --
+ *
+ *	Append SVG path data covering the bits that are set in a bitmap, one
+ *	rectangle per horizontal run of set bits.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Output is appended to bufObj.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+AppendBitmapPath(
+    Tcl_Obj *bufObj,
+    XImage *imagePtr,
+    int width,
+    int height)
+{
+    int x, y, start;
+
+    for (y = 0; y < height; y++) {
+	for (x = 0; x < width; x++) {
+	    start = x;
+	    while ((x < width) && XGetPixel(imagePtr, x, y)) {
+		x++;
+	    }
+	    if (x > start) {
+		Tcl_AppendPrintfToObj(bufObj, "M%d %dh%dv1h%dz",
+			start, y, x - start, start - x);
+	    }
+	}
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * WriteResources --
+ *
+ *	Output the fonts, images, stipples and bitmaps collected during the
+ *	pre-pass. For SVG they become a <defs> section, for PDF they become
+ *	separate objects plus the resource dictionary of the page.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Output is written. Resources that could not be written are left with
+ *	an objNum of 0, so that the items using them skip them.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+WriteResources(
+    TkExportInfo *infoPtr)
+{
+    Tcl_Obj *bufObj = infoPtr->bufObj;
+    Tcl_HashSearch search;
+    Tcl_HashEntry *hPtr;
+    ExportResource *resPtr;
+    XImage *imagePtr;
+    Tcl_Obj *dataObj, *listObj;
+    int x, y, width, height, pdf = (infoPtr->format == EXPORT_PDF);
+
+    if (!pdf) {
+	Tcl_AppendToObj(bufObj, "<defs>\n", TCL_INDEX_NONE);
+	if (infoPtr->fontTable.numEntries > 0) {
+	    Tcl_AppendToObj(bufObj, "<style type=\"text/css\"><![CDATA[\n",
+		    TCL_INDEX_NONE);
+	    for (hPtr = Tcl_FirstHashEntry(&infoPtr->fontTable, &search);
+		    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+		resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+		Tcl_AppendPrintfToObj(bufObj, ".f%d {%s}\n", resPtr->id,
+			(char *) Tcl_GetHashKey(&infoPtr->fontTable, hPtr));
+		resPtr->objNum = 1;
+	    }
+	    Tcl_AppendToObj(bufObj, "]]></style>\n", TCL_INDEX_NONE);
+	}
+    } else {
+	for (hPtr = Tcl_FirstHashEntry(&infoPtr->fontTable, &search);
+		hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	    resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	    resPtr->objNum = AllocObject(infoPtr);
+	    BeginObject(infoPtr, resPtr->objNum);
+	    Tcl_AppendPrintfToObj(bufObj,
+		    "<< /Type /Font /Subtype /Type1 /BaseFont /%s"
+		    " /Encoding /WinAnsiEncoding >>\nendobj\n",
+		    (char *) Tcl_GetHashKey(&infoPtr->fontTable, hPtr));
+	}
+    }
+
+    /*
+     * Stipples are anchored at the canvas origin. In SVG they are used as a
+     * mask covering the exported area; in PDF as an uncolored tiling pattern
+     * that shares the mapping of the page contents.
+     */
+
+    for (hPtr = Tcl_FirstHashEntry(&infoPtr->stippleTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	imagePtr = GetBitmapImage(infoPtr,
+		(Pixmap) PTR2UINT(Tcl_GetHashKey(&infoPtr->stippleTable, hPtr)),
+		&width, &height);
+	if (imagePtr == NULL) {
+	    continue;
+	}
+	if (!pdf) {
+	    Tcl_AppendPrintfToObj(bufObj,
+		    "<pattern id=\"p%d\" width=\"%d\" height=\"%d\""
+		    " patternUnits=\"userSpaceOnUse\">"
+		    "<path fill=\"#fff\" d=\"", resPtr->id, width, height);
+	    AppendBitmapPath(bufObj, imagePtr, width, height);
+	    Tcl_AppendPrintfToObj(bufObj,
+		    "\"/></pattern>\n<mask id=\"s%d\" maskUnits=\"userSpaceOnUse\""
+		    " x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\">"
+		    "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\""
+		    " fill=\"url(#p%d)\"/></mask>\n", resPtr->id,
+		    infoPtr->x, infoPtr->y, infoPtr->width, infoPtr->height,
+		    infoPtr->x, infoPtr->y, infoPtr->width, infoPtr->height,
+		    resPtr->id);
+	    resPtr->objNum = 1;
+	} else {
+	    Tcl_Obj *streamObj = Tcl_ObjPrintf(
+		    "q %d 0 0 %d 0 %d cm\n"
+		    "BI /W %d /H %d /IM true /D [1 0] /F /AHx ID\n",
+		    width, -height, height, width, height);
+	    Tcl_Size length;
+	    const char *bytes;
+
+	    for (y = 0; y < height; y++) {
+		int value = 0, mask = 0x80;
+
+		for (x = 0; x < width; x++) {
+		    if (XGetPixel(imagePtr, x, y)) {
+			value |= mask;
+		    }
+		    mask >>= 1;
+		    if (mask == 0) {
+			Tcl_AppendPrintfToObj(streamObj, "%02x", value);
+			value = 0;
+			mask = 0x80;
+		    }
+		}
+		if (mask != 0x80) {
+		    Tcl_AppendPrintfToObj(streamObj, "%02x", value);
+		}
+		Tcl_AppendToObj(streamObj, "\n", 1);
+	    }
+	    Tcl_AppendToObj(streamObj, ">\nEI\nQ", TCL_INDEX_NONE);
+	    bytes = Tcl_GetStringFromObj(streamObj, &length);
+	    resPtr->objNum = AllocObject(infoPtr);
+	    BeginObject(infoPtr, resPtr->objNum);
+	    listObj = Tcl_ObjPrintf(
+		    "/Type /Pattern /PatternType 1 /PaintType 2 /TilingType 1\n"
+		    "   /BBox [0 0 %d %d] /XStep %d /YStep %d /Resources << >>\n"
+		    "   /Matrix [%.10g 0 0 %.10g %.10g %.10g]", width, height,
+		    width, height, infoPtr->scale, -infoPtr->scale,
+		    -infoPtr->x * infoPtr->scale,
+		    infoPtr->y2 * infoPtr->scale);
+	    Tcl_IncrRefCount(listObj);
+	    WriteStream(infoPtr, Tcl_GetString(listObj),
+		    (const unsigned char *) bytes, length);
+	    Tcl_DecrRefCount(listObj);
+	    Tcl_DecrRefCount(streamObj);
+	}
+	XDestroyImage(imagePtr);
+    }
+
+    /*
+     * Bitmaps drawn by items are painted in the current fill color: an SVG
+     * path referenced with <use>, or a PDF image mask.
+     */
+
+    for (hPtr = Tcl_FirstHashEntry(&infoPtr->bitmapTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	imagePtr = GetBitmapImage(infoPtr,
+		(Pixmap) PTR2UINT(Tcl_GetHashKey(&infoPtr->bitmapTable, hPtr)),
+		&width, &height);
+	if (imagePtr == NULL) {
+	    continue;
+	}
+	if (!pdf) {
+	    Tcl_AppendPrintfToObj(bufObj, "<path id=\"b%d\" d=\"", resPtr->id);
+	    AppendBitmapPath(bufObj, imagePtr, width, height);
+	    Tcl_AppendToObj(bufObj, "\"/>\n", TCL_INDEX_NONE);
+	    resPtr->objNum = 1;
+	} else {
+	    int rowBytes = (width + 7) / 8;
+	    unsigned char *bits;
+
+	    bits = (unsigned char *)ckalloc(rowBytes * height + 1);
+
+	    memset(bits, 0, rowBytes * height + 1);
+	    for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+		    if (XGetPixel(imagePtr, x, y)) {
+			bits[y*rowBytes + x/8] |= 0x80 >> (x % 8);
+		    }
+		}
+	    }
+	    resPtr->objNum = AllocObject(infoPtr);
+	    BeginObject(infoPtr, resPtr->objNum);
+	    listObj = Tcl_ObjPrintf("/Type /XObject /Subtype /Image"
+		    " /Width %d /Height %d /ImageMask true /Decode [1 0]",
+		    width, height);
+	    Tcl_IncrRefCount(listObj);
+	    WriteStream(infoPtr, Tcl_GetString(listObj), bits,
+		    rowBytes * height);
+	    Tcl_DecrRefCount(listObj);
+	    ckfree(bits);
+	}
+	XDestroyImage(imagePtr);
+    }
+
+    /*
+     * Photo images: PNG data for SVG, compressed RGB samples with an
+     * optional soft mask for PDF.
+     */
+
+    for (hPtr = Tcl_FirstHashEntry(&infoPtr->imageTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	const char *name = (const char *)
+		Tcl_GetHashKey(&infoPtr->imageTable, hPtr);
+	Tk_PhotoHandle photo = Tk_FindPhoto(infoPtr->interp, name);
+	Tk_PhotoImageBlock block;
+
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	if (photo == NULL) {
+	    continue;
+	}
+	Tk_PhotoGetImage(photo, &block);
+	if ((block.width <= 0) || (block.height <= 0)) {
+	    continue;
+	}
+	if (!pdf) {
+	    static const char base64[] =
+		    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+		    "0123456789+/";
+	    Tcl_Obj *cmdObjs[4];
+	    const unsigned char *bytes;
+	    char quad[4];
+	    Tcl_Size i, length;
+
+	    cmdObjs[0] = Tcl_NewStringObj(name, TCL_INDEX_NONE);
+	    cmdObjs[1] = Tcl_NewStringObj("data", TCL_INDEX_NONE);
+	    cmdObjs[2] = Tcl_NewStringObj("-format", TCL_INDEX_NONE);
+	    cmdObjs[3] = Tcl_NewStringObj("png", TCL_INDEX_NONE);
+	    for (i = 0; i < 4; i++) {
+		Tcl_IncrRefCount(cmdObjs[i]);
+	    }
+	    x = Tcl_EvalObjv(infoPtr->interp, 4, cmdObjs, TCL_EVAL_GLOBAL);
+	    for (i = 0; i < 4; i++) {
+		Tcl_DecrRefCount(cmdObjs[i]);
+	    }
+	    if (x != TCL_OK) {
+		Tcl_ResetResult(infoPtr->interp);
+		continue;
+	    }
+	    dataObj = Tcl_GetObjResult(infoPtr->interp);
+	    Tcl_IncrRefCount(dataObj);
+	    Tcl_ResetResult(infoPtr->interp);
+	    bytes = Tcl_GetByteArrayFromObj(dataObj, &length);
+	    Tcl_AppendPrintfToObj(bufObj,
+		    "<image id=\"i%d\" width=\"%d\" height=\"%d\""
+		    " xlink:href=\"data:image/png;base64,", resPtr->id,
+		    block.width, block.height);
+	    for (i = 0; i < length; i += 3) {
+		int n = (int) ((length - i < 3) ? length - i : 3);
+		unsigned value = bytes[i] << 16;
+
+		if (n > 1) {
+		    value |= bytes[i+1] << 8;
+		}
+		if (n > 2) {
+		    value |= bytes[i+2];
+		}
+		quad[0] = base64[(value >> 18) & 0x3f];
+		quad[1] = base64[(value >> 12) & 0x3f];
+		quad[2] = (n > 1) ? base64[(value >> 6) & 0x3f] : '=';
+		quad[3] = (n > 2) ? base64[value & 0x3f] : '=';
+		Tcl_AppendToObj(bufObj, quad, 4);
+		MaybeFlushOutput(infoPtr);
+	    }
+	    Tcl_AppendToObj(bufObj, "\"/>\n", TCL_INDEX_NONE);
+	    Tcl_DecrRefCount(dataObj);
+	    resPtr->objNum = 1;
+	} else {
+	    Tcl_Obj *rgbObj, *alphaObj;
+	    unsigned char *rgb, *alpha, *pixelPtr;
+	    int hasAlpha = 0, maskObj = 0;
+	    Tcl_Size length;
+
+	    rgbObj = Tcl_NewByteArrayObj(NULL, 3 * block.width * block.height);
+	    alphaObj = Tcl_NewByteArrayObj(NULL, block.width * block.height);
+	    Tcl_IncrRefCount(rgbObj);
+	    Tcl_IncrRefCount(alphaObj);
+	    rgb = Tcl_GetByteArrayFromObj(rgbObj, (Tcl_Size *)NULL);
+	    alpha = Tcl_GetByteArrayFromObj(alphaObj, (Tcl_Size *)NULL);
+	    for (y = 0; y < block.height; y++) {
+		pixelPtr = block.pixelPtr + y * block.pitch;
+		for (x = 0; x < block.width; x++) {
+		    *rgb++ = pixelPtr[block.offset[0]];
+		    *rgb++ = pixelPtr[block.offset[1]];
+		    *rgb++ = pixelPtr[block.offset[2]];
+		    *alpha = (block.offset[3] < block.pixelSize)
+			    ? pixelPtr[block.offset[3]] : 255;
+		    if (*alpha++ != 255) {
+			hasAlpha = 1;
+		    }
+		    pixelPtr += block.pixelSize;
+		}
+	    }
+
+	    if (hasAlpha && (Tcl_ZlibDeflate(infoPtr->interp,
+		    TCL_ZLIB_FORMAT_ZLIB, alphaObj, TCL_ZLIB_COMPRESS_DEFAULT,
+		    NULL) == TCL_OK)) {
+		dataObj = Tcl_GetObjResult(infoPtr->interp);
+		Tcl_IncrRefCount(dataObj);
+		Tcl_ResetResult(infoPtr->interp);
+		maskObj = AllocObject(infoPtr);
+		BeginObject(infoPtr, maskObj);
+		listObj = Tcl_ObjPrintf("/Type /XObject /Subtype /Image"
+			" /Width %d /Height %d /ColorSpace /DeviceGray"
+			" /BitsPerComponent 8 /Filter /FlateDecode",
+			block.width, block.height);
+		Tcl_IncrRefCount(listObj);
+		rgb = Tcl_GetByteArrayFromObj(dataObj, &length);
+		WriteStream(infoPtr, Tcl_GetString(listObj), rgb, length);
+		Tcl_DecrRefCount(listObj);
+		Tcl_DecrRefCount(dataObj);
+	    }
+	    Tcl_ResetResult(infoPtr->interp);
+	    if (Tcl_ZlibDeflate(infoPtr->interp, TCL_ZLIB_FORMAT_ZLIB, rgbObj,
+		    TCL_ZLIB_COMPRESS_DEFAULT, NULL) == TCL_OK) {
+		dataObj = Tcl_GetObjResult(infoPtr->interp);
+		Tcl_IncrRefCount(dataObj);
+		Tcl_ResetResult(infoPtr->interp);
+		resPtr->objNum = AllocObject(infoPtr);
+		BeginObject(infoPtr, resPtr->objNum);
+		listObj = Tcl_ObjPrintf("/Type /XObject /Subtype /Image"
+			" /Width %d /Height %d /ColorSpace /DeviceRGB"
+			" /BitsPerComponent 8 /Filter /FlateDecode",
+			block.width, block.height);
+		if (maskObj != 0) {
+		    Tcl_AppendPrintfToObj(listObj, " /SMask %d 0 R", maskObj);
+		}
+		Tcl_IncrRefCount(listObj);
+		rgb = Tcl_GetByteArrayFromObj(dataObj, &length);
+		WriteStream(infoPtr, Tcl_GetString(listObj), rgb, length);
+		Tcl_DecrRefCount(listObj);
+		Tcl_DecrRefCount(dataObj);
+	    }
+	    Tcl_ResetResult(infoPtr->interp);
+	    Tcl_DecrRefCount(rgbObj);
+	    Tcl_DecrRefCount(alphaObj);
+	}
+    }
+
+    if (!pdf) {
+	Tcl_AppendToObj(bufObj, "</defs>\n", TCL_INDEX_NONE);
+	FlushOutput(infoPtr);
+	return;
+    }
+
+    /*
+     * The resource dictionary of the PDF page.
+     */
+
+    BeginObject(infoPtr, PDF_RESOURCES_OBJ);
+    Tcl_AppendToObj(bufObj, "<< /ProcSet [/PDF /Text /ImageB /ImageC]\n"
+	    "   /ColorSpace << /CsP [/Pattern /DeviceRGB] >>\n   /Font <<",
+	    TCL_INDEX_NONE);
+    for (hPtr = Tcl_FirstHashEntry(&infoPtr->fontTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	Tcl_AppendPrintfToObj(bufObj, " /F%d %d 0 R", resPtr->id,
+		resPtr->objNum);
+    }
+    Tcl_AppendToObj(bufObj, " >>\n   /Pattern <<", TCL_INDEX_NONE);
+    for (hPtr = Tcl_FirstHashEntry(&infoPtr->stippleTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	if (resPtr->objNum != 0) {
+	    Tcl_AppendPrintfToObj(bufObj, " /P%d %d 0 R", resPtr->id,
+		    resPtr->objNum);
+	}
+    }
+    Tcl_AppendToObj(bufObj, " >>\n   /XObject <<", TCL_INDEX_NONE);
+    for (hPtr = Tcl_FirstHashEntry(&infoPtr->bitmapTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	if (resPtr->objNum != 0) {
+	    Tcl_AppendPrintfToObj(bufObj, " /Bm%d %d 0 R", resPtr->id,
+		    resPtr->objNum);
+	}
+    }
+    for (hPtr = Tcl_FirstHashEntry(&infoPtr->imageTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	resPtr = (ExportResource *)Tcl_GetHashValue(hPtr);
+	if (resPtr->objNum != 0) {
+	    Tcl_AppendPrintfToObj(bufObj, " /Im%d %d 0 R", resPtr->id,
+		    resPtr->objNum);
+	}
+    }
+    Tcl_AppendToObj(bufObj, " >> >>\nendobj\n", TCL_INDEX_NONE);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * AppendColor --
+ *
+ *	Append a color to the pending output: as "#rrggbb" for SVG, or as
+ *	an "r g b" triple followed by the given operator for PDF.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Output is appended to bufObj.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+AppendColor(
+    TkExportInfo *infoPtr,
+    XColor *colorPtr,
+    const char *pdfOperator)	/* PDF operator following the components,
+				 * e.g. "rg", or NULL for none. */
+{
+    if (infoPtr->format == EXPORT_SVG) {
+	Tcl_AppendPrintfToObj(infoPtr->bufObj, "#%02x%02x%02x",
+		(colorPtr->red >> 8) & 0xff, (colorPtr->green >> 8) & 0xff,
+		(colorPtr->blue >> 8) & 0xff);
+    } else {
+	Tcl_AppendPrintfToObj(infoPtr->bufObj, "%.3g %.3g %.3g%s%s",
+		((double) (colorPtr->red >> 8))/255.0,
+		((double) (colorPtr->green >> 8))/255.0,
+		((double) (colorPtr->blue >> 8))/255.0,
+		(pdfOperator ? " " : ""), (pdfOperator ? pdfOperator : ""));
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * AppendEscapedText --
+ *
+ *	Append text to the pending output, escaped as XML character data for
+ *	SVG, or converted to the encoding of the standard fonts and escaped
+ *	as the contents of a string for PDF.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Output is appended to bufObj.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+AppendEscapedText(
+    TkExportInfo *infoPtr,
+    const char *string,
+    Tcl_Size numBytes)		/* Number of bytes of string, or -1 for all
+				 * up to the terminating NUL. */
+{
+    Tcl_Obj *bufObj = infoPtr->bufObj;
+    const char *p, *end, *last;
+
+    if (numBytes < 0) {
+	numBytes = strlen(string);
+    }
+    if (infoPtr->format == EXPORT_SVG) {
+	last = string;
+	end = string + numBytes;
+	for (p = string; p < end; p++) {
+	    const char *entity;
+
+	    switch (*p) {
+	    case '&':  entity = "&amp;";  break;
+	    case '<':  entity = "&lt;";   break;
+	    case '>':  entity = "&gt;";   break;
+	    case '"':  entity = "&quot;"; break;
+	    default:   continue;
+	    }
+	    Tcl_AppendToObj(bufObj, last, p - last);
+	    Tcl_AppendToObj(bufObj, entity, TCL_INDEX_NONE);
+	    last = p + 1;
+	}
+	Tcl_AppendToObj(bufObj, last, end - last);
+    } else {
+	Tcl_DString ds;
+
+	Tcl_UtfToExternalDString(infoPtr->encoding, string, numBytes, &ds);
+	end = Tcl_DStringValue(&ds) + Tcl_DStringLength(&ds);
+	for (p = Tcl_DStringValue(&ds); p < end; p++) {
+	    unsigned char c = UCHAR(*p);
+
+	    if ((c == '(') || (c == ')') || (c == '\\') || (c < 0x20)
+		    || (c > 0x7e)) {
+		Tcl_AppendPrintfToObj(bufObj, "\\%03o", c);
+	    } else {
+		Tcl_AppendToObj(bufObj, p, 1);
+	    }
+	}
+	Tcl_DStringFree(&ds);
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvExportPath --
+ *
+ *	This function is called by item types during the "export" widget
+ *	command to add a polyline, given in canvas coordinates, to the
+ *	current path. The path is painted by TkCanvExportPaint.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The current path is extended.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+TkCanvExportPath(
+    Tk_Canvas canvas,		/* Canvas being exported. */
+    const double *coordPtr,	/* Array of x- and y-coordinates. */
+    Tcl_Size numPoints,		/* Number of points at coordPtr. */
+    int closed)			/* Non-zero means close the polyline. */
+{
+    TkExportInfo *infoPtr = Canvas(canvas)->exportInfo;
+    Tcl_Size i;
+
+    if ((infoPtr == NULL) || infoPtr->prepass || (numPoints < 1)) {
+	return;
+    }
+    if (infoPtr->format == EXPORT_SVG) {
+	Tcl_AppendPrintfToObj(infoPtr->pathObj, "M%.10g %.10g",
+		coordPtr[0], coordPtr[1]);
+	for (i = 1; i < numPoints; i++) {
+	    Tcl_AppendPrintfToObj(infoPtr->pathObj, "%s%.10g %.10g",
+		    (i == 1) ? "L" : " ", coordPtr[2*i], coordPtr[2*i+1]);
+	}
+	if (closed) {
+	    Tcl_AppendToObj(infoPtr->pathObj, "Z", 1);
+	}
+    } else {
+	Tcl_AppendPrintfToObj(infoPtr->pathObj, "%.10g %.10g m\n",
+		coordPtr[0], coordPtr[1]);
+	for (i = 1; i < numPoints; i++) {
+	    Tcl_AppendPrintfToObj(infoPtr->pathObj, "%.10g %.10g l\n",
+		    coordPtr[2*i], coordPtr[2*i+1]);
+	}
+	if (closed) {
+	    Tcl_AppendToObj(infoPtr->pathObj, "h\n", TCL_INDEX_NONE);
+	}
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvExportArcPath --
+ *
+ *	This function is called by item types during the "export" widget
+ *	command to add an elliptical arc to the current path. The arc is
+ *	approximated with cubic Bezier curves of at most 90 degrees each.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The current path is extended.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+TkCanvExportArcPath(
+    Tk_Canvas canvas,		/* Canvas being exported. */
+    const double *bbox,		/* Bounding box (x1, y1, x2, y2) of the
+				 * ellipse the arc is a piece of. */
+    double start,		/* Start angle in degrees, counter-clockwise
+				 * from the 3 o'clock position. */
+    double extent,		/* Angular extent in degrees; 360 or more
+				 * means the whole ellipse. */
+    int style)			/* TK_EXPORT_ARC_OPEN, TK_EXPORT_ARC_CHORD
+				 * or TK_EXPORT_ARC_PIESLICE. */
+{
+    TkExportInfo *infoPtr = Canvas(canvas)->exportInfo;
+    double cx, cy, rx, ry, a0, a1, step, k;
+    int i, numSegments, svg;
+    Tcl_Obj *pathObj;
+
+    if ((infoPtr == NULL) || infoPtr->prepass || (extent == 0.0)) {
+	return;
+    }
+    svg = (infoPtr->format == EXPORT_SVG);
+    pathObj = infoPtr->pathObj;
+    cx = (bbox[0] + bbox[2]) / 2.0;
+    cy = (bbox[1] + bbox[3]) / 2.0;
+    rx = (bbox[2] - bbox[0]) / 2.0;
+    ry = (bbox[3] - bbox[1]) / 2.0;
+    if (extent >= 360.0 || extent <= -360.0) {
+	extent = 360.0;
+	style = TK_EXPORT_ARC_CHORD;
+    }
+    numSegments = (int) ceil(fabs(extent) / 90.0);
+    step = extent / numSegments * PI / 180.0;
+    k = 4.0 / 3.0 * tan(step / 4.0);
+    a0 = start * PI / 180.0;
+
+    if (style == TK_EXPORT_ARC_PIESLICE) {
+	Tcl_AppendPrintfToObj(pathObj, svg ? "M%.10g %.10gL" : "%.10g %.10g m\n",
+		cx, cy);
+	Tcl_AppendPrintfToObj(pathObj, svg ? "%.10g %.10g" : "%.10g %.10g l\n",
+		cx + rx*cos(a0), cy - ry*sin(a0));
+    } else {
+	Tcl_AppendPrintfToObj(pathObj, svg ? "M%.10g %.10g" : "%.10g %.10g m\n",
+		cx + rx*cos(a0), cy - ry*sin(a0));
+    }
+    for (i = 0; i < numSegments; i++) {
+	a1 = a0 + step;
+	Tcl_AppendPrintfToObj(pathObj, svg
+		? "C%.10g %.10g %.10g %.10g %.10g %.10g"
+		: "%.10g %.10g %.10g %.10g %.10g %.10g c\n",
+		cx + rx*(cos(a0) - k*sin(a0)), cy - ry*(sin(a0) + k*cos(a0)),
+		cx + rx*(cos(a1) + k*sin(a1)), cy - ry*(sin(a1) - k*cos(a1)),
+		cx + rx*cos(a1), cy - ry*sin(a1));
+	a0 = a1;
+    }
+    if (style != TK_EXPORT_ARC_OPEN) {
+	Tcl_AppendToObj(pathObj, svg ? "Z" : "h\n", TCL_INDEX_NONE);
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvExportPaint --
+ *
+ *	This function is called by item types during the "export" widget
+ *	command to fill and/or stroke the current path. The outline is drawn
+ *	according to the current state of the item, exactly like
+ *	Tk_CanvasPsOutline does for Postscript. Filling uses the even-odd
+ *	rule, like the X server does for canvas items.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Output is generated and the current path is cleared. During the
+ *	pre-pass the stipples are registered instead.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkCanvExportPaint(
+    Tk_Canvas canvas,		/* Canvas being exported. */
+    Tk_Item *itemPtr,		/* Item being exported. */
+    XColor *fillColor,		/* Color to fill the path with, or NULL. */
+    Pixmap fillStipple,		/* Stipple for filling, or None. */
+    Tk_Outline *outline,	/* Outline to stroke the path with, or NULL. */
+    int capStyle,		/* X cap style for the outline. */
+    int joinStyle)		/* X join style for the outline. */
+{
+    TkExportInfo *infoPtr = Canvas(canvas)->exportInfo;
+    Tcl_Obj *bufObj;
+    ExportResource *fillRes = NULL, *strokeRes = NULL;
+    XColor *color = NULL;
+    Pixmap stipple = None;
+    Tk_Dash *dash = NULL;
+    double width = 0.0;
+    char *dashes = NULL;
+    int i, numDashes = 0, svg;
+    Tk_State state = itemPtr->state;
+
+    if (infoPtr == NULL) {
+	return TCL_OK;
+    }
+    bufObj = infoPtr->bufObj;
+    svg = (infoPtr->format == EXPORT_SVG);
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    if (outline != NULL) {
+	width = outline->width;
+	dash = &outline->dash;
+	color = outline->color;
+	stipple = outline->stipple;
+	if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	    if (outline->activeWidth > width) {
+		width = outline->activeWidth;
+	    }
+	    if (outline->activeDash.number > 0) {
+		dash = &outline->activeDash;
+	    }
+	    if (outline->activeColor != NULL) {
+		color = outline->activeColor;
+	    }
+	    if (outline->activeStipple != None) {
+		stipple = outline->activeStipple;
+	    }
+	} else if (state == TK_STATE_DISABLED) {
+	    if (outline->disabledWidth > 0) {
+		width = outline->disabledWidth;
+	    }
+	    if (outline->disabledDash.number > 0) {
+		dash = &outline->disabledDash;
+	    }
+	    if (outline->disabledColor != NULL) {
+		color = outline->disabledColor;
+	    }
+	    if (outline->disabledStipple != None) {
+		stipple = outline->disabledStipple;
+	    }
+	}
+	if (width < 1.0) {
+	    width = 1.0;
+	}
+    }
+    if (fillColor == NULL) {
+	fillStipple = None;
+    }
+    if (color == NULL) {
+	stipple = None;
+    }
+
+    if (fillStipple != None) {
+	fillRes = GetResource(infoPtr, &infoPtr->stippleTable,
+		UINT2PTR(fillStipple));
+    }
+    if (stipple != None) {
+	strokeRes = GetResource(infoPtr, &infoPtr->stippleTable,
+		UINT2PTR(stipple));
+    }
+    if (infoPtr->prepass || ((fillColor == NULL) && (color == NULL))) {
+	Tcl_SetObjLength(infoPtr->pathObj, 0);
+	return TCL_OK;
+    }
+    if (color != NULL) {
+	numDashes = TkCanvOutlineDashes(dash, width, &dashes);
+    }
+
+    if (svg) {
+	int separate = (fillColor != NULL) && (color != NULL)
+		&& (fillRes != strokeRes);
+
+	Tcl_AppendToObj(bufObj, "<path d=\"", TCL_INDEX_NONE);
+	Tcl_AppendObjToObj(bufObj, infoPtr->pathObj);
+	Tcl_AppendToObj(bufObj, "\"", 1);
+	if (fillColor != NULL) {
+	    Tcl_AppendToObj(bufObj, " fill=\"", TCL_INDEX_NONE);
+	    AppendColor(infoPtr, fillColor, NULL);
+	    Tcl_AppendToObj(bufObj, "\"", 1);
+	} else {
+	    Tcl_AppendToObj(bufObj, " fill=\"none\"", TCL_INDEX_NONE);
+	}
+	if (separate) {
+	    if (fillRes != NULL) {
+		Tcl_AppendPrintfToObj(bufObj, " mask=\"url(#s%d)\"",
+			fillRes->id);
+	    }
+	    Tcl_AppendToObj(bufObj, "/>\n<path d=\"", TCL_INDEX_NONE);
+	    Tcl_AppendObjToObj(bufObj, infoPtr->pathObj);
+	    Tcl_AppendToObj(bufObj, "\" fill=\"none\"", TCL_INDEX_NONE);
+	}
+	if (color != NULL) {
+	    Tcl_AppendToObj(bufObj, " stroke=\"", TCL_INDEX_NONE);
+	    AppendColor(infoPtr, color, NULL);
+	    Tcl_AppendPrintfToObj(bufObj, "\" stroke-width=\"%.10g\"", width);
+	    if (capStyle == CapRound) {
+		Tcl_AppendToObj(bufObj, " stroke-linecap=\"round\"",
+			TCL_INDEX_NONE);
+	    } else if (capStyle == CapProjecting) {
+		Tcl_AppendToObj(bufObj, " stroke-linecap=\"square\"",
+			TCL_INDEX_NONE);
+	    }
+	    if (joinStyle == JoinRound) {
+		Tcl_AppendToObj(bufObj, " stroke-linejoin=\"round\"",
+			TCL_INDEX_NONE);
+	    } else if (joinStyle == JoinBevel) {
+		Tcl_AppendToObj(bufObj, " stroke-linejoin=\"bevel\"",
+			TCL_INDEX_NONE);
+	    }
+	    if (numDashes > 0) {
+		Tcl_AppendToObj(bufObj, " stroke-dasharray=\"", TCL_INDEX_NONE);
+		for (i = 0; i < numDashes; i++) {
+		    Tcl_AppendPrintfToObj(bufObj, "%s%d", (i ? " " : ""),
+			    dashes[i] & 0xff);
+		}
+		Tcl_AppendPrintfToObj(bufObj, "\" stroke-dashoffset=\"%d\"",
+			outline->offset);
+	    }
+	}
+	if (separate ? (strokeRes != NULL)
+		: ((fillRes != NULL) || (strokeRes != NULL))) {
+	    Tcl_AppendPrintfToObj(bufObj, " mask=\"url(#s%d)\"",
+		    (separate || strokeRes != NULL) ? strokeRes->id
+		    : fillRes->id);
+	}
+	Tcl_AppendToObj(bufObj, "/>\n", TCL_INDEX_NONE);
+    } else {
+	if (fillColor != NULL) {
+	    if (fillRes != NULL) {
+		Tcl_AppendToObj(bufObj, "/CsP cs ", TCL_INDEX_NONE);
+		AppendColor(infoPtr, fillColor, NULL);
+		Tcl_AppendPrintfToObj(bufObj, " /P%d scn\n", fillRes->id);
+	    } else {
+		AppendColor(infoPtr, fillColor, "rg\n");
+	    }
+	}
+	if (color != NULL) {
+	    if (strokeRes != NULL) {
+		Tcl_AppendToObj(bufObj, "/CsP CS ", TCL_INDEX_NONE);
+		AppendColor(infoPtr, color, NULL);
+		Tcl_AppendPrintfToObj(bufObj, " /P%d SCN\n", strokeRes->id);
+	    } else {
+		AppendColor(infoPtr, color, "RG\n");
+	    }
+	    Tcl_AppendPrintfToObj(bufObj, "%.10g w %d J %d j [", width,
+		    (capStyle == CapRound) ? 1
+			    : (capStyle == CapProjecting) ? 2 : 0,
+		    (joinStyle == JoinRound) ? 1
+			    : (joinStyle == JoinBevel) ? 2 : 0);
+	    for (i = 0; i < numDashes; i++) {
+		Tcl_AppendPrintfToObj(bufObj, "%s%d", (i ? " " : ""),
+			dashes[i] & 0xff);
+	    }
+	    Tcl_AppendPrintfToObj(bufObj, "] %d d\n",
+		    (numDashes > 0) ? outline->offset : 0);
+	}
+	Tcl_AppendObjToObj(bufObj, infoPtr->pathObj);
+	Tcl_AppendToObj(bufObj, (fillColor == NULL) ? "S\n"
+		: (color == NULL) ? "f*\n" : "B*\n", TCL_INDEX_NONE);
+    }
+    if (dashes != NULL) {
+	ckfree(dashes);
+    }
+    Tcl_SetObjLength(infoPtr->pathObj, 0);
+    MaybeFlushOutput(infoPtr);
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvExportText --
+ *
+ *	This function is called by item types during the "export" widget
+ *	command to draw a text layout. Each run of the layout is placed where
+ *	TkDrawAngledTextLayout would draw it on the screen.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Output is generated. During the pre-pass the font and stipple are
+ *	registered instead.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkCanvExportText(
+    Tk_Canvas canvas,		/* Canvas being exported. */
+    Tk_Font tkfont,		/* Font the layout was computed with. */
+    Tk_TextLayout layout,	/* Layout to draw. */
+    double x, double y,		/* Canvas coordinates of the upper-left
+				 * corner of the layout before rotation. */
+    double angle,		/* Rotation in degrees, counter-clockwise. */
+    XColor *color,		/* Color of the text. */
+    Pixmap stipple)		/* Stipple for the text, or None. */
+{
+    TkExportInfo *infoPtr = Canvas(canvas)->exportInfo;
+    const TkFontAttributes *faPtr;
+    Tcl_Obj *bufObj, *keyObj;
+    ExportResource *fontRes, *stippleRes = NULL;
+    double size;
+    const char *start;
+    Tcl_Size index, numBytes;
+    int cx, cy, width;
+    Tcl_DString ds;
+
+    if ((infoPtr == NULL) || (color == NULL) || (layout == NULL)) {
+	return TCL_OK;
+    }
+    bufObj = infoPtr->bufObj;
+    faPtr = &((TkFont *) tkfont)->fa;
+    size = TkFontGetPixels(infoPtr->tkwin, faPtr->size);
+
+    /*
+     * Fonts are identified by their CSS declaration for SVG, and by the name
+     * of the matching standard Postscript font for PDF.
+     */
+
+    if (infoPtr->format == EXPORT_SVG) {
+	keyObj = Tcl_NewStringObj("font-family:'", TCL_INDEX_NONE);
+	if (faPtr->family != NULL) {
+	    const char *p;
+
+	    for (p = faPtr->family; *p != '\0'; p++) {
+		if ((*p == '\'') || (*p == '\\') || (*p == ']')) {
+		    Tcl_AppendToObj(keyObj, "\\", 1);
+		}
+		Tcl_AppendToObj(keyObj, p, 1);
+	    }
+	}
+	Tcl_AppendPrintfToObj(keyObj, "',sans-serif;font-size:%.4gpx;", size);
+	if (faPtr->weight == TK_FW_BOLD) {
+	    Tcl_AppendToObj(keyObj, "font-weight:bold;", TCL_INDEX_NONE);
+	}
+	if (faPtr->slant == TK_FS_ITALIC) {
+	    Tcl_AppendToObj(keyObj, "font-style:italic;", TCL_INDEX_NONE);
+	}
+	if (faPtr->underline || faPtr->overstrike) {
+	    Tcl_AppendPrintfToObj(keyObj, "text-decoration:%s%s%s;",
+		    faPtr->underline ? "underline" : "",
+		    (faPtr->underline && faPtr->overstrike) ? " " : "",
+		    faPtr->overstrike ? "line-through" : "");
+	}
+    } else {
+	Tcl_DStringInit(&ds);
+	Tk_PostscriptFontName(tkfont, &ds);
+	keyObj = Tcl_NewStringObj(Tcl_DStringValue(&ds),
+		Tcl_DStringLength(&ds));
+	Tcl_DStringFree(&ds);
+    }
+    Tcl_IncrRefCount(keyObj);
+    fontRes = GetResource(infoPtr, &infoPtr->fontTable, Tcl_GetString(keyObj));
+    Tcl_DecrRefCount(keyObj);
+    if (stipple != None) {
+	stippleRes = GetResource(infoPtr, &infoPtr->stippleTable,
+		UINT2PTR(stipple));
+    }
+    if (infoPtr->prepass || (fontRes == NULL)) {
+	return TCL_OK;
+    }
+
+    if (infoPtr->format == EXPORT_SVG) {
+	Tcl_AppendPrintfToObj(bufObj, "<g class=\"f%d\" fill=\"", fontRes->id);
+	AppendColor(infoPtr, color, NULL);
+	Tcl_AppendPrintfToObj(bufObj, "\" transform=\"translate(%.10g %.10g)",
+		x, y);
+	if (angle != 0.0) {
+	    Tcl_AppendPrintfToObj(bufObj, " rotate(%.10g)", -angle);
+	}
+	Tcl_AppendToObj(bufObj, "\"", 1);
+	if (stippleRes != NULL) {
+	    Tcl_AppendPrintfToObj(bufObj, " mask=\"url(#s%d)\"",
+		    stippleRes->id);
+	}
+	Tcl_AppendToObj(bufObj, " xml:space=\"preserve\">\n", TCL_INDEX_NONE);
+	for (index = 0; TkTextLayoutGetChunk(layout, index, &start, &numBytes,
+		&cx, &cy, &width); index++) {
+	    if (numBytes == 0) {
+		continue;
+	    }
+	    Tcl_AppendPrintfToObj(bufObj, "<text x=\"%d\" y=\"%d\">", cx, cy);
+	    AppendEscapedText(infoPtr, start, numBytes);
+	    Tcl_AppendToObj(bufObj, "</text>\n", TCL_INDEX_NONE);
+	}
+	Tcl_AppendToObj(bufObj, "</g>\n", TCL_INDEX_NONE);
+    } else {
+	double radians = angle * PI / 180.0;
+	TkFont *fontPtr = (TkFont *) tkfont;
+
+	if (stippleRes != NULL) {
+	    Tcl_AppendToObj(bufObj, "/CsP cs ", TCL_INDEX_NONE);
+	    AppendColor(infoPtr, color, NULL);
+	    Tcl_AppendPrintfToObj(bufObj, " /P%d scn\n", stippleRes->id);
+	} else {
+	    AppendColor(infoPtr, color, "rg\n");
+	}
+	Tcl_AppendPrintfToObj(bufObj,
+		"%.10g %.10g %.10g %.10g %.10g %.10g cm\nBT /F%d %.4g Tf\n",
+		cos(radians), -sin(radians), sin(radians), cos(radians), x, y,
+		fontRes->id, size);
+	for (index = 0; TkTextLayoutGetChunk(layout, index, &start, &numBytes,
+		&cx, &cy, &width); index++) {
+	    if (numBytes == 0) {
+		continue;
+	    }
+	    Tcl_AppendPrintfToObj(bufObj, "1 0 0 -1 %d %d Tm (", cx, cy);
+	    AppendEscapedText(infoPtr, start, numBytes);
+	    Tcl_AppendToObj(bufObj, ") Tj\n", TCL_INDEX_NONE);
+	}
+	Tcl_AppendToObj(bufObj, "ET\n", TCL_INDEX_NONE);
+
+	/*
+	 * The standard fonts have no underlined or overstruck variants, so
+	 * draw the lines the way the X font code does.
+	 */
+
+	if (faPtr->underline || faPtr->overstrike) {
+	    for (index = 0; TkTextLayoutGetChunk(layout, index, &start,
+		    &numBytes, &cx, &cy, &width); index++) {
+		if (numBytes == 0) {
+		    continue;
+		}
+		if (faPtr->underline) {
+		    Tcl_AppendPrintfToObj(bufObj, "%d %d %d %d re f\n", cx,
+			    cy + fontPtr->underlinePos, width,
+			    fontPtr->underlineHeight);
+		}
+		if (faPtr->overstrike) {
+		    Tcl_AppendPrintfToObj(bufObj, "%d %d %d %d re f\n", cx,
+			    cy - fontPtr->fm.ascent*3/10, width,
+			    fontPtr->underlineHeight);
+		}
+	    }
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvExportImage --
+ *
+ *	This function is called by item types during the "export" widget
+ *	command to draw a photo image with its upper-left corner at the given
+ *	canvas coordinates. Images of other types are skipped.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Output is generated. During the pre-pass the image is registered
+ *	instead.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkCanvExportImage(
+    Tk_Canvas canvas,		/* Canvas being exported. */
+    const char *imageName,	/* Name of the image. */
+    double x, double y,		/* Upper-left corner of the image. */
+    int width, int height)	/* Size of the image. */
+{
+    TkExportInfo *infoPtr = Canvas(canvas)->exportInfo;
+    ExportResource *resPtr;
+
+    if ((infoPtr == NULL) || (imageName == NULL)) {
+	return TCL_OK;
+    }
+    if (infoPtr->prepass
+	    && (Tk_FindPhoto(infoPtr->interp, imageName) == NULL)) {
+	return TCL_OK;
+    }
+    resPtr = GetResource(infoPtr, &infoPtr->imageTable, imageName);
+    if (infoPtr->prepass || (resPtr == NULL)) {
+	return TCL_OK;
+    }
+    if (infoPtr->format == EXPORT_SVG) {
+	Tcl_AppendPrintfToObj(infoPtr->bufObj,
+		"<use xlink:href=\"#i%d\" x=\"%.10g\" y=\"%.10g\"/>\n",
+		resPtr->id, x, y);
+    } else {
+	Tcl_AppendPrintfToObj(infoPtr->bufObj,
+		"q %d 0 0 %d %.10g %.10g cm /Im%d Do Q\n",
+		width, -height, x, y + height, resPtr->id);
+    }
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvExportBitmap --
+ *
+ *	This function is called by item types during the "export" widget
+ *	command to draw a bitmap with its upper-left corner at the given
+ *	canvas coordinates.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Output is generated. During the pre-pass the bitmap is registered
+ *	instead.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkCanvExportBitmap(
+    Tk_Canvas canvas,		/* Canvas being exported. */
+    Pixmap bitmap,		/* Bitmap to draw. */
+    double x, double y,		/* Upper-left corner of the bitmap. */
+    int width, int height,	/* Size of the bitmap. */
+    XColor *fgColor,		/* Color for the bits that are set, or
+				 * NULL. */
+    XColor *bgColor)		/* Color for the other bits, or NULL. */
+{
+    TkExportInfo *infoPtr = Canvas(canvas)->exportInfo;
+    ExportResource *resPtr = NULL;
+    Tcl_Obj *bufObj;
+
+    if ((infoPtr == NULL) || (bitmap == None)) {
+	return TCL_OK;
+    }
+    if (fgColor != NULL) {
+	resPtr = GetResource(infoPtr, &infoPtr->bitmapTable, UINT2PTR(bitmap));
+    }
+    if (infoPtr->prepass) {
+	return TCL_OK;
+    }
+    bufObj = infoPtr->bufObj;
+    if (infoPtr->format == EXPORT_SVG) {
+	if (bgColor != NULL) {
+	    Tcl_AppendPrintfToObj(bufObj, "<rect x=\"%.10g\" y=\"%.10g\""
+		    " width=\"%d\" height=\"%d\" fill=\"", x, y, width, height);
+	    AppendColor(infoPtr, bgColor, NULL);
+	    Tcl_AppendToObj(bufObj, "\"/>\n", TCL_INDEX_NONE);
+	}
+	if (resPtr != NULL) {
+	    Tcl_AppendPrintfToObj(bufObj, "<use xlink:href=\"#b%d\""
+		    " x=\"%.10g\" y=\"%.10g\" fill=\"", resPtr->id, x, y);
+	    AppendColor(infoPtr, fgColor, NULL);
+	    Tcl_AppendToObj(bufObj, "\"/>\n", TCL_INDEX_NONE);
+	}
+    } else {
+	if (bgColor != NULL) {
+	    AppendColor(infoPtr, bgColor, "rg\n");
+	    Tcl_AppendPrintfToObj(bufObj, "%.10g %.10g %d %d re f\n",
+		    x, y, width, height);
+	}
+	if (resPtr != NULL) {
+	    AppendColor(infoPtr, fgColor, "rg\n");
+	    Tcl_AppendPrintfToObj(bufObj,
+		    "q %d 0 0 %d %.10g %.10g cm /Bm%d Do Q\n",
+		    width, -height, x, y + height, resPtr->id);
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -81,6 +81,8 @@ static double		ImageToPoint(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *coordPtr);
 static int		ImageToPostscript(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static int		ImageToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
 static void		ComputeImageBbox(Tk_Canvas canvas, ImageItem *imgPtr);
 static int		ConfigureImage(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, Tcl_Size objc,
@@ -128,7 +130,9 @@ Tk_ItemType tkImageType = {
     NULL,			/* dTextProc */
     NULL,			/* nextPtr */
     RotateImage,		/* rotateProc */
-    0, NULL, NULL
+    0,				/* reserved2 */
+    ImageToExport,		/* exportProc */
+    NULL			/* reserved4 */
 };
 
 /*
@@ -759,6 +763,84 @@ ImageToPostscript(
 	    ((TkCanvas *) canvas)->psInfo, 0, 0, width, height, prepass);
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * ImageToExport --
+ *
+ *	This function is called to describe an image item for the "export"
+ *	widget command of canvases. Only photo images can be exported.
+ *
+ * Results:
+ *	The return value is a standard Tcl result.
+ *
+ * Side effects:
+ *	The item is added to the SVG or PDF output being generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ImageToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    TCL_UNUSED(int))		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    ImageItem *imgPtr = (ImageItem *) itemPtr;
+    double x, y;
+    int width, height;
+    Tk_Image image;
+    Tcl_Obj *imageObj;
+    Tk_State state = itemPtr->state;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+
+    image = imgPtr->image;
+    imageObj = imgPtr->imageObj;
+    if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	if (imgPtr->activeImage != NULL) {
+	    image = imgPtr->activeImage;
+	    imageObj = imgPtr->activeImageObj;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (imgPtr->disabledImage != NULL) {
+	    image = imgPtr->disabledImage;
+	    imageObj = imgPtr->disabledImageObj;
+	}
+    }
+    if (image == NULL || imageObj == NULL) {
+	return TCL_OK;
+    }
+    Tk_SizeOfImage(image, &width, &height);
+
+    /*
+     * Compute the coordinates of the upper-left corner of the image, taking
+     * into account the anchor position for the image.
+     */
+
+    x = imgPtr->x;
+    y = imgPtr->y;
+    switch (imgPtr->anchor) {
+    case TK_ANCHOR_NW:						break;
+    case TK_ANCHOR_N:	   x -= width/2.0;			break;
+    case TK_ANCHOR_NE:	   x -= width;				break;
+    case TK_ANCHOR_E:	   x -= width;	   y -= height/2.0;	break;
+    case TK_ANCHOR_SE:	   x -= width;	   y -= height;		break;
+    case TK_ANCHOR_S:	   x -= width/2.0; y -= height;		break;
+    case TK_ANCHOR_SW:			   y -= height;		break;
+    case TK_ANCHOR_W:			   y -= height/2.0;	break;
+    default: x -= width/2.0; y -= height/2.0;	break;
+    }
+
+    return TkCanvExportImage(canvas, Tcl_GetString(imageObj), x, y, width,
+	    height);
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -66,8 +66,24 @@ typedef struct LineItem {
     const Tk_SmoothMethod *smooth; /* Non-zero means draw line smoothed (i.e.
 				 * with Bezier splines). */
     int splineSteps;		/* Number of steps in each spline segment. */
+    TkSegmentTree *segTreePtr;	/* Segment tree over the (smoothed) points of
+				 * the line, used for hit-testing lines with
+				 * many points. Built on demand by
+				 * GetLineSegmentTree; NULL means not built
+				 * yet. */
 } LineItem;
 
+/*
+ * Information passed to the per-segment hit-testing functions when a line is
+ * searched through its segment tree:
+ */
+
+typedef struct {
+    LineItem *linePtr;		/* Line being tested. */
+    TkSegmentTree *treePtr;	/* Tree holding the points of the line. */
+    double width;		/* Width of the line. */
+} LineSegmentInfo;
+
 /*
  * Number of points in an arrowHead:
  */
@@ -97,6 +113,8 @@ static void		DisplayLine(Tk_Canvas canvas,
 static int		GetLineIndex(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr,
 			    Tcl_Obj *obj, Tcl_Size *indexPtr);
+static TkSegmentTree *	GetLineSegmentTree(Tk_Canvas canvas,
+			    LineItem *linePtr);
 static int		LineCoords(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr,
 			    Tcl_Size objc, Tcl_Obj *const objv[]);
@@ -108,8 +126,14 @@ static int		LineToArea(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *rectPtr);
 static double		LineToPoint(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *coordPtr);
+static int		LineSegmentToArea(void *clientData,
+			    Tcl_Size index, double *rectPtr);
+static double		LineSegmentToPoint(void *clientData,
+			    Tcl_Size index, double *pointPtr);
 static int		LineToPostscript(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static int		LineToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
 static int		ArrowParseProc(void *clientData,
 			    Tcl_Interp *interp, Tk_Window tkwin,
 			    const char *value, char *recordPtr, Tcl_Size offset);
@@ -247,7 +271,9 @@ Tk_ItemType tkLineType = {
     LineDeleteCoords,			/* dTextProc */
     NULL,				/* nextPtr */
     RotateLine,				/* rotateProc */
-    0, NULL, NULL
+    0,					/* reserved2 */
+    LineToExport,			/* exportProc */
+    NULL				/* reserved4 */
 };
 
 /*
@@ -313,6 +339,7 @@ CreateLine(
     linePtr->lastArrowPtr = NULL;
     linePtr->smooth = NULL;
     linePtr->splineSteps = 12;
+    linePtr->segTreePtr = NULL;
 
     /*
      * Count the number of points and then parse them into a point array.
@@ -628,6 +655,7 @@ DeleteLine(
     if (linePtr->lastArrowPtr != NULL) {
 	ckfree(linePtr->lastArrowPtr);
     }
+    TkSegmentTreeFree(linePtr->segTreePtr);
 }
 
 /*
@@ -659,6 +687,14 @@ ComputeLineBbox(
     Tk_State state = linePtr->header.state;
     Tk_TSOffset *tsoffset;
 
+    /*
+     * Any change to the points of the line ends up here, so this is where the
+     * segment tree is discarded; it gets rebuilt the next time it's needed.
+     */
+
+    TkSegmentTreeFree(linePtr->segTreePtr);
+    linePtr->segTreePtr = NULL;
+
     if (state == TK_STATE_NULL) {
 	state = Canvas(canvas)->canvas_state;
     }
@@ -1467,6 +1503,7 @@ LineToPoint(
     int changedMiterToBevel;	/* Non-zero means that a mitered corner had to
 				 * be treated as beveled after all because the
 				 * angle was < 11 degrees. */
+    TkSegmentTree *treePtr;
 
     bestDist = 1.0e36;
 
@@ -1490,7 +1527,11 @@ LineToPoint(
 	}
     }
 
-    if ((linePtr->smooth) && (linePtr->numPoints > 2)) {
+    treePtr = GetLineSegmentTree(canvas, linePtr);
+    if (treePtr != NULL) {
+	numPoints = treePtr->numPoints;
+	linePoints = treePtr->coordPtr;
+    } else if ((linePtr->smooth) && (linePtr->numPoints > 2)) {
 	numPoints = linePtr->smooth->coordProc(canvas, NULL,
 		linePtr->numPoints, linePtr->splineSteps, NULL, NULL);
 	if (numPoints <= MAX_STATIC_POINTS) {
@@ -1520,6 +1561,27 @@ LineToPoint(
 	return bestDist;
     }
 
+    /*
+     * Long lines are searched through their segment tree, which only visits
+     * the segments near the point. The rounded caps are handled by
+     * LineSegmentToPoint.
+     */
+
+    if (treePtr != NULL) {
+	LineSegmentInfo info;
+
+	info.linePtr = linePtr;
+	info.treePtr = treePtr;
+	info.width = width;
+	bestDist = TkSegmentTreeToPoint(treePtr,
+		TK_SEGMENT_MARGIN(width, linePtr->joinStyle), pointPtr,
+		bestDist, LineSegmentToPoint, &info);
+	if (bestDist <= 0.0) {
+	    goto done;
+	}
+	goto arrows;
+    }
+
     /*
      * The overall idea is to iterate through all of the edges of the line,
      * computing a polygon for each edge and testing the point against that
@@ -1630,6 +1692,7 @@ LineToPoint(
      * If there are arrowheads, check the distance to the arrowheads.
      */
 
+  arrows:
     if (linePtr->arrow != ARROWS_NONE) {
 	if (linePtr->arrow != ARROWS_LAST) {
 	    dist = TkPolygonToPoint(linePtr->firstArrowPtr, PTS_IN_ARROW,
@@ -1654,7 +1717,8 @@ LineToPoint(
     }
 
   done:
-    if ((linePoints != staticSpace) && (linePoints != linePtr->coordPtr)) {
+    if ((linePoints != staticSpace) && (linePoints != linePtr->coordPtr)
+	    && (treePtr == NULL)) {
 	ckfree(linePoints);
     }
     return bestDist;
@@ -1690,6 +1754,7 @@ LineToArea(
     int numPoints, result;
     double radius, width;
     Tk_State state = itemPtr->state;
+    TkSegmentTree *treePtr;
 
     if (state == TK_STATE_NULL) {
 	state = Canvas(canvas)->canvas_state;
@@ -1721,10 +1786,14 @@ LineToArea(
 
     /*
      * Handle smoothed lines by generating an expanded set of points against
-     * which to do the check.
+     * which to do the check. Long lines have these in their segment tree.
      */
 
-    if ((linePtr->smooth) && (linePtr->numPoints > 2)) {
+    treePtr = GetLineSegmentTree(canvas, linePtr);
+    if (treePtr != NULL) {
+	numPoints = treePtr->numPoints;
+	linePoints = treePtr->coordPtr;
+    } else if ((linePtr->smooth) && (linePtr->numPoints > 2)) {
 	numPoints = linePtr->smooth->coordProc(canvas, NULL,
 		linePtr->numPoints, linePtr->splineSteps, NULL, NULL);
 	if (numPoints <= MAX_STATIC_POINTS) {
@@ -1747,8 +1816,19 @@ LineToArea(
 	width = 1.0;
     }
 
-    result = TkThickPolyLineToArea(linePoints, numPoints, width,
-	    linePtr->capStyle, linePtr->joinStyle, rectPtr);
+    if (treePtr != NULL) {
+	LineSegmentInfo info;
+
+	info.linePtr = linePtr;
+	info.treePtr = treePtr;
+	info.width = width;
+	result = TkSegmentTreeToArea(treePtr,
+		TK_SEGMENT_MARGIN(width, linePtr->joinStyle), rectPtr,
+		LineSegmentToArea, &info);
+    } else {
+	result = TkThickPolyLineToArea(linePoints, numPoints, width,
+		linePtr->capStyle, linePtr->joinStyle, rectPtr);
+    }
     if (result == 0) {
 	goto done;
     }
@@ -1775,11 +1855,194 @@ LineToArea(
     }
 
   done:
-    if ((linePoints != staticSpace) && (linePoints != linePtr->coordPtr)) {
+    if ((linePoints != staticSpace) && (linePoints != linePtr->coordPtr)
+	    && (treePtr == NULL)) {
 	ckfree(linePoints);
     }
     return result;
 }
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetLineSegmentTree --
+ *
+ *	Returns the segment tree used to hit-test a line with many points,
+ *	building it if necessary from the points of the line (after
+ *	smoothing).
+ *
+ * Results:
+ *	The tree, or NULL if the line has too few points to benefit from one.
+ *
+ * Side effects:
+ *	The tree is cached in the item until its points change.
+ *
+ *--------------------------------------------------------------
+ */
+
+static TkSegmentTree *
+GetLineSegmentTree(
+    Tk_Canvas canvas,		/* Canvas containing item. */
+    LineItem *linePtr)		/* Line whose tree is wanted. */
+{
+    double *linePoints;
+    int numPoints;
+
+    if (linePtr->segTreePtr != NULL) {
+	return linePtr->segTreePtr;
+    }
+    if ((linePtr->smooth) && (linePtr->numPoints > 2)) {
+	numPoints = linePtr->smooth->coordProc(canvas, NULL,
+		linePtr->numPoints, linePtr->splineSteps, NULL, NULL);
+    } else {
+	numPoints = linePtr->numPoints;
+    }
+    if (numPoints < TK_SEGMENT_TREE_MIN_POINTS) {
+	return NULL;
+    }
+
+    if ((linePtr->smooth) && (linePtr->numPoints > 2)) {
+	linePoints = (double *)ckalloc(2 * numPoints * sizeof(double));
+	numPoints = linePtr->smooth->coordProc(canvas, linePtr->coordPtr,
+		linePtr->numPoints, linePtr->splineSteps, NULL, linePoints);
+	linePtr->segTreePtr = TkSegmentTreeCreate(linePoints, numPoints);
+	ckfree(linePoints);
+    } else {
+	linePtr->segTreePtr = TkSegmentTreeCreate(linePtr->coordPtr,
+		numPoints);
+    }
+    return linePtr->segTreePtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * LineSegmentToPoint --
+ *
+ *	Computes the distance from a point to the part of a line drawn for
+ *	one of its segments, including the joint or cap at the start of the
+ *	segment (and the cap at its end, for the last segment). Called through
+ *	TkSegmentTreeToPoint.
+ *
+ * Results:
+ *	The distance, or 0 if the point is inside.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double
+LineSegmentToPoint(
+    void *clientData,		/* Points to a LineSegmentInfo. */
+    Tcl_Size index,		/* Index of the segment. */
+    double *pointPtr)		/* Pointer to x and y coordinates. */
+{
+    LineSegmentInfo *infoPtr = (LineSegmentInfo *)clientData;
+    LineItem *linePtr = infoPtr->linePtr;
+    Tcl_Size numPoints = infoPtr->treePtr->numPoints;
+    double *coordPtr = infoPtr->treePtr->coordPtr + 2*index;
+    double poly[10], wedge[10];
+    double bestDist = 1.0e36, dist;
+
+    if (((linePtr->capStyle == CapRound) && (index == 0))
+	    || ((linePtr->joinStyle == JoinRound) && (index != 0))) {
+	bestDist = hypot(coordPtr[0] - pointPtr[0], coordPtr[1] - pointPtr[1])
+		- infoPtr->width/2.0;
+	if (bestDist <= 0.0) {
+	    return 0.0;
+	}
+    }
+    if ((linePtr->capStyle == CapRound) && (index == numPoints - 2)) {
+	dist = hypot(coordPtr[2] - pointPtr[0], coordPtr[3] - pointPtr[1])
+		- infoPtr->width/2.0;
+	if (dist <= 0.0) {
+	    return 0.0;
+	} else if (dist < bestDist) {
+	    bestDist = dist;
+	}
+    }
+
+    if (TkGetSegmentOutline(infoPtr->treePtr->coordPtr, numPoints, index,
+	    infoPtr->width, linePtr->capStyle, linePtr->joinStyle, poly,
+	    wedge)) {
+	dist = TkPolygonToPoint(wedge, 5, pointPtr);
+	if (dist < bestDist) {
+	    bestDist = dist;
+	}
+    }
+    dist = TkPolygonToPoint(poly, 5, pointPtr);
+    if (dist < bestDist) {
+	bestDist = dist;
+    }
+    return bestDist;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * LineSegmentToArea --
+ *
+ *	Determines whether the part of a line drawn for one of its segments
+ *	lies inside, outside or overlapping a rectangle; see
+ *	LineSegmentToPoint for what that part covers. Called through
+ *	TkSegmentTreeToArea.
+ *
+ * Results:
+ *	-1 if the part is entirely outside the area, 0 if it overlaps, and 1
+ *	if it is entirely inside.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+LineSegmentToArea(
+    void *clientData,		/* Points to a LineSegmentInfo. */
+    Tcl_Size index,		/* Index of the segment. */
+    double *rectPtr)		/* Rectangle to check against. */
+{
+    LineSegmentInfo *infoPtr = (LineSegmentInfo *)clientData;
+    LineItem *linePtr = infoPtr->linePtr;
+    Tcl_Size numPoints = infoPtr->treePtr->numPoints;
+    double *coordPtr = infoPtr->treePtr->coordPtr + 2*index;
+    double poly[10], wedge[10], oval[4];
+    double radius = infoPtr->width/2.0;
+    int inside, beveled;
+
+    beveled = TkGetSegmentOutline(infoPtr->treePtr->coordPtr, numPoints,
+	    index, infoPtr->width, linePtr->capStyle, linePtr->joinStyle,
+	    poly, wedge);
+    inside = TkPolygonToArea(poly, 5, rectPtr);
+    if ((inside == 0)
+	    || (beveled && (TkPolygonToArea(wedge, 5, rectPtr) != inside))) {
+	return 0;
+    }
+
+    if (((linePtr->capStyle == CapRound) && (index == 0))
+	    || ((linePtr->joinStyle == JoinRound) && (index != 0))) {
+	oval[0] = coordPtr[0] - radius;
+	oval[1] = coordPtr[1] - radius;
+	oval[2] = coordPtr[0] + radius;
+	oval[3] = coordPtr[1] + radius;
+	if (TkOvalToArea(oval, rectPtr) != inside) {
+	    return 0;
+	}
+    }
+    if ((linePtr->capStyle == CapRound) && (index == numPoints - 2)) {
+	oval[0] = coordPtr[2] - radius;
+	oval[1] = coordPtr[3] - radius;
+	oval[2] = coordPtr[2] + radius;
+	oval[3] = coordPtr[3] + radius;
+	if (TkOvalToArea(oval, rectPtr) != inside) {
+	    return 0;
+	}
+    }
+    return inside;
+}
 
 /*
  *--------------------------------------------------------------
@@ -2602,6 +2865,133 @@ LineToPostscript(
     return TCL_OK;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * LineToExport --
+ *
+ *	This function is called to describe a line item for the "export"
+ *	widget command of canvases.
+ *
+ * Results:
+ *	The return value is a standard Tcl result.
+ *
+ * Side effects:
+ *	The item is added to the SVG or PDF output being generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+LineToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    TCL_UNUSED(int))		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    LineItem *linePtr = (LineItem *) itemPtr;
+    double width;
+    XColor *color;
+    Pixmap stipple;
+    Tk_State state = itemPtr->state;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+
+    width = linePtr->outline.width;
+    color = linePtr->outline.color;
+    stipple = linePtr->outline.stipple;
+    if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	if (linePtr->outline.activeWidth > width) {
+	    width = linePtr->outline.activeWidth;
+	}
+	if (linePtr->outline.activeColor != NULL) {
+	    color = linePtr->outline.activeColor;
+	}
+	if (linePtr->outline.activeStipple != None) {
+	    stipple = linePtr->outline.activeStipple;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (linePtr->outline.disabledWidth > 0) {
+	    width = linePtr->outline.disabledWidth;
+	}
+	if (linePtr->outline.disabledColor != NULL) {
+	    color = linePtr->outline.disabledColor;
+	}
+	if (linePtr->outline.disabledStipple != None) {
+	    stipple = linePtr->outline.disabledStipple;
+	}
+    }
+
+    if (color == NULL || linePtr->numPoints < 1 || linePtr->coordPtr == NULL){
+	return TCL_OK;
+    }
+
+    /*
+     * A line with a single point is drawn as a dot.
+     */
+
+    if (linePtr->numPoints == 1) {
+	double bbox[4];
+
+	bbox[0] = linePtr->coordPtr[0] - width/2.0;
+	bbox[1] = linePtr->coordPtr[1] - width/2.0;
+	bbox[2] = linePtr->coordPtr[0] + width/2.0;
+	bbox[3] = linePtr->coordPtr[1] + width/2.0;
+	TkCanvExportArcPath(canvas, bbox, 0.0, 360.0, TK_EXPORT_ARC_CHORD);
+	return TkCanvExportPaint(canvas, itemPtr, color, stipple, NULL,
+		CapButt, JoinMiter);
+    }
+
+    if ((!linePtr->smooth) || (linePtr->numPoints < 3)) {
+	TkCanvExportPath(canvas, linePtr->coordPtr, linePtr->numPoints, 0);
+    } else {
+	double staticPoints[2*MAX_STATIC_POINTS];
+	double *pointPtr;
+	int numPoints;
+
+	numPoints = linePtr->smooth->coordProc(canvas, NULL,
+		linePtr->numPoints, linePtr->splineSteps, NULL, NULL);
+	pointPtr = staticPoints;
+	if (numPoints > MAX_STATIC_POINTS) {
+	    pointPtr = (double *)ckalloc(numPoints * 2 * sizeof(double));
+	}
+	numPoints = linePtr->smooth->coordProc(canvas, linePtr->coordPtr,
+		linePtr->numPoints, linePtr->splineSteps, NULL, pointPtr);
+	TkCanvExportPath(canvas, pointPtr, numPoints, 0);
+	if (pointPtr != staticPoints) {
+	    ckfree(pointPtr);
+	}
+    }
+    if (TkCanvExportPaint(canvas, itemPtr, NULL, None, &linePtr->outline,
+	    linePtr->capStyle, linePtr->joinStyle) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /*
+     * Output polygons for the arrowheads, if there are any.
+     */
+
+    if (linePtr->firstArrowPtr != NULL) {
+	TkCanvExportPath(canvas, linePtr->firstArrowPtr, PTS_IN_ARROW, 1);
+	if (TkCanvExportPaint(canvas, itemPtr, color, stipple, NULL,
+		CapButt, JoinMiter) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+    if (linePtr->lastArrowPtr != NULL) {
+	TkCanvExportPath(canvas, linePtr->lastArrowPtr, PTS_IN_ARROW, 1);
+	if (TkCanvExportPaint(canvas, itemPtr, color, stipple, NULL,
+		CapButt, JoinMiter) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+    return TCL_OK;
+}
+
 /*
  *--------------------------------------------------------------
  *
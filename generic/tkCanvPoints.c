@@ -0,0 +1,1636 @@
+/*
+ * tkCanvPoints.c --
+ *
+ *	This file implements points items for canvas widgets. A single points
+ *	item holds any number of small squares, which makes it suitable for
+ *	scatter plots and point clouds with millions of points: the points
+ *	are kept in a packed array of floats, with an optional array of
+ *	indices into a color palette, rather than as one item each.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#include "tkInt.h"
+#include "tkCanvas.h"
+#include "default.h"
+
+/*
+ * Hit-testing uses a uniform grid over the bounding box of the points, built
+ * the first time it is needed. The grid has roughly one cell for every
+ * POINTS_PER_CELL points.
+ */
+
+#define POINTS_PER_CELL	4
+
+typedef struct PointGrid {
+    double x0, y0;		/* Canvas coordinates of the top-left corner
+				 * of the grid. */
+    double cellSize;		/* Width and height of each cell. */
+    int cols, rows;		/* Dimensions of the grid, in cells. */
+    int *cellStart;		/* cols*rows+1 entries: the points in cell i
+				 * are cellPoints[cellStart[i]] up to, but
+				 * not including, cellPoints[cellStart[i+1]].
+				 * Cells are stored row by row. */
+    int *cellPoints;		/* Point numbers, sorted by cell. */
+} PointGrid;
+
+/*
+ * Points are drawn with XFillRectangles, at most this many in one call.
+ */
+
+#define POINTS_BATCH	1024
+
+/*
+ * The structure below defines the record for each points item.
+ */
+
+typedef struct PointsItem  {
+    Tk_Item header;		/* Generic stuff that's the same for all
+				 * types. MUST BE FIRST IN STRUCTURE. */
+    int numPoints;		/* Number of points in the item. */
+    float *coordPtr;		/* Array of 2*numPoints coordinates, x1, y1,
+				 * x2, y2, ... NULL if there are no points. */
+    double bbox[4];		/* Smallest and largest x and y coordinates of
+				 * the points: x1, y1, x2, y2. */
+    int size;			/* Width and height of each point, in
+				 * pixels. */
+    XColor *fillColor;		/* Color for points without a palette entry,
+				 * or NULL. */
+    XColor *activeFillColor;	/* Color for all points when the item is
+				 * active, or NULL. */
+    XColor *disabledFillColor;	/* Color for all points when the item is
+				 * disabled, or NULL. */
+    Tcl_Obj *colorsObj;		/* Value of -colors option, or NULL. */
+    Tcl_Obj *indicesObj;	/* Value of -colorindices option, or NULL. */
+    Tcl_Obj *parsedColorsObj;	/* Value of -colors from which colorPtrs was
+				 * computed (we hold a reference), or
+				 * NULL. */
+    Tcl_Obj *parsedIndicesObj;	/* Value of -colorindices from which indexPtr
+				 * was computed (we hold a reference), or
+				 * NULL. */
+    Tcl_Size numColors;		/* Number of entries in colorPtrs. */
+    XColor **colorPtrs;		/* The palette given by -colors. */
+    Tcl_Size numIndices;	/* Number of entries in indexPtr. */
+    unsigned short *indexPtr;	/* Palette index of each point. Points past
+				 * the end of this array, or with an index
+				 * past the end of the palette, are drawn
+				 * with fillColor. */
+    int *orderPtr;		/* Point numbers sorted by palette index, so
+				 * that each color can be drawn in one go, or
+				 * NULL if not computed yet. */
+    int *runPtr;		/* numColors+2 entries: the points of color i
+				 * are orderPtr[runPtr[i]] up to, but not
+				 * including, orderPtr[runPtr[i+1]]. Index
+				 * numColors stands for fillColor. */
+    PointGrid *gridPtr;		/* Grid used for hit-testing, or NULL if not
+				 * built yet. */
+} PointsItem;
+
+/*
+ * Information used for parsing configuration specs:
+ */
+
+static const Tk_CustomOption stateOption = {
+    TkStateParseProc, TkStatePrintProc, INT2PTR(2)
+};
+static const Tk_CustomOption tagsOption = {
+    Tk_CanvasTagsParseProc, Tk_CanvasTagsPrintProc, NULL
+};
+
+static const Tk_ConfigSpec configSpecs[] = {
+    {TK_CONFIG_COLOR, "-activefill", NULL, NULL,
+	NULL, offsetof(PointsItem, activeFillColor), TK_CONFIG_NULL_OK, NULL},
+    {TK_CONFIG_STRING, "-colorindices", NULL, NULL,
+	NULL, offsetof(PointsItem, indicesObj),
+	TK_CONFIG_NULL_OK|TK_CONFIG_OBJS, NULL},
+    {TK_CONFIG_STRING, "-colors", NULL, NULL,
+	NULL, offsetof(PointsItem, colorsObj),
+	TK_CONFIG_NULL_OK|TK_CONFIG_OBJS, NULL},
+    {TK_CONFIG_COLOR, "-disabledfill", NULL, NULL,
+	NULL, offsetof(PointsItem, disabledFillColor), TK_CONFIG_NULL_OK, NULL},
+    {TK_CONFIG_COLOR, "-fill", NULL, NULL,
+	DEF_CANVITEM_OUTLINE, offsetof(PointsItem, fillColor),
+	TK_CONFIG_NULL_OK, NULL},
+    {TK_CONFIG_PIXELS, "-size", NULL, NULL,
+	"1", offsetof(PointsItem, size), TK_CONFIG_DONT_SET_DEFAULT, NULL},
+    {TK_CONFIG_CUSTOM, "-state", NULL, NULL,
+	NULL, offsetof(Tk_Item, state), TK_CONFIG_NULL_OK,
+	&stateOption},
+    {TK_CONFIG_CUSTOM, "-tags", NULL, NULL,
+	NULL, 0, TK_CONFIG_NULL_OK, &tagsOption},
+    {TK_CONFIG_END, NULL, NULL, NULL, NULL, 0, 0, NULL}
+};
+
+/*
+ * Prototypes for functions defined in this file:
+ */
+
+static void		ComputePointsBbox(Tk_Canvas canvas,
+			    PointsItem *ptsPtr);
+static int		ConfigurePoints(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, Tcl_Size objc,
+			    Tcl_Obj *const objv[], int flags);
+static int		CreatePoints(Tcl_Interp *interp,
+			    Tk_Canvas canvas, struct Tk_Item *itemPtr,
+			    Tcl_Size objc, Tcl_Obj *const objv[]);
+static void		DeletePoints(Tk_Canvas canvas,
+			    Tk_Item *itemPtr, Display *display);
+static void		DisplayPoints(Tk_Canvas canvas,
+			    Tk_Item *itemPtr, Display *display, Drawable dst,
+			    int x, int y, int width, int height);
+static void		FreePointsCache(PointsItem *ptsPtr, int freeOrder);
+static double		GetNearestPoint(PointsItem *ptsPtr, double x,
+			    double y, double halfSize, int *indexPtr);
+static PointGrid *	GetPointGrid(PointsItem *ptsPtr);
+static XColor *		GetPointsColor(Tk_Canvas canvas,
+			    PointsItem *ptsPtr, int *overridePtr);
+static int		GetPointsIndex(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr,
+			    Tcl_Obj *obj, Tcl_Size *indexPtr);
+static int *		GetPointsOrder(PointsItem *ptsPtr);
+static int		ParsePointColors(Tcl_Interp *interp,
+			    Tk_Window tkwin, PointsItem *ptsPtr);
+static int		ParsePointIndices(Tcl_Interp *interp,
+			    PointsItem *ptsPtr);
+static int		PointsCoords(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, Tcl_Size objc,
+			    Tcl_Obj *const objv[]);
+static int		PointsToArea(Tk_Canvas canvas,
+			    Tk_Item *itemPtr, double *rectPtr);
+static int		PointsToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static double		PointsToPoint(Tk_Canvas canvas,
+			    Tk_Item *itemPtr, double *coordPtr);
+static int		PointsToPostscript(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static void		RotatePoints(Tk_Canvas canvas, Tk_Item *itemPtr,
+			    double originX, double originY, double angleRad);
+static void		ScalePoints(Tk_Canvas canvas,
+			    Tk_Item *itemPtr, double originX, double originY,
+			    double scaleX, double scaleY);
+static void		TranslatePoints(Tk_Canvas canvas, Tk_Item *itemPtr,
+			    double deltaX, double deltaY);
+
+/*
+ * The structures below defines the points item type in terms of functions
+ * that can be invoked by generic item code.
+ */
+
+Tk_ItemType tkPointsType = {
+    "points",			/* name */
+    sizeof(PointsItem),		/* itemSize */
+    CreatePoints,		/* createProc */
+    configSpecs,		/* configSpecs */
+    ConfigurePoints,		/* configureProc */
+    PointsCoords,		/* coordProc */
+    DeletePoints,		/* deleteProc */
+    DisplayPoints,		/* displayProc */
+    0,				/* flags */
+    PointsToPoint,		/* pointProc */
+    PointsToArea,		/* areaProc */
+    PointsToPostscript,		/* postscriptProc */
+    ScalePoints,		/* scaleProc */
+    TranslatePoints,		/* translateProc */
+    GetPointsIndex,		/* indexProc */
+    NULL,			/* icursorProc */
+    NULL,			/* selectionProc */
+    NULL,			/* insertProc */
+    NULL,			/* dTextProc */
+    NULL,			/* nextPtr */
+    RotatePoints,		/* rotateProc */
+    0,				/* reserved2 */
+    PointsToExport,		/* exportProc */
+    NULL			/* reserved4 */
+};
+
+/*
+ *--------------------------------------------------------------
+ *
+ * CreatePoints --
+ *
+ *	This function is invoked to create a new points item in a canvas.
+ *
+ * Results:
+ *	A standard Tcl return value. If an error occurred in creating the
+ *	item, then an error message is left in the interp's result; in this
+ *	case itemPtr is left uninitialized, so it can be safely freed by the
+ *	caller.
+ *
+ * Side effects:
+ *	A new points item is created.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+CreatePoints(
+    Tcl_Interp *interp,		/* Interpreter for error reporting. */
+    Tk_Canvas canvas,		/* Canvas to hold new item. */
+    Tk_Item *itemPtr,		/* Record to hold new item; header has been
+				 * initialized by caller. */
+    Tcl_Size objc,		/* Number of arguments in objv. */
+    Tcl_Obj *const objv[])	/* Arguments describing points. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    Tcl_Size i;
+
+    /*
+     * Initialize item's record.
+     */
+
+    ptsPtr->numPoints = 0;
+    ptsPtr->coordPtr = NULL;
+    ptsPtr->size = 1;
+    ptsPtr->fillColor = NULL;
+    ptsPtr->activeFillColor = NULL;
+    ptsPtr->disabledFillColor = NULL;
+    ptsPtr->colorsObj = NULL;
+    ptsPtr->indicesObj = NULL;
+    ptsPtr->parsedColorsObj = NULL;
+    ptsPtr->parsedIndicesObj = NULL;
+    ptsPtr->numColors = 0;
+    ptsPtr->colorPtrs = NULL;
+    ptsPtr->numIndices = 0;
+    ptsPtr->indexPtr = NULL;
+    ptsPtr->orderPtr = NULL;
+    ptsPtr->runPtr = NULL;
+    ptsPtr->gridPtr = NULL;
+
+    /*
+     * Leading arguments are assumed to be coordinates if they don't look
+     * like an option name.
+     */
+
+    for (i = 0; i < objc; i++) {
+	const char *arg = Tcl_GetString(objv[i]);
+
+	if ((arg[0] == '-') && (arg[1] >= 'a') && (arg[1] <= 'z')) {
+	    break;
+	}
+    }
+    if ((i > 0) && (PointsCoords(interp, canvas, itemPtr, i, objv)
+	    != TCL_OK)) {
+	goto error;
+    }
+    if (ConfigurePoints(interp, canvas, itemPtr, objc-i, objv+i, 0)
+	    == TCL_OK) {
+	return TCL_OK;
+    }
+
+  error:
+    DeletePoints(canvas, itemPtr, Tk_Display(Tk_CanvasTkwin(canvas)));
+    return TCL_ERROR;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PointsCoords --
+ *
+ *	This function is invoked to process the "coords" widget command on
+ *	points items. See the user documentation for details on what it does.
+ *
+ * Results:
+ *	Returns TCL_OK or TCL_ERROR, and sets the interp's result.
+ *
+ * Side effects:
+ *	The coordinates for the given item may be changed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PointsCoords(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    Tk_Canvas canvas,		/* Canvas containing item. */
+    Tk_Item *itemPtr,		/* Item whose coordinates are to be read or
+				 * modified. */
+    Tcl_Size objc,		/* Number of coordinates supplied in objv. */
+    Tcl_Obj *const objv[])	/* Array of coordinates: x1, y1, x2, y2, ... */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    float *coordPtr;
+    double value;
+    Tcl_Size i;
+
+    if (objc == 0) {
+	Tcl_Obj *obj = Tcl_NewObj();
+
+	for (i = 0; i < 2*(Tcl_Size)ptsPtr->numPoints; i++) {
+	    Tcl_ListObjAppendElement(NULL, obj,
+		    Tcl_NewDoubleObj(ptsPtr->coordPtr[i]));
+	}
+	Tcl_SetObjResult(interp, obj);
+	return TCL_OK;
+    }
+    if (objc == 1) {
+	if (Tcl_ListObjGetElements(interp, objv[0], &objc,
+		(Tcl_Obj ***) &objv) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    }
+    if (objc & 1) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"wrong # coordinates: expected an even number, got %" TCL_SIZE_MODIFIER "d",
+		objc));
+	Tcl_SetErrorCode(interp, "TK", "CANVAS", "COORDS", "POINTS", (char *)NULL);
+	return TCL_ERROR;
+    } else if (objc/2 > INT_MAX) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"too many points", TCL_INDEX_NONE));
+	Tcl_SetErrorCode(interp, "TK", "CANVAS", "COORDS", "POINTS", (char *)NULL);
+	return TCL_ERROR;
+    }
+
+    /*
+     * Parse into a new array, so that the item is unchanged if one of the
+     * coordinates is bad. Plain numbers are by far the most common, so try
+     * them first.
+     */
+
+    coordPtr = NULL;
+    if (objc > 0) {
+	coordPtr = (float *)ckalloc(sizeof(float) * objc);
+    }
+    for (i = 0; i < objc; i++) {
+	if ((Tcl_GetDoubleFromObj(NULL, objv[i], &value) != TCL_OK)
+		&& (Tk_CanvasGetCoordFromObj(interp, canvas, objv[i],
+			&value) != TCL_OK)) {
+	    ckfree(coordPtr);
+	    return TCL_ERROR;
+	}
+	coordPtr[i] = (float) value;
+    }
+    if (ptsPtr->coordPtr != NULL) {
+	ckfree(ptsPtr->coordPtr);
+    }
+    FreePointsCache(ptsPtr, ptsPtr->numPoints != objc/2);
+    ptsPtr->coordPtr = coordPtr;
+    ptsPtr->numPoints = (int) (objc/2);
+    ComputePointsBbox(canvas, ptsPtr);
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ConfigurePoints --
+ *
+ *	This function is invoked to configure various aspects of a points
+ *	item, such as its colors.
+ *
+ * Results:
+ *	A standard Tcl result code. If an error occurs, then an error message
+ *	is left in the interp's result.
+ *
+ * Side effects:
+ *	Configuration information may be set for itemPtr.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ConfigurePoints(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    Tk_Canvas canvas,		/* Canvas containing itemPtr. */
+    Tk_Item *itemPtr,		/* Points item to reconfigure. */
+    Tcl_Size objc,		/* Number of elements in objv.  */
+    Tcl_Obj *const objv[],	/* Arguments describing things to configure. */
+    int flags)			/* Flags to pass to Tk_ConfigureWidget. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    Tk_Window tkwin = Tk_CanvasTkwin(canvas);
+    int result = TCL_OK;
+
+    if (TCL_OK != Tk_ConfigureWidget(interp, tkwin, configSpecs, objc,
+	    objv, ptsPtr, flags)) {
+	return TCL_ERROR;
+    }
+    if (ptsPtr->size < 1) {
+	ptsPtr->size = 1;
+    }
+    if (ptsPtr->activeFillColor != NULL) {
+	itemPtr->redraw_flags |= TK_ITEM_STATE_DEPENDANT;
+    } else {
+	itemPtr->redraw_flags &= ~TK_ITEM_STATE_DEPENDANT;
+    }
+
+    /*
+     * The palette and the color indices are only parsed again when they
+     * have been changed, since they can be very long.
+     */
+
+    if ((ptsPtr->colorsObj != ptsPtr->parsedColorsObj)
+	    && (ParsePointColors(interp, tkwin, ptsPtr) != TCL_OK)) {
+	result = TCL_ERROR;
+    }
+    if ((result == TCL_OK)
+	    && (ptsPtr->indicesObj != ptsPtr->parsedIndicesObj)
+	    && (ParsePointIndices(interp, ptsPtr) != TCL_OK)) {
+	result = TCL_ERROR;
+    }
+
+    ComputePointsBbox(canvas, ptsPtr);
+    return result;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ParsePointColors --
+ *
+ *	Computes the palette of a points item from its -colors option.
+ *
+ * Results:
+ *	A standard Tcl result code. If an error occurs, then an error message
+ *	is left in the interp's result and the option is reset to its
+ *	previous value.
+ *
+ * Side effects:
+ *	Colors are allocated and freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ParsePointColors(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    Tk_Window tkwin,		/* Window in which colors will be used. */
+    PointsItem *ptsPtr)		/* Item whose -colors option changed. */
+{
+    Tcl_Size i, numColors = 0;
+    Tcl_Obj **objv;
+    XColor **colorPtrs = NULL;
+
+    if ((ptsPtr->colorsObj != NULL) && (Tcl_ListObjGetElements(interp,
+	    ptsPtr->colorsObj, &numColors, &objv) != TCL_OK)) {
+	goto error;
+    }
+    if (numColors > 0) {
+	colorPtrs = (XColor **)ckalloc(sizeof(XColor *) * numColors);
+	for (i = 0; i < numColors; i++) {
+	    colorPtrs[i] = Tk_GetColor(interp, tkwin, Tcl_GetString(objv[i]));
+	    if (colorPtrs[i] == NULL) {
+		while (i-- > 0) {
+		    Tk_FreeColor(colorPtrs[i]);
+		}
+		ckfree(colorPtrs);
+		goto error;
+	    }
+	}
+    }
+
+    for (i = 0; i < ptsPtr->numColors; i++) {
+	Tk_FreeColor(ptsPtr->colorPtrs[i]);
+    }
+    if (ptsPtr->colorPtrs != NULL) {
+	ckfree(ptsPtr->colorPtrs);
+    }
+    ptsPtr->colorPtrs = colorPtrs;
+    ptsPtr->numColors = numColors;
+    if (ptsPtr->parsedColorsObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->parsedColorsObj);
+    }
+    ptsPtr->parsedColorsObj = ptsPtr->colorsObj;
+    if (ptsPtr->parsedColorsObj != NULL) {
+	Tcl_IncrRefCount(ptsPtr->parsedColorsObj);
+    }
+    FreePointsCache(ptsPtr, 1);
+    return TCL_OK;
+
+  error:
+    if (ptsPtr->colorsObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->colorsObj);
+    }
+    ptsPtr->colorsObj = ptsPtr->parsedColorsObj;
+    if (ptsPtr->colorsObj != NULL) {
+	Tcl_IncrRefCount(ptsPtr->colorsObj);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ParsePointIndices --
+ *
+ *	Computes the palette index of each point of a points item from its
+ *	-colorindices option.
+ *
+ * Results:
+ *	A standard Tcl result code. If an error occurs, then an error message
+ *	is left in the interp's result and the option is reset to its
+ *	previous value.
+ *
+ * Side effects:
+ *	Memory is allocated and freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+ParsePointIndices(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    PointsItem *ptsPtr)		/* Item whose -colorindices option
+				 * changed. */
+{
+    Tcl_Size i, numIndices = 0;
+    Tcl_Obj **objv;
+    unsigned short *indexPtr = NULL;
+    int index;
+
+    if ((ptsPtr->indicesObj != NULL) && (Tcl_ListObjGetElements(interp,
+	    ptsPtr->indicesObj, &numIndices, &objv) != TCL_OK)) {
+	goto error;
+    }
+    if (numIndices > 0) {
+	indexPtr = (unsigned short *)
+		ckalloc(sizeof(unsigned short) * numIndices);
+	for (i = 0; i < numIndices; i++) {
+	    if (Tcl_GetIntFromObj(interp, objv[i], &index) != TCL_OK) {
+		ckfree(indexPtr);
+		goto error;
+	    }
+	    if ((index < 0) || (index > USHRT_MAX)) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+			"color index \"%s\" out of range",
+			Tcl_GetString(objv[i])));
+		Tcl_SetErrorCode(interp, "TK", "CANVAS", "POINTS",
+			"COLOR_INDEX", (char *)NULL);
+		ckfree(indexPtr);
+		goto error;
+	    }
+	    indexPtr[i] = (unsigned short) index;
+	}
+    }
+
+    if (ptsPtr->indexPtr != NULL) {
+	ckfree(ptsPtr->indexPtr);
+    }
+    ptsPtr->indexPtr = indexPtr;
+    ptsPtr->numIndices = numIndices;
+    if (ptsPtr->parsedIndicesObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->parsedIndicesObj);
+    }
+    ptsPtr->parsedIndicesObj = ptsPtr->indicesObj;
+    if (ptsPtr->parsedIndicesObj != NULL) {
+	Tcl_IncrRefCount(ptsPtr->parsedIndicesObj);
+    }
+    FreePointsCache(ptsPtr, 1);
+    return TCL_OK;
+
+  error:
+    if (ptsPtr->indicesObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->indicesObj);
+    }
+    ptsPtr->indicesObj = ptsPtr->parsedIndicesObj;
+    if (ptsPtr->indicesObj != NULL) {
+	Tcl_IncrRefCount(ptsPtr->indicesObj);
+    }
+    return TCL_ERROR;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DeletePoints --
+ *
+ *	This function is called to clean up the data structure associated with
+ *	a points item.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Resources associated with itemPtr are released.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+DeletePoints(
+    TCL_UNUSED(Tk_Canvas),	/* Info about overall canvas widget. */
+    Tk_Item *itemPtr,		/* Item that is being deleted. */
+    TCL_UNUSED(Display *))	/* Display containing window for canvas. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    Tcl_Size i;
+
+    if (ptsPtr->coordPtr != NULL) {
+	ckfree(ptsPtr->coordPtr);
+    }
+    if (ptsPtr->fillColor != NULL) {
+	Tk_FreeColor(ptsPtr->fillColor);
+    }
+    if (ptsPtr->activeFillColor != NULL) {
+	Tk_FreeColor(ptsPtr->activeFillColor);
+    }
+    if (ptsPtr->disabledFillColor != NULL) {
+	Tk_FreeColor(ptsPtr->disabledFillColor);
+    }
+    for (i = 0; i < ptsPtr->numColors; i++) {
+	Tk_FreeColor(ptsPtr->colorPtrs[i]);
+    }
+    if (ptsPtr->colorPtrs != NULL) {
+	ckfree(ptsPtr->colorPtrs);
+    }
+    if (ptsPtr->indexPtr != NULL) {
+	ckfree(ptsPtr->indexPtr);
+    }
+    if (ptsPtr->colorsObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->colorsObj);
+    }
+    if (ptsPtr->indicesObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->indicesObj);
+    }
+    if (ptsPtr->parsedColorsObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->parsedColorsObj);
+    }
+    if (ptsPtr->parsedIndicesObj != NULL) {
+	Tcl_DecrRefCount(ptsPtr->parsedIndicesObj);
+    }
+    FreePointsCache(ptsPtr, 1);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * FreePointsCache --
+ *
+ *	Throws away the hit-testing grid of a points item, and optionally the
+ *	order in which its points are drawn, after the points or colors have
+ *	changed. They are computed again when next needed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+FreePointsCache(
+    PointsItem *ptsPtr,		/* Item whose cached information is
+				 * obsolete. */
+    int freeOrder)		/* Non-zero means that the drawing order is
+				 * obsolete too, not just the grid. */
+{
+    if (ptsPtr->gridPtr != NULL) {
+	ckfree(ptsPtr->gridPtr->cellStart);
+	if (ptsPtr->gridPtr->cellPoints != NULL) {
+	    ckfree(ptsPtr->gridPtr->cellPoints);
+	}
+	ckfree(ptsPtr->gridPtr);
+	ptsPtr->gridPtr = NULL;
+    }
+    if (freeOrder && (ptsPtr->orderPtr != NULL)) {
+	ckfree(ptsPtr->orderPtr);
+	ckfree(ptsPtr->runPtr);
+	ptsPtr->orderPtr = NULL;
+	ptsPtr->runPtr = NULL;
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ComputePointsBbox --
+ *
+ *	This function is invoked to compute the bounding box of all the pixels
+ *	that may be drawn as part of a points item.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The fields x1, y1, x2, and y2 are updated in the header for itemPtr,
+ *	and so is the bbox field of the item.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+ComputePointsBbox(
+    Tk_Canvas canvas,		/* Canvas that contains item. */
+    PointsItem *ptsPtr)		/* Item whose bbox is to be recomputed. */
+{
+    const float *coordPtr = ptsPtr->coordPtr;
+    double minX, minY, maxX, maxY, halfSize;
+    int i;
+    Tk_State state = ptsPtr->header.state;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    if (ptsPtr->numPoints == 0) {
+	ptsPtr->bbox[0] = ptsPtr->bbox[1] = ptsPtr->bbox[2] =
+		ptsPtr->bbox[3] = 0.0;
+	ptsPtr->header.x1 = ptsPtr->header.x2 = -1;
+	ptsPtr->header.y1 = ptsPtr->header.y2 = -1;
+	return;
+    }
+
+    minX = maxX = coordPtr[0];
+    minY = maxY = coordPtr[1];
+    for (i = 1, coordPtr += 2; i < ptsPtr->numPoints; i++, coordPtr += 2) {
+	if (coordPtr[0] < minX) {
+	    minX = coordPtr[0];
+	} else if (coordPtr[0] > maxX) {
+	    maxX = coordPtr[0];
+	}
+	if (coordPtr[1] < minY) {
+	    minY = coordPtr[1];
+	} else if (coordPtr[1] > maxY) {
+	    maxY = coordPtr[1];
+	}
+    }
+    ptsPtr->bbox[0] = minX;
+    ptsPtr->bbox[1] = minY;
+    ptsPtr->bbox[2] = maxX;
+    ptsPtr->bbox[3] = maxY;
+
+    if (state == TK_STATE_HIDDEN) {
+	ptsPtr->header.x1 = ptsPtr->header.x2 = (int) minX;
+	ptsPtr->header.y1 = ptsPtr->header.y2 = (int) minY;
+	return;
+    }
+
+    /*
+     * Add one pixel all around to allow for rounding to the pixel grid.
+     */
+
+    halfSize = ptsPtr->size / 2.0;
+    ptsPtr->header.x1 = (int) floor(minX - halfSize) - 1;
+    ptsPtr->header.y1 = (int) floor(minY - halfSize) - 1;
+    ptsPtr->header.x2 = (int) ceil(maxX + halfSize) + 1;
+    ptsPtr->header.y2 = (int) ceil(maxY + halfSize) + 1;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPointsOrder --
+ *
+ *	Returns the point numbers of a points item sorted by palette index,
+ *	computing them first if necessary. This allows all points of the same
+ *	color to be drawn together, whatever order they were given in.
+ *
+ * Results:
+ *	Returns ptsPtr->orderPtr; ptsPtr->runPtr tells where the points of
+ *	each color start.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int *
+GetPointsOrder(
+    PointsItem *ptsPtr)		/* Item with a palette. */
+{
+    int i, c, numRuns = (int) ptsPtr->numColors + 1;
+    int *runPtr;
+
+    if (ptsPtr->orderPtr != NULL) {
+	return ptsPtr->orderPtr;
+    }
+
+    /*
+     * This is a counting sort: first count the points of each color, then
+     * turn the counts into start positions, then place the points.
+     */
+
+    runPtr = (int *)ckalloc(sizeof(int) * (numRuns + 1));
+    memset(runPtr, 0, sizeof(int) * (numRuns + 1));
+    for (i = 0; i < ptsPtr->numPoints; i++) {
+	c = (i < ptsPtr->numIndices) ? ptsPtr->indexPtr[i] : numRuns - 1;
+	if (c >= numRuns) {
+	    c = numRuns - 1;
+	}
+	runPtr[c + 1]++;
+    }
+    for (c = 0; c < numRuns; c++) {
+	runPtr[c + 1] += runPtr[c];
+    }
+    ptsPtr->orderPtr = (int *)ckalloc(sizeof(int) * (ptsPtr->numPoints + 1));
+    for (i = 0; i < ptsPtr->numPoints; i++) {
+	c = (i < ptsPtr->numIndices) ? ptsPtr->indexPtr[i] : numRuns - 1;
+	if (c >= numRuns) {
+	    c = numRuns - 1;
+	}
+	ptsPtr->orderPtr[runPtr[c]++] = i;
+    }
+
+    /*
+     * Placing the points moved each start position to the start of the
+     * next color, so shift them back.
+     */
+
+    for (c = numRuns; c > 0; c--) {
+	runPtr[c] = runPtr[c - 1];
+    }
+    runPtr[0] = 0;
+    ptsPtr->runPtr = runPtr;
+    return ptsPtr->orderPtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPointsColor --
+ *
+ *	Works out whether the state of a points item overrides the colors of
+ *	its points.
+ *
+ * Results:
+ *	Returns the color to use for points without a palette entry. If
+ *	*overridePtr is set to 1, this color is to be used for all points.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static XColor *
+GetPointsColor(
+    Tk_Canvas canvas,		/* Canvas that contains item. */
+    PointsItem *ptsPtr,		/* Item to be drawn. */
+    int *overridePtr)		/* Set to 1 if the palette is not to be
+				 * used, 0 otherwise. */
+{
+    Tk_State state = ptsPtr->header.state;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    *overridePtr = 1;
+    if (Canvas(canvas)->currentItemPtr == (Tk_Item *) ptsPtr) {
+	if (ptsPtr->activeFillColor != NULL) {
+	    return ptsPtr->activeFillColor;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (ptsPtr->disabledFillColor != NULL) {
+	    return ptsPtr->disabledFillColor;
+	}
+    }
+    *overridePtr = (ptsPtr->numColors == 0) || (ptsPtr->numIndices == 0);
+    return ptsPtr->fillColor;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * DisplayPoints --
+ *
+ *	This function is invoked to draw a points item in a given drawable.
+ *	The points are drawn one color at a time, many points per call to
+ *	XFillRectangles.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	ItemPtr is drawn in drawable using the transformation information in
+ *	canvas.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+DisplayPoints(
+    Tk_Canvas canvas,		/* Canvas that contains item. */
+    Tk_Item *itemPtr,		/* Item to be displayed. */
+    Display *display,		/* Display on which to draw item. */
+    Drawable drawable,		/* Pixmap or window in which to draw item. */
+    int x, int y, int width, int height)
+				/* Describes region of canvas that must be
+				 * redisplayed. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    TkCanvas *canvasPtr = Canvas(canvas);
+    XRectangle rects[POINTS_BATCH];
+    XColor *fillColor, *color;
+    const int *orderPtr = NULL;
+    int override, c, i, j, n, first, last, numRuns, size, offset;
+    double px, py, x1, y1, x2, y2;
+
+    fillColor = GetPointsColor(canvas, ptsPtr, &override);
+    if (!override) {
+	orderPtr = GetPointsOrder(ptsPtr);
+    }
+    numRuns = override ? 1 : (int) ptsPtr->numColors + 1;
+    size = ptsPtr->size;
+    offset = size / 2;
+
+    /*
+     * Only the points in the area being redisplayed are drawn. Everything
+     * within that area fits into the 16-bit coordinates of XRectangle.
+     */
+
+    x1 = x - size;
+    y1 = y - size;
+    x2 = x + width + size;
+    y2 = y + height + size;
+
+    for (c = 0; c < numRuns; c++) {
+	if (override) {
+	    color = fillColor;
+	    first = 0;
+	    last = ptsPtr->numPoints;
+	} else {
+	    color = (c < ptsPtr->numColors) ? ptsPtr->colorPtrs[c] : fillColor;
+	    first = ptsPtr->runPtr[c];
+	    last = ptsPtr->runPtr[c + 1];
+	}
+	if ((color == NULL) || (first == last)) {
+	    continue;
+	}
+	n = 0;
+	for (i = first; i < last; i++) {
+	    j = orderPtr ? orderPtr[i] : i;
+	    px = ptsPtr->coordPtr[2*j];
+	    py = ptsPtr->coordPtr[2*j + 1];
+	    if ((px < x1) || (px > x2) || (py < y1) || (py > y2)) {
+		continue;
+	    }
+	    px -= canvasPtr->drawableXOrigin;
+	    py -= canvasPtr->drawableYOrigin;
+	    rects[n].x = (short) ((px > 0) ? (px + 0.5) : (px - 0.5)) - offset;
+	    rects[n].y = (short) ((py > 0) ? (py + 0.5) : (py - 0.5)) - offset;
+	    rects[n].width = (unsigned short) size;
+	    rects[n].height = (unsigned short) size;
+	    if (++n == POINTS_BATCH) {
+		XFillRectangles(display, drawable,
+			Tk_GCForColor(color, drawable), rects, n);
+		n = 0;
+	    }
+	}
+	if (n > 0) {
+	    XFillRectangles(display, drawable,
+		    Tk_GCForColor(color, drawable), rects, n);
+	}
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPointGrid --
+ *
+ *	Returns the grid used to find points of a points item quickly,
+ *	building it first if necessary.
+ *
+ * Results:
+ *	The grid, or NULL if the item has no points.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static PointGrid *
+GetPointGrid(
+    PointsItem *ptsPtr)		/* Item to be searched. */
+{
+    PointGrid *gridPtr = ptsPtr->gridPtr;
+    double w, h, cellSize;
+    int i, cell, numCells;
+    int *cellOfPoint;
+
+    if ((gridPtr != NULL) || (ptsPtr->numPoints == 0)) {
+	return gridPtr;
+    }
+
+    w = ptsPtr->bbox[2] - ptsPtr->bbox[0];
+    h = ptsPtr->bbox[3] - ptsPtr->bbox[1];
+    cellSize = sqrt(((w > 1.0) ? w : 1.0) * ((h > 1.0) ? h : 1.0)
+	    / (ptsPtr->numPoints / POINTS_PER_CELL + 1));
+    if (cellSize < 1.0) {
+	cellSize = 1.0;
+    }
+
+    gridPtr = (PointGrid *)ckalloc(sizeof(PointGrid));
+    gridPtr->x0 = ptsPtr->bbox[0];
+    gridPtr->y0 = ptsPtr->bbox[1];
+    gridPtr->cellSize = cellSize;
+    gridPtr->cols = (int) (w / cellSize) + 1;
+    gridPtr->rows = (int) (h / cellSize) + 1;
+    numCells = gridPtr->cols * gridPtr->rows;
+
+    /*
+     * Sort the points by cell with a counting sort, just like
+     * GetPointsOrder sorts them by color.
+     */
+
+    gridPtr->cellStart = (int *)ckalloc(sizeof(int) * (numCells + 1));
+    memset(gridPtr->cellStart, 0, sizeof(int) * (numCells + 1));
+    gridPtr->cellPoints = (int *)ckalloc(sizeof(int) * ptsPtr->numPoints);
+    cellOfPoint = (int *)ckalloc(sizeof(int) * ptsPtr->numPoints);
+    for (i = 0; i < ptsPtr->numPoints; i++) {
+	int col = (int) ((ptsPtr->coordPtr[2*i] - gridPtr->x0) / cellSize);
+	int row = (int) ((ptsPtr->coordPtr[2*i + 1] - gridPtr->y0) / cellSize);
+
+	if (col >= gridPtr->cols) {
+	    col = gridPtr->cols - 1;
+	}
+	if (row >= gridPtr->rows) {
+	    row = gridPtr->rows - 1;
+	}
+	cellOfPoint[i] = row * gridPtr->cols + col;
+	gridPtr->cellStart[cellOfPoint[i] + 1]++;
+    }
+    for (cell = 0; cell < numCells; cell++) {
+	gridPtr->cellStart[cell + 1] += gridPtr->cellStart[cell];
+    }
+    for (i = 0; i < ptsPtr->numPoints; i++) {
+	gridPtr->cellPoints[gridPtr->cellStart[cellOfPoint[i]]++] = i;
+    }
+    for (cell = numCells; cell > 0; cell--) {
+	gridPtr->cellStart[cell] = gridPtr->cellStart[cell - 1];
+    }
+    gridPtr->cellStart[0] = 0;
+    ckfree(cellOfPoint);
+
+    ptsPtr->gridPtr = gridPtr;
+    return gridPtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetNearestPoint --
+ *
+ *	Finds the point of a points item that is closest to a given location.
+ *	The cells of the grid are searched in rings of growing size around
+ *	the location, until no closer point can be found farther out.
+ *
+ * Results:
+ *	The return value is the distance from (x,y) to the square of the
+ *	given size around the closest point, or 1.0e36 if the item has no
+ *	points. The number of the closest point is stored at *indexPtr.
+ *
+ * Side effects:
+ *	The grid may be built.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double
+GetNearestPoint(
+    PointsItem *ptsPtr,		/* Item to search. */
+    double x, double y,		/* Location to search from. */
+    double halfSize,		/* Half the width of each point. */
+    int *indexPtr)		/* Where to store the number of the closest
+				 * point. */
+{
+    PointGrid *gridPtr = GetPointGrid(ptsPtr);
+    double bestDist = 1.0e36, xDiff, yDiff, dist;
+    int col, row, ring, maxRing, i, j, k, step, cell;
+
+    *indexPtr = 0;
+    if (gridPtr == NULL) {
+	return bestDist;
+    }
+    col = (int) floor((x - gridPtr->x0) / gridPtr->cellSize);
+    row = (int) floor((y - gridPtr->y0) / gridPtr->cellSize);
+    col = (col < 0) ? 0 : (col >= gridPtr->cols) ? gridPtr->cols - 1 : col;
+    row = (row < 0) ? 0 : (row >= gridPtr->rows) ? gridPtr->rows - 1 : row;
+    maxRing = (gridPtr->cols > gridPtr->rows) ? gridPtr->cols : gridPtr->rows;
+
+    for (ring = 0; ring <= maxRing; ring++) {
+	for (j = row - ring; j <= row + ring; j++) {
+	    if ((j < 0) || (j >= gridPtr->rows)) {
+		continue;
+	    }
+
+	    /*
+	     * On the top and bottom row of the ring visit every cell, on the
+	     * others only the first and last.
+	     */
+
+	    step = ((j == row - ring) || (j == row + ring) || (ring == 0))
+		    ? 1 : 2 * ring;
+	    for (i = col - ring; i <= col + ring; i += step) {
+		if ((i < 0) || (i >= gridPtr->cols)) {
+		    continue;
+		}
+		cell = j * gridPtr->cols + i;
+		for (k = gridPtr->cellStart[cell];
+			k < gridPtr->cellStart[cell + 1]; k++) {
+		    int p = gridPtr->cellPoints[k];
+
+		    xDiff = fabs(x - ptsPtr->coordPtr[2*p]) - halfSize;
+		    yDiff = fabs(y - ptsPtr->coordPtr[2*p + 1]) - halfSize;
+		    if (xDiff < 0.0) {
+			xDiff = 0.0;
+		    }
+		    if (yDiff < 0.0) {
+			yDiff = 0.0;
+		    }
+		    dist = hypot(xDiff, yDiff);
+		    if (dist < bestDist) {
+			bestDist = dist;
+			*indexPtr = p;
+		    }
+		}
+	    }
+	}
+
+	/*
+	 * Any point in a cell outside the rings searched so far is at least
+	 * ring cells away.
+	 */
+
+	if (bestDist <= ring * gridPtr->cellSize - halfSize) {
+	    break;
+	}
+    }
+    return bestDist;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PointsToPoint --
+ *
+ *	Computes the distance from a given point to a given points item, in
+ *	canvas units.
+ *
+ * Results:
+ *	The return value is 0 if the point whose x and y coordinates are
+ *	coordPtr[0] and coordPtr[1] is inside one of the points of the item.
+ *	Otherwise the return value is the distance to the closest one.
+ *
+ * Side effects:
+ *	The grid used for hit-testing may be built.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double
+PointsToPoint(
+    TCL_UNUSED(Tk_Canvas),	/* Canvas containing item. */
+    Tk_Item *itemPtr,		/* Item to check against point. */
+    double *coordPtr)		/* Pointer to x and y coordinates. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    int index;
+
+    return GetNearestPoint(ptsPtr, coordPtr[0], coordPtr[1],
+	    ptsPtr->size / 2.0, &index);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PointsToArea --
+ *
+ *	This function is called to determine whether an item lies entirely
+ *	inside, entirely outside, or overlapping a given rectangle.
+ *
+ * Results:
+ *	-1 is returned if the item is entirely outside the area given by
+ *	rectPtr, 0 if it overlaps, and 1 if it is entirely inside the given
+ *	area.
+ *
+ * Side effects:
+ *	The grid used for hit-testing may be built.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PointsToArea(
+    TCL_UNUSED(Tk_Canvas),	/* Canvas containing item. */
+    Tk_Item *itemPtr,		/* Item to check against rectangle. */
+    double *rectPtr)		/* Pointer to array of four coordinates
+				 * (x1,y1,x2,y2) describing rectangular
+				 * area. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    PointGrid *gridPtr;
+    double halfSize = ptsPtr->size / 2.0, px, py;
+    int col1, row1, col2, row2, i, j, k, cell;
+
+    if ((ptsPtr->numPoints == 0)
+	    || (rectPtr[2] < ptsPtr->bbox[0] - halfSize)
+	    || (rectPtr[0] > ptsPtr->bbox[2] + halfSize)
+	    || (rectPtr[3] < ptsPtr->bbox[1] - halfSize)
+	    || (rectPtr[1] > ptsPtr->bbox[3] + halfSize)) {
+	return -1;
+    }
+    if ((rectPtr[0] <= ptsPtr->bbox[0] - halfSize)
+	    && (rectPtr[1] <= ptsPtr->bbox[1] - halfSize)
+	    && (rectPtr[2] >= ptsPtr->bbox[2] + halfSize)
+	    && (rectPtr[3] >= ptsPtr->bbox[3] + halfSize)) {
+	return 1;
+    }
+
+    /*
+     * Only look at the points in cells that overlap the rectangle.
+     */
+
+    gridPtr = GetPointGrid(ptsPtr);
+    col1 = (int) floor((rectPtr[0] - halfSize - gridPtr->x0)
+	    / gridPtr->cellSize);
+    row1 = (int) floor((rectPtr[1] - halfSize - gridPtr->y0)
+	    / gridPtr->cellSize);
+    col2 = (int) floor((rectPtr[2] + halfSize - gridPtr->x0)
+	    / gridPtr->cellSize);
+    row2 = (int) floor((rectPtr[3] + halfSize - gridPtr->y0)
+	    / gridPtr->cellSize);
+    col1 = (col1 < 0) ? 0 : col1;
+    row1 = (row1 < 0) ? 0 : row1;
+    col2 = (col2 >= gridPtr->cols) ? gridPtr->cols - 1 : col2;
+    row2 = (row2 >= gridPtr->rows) ? gridPtr->rows - 1 : row2;
+    for (j = row1; j <= row2; j++) {
+	for (i = col1; i <= col2; i++) {
+	    cell = j * gridPtr->cols + i;
+	    for (k = gridPtr->cellStart[cell];
+		    k < gridPtr->cellStart[cell + 1]; k++) {
+		px = ptsPtr->coordPtr[2*gridPtr->cellPoints[k]];
+		py = ptsPtr->coordPtr[2*gridPtr->cellPoints[k] + 1];
+		if ((px + halfSize >= rectPtr[0])
+			&& (px - halfSize <= rectPtr[2])
+			&& (py + halfSize >= rectPtr[1])
+			&& (py - halfSize <= rectPtr[3])) {
+		    return 0;
+		}
+	    }
+	}
+    }
+    return -1;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPointsIndex --
+ *
+ *	Parse an index into a points item and return either its value or an
+ *	error. Besides integers and "end", "@x,y" is accepted, which is the
+ *	number of the point closest to (x,y).
+ *
+ * Results:
+ *	A standard Tcl result. If all went well, then *indexPtr is filled in
+ *	with the number of a point (not a coordinate, unlike line items).
+ *	Otherwise an error message is left in interp's result.
+ *
+ * Side effects:
+ *	The grid used for hit-testing may be built.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+GetPointsIndex(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    TCL_UNUSED(Tk_Canvas),	/* Canvas containing item. */
+    Tk_Item *itemPtr,		/* Item for which the index is being
+				 * specified. */
+    Tcl_Obj *obj,		/* Specification of a particular point in
+				 * itemPtr. */
+    Tcl_Size *indexPtr)		/* Where to store converted index. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    Tcl_Size idx;
+    const char *string;
+
+    if (TCL_OK == TkGetIntForIndex(obj, ptsPtr->numPoints - 1, 0, &idx)) {
+	if (idx < 0) {
+	    idx = 0;
+	} else if (idx >= ptsPtr->numPoints) {
+	    idx = (ptsPtr->numPoints > 0) ? ptsPtr->numPoints - 1 : 0;
+	}
+	*indexPtr = idx;
+	return TCL_OK;
+    }
+
+    string = Tcl_GetString(obj);
+    if (string[0] == '@') {
+	double x, y;
+	int index;
+	char *end;
+
+	x = strtod(string + 1, &end);
+	if ((end == string + 1) || (*end != ',')) {
+	    goto badIndex;
+	}
+	string = end + 1;
+	y = strtod(string, &end);
+	if ((end == string) || (*end != '\0')) {
+	    goto badIndex;
+	}
+	GetNearestPoint(ptsPtr, x, y, 0.0, &index);
+	*indexPtr = index;
+	return TCL_OK;
+    }
+
+  badIndex:
+    Tcl_SetObjResult(interp, Tcl_ObjPrintf("bad index \"%s\"",
+	    Tcl_GetString(obj)));
+    Tcl_SetErrorCode(interp, "TK", "CANVAS", "ITEM_INDEX", "POINTS",
+	    (char *)NULL);
+    return TCL_ERROR;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ScalePoints --
+ *
+ *	This function is invoked to rescale a points item.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The points referred to by itemPtr are rescaled so that the following
+ *	transformation is applied to all point coordinates:
+ *		x' = originX + scaleX*(x-originX)
+ *		y' = originY + scaleY*(y-originY)
+ *	The size of the points is not changed.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+ScalePoints(
+    Tk_Canvas canvas,		/* Canvas containing item. */
+    Tk_Item *itemPtr,		/* Item to be scaled. */
+    double originX, double originY,
+				/* Origin about which to scale item. */
+    double scaleX,		/* Amount to scale in X direction. */
+    double scaleY)		/* Amount to scale in Y direction. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    float *coordPtr = ptsPtr->coordPtr;
+    int i;
+
+    for (i = 0; i < ptsPtr->numPoints; i++, coordPtr += 2) {
+	coordPtr[0] = (float) (originX + scaleX*(coordPtr[0] - originX));
+	coordPtr[1] = (float) (originY + scaleY*(coordPtr[1] - originY));
+    }
+    FreePointsCache(ptsPtr, 0);
+    ComputePointsBbox(canvas, ptsPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TranslatePoints --
+ *
+ *	This function is called to move a points item by a given amount.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The position of the item is offset by (deltaX, deltaY), and the
+ *	bounding box is updated in the generic part of the item structure.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+TranslatePoints(
+    Tk_Canvas canvas,		/* Canvas containing item. */
+    Tk_Item *itemPtr,		/* Item that is being moved. */
+    double deltaX, double deltaY)
+				/* Amount by which item is to be moved. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    float *coordPtr = ptsPtr->coordPtr;
+    int i;
+
+    for (i = 0; i < ptsPtr->numPoints; i++, coordPtr += 2) {
+	coordPtr[0] = (float) (coordPtr[0] + deltaX);
+	coordPtr[1] = (float) (coordPtr[1] + deltaY);
+    }
+    FreePointsCache(ptsPtr, 0);
+    ComputePointsBbox(canvas, ptsPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * RotatePoints --
+ *
+ *	This function is called to rotate a points item by a given amount
+ *	about a point.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The position of the item is rotated by angleRad about (originX,
+ *	originY), and the bounding box is updated in the generic part of the
+ *	item structure.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+RotatePoints(
+    Tk_Canvas canvas,		/* Canvas containing item. */
+    Tk_Item *itemPtr,		/* Item that is being rotated. */
+    double originX, double originY,
+				/* Point about which to rotate item. */
+    double angleRad)		/* Amount by which item is to be rotated. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    float *coordPtr = ptsPtr->coordPtr;
+    double s = sin(angleRad), c = cos(angleRad), x, y;
+    int i;
+
+    for (i = 0; i < ptsPtr->numPoints; i++, coordPtr += 2) {
+	x = coordPtr[0];
+	y = coordPtr[1];
+	TkRotatePoint(originX, originY, s, c, &x, &y);
+	coordPtr[0] = (float) x;
+	coordPtr[1] = (float) y;
+    }
+    FreePointsCache(ptsPtr, 0);
+    ComputePointsBbox(canvas, ptsPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PointsToPostscript --
+ *
+ *	This function is called to generate Postscript for points items.
+ *
+ * Results:
+ *	The return value is a standard Tcl result. If an error occurs in
+ *	generating Postscript then an error message is left in the interp's
+ *	result, replacing whatever used to be there. If no error occurs, then
+ *	Postscript for the item is appended to the result.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PointsToPostscript(
+    Tcl_Interp *interp,		/* Leave Postscript or error message here. */
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item for which Postscript is wanted. */
+    int prepass)		/* 1 means this is a prepass to collect font
+				 * information; 0 means final Postscript is
+				 * being created. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    XColor *fillColor, *color;
+    const int *orderPtr = NULL;
+    int override, c, i, j, first, last, numRuns, size;
+    Tcl_Obj *psObj;
+    Tcl_InterpState interpState;
+
+    if (prepass || (ptsPtr->numPoints == 0)) {
+	return TCL_OK;
+    }
+    fillColor = GetPointsColor(canvas, ptsPtr, &override);
+    if (!override) {
+	orderPtr = GetPointsOrder(ptsPtr);
+    }
+    numRuns = override ? 1 : (int) ptsPtr->numColors + 1;
+    size = ptsPtr->size;
+
+    psObj = Tcl_NewObj();
+    interpState = Tcl_SaveInterpState(interp, TCL_OK);
+    for (c = 0; c < numRuns; c++) {
+	if (override) {
+	    color = fillColor;
+	    first = 0;
+	    last = ptsPtr->numPoints;
+	} else {
+	    color = (c < ptsPtr->numColors) ? ptsPtr->colorPtrs[c] : fillColor;
+	    first = ptsPtr->runPtr[c];
+	    last = ptsPtr->runPtr[c + 1];
+	}
+	if ((color == NULL) || (first == last)) {
+	    continue;
+	}
+	Tcl_ResetResult(interp);
+	Tk_CanvasPsColor(interp, canvas, color);
+	Tcl_AppendObjToObj(psObj, Tcl_GetObjResult(interp));
+
+	/*
+	 * Fill the squares in groups, to keep the paths short.
+	 */
+
+	for (i = first; i < last; i++) {
+	    j = orderPtr ? orderPtr[i] : i;
+	    Tcl_AppendPrintfToObj(psObj,
+		    "%.15g %.15g moveto %d 0 rlineto 0 %d rlineto "
+		    "%d 0 rlineto closepath\n",
+		    ptsPtr->coordPtr[2*j] - size/2.0,
+		    Tk_CanvasPsY(canvas, ptsPtr->coordPtr[2*j + 1]) - size/2.0,
+		    size, size, -size);
+	    if (((i - first) % 100 == 99) || (i == last - 1)) {
+		Tcl_AppendToObj(psObj, "fill\n", TCL_INDEX_NONE);
+	    }
+	}
+    }
+
+    (void) Tcl_RestoreInterpState(interp, interpState);
+    Tcl_AppendObjToObj(Tcl_GetObjResult(interp), psObj);
+    Tcl_DecrRefCount(psObj);
+    return TCL_OK;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PointsToExport --
+ *
+ *	This function is called to describe a points item for the "export"
+ *	widget command. Each color becomes one path made of squares.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Output is generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PointsToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    int prepass)		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    PointsItem *ptsPtr = (PointsItem *) itemPtr;
+    XColor *fillColor, *color;
+    const int *orderPtr = NULL;
+    int override, c, i, j, first, last, numRuns;
+    double halfSize = ptsPtr->size / 2.0, square[8];
+
+    if (prepass || (ptsPtr->numPoints == 0)) {
+	return TCL_OK;
+    }
+    fillColor = GetPointsColor(canvas, ptsPtr, &override);
+    if (!override) {
+	orderPtr = GetPointsOrder(ptsPtr);
+    }
+    numRuns = override ? 1 : (int) ptsPtr->numColors + 1;
+
+    for (c = 0; c < numRuns; c++) {
+	if (override) {
+	    color = fillColor;
+	    first = 0;
+	    last = ptsPtr->numPoints;
+	} else {
+	    color = (c < ptsPtr->numColors) ? ptsPtr->colorPtrs[c] : fillColor;
+	    first = ptsPtr->runPtr[c];
+	    last = ptsPtr->runPtr[c + 1];
+	}
+	if ((color == NULL) || (first == last)) {
+	    continue;
+	}
+
+	/*
+	 * Paint the squares in groups, so that the output can be flushed in
+	 * between.
+	 */
+
+	for (i = first; i < last; i++) {
+	    j = orderPtr ? orderPtr[i] : i;
+	    square[0] = square[6] = ptsPtr->coordPtr[2*j] - halfSize;
+	    square[2] = square[4] = ptsPtr->coordPtr[2*j] + halfSize;
+	    square[1] = square[3] = ptsPtr->coordPtr[2*j + 1] - halfSize;
+	    square[5] = square[7] = ptsPtr->coordPtr[2*j + 1] + halfSize;
+	    TkCanvExportPath(canvas, square, 4, 1);
+	    if (((i - first) % POINTS_BATCH == POINTS_BATCH - 1)
+		    || (i == last - 1)) {
+		if (TkCanvExportPaint(canvas, itemPtr, color, None, NULL,
+			CapButt, JoinMiter) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+	    }
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
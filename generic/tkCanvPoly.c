@@ -49,8 +49,24 @@ typedef struct PolygonItem  {
     int splineSteps;		/* Number of steps in each spline segment. */
     int autoClosed;		/* Zero means the given polygon was closed,
 				   one means that we auto closed it. */
+    TkSegmentTree *segTreePtr;	/* Segment tree over the (smoothed) points of
+				 * the polygon, used for hit-testing polygons
+				 * with many points. Built on demand by
+				 * GetPolygonSegmentTree; NULL means not built
+				 * yet. */
 } PolygonItem;
 
+/*
+ * Information passed to the per-segment hit-testing functions when the
+ * outline of a polygon is searched through its segment tree:
+ */
+
+typedef struct {
+    PolygonItem *polyPtr;	/* Polygon being tested. */
+    TkSegmentTree *treePtr;	/* Tree holding the points of the polygon. */
+    double width;		/* Width of the outline. */
+} PolygonSegmentInfo;
+
 /*
  * Information used for parsing configuration specs:
  */
@@ -163,6 +179,8 @@ static void		DisplayPolygon(Tk_Canvas canvas,
 static int		GetPolygonIndex(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr,
 			    Tcl_Obj *obj, Tcl_Size *indexPtr);
+static TkSegmentTree *	GetPolygonSegmentTree(Tk_Canvas canvas,
+			    PolygonItem *polyPtr);
 static int		PolygonCoords(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr,
 			    Tcl_Size objc, Tcl_Obj *const objv[]);
@@ -174,8 +192,14 @@ static int		PolygonToArea(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *rectPtr);
 static double		PolygonToPoint(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *pointPtr);
+static int		PolygonSegmentToArea(void *clientData,
+			    Tcl_Size index, double *rectPtr);
+static double		PolygonSegmentToPoint(void *clientData,
+			    Tcl_Size index, double *pointPtr);
 static int		PolygonToPostscript(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static int		PolygonToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
 static void		RotatePolygon(Tk_Canvas canvas, Tk_Item *itemPtr,
 			    double originX, double originY, double angleRad);
 static void		ScalePolygon(Tk_Canvas canvas,
@@ -211,7 +235,9 @@ Tk_ItemType tkPolygonType = {
     PolygonDeleteCoords,		/* dTextProc */
     NULL,				/* nextPtr */
     RotatePolygon,			/* rotateProc */
-    0, NULL, NULL
+    0,					/* reserved2 */
+    PolygonToExport,			/* exportProc */
+    NULL				/* reserved4 */
 };
 
 /*
@@ -280,6 +306,7 @@ CreatePolygon(
     polyPtr->smooth = NULL;
     polyPtr->splineSteps = 12;
     polyPtr->autoClosed = 0;
+    polyPtr->segTreePtr = NULL;
 
     /*
      * Count the number of points and then parse them into a point array.
@@ -597,6 +624,7 @@ DeletePolygon(
     if (polyPtr->fillGC != NULL) {
 	Tk_FreeGC(display, polyPtr->fillGC);
     }
+    TkSegmentTreeFree(polyPtr->segTreePtr);
 }
 
 /*
@@ -627,6 +655,15 @@ ComputePolygonBbox(
     Tk_State state = polyPtr->header.state;
     Tk_TSOffset *tsoffset;
 
+    /*
+     * Any change to the points of the polygon ends up here, so this is where
+     * the segment tree is discarded; it gets rebuilt the next time it's
+     * needed.
+     */
+
+    TkSegmentTreeFree(polyPtr->segTreePtr);
+    polyPtr->segTreePtr = NULL;
+
     if (state == TK_STATE_NULL) {
 	state = Canvas(canvas)->canvas_state;
     }
@@ -1300,6 +1337,7 @@ PolygonToPoint(
 				 * angle was < 11 degrees. */
     double width;
     Tk_State state = itemPtr->state;
+    TkSegmentTree *treePtr;
 
     bestDist = 1.0e36;
 
@@ -1320,10 +1358,15 @@ PolygonToPoint(
 
     /*
      * Handle smoothed polygons by generating an expanded set of points
-     * against which to do the check.
+     * against which to do the check. Large polygons have these in their
+     * segment tree.
      */
 
-    if ((polyPtr->smooth) && (polyPtr->numPoints > 2)) {
+    treePtr = GetPolygonSegmentTree(canvas, polyPtr);
+    if (treePtr != NULL) {
+	numPoints = treePtr->numPoints;
+	polyPoints = treePtr->coordPtr;
+    } else if ((polyPtr->smooth) && (polyPtr->numPoints > 2)) {
 	numPoints = polyPtr->smooth->coordProc(canvas, NULL,
 		polyPtr->numPoints, polyPtr->splineSteps, NULL, NULL);
 	if (numPoints <= MAX_STATIC_POINTS) {
@@ -1338,7 +1381,11 @@ PolygonToPoint(
 	polyPoints = polyPtr->coordPtr;
     }
 
-    bestDist = TkPolygonToPoint(polyPoints, numPoints, pointPtr);
+    if (treePtr != NULL) {
+	bestDist = TkSegmentTreePolygonToPoint(treePtr, pointPtr);
+    } else {
+	bestDist = TkPolygonToPoint(polyPoints, numPoints, pointPtr);
+    }
     if (bestDist <= 0.0) {
 	goto donepoint;
     }
@@ -1356,6 +1403,18 @@ PolygonToPoint(
 	goto donepoint;
     }
 
+    if (treePtr != NULL) {
+	PolygonSegmentInfo info;
+
+	info.polyPtr = polyPtr;
+	info.treePtr = treePtr;
+	info.width = width;
+	bestDist = TkSegmentTreeToPoint(treePtr,
+		TK_SEGMENT_MARGIN(width, polyPtr->joinStyle), pointPtr,
+		bestDist, PolygonSegmentToPoint, &info);
+	goto donepoint;
+    }
+
     /*
      * The overall idea is to iterate through all of the edges of the line,
      * computing a polygon for each edge and testing the point against that
@@ -1446,7 +1505,8 @@ PolygonToPoint(
     }
 
   donepoint:
-    if (polyPoints != staticSpace && polyPoints != polyPtr->coordPtr) {
+    if (polyPoints != staticSpace && polyPoints != polyPtr->coordPtr
+	    && treePtr == NULL) {
 	ckfree(polyPoints);
     }
     return bestDist;
@@ -1495,6 +1555,7 @@ PolygonToArea(
 				 * means overlap has been found. */
     double width;
     Tk_State state = itemPtr->state;
+    TkSegmentTree *treePtr;
 
     if (state == TK_STATE_NULL) {
 	state = Canvas(canvas)->canvas_state;
@@ -1528,10 +1589,15 @@ PolygonToArea(
 
     /*
      * Handle smoothed polygons by generating an expanded set of points
-     * against which to do the check.
+     * against which to do the check. Large polygons have these in their
+     * segment tree.
      */
 
-    if (polyPtr->smooth) {
+    treePtr = GetPolygonSegmentTree(canvas, polyPtr);
+    if (treePtr != NULL) {
+	numPoints = treePtr->numPoints;
+	polyPoints = treePtr->coordPtr;
+    } else if (polyPtr->smooth) {
 	numPoints = polyPtr->smooth->coordProc(canvas, NULL,
 		polyPtr->numPoints, polyPtr->splineSteps, NULL, NULL);
 	if (numPoints <= MAX_STATIC_POINTS) {
@@ -1552,7 +1618,11 @@ PolygonToArea(
      * if it isn't filled.
      */
 
-    inside = TkPolygonToArea(polyPoints, numPoints, rectPtr);
+    if (treePtr != NULL) {
+	inside = TkSegmentTreePolygonToArea(treePtr, rectPtr);
+    } else {
+	inside = TkPolygonToArea(polyPoints, numPoints, rectPtr);
+    }
     if (inside == 0) {
 	goto donearea;
     }
@@ -1561,6 +1631,20 @@ PolygonToArea(
 	goto donearea;
     }
 
+    if (treePtr != NULL) {
+	PolygonSegmentInfo info;
+
+	info.polyPtr = polyPtr;
+	info.treePtr = treePtr;
+	info.width = width;
+	if (TkSegmentTreeToArea(treePtr,
+		TK_SEGMENT_MARGIN(width, polyPtr->joinStyle), rectPtr,
+		PolygonSegmentToArea, &info) != inside) {
+	    inside = 0;
+	}
+	goto donearea;
+    }
+
     /*
      * Iterate through all of the edges of the line, computing a polygon for
      * each edge and testing the area against that polygon. In addition, there
@@ -1639,11 +1723,171 @@ PolygonToArea(
     }
 
   donearea:
-    if ((polyPoints != staticSpace) && (polyPoints != polyPtr->coordPtr)) {
+    if ((polyPoints != staticSpace) && (polyPoints != polyPtr->coordPtr)
+	    && (treePtr == NULL)) {
 	ckfree(polyPoints);
     }
     return inside;
 }
+
+/*
+ *--------------------------------------------------------------
+ *
+ * GetPolygonSegmentTree --
+ *
+ *	Returns the segment tree used to hit-test a polygon with many points,
+ *	building it if necessary from the points of the polygon (after
+ *	smoothing).
+ *
+ * Results:
+ *	The tree, or NULL if the polygon has too few points to benefit from
+ *	one.
+ *
+ * Side effects:
+ *	The tree is cached in the item until its points change.
+ *
+ *--------------------------------------------------------------
+ */
+
+static TkSegmentTree *
+GetPolygonSegmentTree(
+    Tk_Canvas canvas,		/* Canvas containing item. */
+    PolygonItem *polyPtr)	/* Polygon whose tree is wanted. */
+{
+    double *polyPoints;
+    int numPoints;
+
+    if (polyPtr->segTreePtr != NULL) {
+	return polyPtr->segTreePtr;
+    }
+    if ((polyPtr->smooth) && (polyPtr->numPoints > 2)) {
+	numPoints = polyPtr->smooth->coordProc(canvas, NULL,
+		polyPtr->numPoints, polyPtr->splineSteps, NULL, NULL);
+    } else {
+	numPoints = polyPtr->numPoints;
+    }
+    if (numPoints < TK_SEGMENT_TREE_MIN_POINTS) {
+	return NULL;
+    }
+
+    if ((polyPtr->smooth) && (polyPtr->numPoints > 2)) {
+	polyPoints = (double *)ckalloc(2 * numPoints * sizeof(double));
+	numPoints = polyPtr->smooth->coordProc(canvas, polyPtr->coordPtr,
+		polyPtr->numPoints, polyPtr->splineSteps, NULL, polyPoints);
+	polyPtr->segTreePtr = TkSegmentTreeCreate(polyPoints, numPoints);
+	ckfree(polyPoints);
+    } else {
+	polyPtr->segTreePtr = TkSegmentTreeCreate(polyPtr->coordPtr,
+		numPoints);
+    }
+    return polyPtr->segTreePtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PolygonSegmentToPoint --
+ *
+ *	Computes the distance from a point to the part of a polygon's outline
+ *	drawn for one of its edges, including the joint at the start of the
+ *	edge. Called through TkSegmentTreeToPoint.
+ *
+ * Results:
+ *	The distance, or 0 if the point is inside.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double
+PolygonSegmentToPoint(
+    void *clientData,		/* Points to a PolygonSegmentInfo. */
+    Tcl_Size index,		/* Index of the edge. */
+    double *pointPtr)		/* Pointer to x and y coordinates. */
+{
+    PolygonSegmentInfo *infoPtr = (PolygonSegmentInfo *)clientData;
+    PolygonItem *polyPtr = infoPtr->polyPtr;
+    double *coordPtr = infoPtr->treePtr->coordPtr + 2*index;
+    double poly[10], wedge[10];
+    double bestDist = 1.0e36, dist;
+
+    if (polyPtr->joinStyle == JoinRound) {
+	bestDist = hypot(coordPtr[0] - pointPtr[0], coordPtr[1] - pointPtr[1])
+		- infoPtr->width/2.0;
+	if (bestDist <= 0.0) {
+	    return 0.0;
+	}
+    }
+    if (TkGetSegmentOutline(infoPtr->treePtr->coordPtr,
+	    infoPtr->treePtr->numPoints, index, infoPtr->width, CapButt,
+	    polyPtr->joinStyle, poly, wedge)) {
+	dist = TkPolygonToPoint(wedge, 5, pointPtr);
+	if (dist < bestDist) {
+	    bestDist = dist;
+	}
+    }
+    dist = TkPolygonToPoint(poly, 5, pointPtr);
+    if (dist < bestDist) {
+	bestDist = dist;
+    }
+    return bestDist;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * PolygonSegmentToArea --
+ *
+ *	Determines whether the part of a polygon's outline drawn for one of
+ *	its edges lies inside, outside or overlapping a rectangle; see
+ *	PolygonSegmentToPoint for what that part covers. Called through
+ *	TkSegmentTreeToArea.
+ *
+ * Results:
+ *	-1 if the part is entirely outside the area, 0 if it overlaps, and 1
+ *	if it is entirely inside.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PolygonSegmentToArea(
+    void *clientData,		/* Points to a PolygonSegmentInfo. */
+    Tcl_Size index,		/* Index of the edge. */
+    double *rectPtr)		/* Rectangle to check against. */
+{
+    PolygonSegmentInfo *infoPtr = (PolygonSegmentInfo *)clientData;
+    PolygonItem *polyPtr = infoPtr->polyPtr;
+    double *coordPtr = infoPtr->treePtr->coordPtr + 2*index;
+    double poly[10], wedge[10], oval[4];
+    double radius = infoPtr->width/2.0;
+    int inside, beveled;
+
+    beveled = TkGetSegmentOutline(infoPtr->treePtr->coordPtr,
+	    infoPtr->treePtr->numPoints, index, infoPtr->width, CapButt,
+	    polyPtr->joinStyle, poly, wedge);
+    inside = TkPolygonToArea(poly, 5, rectPtr);
+    if ((inside == 0)
+	    || (beveled && (TkPolygonToArea(wedge, 5, rectPtr) != inside))) {
+	return 0;
+    }
+
+    if (polyPtr->joinStyle == JoinRound) {
+	oval[0] = coordPtr[0] - radius;
+	oval[1] = coordPtr[1] - radius;
+	oval[2] = coordPtr[0] + radius;
+	oval[3] = coordPtr[1] + radius;
+	if (TkOvalToArea(oval, rectPtr) != inside) {
+	    return 0;
+	}
+    }
+    return inside;
+}
 
 /*
  *--------------------------------------------------------------
@@ -2049,6 +2293,142 @@ PolygonToPostscript(
     return TCL_OK;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * PolygonToExport --
+ *
+ *	This function is called to describe a polygon item for the "export"
+ *	widget command of canvases.
+ *
+ * Results:
+ *	The return value is a standard Tcl result.
+ *
+ * Side effects:
+ *	The item is added to the SVG or PDF output being generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+PolygonToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    TCL_UNUSED(int))		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    PolygonItem *polyPtr = (PolygonItem *) itemPtr;
+    XColor *color;
+    XColor *fillColor;
+    Pixmap stipple;
+    Pixmap fillStipple;
+    Tk_State state = itemPtr->state;
+    double width;
+
+    if (polyPtr->numPoints < 2 || polyPtr->coordPtr == NULL) {
+	return TCL_OK;
+    }
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    width = polyPtr->outline.width;
+    color = polyPtr->outline.color;
+    stipple = polyPtr->outline.stipple;
+    fillColor = polyPtr->fillColor;
+    fillStipple = polyPtr->fillStipple;
+    if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	if (polyPtr->outline.activeWidth > width) {
+	    width = polyPtr->outline.activeWidth;
+	}
+	if (polyPtr->outline.activeColor != NULL) {
+	    color = polyPtr->outline.activeColor;
+	}
+	if (polyPtr->outline.activeStipple != None) {
+	    stipple = polyPtr->outline.activeStipple;
+	}
+	if (polyPtr->activeFillColor != NULL) {
+	    fillColor = polyPtr->activeFillColor;
+	}
+	if (polyPtr->activeFillStipple != None) {
+	    fillStipple = polyPtr->activeFillStipple;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (polyPtr->outline.disabledWidth > 0.0) {
+	    width = polyPtr->outline.disabledWidth;
+	}
+	if (polyPtr->outline.disabledColor != NULL) {
+	    color = polyPtr->outline.disabledColor;
+	}
+	if (polyPtr->outline.disabledStipple != None) {
+	    stipple = polyPtr->outline.disabledStipple;
+	}
+	if (polyPtr->disabledFillColor != NULL) {
+	    fillColor = polyPtr->disabledFillColor;
+	}
+	if (polyPtr->disabledFillStipple != None) {
+	    fillStipple = polyPtr->disabledFillStipple;
+	}
+    }
+
+    if (polyPtr->numPoints == 2) {
+	double bbox[4];
+
+	/*
+	 * Create a point by using a small circle.
+	 */
+
+	if (color == NULL) {
+	    return TCL_OK;
+	}
+	bbox[0] = polyPtr->coordPtr[0] - width/2.0;
+	bbox[1] = polyPtr->coordPtr[1] - width/2.0;
+	bbox[2] = polyPtr->coordPtr[0] + width/2.0;
+	bbox[3] = polyPtr->coordPtr[1] + width/2.0;
+	TkCanvExportArcPath(canvas, bbox, 0.0, 360.0, TK_EXPORT_ARC_CHORD);
+	return TkCanvExportPaint(canvas, itemPtr, color, stipple, NULL,
+		CapButt, JoinMiter);
+    }
+
+    /*
+     * The area is only filled if the polygon has at least three distinct
+     * points, just like when it is displayed.
+     */
+
+    if (polyPtr->numPoints <= 3) {
+	fillColor = NULL;
+    }
+    if ((fillColor == NULL) && (color == NULL)) {
+	return TCL_OK;
+    }
+
+    if (!polyPtr->smooth) {
+	TkCanvExportPath(canvas, polyPtr->coordPtr, polyPtr->numPoints, 1);
+    } else {
+	double staticPoints[2*MAX_STATIC_POINTS];
+	double *pointPtr;
+	int numPoints;
+
+	numPoints = polyPtr->smooth->coordProc(canvas, NULL,
+		polyPtr->numPoints, polyPtr->splineSteps, NULL, NULL);
+	pointPtr = staticPoints;
+	if (numPoints > MAX_STATIC_POINTS) {
+	    pointPtr = (double *)ckalloc(numPoints * 2 * sizeof(double));
+	}
+	numPoints = polyPtr->smooth->coordProc(canvas, polyPtr->coordPtr,
+		polyPtr->numPoints, polyPtr->splineSteps, NULL, pointPtr);
+	TkCanvExportPath(canvas, pointPtr, numPoints, 1);
+	if (pointPtr != staticPoints) {
+	    ckfree(pointPtr);
+	}
+    }
+    return TkCanvExportPaint(canvas, itemPtr, fillColor, fillStipple,
+	    (color != NULL) ? &polyPtr->outline : NULL, CapRound,
+	    polyPtr->joinStyle);
+}
+
 /*
  * Local Variables:
  * mode: c
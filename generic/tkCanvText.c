@@ -18,6 +18,28 @@
 #include "tkWinInt.h"
 #endif
 
+/*
+ * Laying out text is costly, and many canvases display the same label
+ * (an axis tick, a node name) on many items. Text items therefore share
+ * their layouts through a table kept in the canvas, keyed by font name,
+ * wrap length, justification and text. The layout does not depend on the
+ * angle or position of the item, so moving, scaling and rotating an item
+ * keep its layout; it is only looked up again when the text or one of
+ * these options changes. One of the structures below exists for each
+ * distinct layout:
+ */
+
+typedef struct SharedLayout {
+    Tcl_Size refCount;		/* Number of text items using the layout. */
+    Tcl_HashEntry *hPtr;	/* Entry in the canvas's textLayoutTable, or
+				 * NULL if the table has been flushed while
+				 * the layout was still in use. */
+    Tk_TextLayout layout;	/* The layout itself. It refers to the
+				 * string below. */
+    int width, height;		/* Size of the layout, in pixels. */
+    char string[TKFLEXARRAY];	/* Copy of the text that was laid out. */
+} SharedLayout;
+
 /*
  * The structure below defines the record for each text item.
  */
@@ -66,7 +88,9 @@ typedef struct TextItem {
      * configuration settings above.
      */
 
-    Tk_TextLayout textLayout;	/* Cached text layout information. */
+    SharedLayout *layoutPtr;	/* Shared layout of the text, or NULL. */
+    Tk_TextLayout textLayout;	/* Cached text layout information, taken from
+				 * layoutPtr. */
     int actualWidth;		/* Width of text as computed. Used to make
 				 * selections of wrapped text display
 				 * right. */
@@ -216,6 +240,12 @@ static const Tk_ConfigSpec configSpecs[] = {
  */
 
 static void		ComputeTextBbox(Tk_Canvas canvas, TextItem *textPtr);
+static void		ComputeTextLayout(Tk_Canvas canvas,
+			    TextItem *textPtr);
+static SharedLayout *	GetSharedLayout(TkCanvas *canvasPtr, Tk_Font tkfont,
+			    const char *string, Tcl_Size numChars,
+			    int wrapLength, Tk_Justify justify);
+static void		ReleaseSharedLayout(SharedLayout *layoutPtr);
 static int		ConfigureText(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, Tcl_Size objc,
 			    Tcl_Obj *const objv[], int flags);
@@ -251,6 +281,8 @@ static double		TextToPoint(Tk_Canvas canvas,
 			    Tk_Item *itemPtr, double *pointPtr);
 static int		TextToPostscript(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static int		TextToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
 static void		RotateText(Tk_Canvas canvas, Tk_Item *itemPtr,
 			    double originX, double originY, double angleRad);
 static void		TranslateText(Tk_Canvas canvas,
@@ -283,7 +315,9 @@ Tk_ItemType tkTextType = {
     TextDeleteChars,		/* dTextProc */
     NULL,			/* nextPtr */
     RotateText,			/* rotateProc */
-    0, NULL, NULL
+    0,				/* reserved2 */
+    TextToExport,		/* exportProc */
+    NULL			/* reserved4 */
 };
 
 #define ROUND(d) ((int) floor((d) + 0.5))
@@ -348,6 +382,7 @@ CreateText(
     textPtr->underline	= INT_MIN;
     textPtr->angle	= 0.0;
 
+    textPtr->layoutPtr	= NULL;
     textPtr->textLayout = NULL;
     textPtr->actualWidth = 0;
     textPtr->drawOrigin[0] = textPtr->drawOrigin[1] = 0.0;
@@ -620,6 +655,7 @@ ConfigureText(
     textPtr->sine = sin(textPtr->angle * PI/180.0);
     textPtr->cosine = cos(textPtr->angle * PI/180.0);
 
+    ComputeTextLayout(canvas, textPtr);
     ComputeTextBbox(canvas, textPtr);
     return TCL_OK;
 }
@@ -672,7 +708,7 @@ DeleteText(
 	Tcl_DecrRefCount(textPtr->textObj);
     }
 
-    Tk_FreeTextLayout(textPtr->textLayout);
+    ReleaseSharedLayout(textPtr->layoutPtr);
     if (textPtr->gc != NULL) {
 	Tk_FreeGC(display, textPtr->gc);
     }
@@ -684,6 +720,202 @@ DeleteText(
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * GetSharedLayout --
+ *
+ *	Returns a layout of a text string, sharing it with the other text
+ *	items of the canvas that display the same string in the same way.
+ *
+ * Results:
+ *	A pointer to the shared layout. The caller must release it with
+ *	ReleaseSharedLayout when it is no longer needed.
+ *
+ * Side effects:
+ *	The layout is computed and entered in the canvas's layout table if no
+ *	item uses it yet.
+ *
+ *--------------------------------------------------------------
+ */
+
+static SharedLayout *
+GetSharedLayout(
+    TkCanvas *canvasPtr,	/* Canvas that contains the item. */
+    Tk_Font tkfont,		/* Font to lay out the text in. */
+    const char *string,		/* Text to lay out. */
+    Tcl_Size numChars,		/* Number of characters in string. */
+    int wrapLength,		/* Length at which to wrap lines, or <= 0
+				 * for no wrapping. */
+    Tk_Justify justify)		/* How to justify the lines. */
+{
+    SharedLayout *layoutPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_DString key;
+    const char *fontName = (tkfont != NULL) ? Tk_NameOfFont(tkfont) : "";
+    char buf[TCL_INTEGER_SPACE * 3 + 40];
+    size_t length;
+    int isNew;
+
+    if (canvasPtr->textLayoutTable == NULL) {
+	canvasPtr->textLayoutTable = (Tcl_HashTable *)
+		ckalloc(sizeof(Tcl_HashTable));
+	Tcl_InitHashTable(canvasPtr->textLayoutTable, TCL_STRING_KEYS);
+    }
+
+    /*
+     * The font is identified by its name rather than its address: a freed
+     * font's address can be reused by another font while a layout computed
+     * with the old one is still in the table. Fonts with the same name on
+     * the same display are the same font. The length of the name keeps the
+     * key unambiguous, since names can contain spaces.
+     */
+
+    Tcl_DStringInit(&key);
+    snprintf(buf, sizeof(buf), "%d %d %" TCL_Z_MODIFIER "u ", wrapLength,
+	    (int) justify, strlen(fontName));
+    Tcl_DStringAppend(&key, buf, -1);
+    Tcl_DStringAppend(&key, fontName, -1);
+    Tcl_DStringAppend(&key, string, -1);
+    hPtr = Tcl_CreateHashEntry(canvasPtr->textLayoutTable,
+	    Tcl_DStringValue(&key), &isNew);
+    Tcl_DStringFree(&key);
+    if (!isNew) {
+	layoutPtr = (SharedLayout *)Tcl_GetHashValue(hPtr);
+	layoutPtr->refCount++;
+	return layoutPtr;
+    }
+
+    length = strlen(string);
+    layoutPtr = (SharedLayout *)ckalloc(
+	    offsetof(SharedLayout, string) + length + 1);
+    memcpy(layoutPtr->string, string, length + 1);
+    layoutPtr->refCount = 1;
+    layoutPtr->hPtr = hPtr;
+    layoutPtr->layout = Tk_ComputeTextLayout(tkfont, layoutPtr->string,
+	    numChars, wrapLength, justify, 0, &layoutPtr->width,
+	    &layoutPtr->height);
+    Tcl_SetHashValue(hPtr, layoutPtr);
+    return layoutPtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ReleaseSharedLayout --
+ *
+ *	Gives up one reference to a layout returned by GetSharedLayout.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The layout is freed, and removed from its canvas's layout table, when
+ *	its last user releases it.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+ReleaseSharedLayout(
+    SharedLayout *layoutPtr)	/* Layout to release, or NULL. */
+{
+    if (layoutPtr == NULL || --layoutPtr->refCount > 0) {
+	return;
+    }
+    if (layoutPtr->hPtr != NULL) {
+	Tcl_DeleteHashEntry(layoutPtr->hPtr);
+    }
+    Tk_FreeTextLayout(layoutPtr->layout);
+    ckfree(layoutPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvFreeTextLayouts --
+ *
+ *	Empties the table of shared text layouts of a canvas. This is called
+ *	when the canvas is destroyed, and when fonts may have changed so that
+ *	the layouts in the table are stale.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Layouts still in use are detached from the table; they are freed when
+ *	their items release them. New layouts are computed for all later
+ *	lookups.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+TkCanvFreeTextLayouts(
+    TkCanvas *canvasPtr)	/* Canvas whose layouts are to be freed. */
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    if (canvasPtr->textLayoutTable == NULL) {
+	return;
+    }
+    for (hPtr = Tcl_FirstHashEntry(canvasPtr->textLayoutTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	((SharedLayout *)Tcl_GetHashValue(hPtr))->hPtr = NULL;
+    }
+    Tcl_DeleteHashTable(canvasPtr->textLayoutTable);
+    ckfree(canvasPtr->textLayoutTable);
+    canvasPtr->textLayoutTable = NULL;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * ComputeTextLayout --
+ *
+ *	This function is invoked when the text of a text item, or one of the
+ *	options that its layout depends on (font, width and justification),
+ *	may have changed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The item's layout is replaced with the shared layout of its current
+ *	text and options. The text is only laid out again if no item of the
+ *	canvas uses that layout yet.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+ComputeTextLayout(
+    Tk_Canvas canvas,		/* Canvas that contains item. */
+    TextItem *textPtr)		/* Item whose layout is to be recomputed. */
+{
+    SharedLayout *oldLayoutPtr = textPtr->layoutPtr;
+    Tcl_Size numChars;
+    int width = 0;
+
+    if (textPtr->widthObj) {
+	Tk_GetPixelsFromObj(NULL, Tk_CanvasTkwin(canvas), textPtr->widthObj, &width);
+    }
+    numChars = textPtr->textObj ? Tcl_GetCharLength(textPtr->textObj) : 0;
+
+    /*
+     * Look up the new layout before releasing the old one, so that a
+     * layout that did not change is kept even if this item is its only
+     * user.
+     */
+
+    textPtr->layoutPtr = GetSharedLayout(Canvas(canvas), textPtr->tkfont,
+	    (textPtr->textObj ? Tcl_GetString(textPtr->textObj) : ""), numChars,
+	    width, textPtr->justify);
+    textPtr->textLayout = textPtr->layoutPtr->layout;
+    ReleaseSharedLayout(oldLayoutPtr);
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -698,8 +930,9 @@ DeleteText(
  *	None.
  *
  * Side effects:
- *	The fields x1, y1, x2, and y2 are updated in the header for itemPtr,
- *	and the linePtr structure is regenerated for itemPtr.
+ *	The fields x1, y1, x2, and y2 are updated in the header for itemPtr.
+ *	The text is only laid out if the item has no layout yet; see
+ *	ComputeTextLayout.
  *
  *--------------------------------------------------------------
  */
@@ -718,15 +951,11 @@ ComputeTextBbox(
 	state = Canvas(canvas)->canvas_state;
     }
 
-    Tk_FreeTextLayout(textPtr->textLayout);
-    width = 0;
-    if (textPtr->widthObj) {
-	Tk_GetPixelsFromObj(NULL, Tk_CanvasTkwin(canvas), textPtr->widthObj, &width);
+    if (textPtr->layoutPtr == NULL) {
+	ComputeTextLayout(canvas, textPtr);
     }
-    Tcl_Size numChars = textPtr->textObj ? Tcl_GetCharLength(textPtr->textObj) : 0;
-    textPtr->textLayout = Tk_ComputeTextLayout(textPtr->tkfont,
-	    (textPtr->textObj ? Tcl_GetString(textPtr->textObj) : ""), numChars, width,
-	    textPtr->justify, 0, &width, &height);
+    width = textPtr->layoutPtr->width;
+    height = textPtr->layoutPtr->height;
 
     if (state == TK_STATE_HIDDEN || textPtr->color == NULL) {
 	width = height = 0;
@@ -1145,6 +1374,7 @@ TextInsert(
     if (textPtr->insertPos >= index) {
 	textPtr->insertPos += charsAdded;
     }
+    ComputeTextLayout(canvas, textPtr);
     ComputeTextBbox(canvas, textPtr);
 }
 
@@ -1238,6 +1468,7 @@ TextDeleteChars(
 	    textPtr->insertPos = first;
 	}
     }
+    ComputeTextLayout(canvas, textPtr);
     ComputeTextBbox(canvas, textPtr);
     return;
 }
@@ -1767,6 +1998,67 @@ TextToPostscript(
     return TCL_ERROR;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * TextToExport --
+ *
+ *	This function is called to describe a text item for the "export"
+ *	widget command of canvases. The text is placed using the layout
+ *	computed for the screen, so lines break at the same places.
+ *
+ * Results:
+ *	The return value is a standard Tcl result.
+ *
+ * Side effects:
+ *	The item is added to the SVG or PDF output being generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+TextToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    TCL_UNUSED(int))		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    TextItem *textPtr = (TextItem *) itemPtr;
+    XColor *color;
+    Pixmap stipple;
+    Tk_State state = itemPtr->state;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    color = textPtr->color;
+    stipple = textPtr->stipple;
+    if (state == TK_STATE_HIDDEN || textPtr->color == NULL ||
+	    textPtr->textObj == NULL) {
+	return TCL_OK;
+    } else if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	if (textPtr->activeColor != NULL) {
+	    color = textPtr->activeColor;
+	}
+	if (textPtr->activeStipple != None) {
+	    stipple = textPtr->activeStipple;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (textPtr->disabledColor != NULL) {
+	    color = textPtr->disabledColor;
+	}
+	if (textPtr->disabledStipple != None) {
+	    stipple = textPtr->disabledStipple;
+	}
+    }
+
+    return TkCanvExportText(canvas, textPtr->tkfont, textPtr->textLayout,
+	    textPtr->drawOrigin[0], textPtr->drawOrigin[1], textPtr->angle,
+	    color, stipple);
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -1504,6 +1504,62 @@ Tk_CanvasPsOutline(
     return TCL_OK;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * TkCanvOutlineDashes --
+ *
+ *	Computes the lengths of the dashes and gaps of a dash pattern, for
+ *	output formats that describe dashes by their lengths, just like
+ *	Tk_CanvasPsOutline does for Postscript. Patterns with an odd number of
+ *	elements are repeated once, and character-like patterns (e.g. "-..")
+ *	are converted according to the line width.
+ *
+ * Results:
+ *	The number of lengths stored in *dashesPtr, or 0 for a solid line. If
+ *	the result is non-zero, *dashesPtr points to memory allocated with
+ *	ckalloc that the caller must free.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkCanvOutlineDashes(
+    Tk_Dash *dash,		/* Dash pattern to convert. */
+    double width,		/* Width of the line being dashed. */
+    char **dashesPtr)		/* Where to store the array of lengths. */
+{
+    char *ptr, *lengths;
+    int n;
+
+    *dashesPtr = NULL;
+    ptr = ((unsigned) ABS(dash->number) > sizeof(char *)) ?
+	    dash->pattern.pt : dash->pattern.array;
+    if (dash->number > 0) {
+	n = dash->number;
+	lengths = (char *)ckalloc(2 * n);
+	memcpy(lengths, ptr, n);
+	if (n & 1) {
+	    memcpy(lengths + n, ptr, n);
+	    n *= 2;
+	}
+    } else if (dash->number < 0) {
+	lengths = (char *)ckalloc(1 - 2*dash->number);
+	n = DashConvert(lengths, ptr, -dash->number, width);
+	if (n <= 0) {
+	    ckfree(lengths);
+	    return 0;
+	}
+    } else {
+	return 0;
+    }
+    *dashesPtr = lengths;
+    return n;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -132,6 +132,8 @@ static const Tk_ConfigSpec configSpecs[] = {
 	DEF_CANVAS_INSERT_ON_TIME, offsetof(TkCanvas, insertOnTime), 0, NULL},
     {TK_CONFIG_PIXELS, "-insertwidth", "insertWidth", "InsertWidth",
 	DEF_CANVAS_INSERT_WIDTH, offsetof(TkCanvas, textInfo.insertWidthObj), TK_CONFIG_OBJS, NULL},
+    {TK_CONFIG_DOUBLE, "-maxfps", "maxFps", "MaxFps",
+	DEF_CANVAS_MAX_FPS, offsetof(TkCanvas, maxFps), 0, NULL},
     {TK_CONFIG_CUSTOM, "-offset", "offset", "Offset", "0,0",
 	offsetof(TkCanvas, tsoffset),TK_CONFIG_DONT_SET_DEFAULT,
 	&offsetOption},
@@ -230,7 +232,9 @@ static Tcl_Size	CanvasFetchSelection(void *clientData, Tcl_Size offset,
 static Tk_Item *	CanvasFindClosest(TkCanvas *canvasPtr,
 			    double coords[2]);
 static void		CanvasFocusProc(TkCanvas *canvasPtr, int gotFocus);
+static void		CanvasFrameProc(void *clientData);
 static void		CanvasLostSelection(void *clientData);
+static void		CanvasScheduleDisplay(TkCanvas *canvasPtr);
 static void		CanvasSelectTo(TkCanvas *canvasPtr,
 			    Tk_Item *itemPtr, Tcl_Size index);
 static void		CanvasSetOrigin(TkCanvas *canvasPtr,
@@ -746,6 +750,16 @@ Tk_CanvasObjCmd(
     canvasPtr->tsoffset.xoffset = 0;
     canvasPtr->tsoffset.yoffset = 0;
     canvasPtr->bindTagExprs = NULL;
+    canvasPtr->exportInfo = NULL;
+    canvasPtr->maxFps = 0.0;
+    canvasPtr->frameHandler = NULL;
+    canvasPtr->lastFrameTime.sec = 0;
+    canvasPtr->lastFrameTime.usec = 0;
+    canvasPtr->numFrames = 0;
+    canvasPtr->numDeferred = 0;
+    canvasPtr->numItemsDrawn = 0;
+    canvasPtr->numPixelsDamaged = 0;
+    canvasPtr->textLayoutTable = NULL;
     Tcl_InitHashTable(&canvasPtr->idTable, TCL_ONE_WORD_KEYS);
 
     Tk_SetClass(canvasPtr->tkwin, "Canvas");
@@ -808,25 +822,25 @@ CanvasWidgetCmd(
 	"addtag",	"bbox",		"bind",		"canvasx",
 	"canvasy",	"cget",		"configure",	"coords",
 	"create",	"dchars",	"delete",	"dtag",
-	"find",		"focus",	"gettags",	"icursor",
+	"export",	"find",		"focus",	"gettags",	"icursor",
 	"image",	"imove",	"index",	"insert",
 	"itemcget",	"itemconfigure",
 	"lower",	"move",		"moveto",	"postscript",
 	"raise",	"rchars",	"rotate",	"scale",
-	"scan",		"select",	"type",		"xview",
-	"yview",	NULL
+	"scan",		"select",	"stats",	"type",
+	"xview",	"yview",	NULL
     };
     enum canvasOptionStringsEnum {
 	CANV_ADDTAG,	CANV_BBOX,	CANV_BIND,	CANV_CANVASX,
 	CANV_CANVASY,	CANV_CGET,	CANV_CONFIGURE,	CANV_COORDS,
 	CANV_CREATE,	CANV_DCHARS,	CANV_DELETE,	CANV_DTAG,
-	CANV_FIND,	CANV_FOCUS,	CANV_GETTAGS,	CANV_ICURSOR,
+	CANV_EXPORT,	CANV_FIND,	CANV_FOCUS,	CANV_GETTAGS,	CANV_ICURSOR,
 	CANV_IMAGE,	CANV_IMOVE,	CANV_INDEX,	CANV_INSERT,
 	CANV_ITEMCGET,	CANV_ITEMCONFIGURE,
 	CANV_LOWER,	CANV_MOVE,	CANV_MOVETO,	CANV_POSTSCRIPT,
 	CANV_RAISE,	CANV_RCHARS,	CANV_ROTATE,	CANV_SCALE,
-	CANV_SCAN,	CANV_SELECT,	CANV_TYPE,	CANV_XVIEW,
-	CANV_YVIEW
+	CANV_SCAN,	CANV_SELECT,	CANV_STATS,	CANV_TYPE,
+	CANV_XVIEW,	CANV_YVIEW
     };
 
     if (objc < 2) {
@@ -1442,6 +1456,10 @@ CanvasWidgetCmd(
 	}
 	break;
     }
+    case CANV_EXPORT: {
+	result = TkCanvExportObjCmd(canvasPtr, interp, objc, objv);
+	break;
+    }
     case CANV_FIND:
 	if (objc < 3) {
 	    Tcl_WrongNumArgs(interp, 2, objv, "searchCommand ?arg ...?");
@@ -2021,6 +2039,41 @@ CanvasWidgetCmd(
 	}
 	break;
     }
+    case CANV_STATS: {
+	Tcl_Obj *resultObj;
+
+	if ((objc > 3) || ((objc == 3)
+		&& strcmp(Tcl_GetString(objv[2]), "-reset"))) {
+	    Tcl_WrongNumArgs(interp, 2, objv, "?-reset?");
+	    result = TCL_ERROR;
+	    goto done;
+	}
+	resultObj = Tcl_NewObj();
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewStringObj("frames", TCL_INDEX_NONE));
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewWideIntObj(canvasPtr->numFrames));
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewStringObj("deferred", TCL_INDEX_NONE));
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewWideIntObj(canvasPtr->numDeferred));
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewStringObj("items", TCL_INDEX_NONE));
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewWideIntObj(canvasPtr->numItemsDrawn));
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewStringObj("pixels", TCL_INDEX_NONE));
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewWideIntObj(canvasPtr->numPixelsDamaged));
+	Tcl_SetObjResult(interp, resultObj);
+	if (objc == 3) {
+	    canvasPtr->numFrames = 0;
+	    canvasPtr->numDeferred = 0;
+	    canvasPtr->numItemsDrawn = 0;
+	    canvasPtr->numPixelsDamaged = 0;
+	}
+	break;
+    }
     case CANV_TYPE:
 	if (objc != 3) {
 	    Tcl_WrongNumArgs(interp, 2, objv, "tag");
@@ -2207,6 +2260,7 @@ DestroyCanvas(
 	}
 	ckfree(itemPtr);
     }
+    TkCanvFreeTextLayouts(canvasPtr);
 
     /*
      * Free up all the stuff that requires special handling, then let
@@ -2273,6 +2327,20 @@ ConfigureCanvas(
 	return TCL_ERROR;
     }
 
+    /*
+     * If redisplay is being held back for a frame interval that no longer
+     * applies, let it happen now.
+     */
+
+    if (canvasPtr->maxFps < 0.0) {
+	canvasPtr->maxFps = 0.0;
+    }
+    if ((canvasPtr->frameHandler != NULL) && (canvasPtr->maxFps == 0.0)) {
+	Tcl_DeleteTimerHandler(canvasPtr->frameHandler);
+	canvasPtr->frameHandler = NULL;
+	Tcl_DoWhenIdle(DisplayCanvas, canvasPtr);
+    }
+
     /*
      * A few options need special processing, such as setting the background
      * from a 3-D border and creating a GC for copying bits to the screen.
@@ -2438,6 +2506,12 @@ CanvasWorldChanged(
     Tk_GetPixelsFromObj(NULL, canvasPtr->tkwin, canvasPtr->textInfo.insertWidthObj, &canvasPtr->textInfo.insertWidth);
     Tk_GetPixelsFromObj(NULL, canvasPtr->tkwin, canvasPtr->textInfo.selBorderWidthObj, &canvasPtr->textInfo.selBorderWidth);
 
+    /*
+     * Fonts may have changed in place, so the shared text layouts can't be
+     * trusted any more.
+     */
+
+    TkCanvFreeTextLayouts(canvasPtr);
     itemPtr = canvasPtr->firstItemPtr;
     for ( ; itemPtr != NULL; itemPtr = itemPtr->nextPtr) {
 	if (ItemConfigure(canvasPtr, itemPtr, 0, NULL) != TCL_OK) {
@@ -3018,6 +3092,7 @@ DisplayCanvas(
     if (!Tk_IsMapped(tkwin)) {
 	goto done;
     }
+    Tcl_GetTime(&canvasPtr->lastFrameTime);
 
     /*
      * Choose a new current item if that is needed (this could cause event
@@ -3079,6 +3154,8 @@ DisplayCanvas(
 
 	width = screenX2 - screenX1;
 	height = screenY2 - screenY1;
+	canvasPtr->numFrames++;
+	canvasPtr->numPixelsDamaged += (Tcl_WideInt) width * height;
 
 #ifndef TK_NO_DOUBLE_BUFFERING
 	/*
@@ -3184,6 +3261,7 @@ DisplayCanvas(
 	    }
 	    ItemDisplay(canvasPtr, itemPtr, pixmap, screenX1, screenY1, width,
 		    height);
+	    canvasPtr->numItemsDrawn++;
 	}
 
 #ifndef TK_NO_DOUBLE_BUFFERING
@@ -3295,6 +3373,10 @@ CanvasEventProc(
 	}
 	if (canvasPtr->flags & REDRAW_PENDING) {
 	    Tcl_CancelIdleCall(DisplayCanvas, canvasPtr);
+	    if (canvasPtr->frameHandler != NULL) {
+		Tcl_DeleteTimerHandler(canvasPtr->frameHandler);
+		canvasPtr->frameHandler = NULL;
+	    }
 	}
 	Tcl_EventuallyFree(canvasPtr, DestroyCanvas);
     } else if (eventPtr->type == ConfigureNotify) {
@@ -3437,10 +3519,7 @@ Tk_CanvasEventuallyRedraw(
 	canvasPtr->redrawY2 = y2;
 	canvasPtr->flags |= BBOX_NOT_EMPTY;
     }
-    if (!(canvasPtr->flags & REDRAW_PENDING)) {
-	Tcl_DoWhenIdle(DisplayCanvas, canvasPtr);
-	canvasPtr->flags |= REDRAW_PENDING;
-    }
+    CanvasScheduleDisplay(canvasPtr);
 }
 
 /*
@@ -3501,10 +3580,81 @@ EventuallyRedrawItem(
 	}
 	itemPtr->redraw_flags |= FORCE_REDRAW;
     }
-    if (!(canvasPtr->flags & REDRAW_PENDING)) {
-	Tcl_DoWhenIdle(DisplayCanvas, canvasPtr);
-	canvasPtr->flags |= REDRAW_PENDING;
+    CanvasScheduleDisplay(canvasPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CanvasScheduleDisplay --
+ *
+ *	Arrange for DisplayCanvas to be called, unless that has already been
+ *	arranged. If the -maxfps option is set and the last redisplay was
+ *	less than a frame interval ago, DisplayCanvas is only called once the
+ *	interval has elapsed, so that all damage in the meantime is redrawn
+ *	together.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	An idle handler or a timer handler may be created.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CanvasScheduleDisplay(
+    TkCanvas *canvasPtr)	/* Information about widget. */
+{
+    if (canvasPtr->flags & REDRAW_PENDING) {
+	return;
+    }
+    canvasPtr->flags |= REDRAW_PENDING;
+    if (canvasPtr->maxFps > 0.0) {
+	Tcl_Time now;
+	double elapsed, interval;
+
+	Tcl_GetTime(&now);
+	elapsed = (now.sec - canvasPtr->lastFrameTime.sec) * 1000.0
+		+ (now.usec - canvasPtr->lastFrameTime.usec) / 1000.0;
+	interval = 1000.0 / canvasPtr->maxFps;
+	if ((elapsed >= 0.0) && (elapsed < interval)) {
+	    canvasPtr->numDeferred++;
+	    canvasPtr->frameHandler = Tcl_CreateTimerHandler(
+		    (int) ceil(interval - elapsed), CanvasFrameProc,
+		    canvasPtr);
+	    return;
+	}
     }
+    Tcl_DoWhenIdle(DisplayCanvas, canvasPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CanvasFrameProc --
+ *
+ *	This function is invoked by a timer handler once the frame interval
+ *	set by the -maxfps option has elapsed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The canvas will be redisplayed when idle.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CanvasFrameProc(
+    void *clientData)		/* Information about widget. */
+{
+    TkCanvas *canvasPtr = (TkCanvas *)clientData;
+
+    canvasPtr->frameHandler = NULL;
+    Tcl_DoWhenIdle(DisplayCanvas, canvasPtr);
 }
 
 /*
@@ -3622,7 +3772,8 @@ InitCanvas(void)
     tkImageType.nextPtr = &tkOvalType;
     tkOvalType.nextPtr = &tkBitmapType;
     tkBitmapType.nextPtr = &tkArcType;
-    tkArcType.nextPtr = &tkWindowType;
+    tkArcType.nextPtr = &tkPointsType;
+    tkPointsType.nextPtr = &tkWindowType;
     tkWindowType.nextPtr = NULL;
     Tcl_MutexUnlock(&typeListMutex);
 }
@@ -5625,10 +5776,7 @@ CanvasFocusProc(
     Tk_GetPixelsFromObj(NULL, canvasPtr->tkwin, canvasPtr->highlightWidthObj, &highlightWidth);
     if (highlightWidth > 0) {
 	canvasPtr->flags |= REDRAW_BORDERS;
-	if (!(canvasPtr->flags & REDRAW_PENDING)) {
-	    Tcl_DoWhenIdle(DisplayCanvas, canvasPtr);
-	    canvasPtr->flags |= REDRAW_PENDING;
-	}
+	CanvasScheduleDisplay(canvasPtr);
     }
 }
 
@@ -233,13 +233,44 @@ typedef struct TkCanvas {
     TagSearchExpr *bindTagExprs;/* Linked list of tag expressions used in
 				 * bindings. */
 #endif
+    struct TkExportInfo *exportInfo;
+				/* Information used for generating SVG or PDF
+				 * for the canvas. NULL means no export is
+				 * currently being generated. */
+
+    /*
+     * Information used to pace redisplay, and statistics about it:
+     */
+
+    double maxFps;		/* Value of -maxfps option: the canvas is
+				 * redisplayed at most this many times per
+				 * second. 0 means no limit. */
+    Tcl_TimerToken frameHandler;/* Timer handler used to delay redisplay
+				 * until the current frame interval has
+				 * elapsed, or NULL. */
+    Tcl_Time lastFrameTime;	/* Time at which the last redisplay
+				 * started. */
+    Tcl_WideInt numFrames;	/* Number of redisplays that drew part of
+				 * the canvas. */
+    Tcl_WideInt numDeferred;	/* Number of redisplays that were delayed
+				 * because of -maxfps. */
+    Tcl_WideInt numItemsDrawn;	/* Number of calls to item display
+				 * procedures. */
+    Tcl_WideInt numPixelsDamaged;
+				/* Total area redrawn, in pixels. */
+    Tcl_HashTable *textLayoutTable;
+				/* Text layouts shared by the text items of
+				 * this canvas, keyed by font, wrap length,
+				 * justification and text. NULL until the
+				 * first text item is laid out. */
 } TkCanvas;
 
 /*
  * Flag bits for canvases:
  *
- * REDRAW_PENDING -		1 means a DoWhenIdle handler has already been
- *				created to redraw some or all of the canvas.
+ * REDRAW_PENDING -		1 means a DoWhenIdle handler (or a frame timer
+ *				that will create one) has already been created
+ *				to redraw some or all of the canvas.
  * REDRAW_BORDERS -		1 means that the borders need to be redrawn
  *				during the next redisplay operation.
  * REPICK_NEEDED -		1 means DisplayCanvas should pick a new
@@ -284,6 +315,44 @@ typedef struct TkCanvas {
 
 #define FORCE_REDRAW		8
 
+/*
+ * A bounding-volume hierarchy over the segments of a polyline. Line and
+ * polygon items with many points build one lazily so that hit-testing
+ * doesn't have to look at every segment; see TkSegmentTreeCreate.
+ */
+
+typedef struct TkSegmentTree {
+    double *coordPtr;		/* Copy of the points the tree was built
+				 * from: x0, y0, x1, y1, ... */
+    Tcl_Size numPoints;		/* Number of points at coordPtr. */
+    Tcl_Size numLeaves;		/* Number of leaves; a power of two. */
+    double *bboxPtr;		/* Bounding boxes of the nodes, four values
+				 * each, in heap order: node 1 is the root
+				 * and the children of node n are 2n and
+				 * 2n+1. Shares storage with coordPtr. */
+} TkSegmentTree;
+
+typedef double (TkSegmentPointProc)(void *clientData, Tcl_Size index,
+	double *pointPtr);
+typedef int (TkSegmentAreaProc)(void *clientData, Tcl_Size index,
+	double *rectPtr);
+
+/*
+ * Items with fewer points than this are hit-tested segment by segment.
+ */
+
+#define TK_SEGMENT_TREE_MIN_POINTS	64
+
+/*
+ * How far the outline of a segment, as computed by TkGetSegmentOutline, may
+ * extend beyond the end-points of the segment. Miters are limited by the
+ * 11 degree cutoff in TkGetMiterPoints; the extra pixel allows for the
+ * rounding done there.
+ */
+
+#define TK_SEGMENT_MARGIN(width, joinStyle) \
+	(((joinStyle) == JoinMiter) ? 5.25*(width) + 1.0 : (width) + 1.0)
+
 /*
  * Canvas-related functions that are shared among Tk modules but not exported
  * to the outside world:
@@ -294,12 +363,63 @@ MODULE_SCOPE int	TkCanvPostscriptObjCmd(TkCanvas *canvasPtr,
 MODULE_SCOPE int	TkCanvTranslatePath(TkCanvas *canvPtr,
 			    int numVertex, double *coordPtr, int closed,
 			    XPoint *outPtr);
+MODULE_SCOPE int	TkGetSegmentOutline(double *coordPtr,
+			    Tcl_Size numPoints, Tcl_Size index, double width,
+			    int capStyle, int joinStyle, double *polyPtr,
+			    double *wedgePtr);
+MODULE_SCOPE TkSegmentTree *TkSegmentTreeCreate(const double *coordPtr,
+			    Tcl_Size numPoints);
+MODULE_SCOPE void	TkSegmentTreeFree(TkSegmentTree *treePtr);
+MODULE_SCOPE double	TkSegmentTreeToPoint(TkSegmentTree *treePtr,
+			    double margin, double *pointPtr, double bestDist,
+			    TkSegmentPointProc *proc, void *clientData);
+MODULE_SCOPE int	TkSegmentTreeToArea(TkSegmentTree *treePtr,
+			    double margin, double *rectPtr,
+			    TkSegmentAreaProc *proc, void *clientData);
+MODULE_SCOPE double	TkSegmentTreePolygonToPoint(TkSegmentTree *treePtr,
+			    double *pointPtr);
+MODULE_SCOPE int	TkSegmentTreePolygonToArea(TkSegmentTree *treePtr,
+			    double *rectPtr);
+MODULE_SCOPE void	TkCanvFreeTextLayouts(TkCanvas *canvasPtr);
+MODULE_SCOPE int	TkCanvOutlineDashes(Tk_Dash *dash, double width,
+			    char **dashesPtr);
+
+/*
+ * Functions used by the item types to describe themselves during the canvas
+ * "export" widget command, and the arc styles for TkCanvExportArcPath:
+ */
+
+#define TK_EXPORT_ARC_OPEN	0
+#define TK_EXPORT_ARC_CHORD	1
+#define TK_EXPORT_ARC_PIESLICE	2
+
+MODULE_SCOPE int	TkCanvExportObjCmd(TkCanvas *canvasPtr,
+			    Tcl_Interp *interp, Tcl_Size objc, Tcl_Obj *const objv[]);
+MODULE_SCOPE void	TkCanvExportPath(Tk_Canvas canvas,
+			    const double *coordPtr, Tcl_Size numPoints,
+			    int closed);
+MODULE_SCOPE void	TkCanvExportArcPath(Tk_Canvas canvas,
+			    const double *bbox, double start, double extent,
+			    int style);
+MODULE_SCOPE int	TkCanvExportPaint(Tk_Canvas canvas, Tk_Item *itemPtr,
+			    XColor *fillColor, Pixmap fillStipple,
+			    Tk_Outline *outline, int capStyle, int joinStyle);
+MODULE_SCOPE int	TkCanvExportText(Tk_Canvas canvas, Tk_Font tkfont,
+			    Tk_TextLayout layout, double x, double y,
+			    double angle, XColor *color, Pixmap stipple);
+MODULE_SCOPE int	TkCanvExportImage(Tk_Canvas canvas,
+			    const char *imageName, double x, double y,
+			    int width, int height);
+MODULE_SCOPE int	TkCanvExportBitmap(Tk_Canvas canvas, Pixmap bitmap,
+			    double x, double y, int width, int height,
+			    XColor *fgColor, XColor *bgColor);
+
 /*
  * Standard item types provided by Tk:
  */
 
 MODULE_SCOPE Tk_ItemType tkArcType, tkBitmapType, tkImageType, tkLineType;
-MODULE_SCOPE Tk_ItemType tkOvalType, tkPolygonType;
+MODULE_SCOPE Tk_ItemType tkOvalType, tkPointsType, tkPolygonType;
 MODULE_SCOPE Tk_ItemType tkRectangleType, tkTextType, tkWindowType;
 
 /*
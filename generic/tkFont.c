@@ -4362,6 +4362,60 @@ TkFontGetFirstTextLayout(
     *font = layoutPtr->tkfont;
     return numBytesInChunk;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkTextLayoutGetChunk --
+ *
+ *	This function returns one of the chunks of a Tk_TextLayout, for code
+ *	that renders a layout other than by drawing it, such as the canvas
+ *	"export" widget command.
+ *
+ * Results:
+ *	The return value is 0 if index is beyond the last chunk. Otherwise it
+ *	is 1 and the start and byte length of the displayable characters of
+ *	the chunk are stored in *startPtr and *numBytesPtr (the length is 0
+ *	for chunks that only hold tabs or newlines). *xPtr and *yPtr get the
+ *	position of the chunk's baseline origin relative to the upper-left
+ *	corner of the layout, and *widthPtr its displayed width.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkTextLayoutGetChunk(
+    Tk_TextLayout layout,	/* Layout information, from a previous call to
+				 * Tk_ComputeTextLayout(). */
+    Tcl_Size index,		/* Index of the chunk, starting at 0. */
+    const char **startPtr,	/* Filled with the start of the chunk. */
+    Tcl_Size *numBytesPtr,	/* Filled with its number of bytes. */
+    int *xPtr, int *yPtr,	/* Filled with its baseline origin. */
+    int *widthPtr)		/* Filled with its displayed width. */
+{
+    TextLayout *layoutPtr = (TextLayout *) layout;
+    LayoutChunk *chunkPtr;
+
+    if ((layoutPtr == NULL) || (index < 0)
+	    || (index >= layoutPtr->numChunks)) {
+	return 0;
+    }
+    chunkPtr = &layoutPtr->chunks[index];
+    *startPtr = chunkPtr->start;
+    if (chunkPtr->numDisplayChars <= 0) {
+	*numBytesPtr = 0;
+    } else {
+	*numBytesPtr = Tcl_UtfAtIndex(chunkPtr->start,
+		chunkPtr->numDisplayChars) - chunkPtr->start;
+    }
+    *xPtr = chunkPtr->x;
+    *yPtr = chunkPtr->y;
+    *widthPtr = chunkPtr->displayWidth;
+    return 1;
+}
 
 /*
  * Local Variables:
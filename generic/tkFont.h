@@ -212,6 +212,10 @@ MODULE_SCOPE int	TkDeleteNamedFont(Tcl_Interp *interp,
 			    Tk_Window tkwin, const char *name);
 MODULE_SCOPE int	TkFontGetFirstTextLayout(Tk_TextLayout layout,
 			    Tk_Font *font, char *dst);
+MODULE_SCOPE int	TkTextLayoutGetChunk(Tk_TextLayout layout,
+			    Tcl_Size index, const char **startPtr,
+			    Tcl_Size *numBytesPtr, int *xPtr, int *yPtr,
+			    int *widthPtr);
 
 /*
  * Low-level API exported by platform-specific code to generic code.
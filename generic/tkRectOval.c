@@ -145,6 +145,8 @@ static int		RectOvalCoords(Tcl_Interp *interp, Tk_Canvas canvas,
 			    Tk_Item *itemPtr, Tcl_Size objc, Tcl_Obj *const objv[]);
 static int		RectOvalToPostscript(Tcl_Interp *interp,
 			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
+static int		RectOvalToExport(Tcl_Interp *interp,
+			    Tk_Canvas canvas, Tk_Item *itemPtr, int prepass);
 static int		RectToArea(Tk_Canvas canvas, Tk_Item *itemPtr,
 			    double *areaPtr);
 static double		RectToPoint(Tk_Canvas canvas, Tk_Item *itemPtr,
@@ -184,7 +186,9 @@ Tk_ItemType tkRectangleType = {
     NULL,			/* dTextProc */
     NULL,			/* nextPtr */
     RotateRectOval,		/* rotateProc */
-    0, NULL, NULL
+    0,				/* reserved2 */
+    RectOvalToExport,		/* exportProc */
+    NULL			/* reserved4 */
 };
 
 Tk_ItemType tkOvalType = {
@@ -209,7 +213,9 @@ Tk_ItemType tkOvalType = {
     NULL,			/* dTextProc */
     NULL,			/* nextPtr */
     RotateRectOval,		/* rotateProc */
-    0, NULL, NULL
+    0,				/* reserved2 */
+    RectOvalToExport,		/* exportProc */
+    NULL			/* reserved4 */
 };
 
 /*
@@ -1557,6 +1563,91 @@ RectOvalToPostscript(
     return TCL_OK;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * RectOvalToExport --
+ *
+ *	This function is called to describe a rectangle or oval item for the
+ *	"export" widget command of canvases.
+ *
+ * Results:
+ *	The return value is a standard Tcl result.
+ *
+ * Side effects:
+ *	The item is added to the SVG or PDF output being generated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+RectOvalToExport(
+    TCL_UNUSED(Tcl_Interp *),
+    Tk_Canvas canvas,		/* Information about overall canvas. */
+    Tk_Item *itemPtr,		/* Item to export. */
+    TCL_UNUSED(int))		/* 1 means this is a prepass to collect
+				 * resources; 0 means final output is being
+				 * created. */
+{
+    RectOvalItem *rectOvalPtr = (RectOvalItem *) itemPtr;
+    XColor *color;
+    XColor *fillColor;
+    Pixmap fillStipple;
+    Tk_State state = itemPtr->state;
+
+    if (state == TK_STATE_NULL) {
+	state = Canvas(canvas)->canvas_state;
+    }
+    color = rectOvalPtr->outline.color;
+    fillColor = rectOvalPtr->fillColor;
+    fillStipple = rectOvalPtr->fillStipple;
+    if (Canvas(canvas)->currentItemPtr == itemPtr) {
+	if (rectOvalPtr->outline.activeColor!=NULL) {
+	    color = rectOvalPtr->outline.activeColor;
+	}
+	if (rectOvalPtr->activeFillColor!=NULL) {
+	    fillColor = rectOvalPtr->activeFillColor;
+	}
+	if (rectOvalPtr->activeFillStipple!=None) {
+	    fillStipple = rectOvalPtr->activeFillStipple;
+	}
+    } else if (state == TK_STATE_DISABLED) {
+	if (rectOvalPtr->outline.disabledColor!=NULL) {
+	    color = rectOvalPtr->outline.disabledColor;
+	}
+	if (rectOvalPtr->disabledFillColor!=NULL) {
+	    fillColor = rectOvalPtr->disabledFillColor;
+	}
+	if (rectOvalPtr->disabledFillStipple!=None) {
+	    fillStipple = rectOvalPtr->disabledFillStipple;
+	}
+    }
+    if ((fillColor == NULL) && (color == NULL)) {
+	return TCL_OK;
+    }
+
+    /*
+     * Generate the path for the rectangle or oval. This is the only part of
+     * the function's code that is type-specific.
+     */
+
+    if (rectOvalPtr->header.typePtr == &tkRectangleType) {
+	double coords[8];
+
+	coords[0] = coords[6] = rectOvalPtr->bbox[0];
+	coords[1] = coords[3] = rectOvalPtr->bbox[1];
+	coords[2] = coords[4] = rectOvalPtr->bbox[2];
+	coords[5] = coords[7] = rectOvalPtr->bbox[3];
+	TkCanvExportPath(canvas, coords, 4, 1);
+    } else {
+	TkCanvExportArcPath(canvas, rectOvalPtr->bbox, 0.0, 360.0,
+		TK_EXPORT_ARC_CHORD);
+    }
+    return TkCanvExportPaint(canvas, itemPtr, fillColor, fillStipple,
+	    (color != NULL) ? &rectOvalPtr->outline : NULL, CapProjecting,
+	    JoinMiter);
+}
+
 /*
  * Local Variables:
  * mode: c
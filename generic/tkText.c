@@ -176,9 +176,15 @@ static const Tk_OptionSpec optionSpecs[] = {
     {TK_OPTION_PIXELS, "-insertwidth", "insertWidth", "InsertWidth",
 	DEF_TEXT_INSERT_WIDTH, offsetof(TkText, insertWidthObj), TCL_INDEX_NONE,
 	0, 0, 0},
+    {TK_OPTION_INT, "-maxlines", "maxLines", "MaxLines",
+	DEF_TEXT_MAX_LINES, TCL_INDEX_NONE, offsetof(TkText, maxLines),
+	TK_OPTION_DONT_SET_DEFAULT, 0, 0},
     {TK_OPTION_INT, "-maxundo", "maxUndo", "MaxUndo",
 	DEF_TEXT_MAX_UNDO, TCL_INDEX_NONE, offsetof(TkText, maxUndo),
 	TK_OPTION_DONT_SET_DEFAULT, 0, 0},
+    {TK_OPTION_INT, "-maxundobytes", "maxUndoBytes", "MaxUndoBytes",
+	DEF_TEXT_MAX_UNDO_BYTES, TCL_INDEX_NONE,
+	offsetof(TkText, maxUndoBytes), TK_OPTION_DONT_SET_DEFAULT, 0, 0},
     {TK_OPTION_PIXELS, "-padx", "padX", "Pad",
 	DEF_TEXT_PADX, offsetof(TkText, padXObj), TCL_INDEX_NONE, 0, 0,
 	TK_TEXT_LINE_GEOMETRY},
@@ -265,6 +271,9 @@ typedef int		SearchMatchProc(int lineNum,
 typedef int		SearchLineIndexProc(Tcl_Interp *interp,
 			    Tcl_Obj *objPtr, struct SearchSpec *searchSpecPtr,
 			    int *linePosPtr, Tcl_Size *offsetPosPtr);
+typedef int		SearchMayMatchProc(int lineNum,
+			    struct SearchSpec *searchSpecPtr,
+			    const char *pattern);
 
 typedef struct SearchSpec {
     int exact;			/* Whether search is exact or regexp. */
@@ -301,8 +310,17 @@ typedef struct SearchSpec {
     SearchLineIndexProc *lineIndexProc;
 				/* Function to call when we have found a
 				 * match. */
+    SearchMayMatchProc *mayMatchProc;
+				/* Function to call to find out, without
+				 * adding it to the search string, whether a
+				 * line may contain an exact pattern. May be
+				 * NULL. */
     void *clientData;	/* Information about structure being searched,
 				 * in this case a text widget. */
+    int prevLine;		/* Line last returned by addLineProc, or -1.
+				 * Lines are mostly added in sequence, so the
+				 * next one can be found from this one. */
+    void *prevLineInfo;		/* Token addLineProc returned for prevLine. */
 } SearchSpec;
 
 /*
@@ -316,6 +334,22 @@ static int		SearchPerform(Tcl_Interp *interp,
 			    SearchSpec *searchSpecPtr, Tcl_Obj *patObj,
 			    Tcl_Obj *fromPtr, Tcl_Obj *toPtr);
 
+/*
+ * Information shared by the functions implementing the "dump" widget command.
+ */
+
+typedef struct DumpInfo {
+    Tcl_Obj *command;		/* Script callback to apply to segments, or
+				 * NULL to append them to the result. */
+    Tcl_Channel channel;	/* Channel the text is written to (-channel),
+				 * or NULL. */
+    int writeError;		/* Error code of the first failed write to
+				 * channel, or 0. */
+    Tcl_Size offset;		/* With -offsets, the number of characters
+				 * from the first dumped index to the place
+				 * the dump has reached. */
+} DumpInfo;
+
 /*
  * Boolean variable indicating whether or not special debugging code should be
  * executed.
@@ -355,27 +389,33 @@ static int		TextInsertCmd(TkSharedText *sharedTextPtr,
 			    TkText *textPtr, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const objv[],
 			    const TkTextIndex *indexPtr, int viewUpdate);
+static int		TextLoadCmd(TkText *textPtr, Tcl_Interp *interp,
+			    Tcl_Size objc, Tcl_Obj *const objv[]);
+static void		TextTrimLines(TkSharedText *sharedTextPtr,
+			    const TkTextIndex *keepPtr);
 static int		TextReplaceCmd(TkText *textPtr, Tcl_Interp *interp,
 			    const TkTextIndex *indexFromPtr,
 			    const TkTextIndex *indexToPtr,
 			    Tcl_Size objc, Tcl_Obj *const objv[], int viewUpdate);
 static int		TextSearchCmd(TkText *textPtr, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const objv[]);
+static int		TextDebugStatsCmd(TkText *textPtr,
+			    Tcl_Interp *interp, Tcl_Size objc,
+			    Tcl_Obj *const objv[]);
 static int		TextEditCmd(TkText *textPtr, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const objv[]);
 static Tcl_ObjCmdProc2 TextWidgetObjCmd;
-static Tcl_ObjCmdProc2 SharedTextObjCmd;
 static void		TextWorldChangedCallback(void *instanceData);
 static void		TextWorldChanged(TkText *textPtr, int mask);
 static int		TextDumpCmd(TkText *textPtr, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const objv[]);
 static int		DumpLine(Tcl_Interp *interp, TkText *textPtr,
 			    int what, TkTextLine *linePtr, int start, int end,
-			    int lineno, Tcl_Obj *command);
+			    int lineno, DumpInfo *infoPtr);
 static int		DumpSegment(TkText *textPtr, Tcl_Interp *interp,
 			    const char *key, const char *value,
-			    Tcl_Obj *command, const TkTextIndex *index,
-			    int what);
+			    DumpInfo *infoPtr, const TkTextIndex *index,
+			    Tcl_Size offset, int what);
 static int		TextEditUndo(TkText *textPtr);
 static int		TextEditRedo(TkText *textPtr);
 static Tcl_Obj *	TextGetText(const TkText *textPtr,
@@ -383,16 +423,22 @@ static Tcl_Obj *	TextGetText(const TkText *textPtr,
 			    const TkTextIndex *index2, int visibleOnly);
 static void		GenerateModifiedEvent(TkText *textPtr);
 static void		GenerateUndoStackEvent(TkText *textPtr);
+static void		NoteLinesChanged(TkSharedText *sharedTextPtr,
+			    int line, int oldLines, int newLines);
+static void		LinesChangedProc(void *clientData);
 static void		UpdateDirtyFlag(TkSharedText *sharedPtr);
 static void		TextPushUndoAction(TkText *textPtr,
 			    Tcl_Obj *undoString, int insert,
-			    const TkTextIndex *index1Ptr,
-			    const TkTextIndex *index2Ptr);
+			    const TkTextIndex *indexPtr);
+static int		TextSearchAnyElided(TkSharedText *sharedTextPtr);
 static Tcl_Size		TextSearchIndexInLine(const SearchSpec *searchSpecPtr,
 			    TkTextLine *linePtr, Tcl_Size byteIndex);
 static int		TextPeerCmd(TkText *textPtr, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const objv[]);
-static TkUndoProc	TextUndoRedoCallback;
+static TkUndoRecordProc	TextUndoRecordProc;
+static void		SetUndoMark(TkText *textPtr, const char *name,
+			    TkTextIndex *indexPtr, const Tk_SegType *typePtr);
+static void		TextSeeInsert(TkText *textPtr);
 
 /*
  * Declarations of the three search procs required by the multi-line search
@@ -402,6 +448,9 @@ static TkUndoProc	TextUndoRedoCallback;
 static SearchMatchProc		TextSearchFoundMatch;
 static SearchAddLineProc	TextSearchAddNextLine;
 static SearchLineIndexProc	TextSearchGetLineIndex;
+static SearchMayMatchProc	TextSearchMayMatch;
+static TkTextLine *	TextSearchFindLine(int lineNum,
+			    SearchSpec *searchSpecPtr);
 
 /*
  * The structure below defines text class behavior by means of functions that
@@ -530,7 +579,9 @@ CreateWidget(
 	sharedPtr->autoSeparators = 1;
 	sharedPtr->lastEditMode = TK_TEXT_EDIT_OTHER;
 	sharedPtr->stateEpoch = 0;
+	sharedPtr->numElideTags = 0;
 	sharedPtr->imageCount = 0;
+	sharedPtr->changedFirst = -1;
     }
 
     /*
@@ -592,7 +643,9 @@ CreateWidget(
     textPtr->pickEvent.type = LeaveNotify;
     textPtr->undo = textPtr->sharedTextPtr->undo;
     textPtr->maxUndo = textPtr->sharedTextPtr->maxUndo;
+    textPtr->maxUndoBytes = textPtr->sharedTextPtr->maxUndoBytes;
     textPtr->autoSeparators = textPtr->sharedTextPtr->autoSeparators;
+    textPtr->maxLines = textPtr->sharedTextPtr->maxLines;
     textPtr->tabOptionObj = NULL;
 
     /*
@@ -681,13 +734,13 @@ TextWidgetObjCmd(
     static const char *const optionStrings[] = {
 	"bbox", "cget", "compare", "configure", "count", "debug", "delete",
 	"dlineinfo", "dump", "edit", "get", "image", "index", "insert",
-	"mark", "peer", "pendingsync", "replace", "scan", "search",
+	"load", "mark", "peer", "pendingsync", "replace", "scan", "search",
 	"see", "sync", "tag", "window", "xview", "yview", NULL
     };
     enum options {
 	TEXT_BBOX, TEXT_CGET, TEXT_COMPARE, TEXT_CONFIGURE, TEXT_COUNT,
 	TEXT_DEBUG, TEXT_DELETE, TEXT_DLINEINFO, TEXT_DUMP, TEXT_EDIT,
-	TEXT_GET, TEXT_IMAGE, TEXT_INDEX, TEXT_INSERT, TEXT_MARK,
+	TEXT_GET, TEXT_IMAGE, TEXT_INDEX, TEXT_INSERT, TEXT_LOAD, TEXT_MARK,
 	TEXT_PEER, TEXT_PENDINGSYNC, TEXT_REPLACE, TEXT_SCAN,
 	TEXT_SEARCH, TEXT_SEE, TEXT_SYNC, TEXT_TAG, TEXT_WINDOW,
 	TEXT_XVIEW, TEXT_YVIEW
@@ -1035,6 +1088,10 @@ TextWidgetObjCmd(
 	goto done;
     }
     case TEXT_DEBUG:
+	if ((objc > 2) && !strcmp(Tcl_GetString(objv[2]), "stats")) {
+	    result = TextDebugStatsCmd(textPtr, interp, objc, objv);
+	    break;
+	}
 	if (objc > 3) {
 	    Tcl_WrongNumArgs(interp, 2, objv, "boolean");
 	    result = TCL_ERROR;
@@ -1363,9 +1420,13 @@ TextWidgetObjCmd(
 	if (textPtr->state != TK_TEXT_STATE_DISABLED) {
 	    result = TextInsertCmd(NULL, textPtr, interp, objc-3, objv+3,
 		    indexPtr, 1);
+	    TextTrimLines(textPtr->sharedTextPtr, NULL);
 	}
 	break;
     }
+    case TEXT_LOAD:
+	result = TextLoadCmd(textPtr, interp, objc, objv);
+	break;
     case TEXT_MARK:
 	result = TkTextMarkCmd(textPtr, interp, objc, objv);
 	break;
@@ -1492,6 +1553,7 @@ TextWidgetObjCmd(
 		TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			lineNum, byteIndex, &index);
 		TkTextSetYView(textPtr, &index, TK_TEXT_NOPIXELADJUST);
+		TextTrimLines(textPtr->sharedTextPtr, NULL);
 	    }
 	}
 	break;
@@ -1499,9 +1561,14 @@ TextWidgetObjCmd(
     case TEXT_SCAN:
 	result = TkTextScanCmd(textPtr, interp, objc, objv);
 	break;
-    case TEXT_SEARCH:
+    case TEXT_SEARCH: {
+	Tcl_WideInt startTime = TkTextStatsClock();
+
 	result = TextSearchCmd(textPtr, interp, objc, objv);
+	textPtr->stats.searches++;
+	textPtr->stats.searchTime += TkTextStatsClock() - startTime;
 	break;
+    }
     case TEXT_SEE:
 	result = TkTextSeeCmd(textPtr, interp, objc, objv);
 	break;
@@ -1558,116 +1625,133 @@ TextWidgetObjCmd(
     }
     return result;
 }
-
+
 /*
  *--------------------------------------------------------------
  *
- * SharedTextObjCmd --
+ * TextDebugStatsCmd --
  *
- *	This function is invoked to process commands on the shared portion of
- *	a text widget. Currently it is not actually exported as a Tcl command,
- *	and is only used internally to process parts of undo/redo scripts.
- *	See the user documentation for 'text' for details on what it does -
- *	the only subcommands it currently supports are 'insert' and 'delete'.
+ *	This function is invoked to process the "debug stats" widget command
+ *	for text widgets. See the user documentation for details on what it
+ *	does.
  *
  * Results:
- *	A standard Tcl result.
+ *	A standard Tcl result. The interpreter result is set to a dictionary
+ *	of the statistics gathered so far.
  *
  * Side effects:
- *	See the user documentation for "text".
+ *	With -reset, all the statistics are set back to zero.
  *
  *--------------------------------------------------------------
  */
 
 static int
-SharedTextObjCmd(
-    void *clientData,	/* Information about shared test B-tree. */
+TextDebugStatsCmd(
+    TkText *textPtr,		/* Information about text widget. */
     Tcl_Interp *interp,		/* Current interpreter. */
-    Tcl_Size objc,			/* Number of arguments. */
+    Tcl_Size objc,		/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    TkSharedText *sharedPtr = (TkSharedText *)clientData;
-    int result = TCL_OK;
-    int index;
-
-    static const char *const optionStrings[] = {
-	"delete", "insert", NULL
-    };
-    enum options {
-	TEXT_DELETE, TEXT_INSERT
+    static const struct {
+	const char *name;
+	size_t offset;
+    } statFields[] = {
+	{"layouts",		offsetof(TkTextStats, layouts)},
+	{"chunks",		offsetof(TkTextStats, chunks)},
+	{"stylehits",		offsetof(TkTextStats, styleHits)},
+	{"stylemisses",		offsetof(TkTextStats, styleMisses)},
+	{"heightcalcs",		offsetof(TkTextStats, heightCalcs)},
+	{"metricbatches",	offsetof(TkTextStats, metricBatches)},
+	{"metriclines",		offsetof(TkTextStats, metricLines)},
+	{"redisplays",		offsetof(TkTextStats, redisplays)},
+	{"linesredrawn",	offsetof(TkTextStats, linesRedrawn)},
+	{"redrawregions",	offsetof(TkTextStats, redrawRegions)},
+	{"copies",		offsetof(TkTextStats, copies)},
+	{"tagchanges",		offsetof(TkTextStats, tagChanges)},
+	{"searches",		offsetof(TkTextStats, searches)},
+	{"layouttime",		offsetof(TkTextStats, layoutTime)},
+	{"displaytime",		offsetof(TkTextStats, displayTime)},
+	{"metrictime",		offsetof(TkTextStats, metricTime)},
+	{"tagtime",		offsetof(TkTextStats, tagTime)},
+	{"searchtime",		offsetof(TkTextStats, searchTime)},
+	{NULL,			0}
     };
+    static const char *const statOptions[] = {"-reset", NULL};
+    Tcl_Obj *resultObj;
+    int index, i;
 
-    if (objc < 2) {
-	Tcl_WrongNumArgs(interp, 1, objv, "option ?arg ...?");
+    if (objc > 4) {
+	Tcl_WrongNumArgs(interp, 3, objv, "?-reset?");
 	return TCL_ERROR;
     }
-
-    if (Tcl_GetIndexFromObjStruct(interp, objv[1], optionStrings,
-	    sizeof(char *), "option", 0, &index) != TCL_OK) {
+    if ((objc == 4) && (Tcl_GetIndexFromObjStruct(interp, objv[3],
+	    statOptions, sizeof(char *), "option", 0, &index) != TCL_OK)) {
 	return TCL_ERROR;
     }
 
-    switch ((enum options) index) {
-    case TEXT_DELETE:
-	if (objc < 3) {
-	    Tcl_WrongNumArgs(interp, 2, objv, "index1 ?index2 ...?");
-	    return TCL_ERROR;
-	}
-	if (objc < 5) {
-	    /*
-	     * Simple case requires no predetermination of indices.
-	     */
-
-	    TkTextIndex index1;
-
-	    /*
-	     * Parse the starting and stopping indices.
-	     */
+    resultObj = Tcl_NewObj();
+    for (i = 0; statFields[i].name != NULL; i++) {
+	Tcl_ListObjAppendElement(NULL, resultObj,
+		Tcl_NewStringObj(statFields[i].name, TCL_INDEX_NONE));
+	Tcl_ListObjAppendElement(NULL, resultObj, Tcl_NewWideIntObj(
+		*(Tcl_WideInt *)((char *)&textPtr->stats
+		+ statFields[i].offset)));
+    }
+    Tcl_SetObjResult(interp, resultObj);
+    if (objc == 4) {
+	memset(&textPtr->stats, 0, sizeof(TkTextStats));
+    }
+    return TCL_OK;
+}
 
-	    result = TkTextSharedGetObjIndex(interp, sharedPtr, objv[2],
-		    &index1);
-	    if (result != TCL_OK) {
-		return result;
-	    }
-	    if (objc == 4) {
-		TkTextIndex index2;
+/*
+ *--------------------------------------------------------------
+ *
+ * TkTextStatsClock --
+ *
+ *	Returns the time of a monotonic clock, for measuring the times
+ *	reported by "debug stats", so that they don't jump when the system
+ *	clock is adjusted. Falls back to Tcl_GetTime where there is no
+ *	monotonic clock.
+ *
+ * Results:
+ *	The time in microseconds since an arbitrary starting point.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
 
-		result = TkTextSharedGetObjIndex(interp, sharedPtr, objv[3],
-			&index2);
-		if (result != TCL_OK) {
-		    return result;
-		}
-		DeleteIndexRange(sharedPtr, NULL, &index1, &index2, 1);
-	    } else {
-		DeleteIndexRange(sharedPtr, NULL, &index1, NULL, 1);
-	    }
-	    return TCL_OK;
-	} else {
-	    /* Too many arguments */
-	    return TCL_ERROR;
-	}
-	break;
-    case TEXT_INSERT: {
-	TkTextIndex index1;
+Tcl_WideInt
+TkTextStatsClock(void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
 
-	if (objc < 4) {
-	    Tcl_WrongNumArgs(interp, 2, objv,
-		    "index chars ?tagList chars tagList ...?");
-	    return TCL_ERROR;
-	}
-	result = TkTextSharedGetObjIndex(interp, sharedPtr, objv[2],
-		&index1);
-	if (result != TCL_OK) {
-	    return result;
-	}
-	return TextInsertCmd(sharedPtr, NULL, interp, objc-3, objv+3, &index1,
-		1);
+    if (frequency.QuadPart == 0) {
+	QueryPerformanceFrequency(&frequency);
     }
-    default:
-	return TCL_OK;
+    QueryPerformanceCounter(&now);
+    return (Tcl_WideInt) (now.QuadPart / frequency.QuadPart) * 1000000
+	    + (Tcl_WideInt) (now.QuadPart % frequency.QuadPart) * 1000000
+	    / frequency.QuadPart;
+#else
+    Tcl_Time time;
+#ifdef CLOCK_MONOTONIC
+    struct timespec now;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0) {
+	return (Tcl_WideInt) now.tv_sec * 1000000 + now.tv_nsec / 1000;
     }
+#endif
+    Tcl_GetTime(&time);
+    return (Tcl_WideInt) time.sec * 1000000 + time.usec;
+#endif
 }
 
+
 /*
  *--------------------------------------------------------------
  *
@@ -2011,6 +2095,7 @@ DestroyText(
 	if (sharedTextPtr->bindingTable != NULL) {
 	    Tk_DeleteBindingTable(sharedTextPtr->bindingTable);
 	}
+	Tcl_CancelIdleCall(LinesChangedProc, sharedTextPtr);
 	ckfree(sharedTextPtr);
     }
 
@@ -2074,10 +2159,15 @@ ConfigureText(
 
     textPtr->sharedTextPtr->undo = textPtr->undo;
     textPtr->sharedTextPtr->maxUndo = textPtr->maxUndo;
+    textPtr->sharedTextPtr->maxUndoBytes = textPtr->maxUndoBytes;
     textPtr->sharedTextPtr->autoSeparators = textPtr->autoSeparators;
+    textPtr->sharedTextPtr->maxLines = textPtr->maxLines;
 
     TkUndoSetMaxDepth(textPtr->sharedTextPtr->undoStack,
 	    textPtr->sharedTextPtr->maxUndo);
+    TkUndoSetMaxBytes(textPtr->sharedTextPtr->undoStack,
+	    (textPtr->sharedTextPtr->maxUndoBytes > 0)
+	    ? textPtr->sharedTextPtr->maxUndoBytes : 0);
 
     /*
      * A few other options also need special processing, such as parsing the
@@ -2316,6 +2406,7 @@ ConfigureText(
     }
     Tk_FreeSavedOptions(&savedOptions);
     TextWorldChanged(textPtr, mask);
+    TextTrimLines(textPtr->sharedTextPtr, NULL);
     return TCL_OK;
 }
 
@@ -2607,8 +2698,8 @@ InsertChars(
 				 * information to add to text. */
     int viewUpdate)		/* Update the view if set. */
 {
-    int lineIndex;
-    Tcl_Size length;
+    int lineIndex, firstLine, newLines;
+    Tcl_Size length, i;
     TkText *tPtr;
     int *lineAndByteIndex;
     int resetViewCount;
@@ -2661,6 +2752,7 @@ InsertChars(
 
     sharedTextPtr->stateEpoch++;
 
+    firstLine = TkBTreeLinesTo(NULL, indexPtr->linePtr);
     TkBTreeInsertChars(sharedTextPtr->tree, indexPtr, string);
 
     /*
@@ -2670,8 +2762,6 @@ InsertChars(
 
     if (length > 0) {
 	if (sharedTextPtr->undo) {
-	    TkTextIndex toIndex;
-
 	    if (sharedTextPtr->autoSeparators &&
 		sharedTextPtr->lastEditMode != TK_TEXT_EDIT_INSERT) {
 		TkUndoInsertUndoSeparator(sharedTextPtr->undoStack);
@@ -2679,11 +2769,17 @@ InsertChars(
 
 	    sharedTextPtr->lastEditMode = TK_TEXT_EDIT_INSERT;
 
-	    TkTextIndexForwBytes(textPtr, indexPtr, length, &toIndex);
-	    TextPushUndoAction(textPtr, stringPtr, 1, indexPtr, &toIndex);
+	    TextPushUndoAction(textPtr, stringPtr, 1, indexPtr);
 	}
 
 	UpdateDirtyFlag(sharedTextPtr);
+
+	for (i = 0, newLines = 0; i < length; i++) {
+	    if (string[i] == '\n') {
+		newLines++;
+	    }
+	}
+	NoteLinesChanged(sharedTextPtr, firstLine, 0, newLines);
     }
 
     resetViewCount = 0;
@@ -2729,16 +2825,17 @@ InsertChars(
  *
  * TextPushUndoAction --
  *
- *	Shared by insert and delete actions. Stores the appropriate scripts
- *	into our undo stack. We will add a single refCount to the 'undoString'
- *	object, so, if it previously had a refCount of zero, the caller should
- *	not free it.
+ *	Shared by insert and delete actions. Records the change on our undo
+ *	stack as the line and byte offset where it happened and a reference
+ *	to the text, which TextUndoRecordProc replays directly on the B-tree.
+ *	We will add a single refCount to the 'undoString' object, so, if it
+ *	previously had a refCount of zero, the caller should not free it.
  *
  * Results:
  *	None.
  *
  * Side effects:
- *	Items pushed onto stack.
+ *	Items pushed onto stack, or merged into the item on top of it.
  *
  *----------------------------------------------------------------------
  */
@@ -2748,265 +2845,187 @@ TextPushUndoAction(
     TkText *textPtr,		/* Overall information about text widget. */
     Tcl_Obj *undoString,	/* New text. */
     int insert,			/* 1 if insert, else delete. */
-    const TkTextIndex *index1Ptr,
-				/* Index describing first location. */
-    const TkTextIndex *index2Ptr)
-				/* Index describing second location. */
+    const TkTextIndex *indexPtr)/* Index describing the location of the
+				 * first character inserted or deleted. */
 {
-    TkUndoSubAtom *iAtom, *dAtom;
+    TkSharedText *sharedTextPtr = textPtr->sharedTextPtr;
     int canUndo, canRedo;
-    char lMarkName[16 + TCL_INTEGER_SPACE] = "tk::undoMarkL";
-    char rMarkName[16 + TCL_INTEGER_SPACE] = "tk::undoMarkR";
-    char stringUndoMarkId[TCL_INTEGER_SPACE] = "";
-
-    /*
-     * Create the helpers.
-     */
-
-    Tcl_Obj *seeInsertObj = Tcl_NewObj();
-    Tcl_Obj *markSet1InsertObj = Tcl_NewObj();
-    Tcl_Obj *markSet2InsertObj = NULL;
-    Tcl_Obj *insertCmdObj = Tcl_NewObj();
-    Tcl_Obj *deleteCmdObj = Tcl_NewObj();
-    Tcl_Obj *markSetLUndoMarkCmdObj = Tcl_NewObj();
-    Tcl_Obj *markSetRUndoMarkCmdObj = NULL;
-    Tcl_Obj *markGravityLUndoMarkCmdObj = Tcl_NewObj();
-    Tcl_Obj *markGravityRUndoMarkCmdObj = NULL;
-
-    /*
-     * Get the index positions.
-     */
-
-    Tcl_Obj *index1Obj = TkTextNewIndexObj(NULL, index1Ptr);
-    Tcl_Obj *index2Obj = TkTextNewIndexObj(NULL, index2Ptr);
 
-    /*
-     * These need refCounts, because they are used more than once below.
-     */
-
-    Tcl_IncrRefCount(seeInsertObj);
-    Tcl_IncrRefCount(index1Obj);
-    Tcl_IncrRefCount(index2Obj);
-
-    Tcl_ListObjAppendElement(NULL, seeInsertObj,
-	    Tcl_NewStringObj(Tk_PathName(textPtr->tkwin), TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, seeInsertObj, Tcl_NewStringObj("see", 3));
-    Tcl_ListObjAppendElement(NULL, seeInsertObj,
-	    Tcl_NewStringObj("insert", 6));
-
-    Tcl_ListObjAppendElement(NULL, markSet1InsertObj,
-	    Tcl_NewStringObj(Tk_PathName(textPtr->tkwin), TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, markSet1InsertObj,
-	    Tcl_NewStringObj("mark", 4));
-    Tcl_ListObjAppendElement(NULL, markSet1InsertObj,
-	    Tcl_NewStringObj("set", 3));
-    Tcl_ListObjAppendElement(NULL, markSet1InsertObj,
-	    Tcl_NewStringObj("insert", 6));
-    markSet2InsertObj = Tcl_DuplicateObj(markSet1InsertObj);
-    Tcl_ListObjAppendElement(NULL, markSet1InsertObj, index1Obj);
-    Tcl_ListObjAppendElement(NULL, markSet2InsertObj, index2Obj);
-
-    Tcl_ListObjAppendElement(NULL, insertCmdObj,
-	    Tcl_NewStringObj("insert", 6));
-    Tcl_ListObjAppendElement(NULL, insertCmdObj, index1Obj);
-
-    /*
-     * Only use of 'undoString' is here.
-     */
-
-    Tcl_ListObjAppendElement(NULL, insertCmdObj, undoString);
-
-    Tcl_ListObjAppendElement(NULL, deleteCmdObj,
-	    Tcl_NewStringObj("delete", 6));
-    Tcl_ListObjAppendElement(NULL, deleteCmdObj, index1Obj);
-    Tcl_ListObjAppendElement(NULL, deleteCmdObj, index2Obj);
-
-    Tcl_ListObjAppendElement(NULL, markSetLUndoMarkCmdObj,
-	    Tcl_NewStringObj(Tk_PathName(textPtr->tkwin), TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, markSetLUndoMarkCmdObj,
-	    Tcl_NewStringObj("mark", 4));
-    Tcl_ListObjAppendElement(NULL, markSetLUndoMarkCmdObj,
-	    Tcl_NewStringObj("set", 3));
-    markSetRUndoMarkCmdObj = Tcl_DuplicateObj(markSetLUndoMarkCmdObj);
-    textPtr->sharedTextPtr->undoMarkId++;
-    snprintf(stringUndoMarkId, TCL_INTEGER_SPACE, "%" TCL_SIZE_MODIFIER "d", textPtr->sharedTextPtr->undoMarkId);
-    strcat(lMarkName, stringUndoMarkId);
-    strcat(rMarkName, stringUndoMarkId);
-    Tcl_ListObjAppendElement(NULL, markSetLUndoMarkCmdObj,
-	    Tcl_NewStringObj(lMarkName, TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, markSetRUndoMarkCmdObj,
-	    Tcl_NewStringObj(rMarkName, TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, markSetLUndoMarkCmdObj, index1Obj);
-    Tcl_ListObjAppendElement(NULL, markSetRUndoMarkCmdObj, index2Obj);
-
-    Tcl_ListObjAppendElement(NULL, markGravityLUndoMarkCmdObj,
-	    Tcl_NewStringObj(Tk_PathName(textPtr->tkwin), TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, markGravityLUndoMarkCmdObj,
-	    Tcl_NewStringObj("mark", 4));
-    Tcl_ListObjAppendElement(NULL, markGravityLUndoMarkCmdObj,
-	    Tcl_NewStringObj("gravity", 7));
-    markGravityRUndoMarkCmdObj = Tcl_DuplicateObj(markGravityLUndoMarkCmdObj);
-    Tcl_ListObjAppendElement(NULL, markGravityLUndoMarkCmdObj,
-	    Tcl_NewStringObj(lMarkName, TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, markGravityRUndoMarkCmdObj,
-	    Tcl_NewStringObj(rMarkName, TCL_INDEX_NONE));
-    Tcl_ListObjAppendElement(NULL, markGravityLUndoMarkCmdObj,
-	    Tcl_NewStringObj("left", 4));
-    Tcl_ListObjAppendElement(NULL, markGravityRUndoMarkCmdObj,
-	    Tcl_NewStringObj("right", 5));
-
-    /*
-     * Note: we don't wish to use textPtr->widgetCmd in these callbacks
-     * because if we delete the textPtr, but peers still exist, we will then
-     * have references to a non-existent Tcl_Command in the undo stack, which
-     * will lead to crashes later. Also, the behaviour of the widget w.r.t.
-     * bindings (%W substitutions) always uses the widget path name, so there
-     * is no good reason the undo stack should do otherwise.
-     *
-     * For the 'insert' and 'delete' actions, we have to register a functional
-     * callback, because these actions are defined to operate on the
-     * underlying data shared by all peers.
-     */
-
-    iAtom = TkUndoMakeSubAtom(&TextUndoRedoCallback, textPtr->sharedTextPtr,
-	    insertCmdObj, NULL);
-    TkUndoMakeCmdSubAtom(NULL, markSet2InsertObj, iAtom);
-    TkUndoMakeCmdSubAtom(NULL, seeInsertObj, iAtom);
-    TkUndoMakeCmdSubAtom(NULL, markSetLUndoMarkCmdObj, iAtom);
-    TkUndoMakeCmdSubAtom(NULL, markSetRUndoMarkCmdObj, iAtom);
-    TkUndoMakeCmdSubAtom(NULL, markGravityLUndoMarkCmdObj, iAtom);
-    TkUndoMakeCmdSubAtom(NULL, markGravityRUndoMarkCmdObj, iAtom);
-
-    dAtom = TkUndoMakeSubAtom(&TextUndoRedoCallback, textPtr->sharedTextPtr,
-	    deleteCmdObj, NULL);
-    TkUndoMakeCmdSubAtom(NULL, markSet1InsertObj, dAtom);
-    TkUndoMakeCmdSubAtom(NULL, seeInsertObj, dAtom);
-    TkUndoMakeCmdSubAtom(NULL, markSetLUndoMarkCmdObj, dAtom);
-    TkUndoMakeCmdSubAtom(NULL, markSetRUndoMarkCmdObj, dAtom);
-    TkUndoMakeCmdSubAtom(NULL, markGravityLUndoMarkCmdObj, dAtom);
-    TkUndoMakeCmdSubAtom(NULL, markGravityRUndoMarkCmdObj, dAtom);
-
-    Tcl_DecrRefCount(seeInsertObj);
-    Tcl_DecrRefCount(index1Obj);
-    Tcl_DecrRefCount(index2Obj);
-
-    canUndo = TkUndoCanUndo(textPtr->sharedTextPtr->undoStack);
-    canRedo = TkUndoCanRedo(textPtr->sharedTextPtr->undoStack);
+    canUndo = TkUndoCanUndo(sharedTextPtr->undoStack);
+    canRedo = TkUndoCanRedo(sharedTextPtr->undoStack);
 
     /*
-     * Depending whether the action is to insert or delete, we provide the
-     * appropriate second and third arguments to TkUndoPushAction. (The first
-     * is the 'actionCommand', and the second the 'revertCommand').
+     * The record refers to the shared B-tree rather than to this widget,
+     * because if we delete the textPtr, but peers still exist, the undo
+     * stack still has to work for them.
      */
 
-    if (insert) {
-	TkUndoPushAction(textPtr->sharedTextPtr->undoStack, iAtom, dAtom);
-    } else {
-	TkUndoPushAction(textPtr->sharedTextPtr->undoStack, dAtom, iAtom);
-    }
+    TkUndoPushRecord(sharedTextPtr->undoStack, TextUndoRecordProc,
+	    sharedTextPtr, insert ? TK_UNDO_INSERT : TK_UNDO_DELETE,
+	    TkBTreeLinesTo(NULL, indexPtr->linePtr), indexPtr->byteIndex,
+	    undoString);
 
     if (!canUndo || canRedo) {
 	GenerateUndoStackEvent(textPtr);
     }
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
- * TextUndoRedoCallback --
+ * TextUndoRecordProc --
  *
- *	This function is registered with the generic undo/redo code to handle
- *	'insert' and 'delete' actions on all text widgets. We cannot perform
- *	those actions on any particular text widget, because that text widget
- *	might have been deleted by the time we get here.
+ *	This function is registered with the generic undo/redo code to replay
+ *	the insertions and deletions recorded by TextPushUndoAction on all
+ *	text widgets. We cannot perform those actions on any particular text
+ *	widget, because that text widget might have been deleted by the time
+ *	we get here, so the change is made directly on the shared data.
+ *
+ *	In the peer doing the undo or redo, the insert mark is moved to the
+ *	change, and the temporary marks tk::undoMarkL<n> and tk::undoMarkR<n>
+ *	are set around it for ::tk::TextUndoRedoProcessMarks.
  *
  * Results:
- *	A standard Tcl result.
+ *	Returns a standard Tcl result, currently always TCL_OK.
  *
  * Side effects:
- *	Will insert or delete text, depending on the first word contained in
- *	objPtr.
+ *	Text is inserted or deleted, and marks are set.
  *
  *----------------------------------------------------------------------
  */
 
-int
-TextUndoRedoCallback(
-    Tcl_Interp *interp,		/* Current interpreter. */
-    void *clientData,	/* Passed from undo code, but contains our
-				 * shared text data structure. */
-    Tcl_Obj *objPtr)		/* Arguments of a command to be handled by the
+static int
+TextUndoRecordProc(
+    TCL_UNUSED(Tcl_Interp *),
+    void *clientData,		/* Passed from undo code, but contains our
 				 * shared text data structure. */
+    TkUndoRecordType type,	/* Whether to insert or delete the text. */
+    TkUndoRecord *recordPtr)	/* Position and text of the change. */
 {
     TkSharedText *sharedPtr = (TkSharedText *)clientData;
-    int res;
-    Tcl_Size objc;
-    Tcl_Obj **objv;
-    TkText *textPtr;
+    TkText *textPtr = sharedPtr->undoTextPtr;
+    TkTextIndex index1, index2, insertIndex;
+    Tcl_Size length;
+    char markName[16 + TCL_INTEGER_SPACE];
 
-    res = Tcl_ListObjGetElements(interp, objPtr, &objc, &objv);
-    if (res != TCL_OK) {
-	return res;
-    }
+    (void) Tcl_GetStringFromObj(recordPtr->textObj, &length);
+    TkTextMakeByteIndex(sharedPtr->tree, NULL, (int) recordPtr->line,
+	    recordPtr->byteIndex, &index1);
 
-    /*
-     * If possible, use a real text widget to perform the undo/redo action
-     * (i.e. insertion or deletion of text). This provides maximum
-     * compatibility with older versions of Tk, in which the user may rename
-     * the text widget to allow capture of undo or redo actions.
-     *
-     * In particular, this sorting of capture is useful in text editors based
-     * on the Tk text widget, which need to know which new text needs
-     * re-coloring.
-     *
-     * It would be better if the text widget provided some other mechanism to
-     * allow capture of this information ("What has just changed in the text
-     * widget?"). What we have here is not entirely satisfactory under all
-     * circumstances.
-     */
+    if (type == TK_UNDO_INSERT) {
+	InsertChars(sharedPtr, NULL, &index1, recordPtr->textObj, 1);
+	TkTextIndexForwBytes(NULL, &index1, length, &index2);
+	insertIndex = index2;
+    } else {
+	TkTextIndex lineStart;
+	int endLine, endChar;
 
-    textPtr = sharedPtr->peers;
-    while (textPtr != NULL) {
-	if (textPtr->start == NULL && textPtr->end == NULL) {
-	    Tcl_Obj *cmdNameObj, *evalObj;
+	/*
+	 * The right undo mark goes to the line and character at which the
+	 * deleted text ended, taken again after the deletion. This is where
+	 * "edit undo" has always reported the end of such ranges.
+	 */
 
-	    evalObj = Tcl_NewObj();
-	    Tcl_IncrRefCount(evalObj);
+	TkTextIndexForwBytes(NULL, &index1, length, &index2);
+	endLine = TkBTreeLinesTo(NULL, index2.linePtr);
+	TkTextMakeByteIndex(sharedPtr->tree, NULL, endLine, 0, &lineStart);
+	endChar = TkTextIndexCount(NULL, &lineStart, &index2, COUNT_INDICES);
+	DeleteIndexRange(sharedPtr, NULL, &index1, &index2, 1);
+	TkTextMakeByteIndex(sharedPtr->tree, NULL, (int) recordPtr->line,
+		recordPtr->byteIndex, &index1);
+	TkTextMakeCharIndex(sharedPtr->tree, NULL, endLine, endChar,
+		&index2);
+	insertIndex = index1;
+    }
+
+    if (textPtr != NULL) {
+	TkTextIndexAdjustToStartEnd(textPtr, &insertIndex, 0);
+	TkTextSetMark(textPtr, "insert", &insertIndex);
+
+	sharedPtr->undoMarkId++;
+	snprintf(markName, sizeof(markName), "tk::undoMarkL%" TCL_SIZE_MODIFIER
+		"d", sharedPtr->undoMarkId);
+	SetUndoMark(textPtr, markName, &index1, &tkTextLeftMarkType);
+	markName[12] = 'R';
+	SetUndoMark(textPtr, markName, &index2, &tkTextRightMarkType);
+    }
+    return TCL_OK;
+}
 
-	    /*
-	     * We might wish to use the real, current command-name for the
-	     * widget, but this will break any code that has over-ridden the
-	     * widget, and is expecting to observe the insert/delete actions
-	     * which are caused by undo/redo operations.
-	     *
-	     * cmdNameObj = Tcl_NewObj();
-	     * Tcl_GetCommandFullName(interp, textPtr->widgetCmd, cmdNameObj);
-	     *
-	     * While such interception is not explicitly documented as
-	     * supported, it does occur, and so until we can provide some
-	     * alternative mechanism for such code to do what it needs, we
-	     * allow it to take place here.
-	     */
+/*
+ *----------------------------------------------------------------------
+ *
+ * SetUndoMark --
+ *
+ *	Set one of the temporary marks delimiting a change made by undo or
+ *	redo, with the given gravity.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The mark is created or moved.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	    cmdNameObj = Tcl_NewStringObj(Tk_PathName(textPtr->tkwin), TCL_INDEX_NONE);
-	    Tcl_ListObjAppendElement(NULL, evalObj, cmdNameObj);
-	    Tcl_ListObjAppendList(NULL, evalObj, objPtr);
-	    res = Tcl_EvalObjEx(interp, evalObj, TCL_EVAL_GLOBAL);
-	    Tcl_DecrRefCount(evalObj);
-	    return res;
-	}
-	textPtr = textPtr->next;
+static void
+SetUndoMark(
+    TkText *textPtr,		/* Peer doing the undo or redo. */
+    const char *name,		/* Name of the mark. */
+    TkTextIndex *indexPtr,	/* Where to set the mark. */
+    const Tk_SegType *typePtr)	/* tkTextLeftMarkType or
+				 * tkTextRightMarkType. */
+{
+    TkTextIndex index = *indexPtr;
+    TkTextSegment *markPtr;
+
+    TkTextIndexAdjustToStartEnd(textPtr, &index, 0);
+    markPtr = TkTextSetMark(textPtr, name, &index);
+    if (markPtr->typePtr != typePtr) {
+	TkTextMarkSegToIndex(textPtr, markPtr, &index);
+	TkBTreeUnlinkSegment(markPtr, markPtr->body.mark.linePtr);
+	markPtr->typePtr = typePtr;
+	TkBTreeLinkSegment(markPtr, &index);
     }
+}
 
-    /*
-     * If there's no current text widget which shows everything, then we fall
-     * back on acting directly. This means there is no way to intercept from
-     * the Tcl level.
-     */
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextSeeInsert --
+ *
+ *	Adjust the view of a text widget so that the insert mark is visible,
+ *	as "$text see insert" does.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The view may change.
+ *
+ *----------------------------------------------------------------------
+ */
 
-    return SharedTextObjCmd(sharedPtr, interp, objc+1, objv-1);
+static void
+TextSeeInsert(
+    TkText *textPtr)		/* Information about text widget. */
+{
+    Tcl_Obj *objv[3];
+    int i;
+
+    objv[0] = Tcl_NewStringObj(Tk_PathName(textPtr->tkwin), TCL_INDEX_NONE);
+    objv[1] = Tcl_NewStringObj("see", 3);
+    objv[2] = Tcl_NewStringObj("insert", 6);
+    for (i = 0; i < 3; i++) {
+	Tcl_IncrRefCount(objv[i]);
+    }
+    (void) TkTextSeeCmd(textPtr, textPtr->interp, 3, objv);
+    for (i = 0; i < 3; i++) {
+	Tcl_DecrRefCount(objv[i]);
+    }
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3097,7 +3116,7 @@ DeleteIndexRange(
 				 * given by indexPtr1. */
     int viewUpdate)		/* Update vertical view if set. */
 {
-    int line1, line2;
+    int line1, line2, firstLine, oldLines;
     TkTextIndex index1, index2;
     TkText *tPtr;
     int *lineAndByteIndex;
@@ -3195,7 +3214,7 @@ DeleteIndexRange(
 	     *	event generate $textWidget <<Selection>>
 	     */
 
-	    TkTextSelectionEvent(textPtr);
+	    TkTextSelectionEvent(tPtr);
 	    tPtr->abortSelections = 1;
 	}
     }
@@ -3292,13 +3311,16 @@ DeleteIndexRange(
 	    sharedTextPtr->lastEditMode = TK_TEXT_EDIT_DELETE;
 
 	    get = TextGetText(textPtr, &index1, &index2, 0);
-	    TextPushUndoAction(textPtr, get, 0, &index1, &index2);
+	    TextPushUndoAction(textPtr, get, 0, &index1);
 	}
 	sharedTextPtr->stateEpoch++;
 
+	firstLine = TkBTreeLinesTo(NULL, index1.linePtr);
+	oldLines = TkBTreeLinesTo(NULL, index2.linePtr) - firstLine;
 	TkBTreeDeleteIndexRange(sharedTextPtr->tree, &index1, &index2);
 
 	UpdateDirtyFlag(sharedTextPtr);
+	NoteLinesChanged(sharedTextPtr, firstLine, oldLines, 0);
     }
 
     resetViewCount = 0;
@@ -3749,74 +3771,362 @@ TextInsertCmd(
 /*
  *----------------------------------------------------------------------
  *
- * TextSearchCmd --
+ * TextLoadCmd --
  *
- *	This function is invoked to process the "search" widget command for
- *	text widgets. See the user documentation for details on what it does.
+ *	This function is invoked to process the "load" widget command for
+ *	text widgets: it reads a channel and inserts its contents into the
+ *	text a chunk at a time. Reading stops at the end of the file or, for a
+ *	non-blocking channel, when no more input is available. The inserted
+ *	text is not recorded on the undo stack.
  *
  * Results:
- *	A standard Tcl result.
+ *	A standard Tcl result. The interpreter's result is the number of
+ *	characters inserted.
  *
  * Side effects:
- *	See the user documentation.
+ *	Text is inserted and input is consumed from the channel. Reading a
+ *	reflected channel can run arbitrary scripts.
  *
  *----------------------------------------------------------------------
  */
 
 static int
-TextSearchCmd(
+TextLoadCmd(
     TkText *textPtr,		/* Information about text widget. */
     Tcl_Interp *interp,		/* Current interpreter. */
-    Tcl_Size objc,			/* Number of arguments. */
+    Tcl_Size objc,		/* Number of arguments. */
     Tcl_Obj *const objv[])	/* Argument objects. */
 {
-    Tcl_Size i, argsLeft;
-    int code;
-    SearchSpec searchSpec;
+    TkSharedText *sharedTextPtr = textPtr->sharedTextPtr;
+    Tcl_Obj *channelObj = NULL, *chunkObj;
+    Tcl_Channel chan;
+    Tcl_HashEntry *hPtr;
+    TkTextIndex index;
+    const TkTextIndex *indexPtr;
+    Tcl_Size i, numChars, epoch, total = 0;
+    int chunkSize = 65536, mode, undo, code = TCL_OK;
+    char markName[10 + TCL_INTEGER_SPACE];
 
-    static const char *const switchStrings[] = {
-	"-hidden",
-	"--", "-all", "-backwards", "-count", "-elide", "-exact", "-forwards",
-	"-nocase", "-nolinestop", "-overlap", "-regexp", "-strictlimits", NULL
+    static const char *const loadOptionStrings[] = {
+	"-channel", "-chunksize", "-index", NULL
     };
-    enum SearchSwitches {
-	TK_TEXT_SEARCH_HIDDEN,
-	TK_TEXT_SEARCH_END, TK_TEXT_SEARCH_ALL, TK_TEXT_SEARCH_BACK, TK_TEXT_SEARCH_COUNT, TK_TEXT_SEARCH_ELIDE,
-	TK_TEXT_SEARCH_EXACT, TK_TEXT_SEARCH_FWD, TK_TEXT_SEARCH_NOCASE,
-	TK_TEXT_SEARCH_NOLINESTOP, TK_TEXT_SEARCH_OVERLAP, TK_TEXT_SEARCH_REGEXP, TK_TEXT_SEARCH_STRICTLIMITS
+    enum loadOptions {
+	LOAD_CHANNEL, LOAD_CHUNKSIZE, LOAD_INDEX
     };
 
-    /*
-     * Set up the search specification, including the last 4 fields which are
-     * text widget specific.
-     */
+    TkTextMakeByteIndex(sharedTextPtr->tree, textPtr,
+	    TkBTreeNumLines(sharedTextPtr->tree, textPtr), 0, &index);
+    for (i = 2; i < objc; i += 2) {
+	int optIndex;
 
-    searchSpec.exact = 1;
-    searchSpec.noCase = 0;
-    searchSpec.all = 0;
-    searchSpec.backwards = 0;
-    searchSpec.varPtr = NULL;
-    searchSpec.countPtr = NULL;
-    searchSpec.resPtr = NULL;
-    searchSpec.searchElide = 0;
-    searchSpec.noLineStop = 0;
-    searchSpec.overlap = 0;
-    searchSpec.strictLimits = 0;
-    searchSpec.numLines =
-	    TkBTreeNumLines(textPtr->sharedTextPtr->tree, textPtr);
-    searchSpec.clientData = textPtr;
-    searchSpec.addLineProc = &TextSearchAddNextLine;
-    searchSpec.foundMatchProc = &TextSearchFoundMatch;
-    searchSpec.lineIndexProc = &TextSearchGetLineIndex;
+	if (Tcl_GetIndexFromObjStruct(interp, objv[i], loadOptionStrings,
+		sizeof(char *), "option", 0, &optIndex) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (i + 1 >= objc) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "no value given for \"%s\" option",
+		    loadOptionStrings[optIndex]));
+	    Tcl_SetErrorCode(interp, "TK", "TEXT", "VALUE", (char *)NULL);
+	    return TCL_ERROR;
+	}
+	switch ((enum loadOptions) optIndex) {
+	case LOAD_CHANNEL:
+	    channelObj = objv[i+1];
+	    break;
+	case LOAD_CHUNKSIZE:
+	    if (Tcl_GetIntFromObj(interp, objv[i+1], &chunkSize) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (chunkSize <= 0) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+			"chunk size must be positive, but got \"%s\"",
+			Tcl_GetString(objv[i+1])));
+		Tcl_SetErrorCode(interp, "TK", "TEXT", "VALUE", (char *)NULL);
+		return TCL_ERROR;
+	    }
+	    break;
+	case LOAD_INDEX:
+	    indexPtr = TkTextGetIndexFromObj(interp, textPtr, objv[i+1]);
+	    if (indexPtr == NULL) {
+		return TCL_ERROR;
+	    }
+	    index = *indexPtr;
+	    break;
+	}
+    }
+    if (channelObj == NULL) {
+	Tcl_WrongNumArgs(interp, 2, objv,
+		"-channel channelId ?-chunksize size? ?-index index?");
+	return TCL_ERROR;
+    }
+    chan = Tcl_GetChannel(interp, Tcl_GetString(channelObj), &mode);
+    if (chan == NULL) {
+	return TCL_ERROR;
+    }
+    if (!(mode & TCL_READABLE)) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"channel \"%s\" wasn't opened for reading",
+		Tcl_GetString(channelObj)));
+	Tcl_SetErrorCode(interp, "TK", "TEXT", "LOAD", "UNREADABLE",
+		(char *)NULL);
+	return TCL_ERROR;
+    }
+    if (textPtr->state == TK_TEXT_STATE_DISABLED) {
+	Tcl_SetObjResult(interp, Tcl_NewWideIntObj(0));
+	return TCL_OK;
+    }
 
     /*
-     * Parse switches and other arguments.
+     * Insert the text in chunks so that the whole file never has to be held
+     * in memory as a single string. Undo is turned off while inserting so
+     * that the chunks don't pile up on the undo stack; the stacks are
+     * cleared instead.
+     *
+     * Reading a reflected channel runs Tcl scripts, which may change the
+     * text or destroy the widget. A temporary mark with right gravity
+     * follows the insertion point so that it can be found again if the
+     * text changed during a read.
      */
 
-    for (i=2 ; i<objc ; i++) {
-	int index;
+    textPtr->refCount++;
+    sharedTextPtr->loadMarkId++;
+    snprintf(markName, sizeof(markName), "tk::load%" TCL_SIZE_MODIFIER "d",
+	    sharedTextPtr->loadMarkId);
+    TkTextSetMark(textPtr, markName, &index);
+    chunkObj = Tcl_NewObj();
+    Tcl_IncrRefCount(chunkObj);
+    undo = sharedTextPtr->undo;
+    sharedTextPtr->undo = 0;
+    while (1) {
+	Tcl_Size length;
 
-	if (Tcl_GetString(objv[i])[0] != '-') {
+	epoch = sharedTextPtr->stateEpoch;
+	numChars = Tcl_ReadChars(chan, chunkObj, chunkSize, 0);
+	if (textPtr->flags & DESTROYED) {
+	    break;
+	}
+	if (numChars == TCL_IO_FAILURE) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "error reading \"%s\": %s",
+		    Tcl_GetString(channelObj), Tcl_PosixError(interp)));
+	    code = TCL_ERROR;
+	    break;
+	}
+	if (numChars == 0) {
+	    break;
+	}
+	if (sharedTextPtr->stateEpoch != epoch) {
+	    /*
+	     * Our index is no longer valid. If the mark went too, there is
+	     * nowhere left to insert.
+	     */
+
+	    hPtr = Tcl_FindHashEntry(&sharedTextPtr->markTable, markName);
+	    if (hPtr == NULL) {
+		break;
+	    }
+	    TkTextMarkSegToIndex(textPtr,
+		    (TkTextSegment *)Tcl_GetHashValue(hPtr), &index);
+	}
+
+	/*
+	 * InsertChars moves the index off the last (dummy) line if needed,
+	 * so that the next chunk follows this one.
+	 */
+
+	length = InsertChars(sharedTextPtr, textPtr, &index, chunkObj, 1);
+	TkTextIndexForwBytes(textPtr, &index, length, &index);
+	total += numChars;
+
+	/*
+	 * Honour -maxlines as we go, so that following a large file doesn't
+	 * need memory for all of it.
+	 */
+
+	TextTrimLines(sharedTextPtr, &index);
+    }
+    Tcl_DecrRefCount(chunkObj);
+    if (textPtr->flags & DESTROYED) {
+	/*
+	 * The shared part of the widget may have gone with it.
+	 */
+
+	goto done;
+    }
+    sharedTextPtr->undo = undo;
+    hPtr = Tcl_FindHashEntry(&sharedTextPtr->markTable, markName);
+    if (hPtr != NULL) {
+	TkTextSegment *markPtr = (TkTextSegment *)Tcl_GetHashValue(hPtr);
+
+	TkBTreeUnlinkSegment(markPtr, markPtr->body.mark.linePtr);
+	Tcl_DeleteHashEntry(hPtr);
+	ckfree(markPtr);
+    }
+
+    /*
+     * The chunks weren't recorded, so the positions in the undo and redo
+     * stacks may no longer be right: clear them.
+     */
+
+    if (total > 0 && (TkUndoCanUndo(sharedTextPtr->undoStack)
+	    || TkUndoCanRedo(sharedTextPtr->undoStack))) {
+	TkUndoClearStacks(sharedTextPtr->undoStack);
+	GenerateUndoStackEvent(textPtr);
+    }
+
+  done:
+    if (code == TCL_OK) {
+	Tcl_SetObjResult(interp, Tcl_NewWideIntObj(total));
+    }
+    if (textPtr->refCount-- <= 1) {
+	ckfree(textPtr);
+    }
+    return code;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextTrimLines --
+ *
+ *	Enforces the -maxlines option: deletes lines from the beginning of the
+ *	shared text until there are no more than the maximum, even if no peer
+ *	shows them. The deletion isn't recorded on the undo stack; since the
+ *	indices in the stack are then wrong, the undo and redo stacks are
+ *	cleared instead.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Lines may be deleted. If keepPtr is not NULL, the line it refers to
+ *	and the lines after it are kept, even if that leaves too many lines,
+ *	so that the caller can go on using the index.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TextTrimLines(
+    TkSharedText *sharedTextPtr,/* Shared portion of peer widgets. */
+    const TkTextIndex *keepPtr)	/* Index whose line must not be deleted, or
+				 * NULL. */
+{
+    TkTextIndex index1, index2;
+    int excess, undo;
+
+    if (sharedTextPtr->maxLines <= 0) {
+	return;
+    }
+    excess = TkBTreeNumLines(sharedTextPtr->tree, NULL)
+	    - sharedTextPtr->maxLines;
+    if (keepPtr != NULL) {
+	int keepLine = TkBTreeLinesTo(NULL, keepPtr->linePtr);
+
+	if (excess > keepLine) {
+	    excess = keepLine;
+	}
+    }
+    if (excess <= 0) {
+	return;
+    }
+
+    /*
+     * Delete the lines of the shared tree, whatever range the peers show.
+     * The stacks are cleared whether or not undo is on at the moment:
+     * this may be called while undoing, or while loading.
+     */
+
+    TkTextMakeByteIndex(sharedTextPtr->tree, NULL, 0, 0, &index1);
+    TkTextMakeByteIndex(sharedTextPtr->tree, NULL, excess, 0, &index2);
+    undo = sharedTextPtr->undo;
+    sharedTextPtr->undo = 0;
+    DeleteIndexRange(sharedTextPtr, NULL, &index1, &index2, 1);
+    sharedTextPtr->undo = undo;
+    if (TkUndoCanUndo(sharedTextPtr->undoStack)
+	    || TkUndoCanRedo(sharedTextPtr->undoStack)) {
+	TkUndoClearStacks(sharedTextPtr->undoStack);
+	if (sharedTextPtr->peers != NULL) {
+	    GenerateUndoStackEvent(sharedTextPtr->peers);
+	}
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextSearchCmd --
+ *
+ *	This function is invoked to process the "search" widget command for
+ *	text widgets. See the user documentation for details on what it does.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the user documentation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextSearchCmd(
+    TkText *textPtr,		/* Information about text widget. */
+    Tcl_Interp *interp,		/* Current interpreter. */
+    Tcl_Size objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    Tcl_Size i, argsLeft;
+    int code;
+    SearchSpec searchSpec;
+
+    static const char *const switchStrings[] = {
+	"-hidden",
+	"--", "-all", "-backwards", "-count", "-elide", "-exact", "-forwards",
+	"-nocase", "-nolinestop", "-overlap", "-regexp", "-strictlimits", NULL
+    };
+    enum SearchSwitches {
+	TK_TEXT_SEARCH_HIDDEN,
+	TK_TEXT_SEARCH_END, TK_TEXT_SEARCH_ALL, TK_TEXT_SEARCH_BACK, TK_TEXT_SEARCH_COUNT, TK_TEXT_SEARCH_ELIDE,
+	TK_TEXT_SEARCH_EXACT, TK_TEXT_SEARCH_FWD, TK_TEXT_SEARCH_NOCASE,
+	TK_TEXT_SEARCH_NOLINESTOP, TK_TEXT_SEARCH_OVERLAP, TK_TEXT_SEARCH_REGEXP, TK_TEXT_SEARCH_STRICTLIMITS
+    };
+
+    /*
+     * Set up the search specification, including the last 4 fields which are
+     * text widget specific.
+     */
+
+    searchSpec.exact = 1;
+    searchSpec.noCase = 0;
+    searchSpec.all = 0;
+    searchSpec.backwards = 0;
+    searchSpec.varPtr = NULL;
+    searchSpec.countPtr = NULL;
+    searchSpec.resPtr = NULL;
+    searchSpec.searchElide = 0;
+    searchSpec.noLineStop = 0;
+    searchSpec.overlap = 0;
+    searchSpec.strictLimits = 0;
+    searchSpec.numLines =
+	    TkBTreeNumLines(textPtr->sharedTextPtr->tree, textPtr);
+    searchSpec.clientData = textPtr;
+    searchSpec.addLineProc = &TextSearchAddNextLine;
+    searchSpec.foundMatchProc = &TextSearchFoundMatch;
+    searchSpec.lineIndexProc = &TextSearchGetLineIndex;
+    searchSpec.mayMatchProc = &TextSearchMayMatch;
+    searchSpec.prevLine = -1;
+    searchSpec.prevLineInfo = NULL;
+
+    /*
+     * Parse switches and other arguments.
+     */
+
+    for (i=2 ; i<objc ; i++) {
+	int index;
+
+	if (Tcl_GetString(objv[i])[0] != '-') {
 	    break;
 	}
 
@@ -3912,6 +4222,17 @@ TextSearchCmd(
 	return TCL_ERROR;
     }
 
+    /*
+     * Finding out whether a piece of text is elided is expensive. If no tag
+     * elides anything, searching the elided text gives the same result as
+     * skipping it, and is much faster on large texts.
+     */
+
+    if (!searchSpec.searchElide
+	    && !TextSearchAnyElided(textPtr->sharedTextPtr)) {
+	searchSpec.searchElide = 1;
+    }
+
     /*
      * Scan through all of the lines of the text circularly, starting at the
      * given index. 'objv[i]' is the pattern which may be an exact string or a
@@ -4087,6 +4408,46 @@ TextSearchIndexInLine(
     return index;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextSearchAnyElided --
+ *
+ *	Checks whether any tag of a text, including the "sel" tags of all its
+ *	peers, has its -elide option set to true.
+ *
+ * Results:
+ *	1 if some text may be elided, 0 if no text can be elided.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextSearchAnyElided(
+    TkSharedText *sharedTextPtr)	/* Text to check. */
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    TkText *peerPtr;
+
+    for (hPtr = Tcl_FirstHashEntry(&sharedTextPtr->tagTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	if (((TkTextTag *) Tcl_GetHashValue(hPtr))->elide > 0) {
+	    return 1;
+	}
+    }
+    for (peerPtr = sharedTextPtr->peers; peerPtr != NULL;
+	    peerPtr = peerPtr->next) {
+	if (peerPtr->selTagPtr != NULL && peerPtr->selTagPtr->elide > 0) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4132,14 +4493,15 @@ TextSearchAddNextLine(
     TkText *textPtr = (TkText *)searchSpecPtr->clientData;
     int nothingYet = 1;
 
+    linePtr = TextSearchFindLine(lineNum, searchSpecPtr);
+    if (linePtr == NULL) {
+	return NULL;
+    }
+
     /*
      * Extract the text from the line.
      */
 
-    linePtr = TkBTreeFindLine(textPtr->sharedTextPtr->tree, textPtr, lineNum);
-    if (linePtr == NULL) {
-	return NULL;
-    }
     curIndex.tree = textPtr->sharedTextPtr->tree;
     thisLinePtr = linePtr;
 
@@ -4210,6 +4572,112 @@ TextSearchAddNextLine(
     return linePtr;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextSearchFindLine --
+ *
+ *	Finds a line of the text widget being searched. Lines are mostly
+ *	needed in sequence, so the line is found by stepping from the previous
+ *	one when possible, which is much quicker than a lookup in the B-tree.
+ *
+ * Results:
+ *	The line, or NULL if there is no such line.
+ *
+ * Side effects:
+ *	The line is remembered in 'searchSpecPtr' for the next call.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TkTextLine *
+TextSearchFindLine(
+    int lineNum,		/* Line to find. */
+    SearchSpec *searchSpecPtr)	/* Search parameters. */
+{
+    TkText *textPtr = (TkText *)searchSpecPtr->clientData;
+    TkTextLine *linePtr = NULL;
+
+    if (searchSpecPtr->prevLine != -1) {
+	TkTextLine *prevLinePtr = (TkTextLine *)searchSpecPtr->prevLineInfo;
+
+	if (lineNum == searchSpecPtr->prevLine) {
+	    linePtr = prevLinePtr;
+	} else if (lineNum == searchSpecPtr->prevLine + 1) {
+	    linePtr = TkBTreeNextLine(textPtr, prevLinePtr);
+	} else if (lineNum == searchSpecPtr->prevLine - 1) {
+	    linePtr = TkBTreePreviousLine(textPtr, prevLinePtr);
+	}
+    }
+    if (linePtr == NULL) {
+	linePtr = TkBTreeFindLine(textPtr->sharedTextPtr->tree, textPtr,
+		lineNum);
+	if (linePtr == NULL) {
+	    return NULL;
+	}
+    }
+    searchSpecPtr->prevLine = lineNum;
+    searchSpecPtr->prevLineInfo = linePtr;
+    return linePtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TextSearchMayMatch --
+ *
+ *	Checks whether an exact pattern may occur in a line of the text
+ *	widget, by looking at the characters of the line where they are
+ *	stored rather than copying them into the search string. Most lines of
+ *	a large text don't match, and this avoids copying them.
+ *
+ * Results:
+ *	0 if the pattern certainly doesn't occur in the line, 1 if it may.
+ *	Only a line whose characters are all in one segment can be checked;
+ *	for other lines, and when elided text is skipped (which changes the
+ *	text that is searched), the result is 1.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+TextSearchMayMatch(
+    int lineNum,		/* Line to check. */
+    SearchSpec *searchSpecPtr,	/* Search parameters. */
+    const char *pattern)	/* Exact pattern, without newlines except
+				 * possibly at its end. */
+{
+    TkTextLine *linePtr;
+    TkTextSegment *segPtr, *charSegPtr = NULL;
+
+    if (!searchSpecPtr->searchElide) {
+	return 1;
+    }
+    linePtr = TextSearchFindLine(lineNum, searchSpecPtr);
+    if (linePtr == NULL) {
+	return 1;
+    }
+    for (segPtr = linePtr->segPtr; segPtr != NULL; segPtr = segPtr->nextPtr) {
+	if (segPtr->typePtr == &tkTextCharType) {
+	    if (charSegPtr != NULL) {
+		return 1;
+	    }
+	    charSegPtr = segPtr;
+	}
+    }
+
+    /*
+     * Character segments are null-terminated, and never contain a null
+     * character themselves.
+     */
+
+    return (charSegPtr != NULL
+	    && strstr(charSegPtr->body.chars, pattern) != NULL);
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4637,7 +5105,9 @@ TextDumpCmd(
     int what = 0;		/* bitfield to select segment types. */
     int atEnd;			/* True if dumping up to logical end. */
     TkTextLine *linePtr;
-    Tcl_Obj *command = NULL;	/* Script callback to apply to segments. */
+    DumpInfo info;
+    Tcl_Obj *channelObj = NULL;	/* Name of the channel to write text to. */
+    int offsets = 0;		/* Report offsets rather than indices. */
 #define TK_DUMP_TEXT	0x1
 #define TK_DUMP_MARK	0x2
 #define TK_DUMP_TAG	0x4
@@ -4645,14 +5115,21 @@ TextDumpCmd(
 #define TK_DUMP_IMG	0x10
 #define TK_DUMP_ALL	(TK_DUMP_TEXT|TK_DUMP_MARK|TK_DUMP_TAG| \
 	TK_DUMP_WIN|TK_DUMP_IMG)
+#define TK_DUMP_OFFSETS	0x20
     static const char *const optStrings[] = {
-	"-all", "-command", "-image", "-mark", "-tag", "-text", "-window",
-	NULL
+	"-all", "-channel", "-command", "-image", "-mark", "-offsets", "-tag",
+	"-text", "-window", NULL
     };
     enum opts {
-	DUMP_ALL, DUMP_CMD, DUMP_IMG, DUMP_MARK, DUMP_TAG, DUMP_TXT, DUMP_WIN
+	DUMP_ALL, DUMP_CHANNEL, DUMP_CMD, DUMP_IMG, DUMP_MARK, DUMP_OFFSETS,
+	DUMP_TAG, DUMP_TXT, DUMP_WIN
     };
 
+    info.command = NULL;
+    info.channel = NULL;
+    info.writeError = 0;
+    info.offset = 0;
+
     for (arg=2 ; arg < objc ; arg++) {
 	int index;
 	if (Tcl_GetString(objv[arg])[0] != '-') {
@@ -4686,7 +5163,17 @@ TextDumpCmd(
 	    if (arg >= objc) {
 		goto wrongArgs;
 	    }
-	    command = objv[arg];
+	    info.command = objv[arg];
+	    break;
+	case DUMP_CHANNEL:
+	    arg++;
+	    if (arg >= objc) {
+		goto wrongArgs;
+	    }
+	    channelObj = objv[arg];
+	    break;
+	case DUMP_OFFSETS:
+	    offsets = 1;
 	    break;
 	default:
 	    Tcl_Panic("unexpected switch fallthrough");
@@ -4696,13 +5183,34 @@ TextDumpCmd(
     wrongArgs:
 	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
 		"Usage: %s dump ?-all -image -text -mark -tag -window? "
-		"?-command script? index ?index2?", Tcl_GetString(objv[0])));
+		"?-channel channelId? ?-command script? ?-offsets? "
+		"index ?index2?", Tcl_GetString(objv[0])));
 	Tcl_SetErrorCode(interp, "TCL", "WRONGARGS", (char *)NULL);
 	return TCL_ERROR;
     }
     if (what == 0) {
 	what = TK_DUMP_ALL;
     }
+    if (offsets) {
+	what |= TK_DUMP_OFFSETS;
+    }
+    if (channelObj != NULL) {
+	int mode;
+
+	info.channel = Tcl_GetChannel(interp, Tcl_GetString(channelObj),
+		&mode);
+	if (info.channel == NULL) {
+	    return TCL_ERROR;
+	}
+	if (!(mode & TCL_WRITABLE)) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "channel \"%s\" wasn't opened for writing",
+		    Tcl_GetString(channelObj)));
+	    Tcl_SetErrorCode(interp, "TK", "TEXT", "DUMP", "UNWRITABLE",
+		    (char *)NULL);
+	    return TCL_ERROR;
+	}
+    }
     if (TkTextGetObjIndex(interp, textPtr, objv[arg], &index1) != TCL_OK) {
 	return TCL_ERROR;
     }
@@ -4728,14 +5236,14 @@ TextDumpCmd(
     lineno = TkBTreeLinesTo(textPtr, index1.linePtr);
     if (index1.linePtr == index2.linePtr) {
 	DumpLine(interp, textPtr, what, index1.linePtr,
-		index1.byteIndex, index2.byteIndex, lineno, command);
+		index1.byteIndex, index2.byteIndex, lineno, &info);
     } else {
 	int textChanged;
 	int lineend = TkBTreeLinesTo(textPtr, index2.linePtr);
 	int endByteIndex = index2.byteIndex;
 
 	textChanged = DumpLine(interp, textPtr, what, index1.linePtr,
-		index1.byteIndex, 32000000, lineno, command);
+		index1.byteIndex, 32000000, lineno, &info);
 	if (textChanged) {
 	    if (textPtr->flags & DESTROYED) {
 		return TCL_OK;
@@ -4752,7 +5260,7 @@ TextDumpCmd(
 		break;
 	    }
 	    textChanged = DumpLine(interp, textPtr, what, linePtr, 0,
-		    32000000, lineno, command);
+		    32000000, lineno, &info);
 	    if (textChanged) {
 		if (textPtr->flags & DESTROYED) {
 		    return TCL_OK;
@@ -4764,7 +5272,7 @@ TextDumpCmd(
 	}
 	if (linePtr != NULL) {
 	    DumpLine(interp, textPtr, what, linePtr, 0, endByteIndex, lineno,
-		    command);
+		    &info);
 	    if (textPtr->flags & DESTROYED) {
 		return TCL_OK;
 	    }
@@ -4788,7 +5296,13 @@ TextDumpCmd(
 	    return TCL_ERROR;
 	}
 	DumpLine(interp, textPtr, what & ~TK_DUMP_TEXT, index2.linePtr,
-		0, 1, lineno, command);
+		0, 1, lineno, &info);
+    }
+    if (info.writeError) {
+	Tcl_SetErrno(info.writeError);
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf("error writing \"%s\": %s",
+		Tcl_GetString(channelObj), Tcl_PosixError(interp)));
+	return TCL_ERROR;
     }
     return TCL_OK;
 }
@@ -4799,7 +5313,9 @@ TextDumpCmd(
  * DumpLine
  *
  *	Return information about a given text line from character position
- *	"start" up to, but not including, "end".
+ *	"start" up to, but not including, "end". With the TK_DUMP_OFFSETS
+ *	flag, infoPtr->offset is the offset of "start" on entry, and is
+ *	advanced to that of "end" (or of the start of the next line).
  *
  * Results:
  *	Returns 1 if the command callback made any changes to the text widget
@@ -4808,7 +5324,8 @@ TextDumpCmd(
  *	such entities. Returns 0 otherwise.
  *
  * Side effects:
- *	None, but see DumpSegment which can have arbitrary side-effects
+ *	None, but see DumpSegment which can have arbitrary side-effects, as
+ *	can writing to a reflected channel.
  *
  *----------------------------------------------------------------------
  */
@@ -4821,11 +5338,34 @@ DumpLine(
     TkTextLine *linePtr,	/* The current line. */
     int startByte, int endByte,	/* Byte range to dump. */
     int lineno,			/* Line number for indices dump. */
-    Tcl_Obj *command)		/* Script to apply to the segment. */
+    DumpInfo *infoPtr)		/* Options and state of the dump. */
 {
     TkTextSegment *segPtr;
     TkTextIndex index;
     int offset = 0, textChanged = 0;
+    Tcl_Size lineBase = 0;	/* With TK_DUMP_OFFSETS, the offset of the
+				 * start of the line... */
+    Tcl_Size segChars = 0;	/* ... and the number of characters before
+				 * segPtr in the line. */
+
+    if (what & TK_DUMP_OFFSETS) {
+	lineBase = infoPtr->offset;
+	for (segPtr = linePtr->segPtr; (offset < startByte) && (segPtr != NULL);
+		segPtr = segPtr->nextPtr) {
+	    int n = segPtr->size;
+
+	    if (offset + n > startByte) {
+		n = startByte - offset;
+	    }
+	    if (segPtr->typePtr == &tkTextCharType) {
+		lineBase -= Tcl_NumUtfChars(segPtr->body.chars, n);
+	    } else {
+		lineBase -= n;
+	    }
+	    offset += segPtr->size;
+	}
+	offset = 0;
+    }
 
     /*
      * Must loop through line looking at its segments.
@@ -4852,7 +5392,30 @@ DumpLine(
 	    if (startByte > offset) {
 		first = startByte - offset;
 	    }
-	    if (last != currentSize) {
+	    if (infoPtr->channel != NULL) {
+		Tcl_Size oldStateEpoch =
+			TkBTreeEpoch(textPtr->sharedTextPtr->tree);
+		Tcl_DString buf;
+
+		/*
+		 * The text goes straight to the channel rather than into a
+		 * "text" item. Writing to a reflected channel runs scripts
+		 * that can change the text while it is being written, so a
+		 * copy of the characters is written.
+		 */
+
+		Tcl_DStringInit(&buf);
+		Tcl_DStringAppend(&buf, segPtr->body.chars + first,
+			last - first);
+		if ((Tcl_WriteChars(infoPtr->channel, Tcl_DStringValue(&buf),
+			last - first) < 0) && !infoPtr->writeError) {
+		    infoPtr->writeError = Tcl_GetErrno();
+		}
+		Tcl_DStringFree(&buf);
+		lineChanged = ((textPtr->flags & DESTROYED) ||
+			TkBTreeEpoch(textPtr->sharedTextPtr->tree)
+			!= oldStateEpoch);
+	    } else if (last != currentSize) {
 		/*
 		 * To avoid modifying the string in place we copy over just
 		 * the segment that we want. Since DumpSegment can modify the
@@ -4869,13 +5432,16 @@ DumpLine(
 		TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			lineno, offset + first, &index);
 		lineChanged = DumpSegment(textPtr, interp, "text", range,
-			command, &index, what);
+			infoPtr, &index, lineBase + segChars
+			+ Tcl_NumUtfChars(segPtr->body.chars, first), what);
 		ckfree(range);
 	    } else {
 		TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			lineno, offset + first, &index);
 		lineChanged = DumpSegment(textPtr, interp, "text",
-			segPtr->body.chars + first, command, &index, what);
+			segPtr->body.chars + first, infoPtr, &index,
+			lineBase + segChars
+			+ Tcl_NumUtfChars(segPtr->body.chars, first), what);
 	    }
 	} else if ((offset >= startByte)) {
 	    if ((what & TK_DUMP_MARK)
@@ -4899,22 +5465,22 @@ DumpLine(
 		    TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			    lineno, offset, &index);
 		    lineChanged = DumpSegment(textPtr, interp, "mark", name,
-			    command, &index, what);
+			    infoPtr, &index, lineBase + segChars, what);
 		}
 	    } else if ((what & TK_DUMP_TAG) &&
 		    (segPtr->typePtr == &tkTextToggleOnType)) {
 		TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			lineno, offset, &index);
 		lineChanged = DumpSegment(textPtr, interp, "tagon",
-			segPtr->body.toggle.tagPtr->name, command, &index,
-			what);
+			segPtr->body.toggle.tagPtr->name, infoPtr, &index,
+			lineBase + segChars, what);
 	    } else if ((what & TK_DUMP_TAG) &&
 		    (segPtr->typePtr == &tkTextToggleOffType)) {
 		TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			lineno, offset, &index);
 		lineChanged = DumpSegment(textPtr, interp, "tagoff",
-			segPtr->body.toggle.tagPtr->name, command, &index,
-			what);
+			segPtr->body.toggle.tagPtr->name, infoPtr, &index,
+			lineBase + segChars, what);
 	    } else if ((what & TK_DUMP_IMG) &&
 		    (segPtr->typePtr == &tkTextEmbImageType)) {
 		TkTextEmbImage *eiPtr = &segPtr->body.ei;
@@ -4923,7 +5489,7 @@ DumpLine(
 		TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			lineno, offset, &index);
 		lineChanged = DumpSegment(textPtr, interp, "image", name,
-			command, &index, what);
+			infoPtr, &index, lineBase + segChars, what);
 	    } else if ((what & TK_DUMP_WIN) &&
 		    (segPtr->typePtr == &tkTextEmbWindowType)) {
 		TkTextEmbWindow *ewPtr = &segPtr->body.ew;
@@ -4937,11 +5503,18 @@ DumpLine(
 		TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
 			lineno, offset, &index);
 		lineChanged = DumpSegment(textPtr, interp, "window", pathname,
-			command, &index, what);
+			infoPtr, &index, lineBase + segChars, what);
 	    }
 	}
 
 	offset += currentSize;
+	if (what & TK_DUMP_OFFSETS) {
+	    if (segPtr->typePtr == &tkTextCharType) {
+		segChars += Tcl_NumUtfChars(segPtr->body.chars, currentSize);
+	    } else {
+		segChars += currentSize;
+	    }
+	}
 	if (lineChanged) {
 	    TkTextSegment *newSegPtr;
 	    int newOffset = 0;
@@ -4986,6 +5559,7 @@ DumpLine(
 	    segPtr = segPtr->nextPtr;
 	}
     }
+    infoPtr->offset = lineBase + segChars;
     return textChanged;
 }
 
@@ -4995,7 +5569,9 @@ DumpLine(
  * DumpSegment
  *
  *	Either append information about the current segment to the result, or
- *	make a script callback with that information as arguments.
+ *	make a script callback with that information as arguments. The
+ *	position of the segment is given as an index or, with the
+ *	TK_DUMP_OFFSETS flag, as a character offset.
  *
  * Results:
  *	Returns 1 if the command callback made any changes to the text widget
@@ -5016,17 +5592,23 @@ DumpSegment(
     Tcl_Interp *interp,
     const char *key,		/* Segment type key. */
     const char *value,		/* Segment value. */
-    Tcl_Obj *command,		/* Script callback. */
+    DumpInfo *infoPtr,		/* Holds the script callback. */
     const TkTextIndex *index,	/* index with line/byte position info. */
-    TCL_UNUSED(int))		/* Look for TK_DUMP_INDEX bit. */
+    Tcl_Size offset,		/* Character offset of the segment. */
+    int what)			/* Look for TK_DUMP_OFFSETS bit. */
 {
     char buffer[TK_POS_CHARS];
     Tcl_Obj *values[3], *tuple;
+    Tcl_Obj *command = infoPtr->command;
 
-    TkTextPrintIndex(textPtr, index, buffer);
     values[0] = Tcl_NewStringObj(key, -1);
     values[1] = Tcl_NewStringObj(value, -1);
-    values[2] = Tcl_NewStringObj(buffer, -1);
+    if (what & TK_DUMP_OFFSETS) {
+	values[2] = Tcl_NewWideIntObj(offset);
+    } else {
+	TkTextPrintIndex(textPtr, index, buffer);
+	values[2] = Tcl_NewStringObj(buffer, -1);
+    }
     tuple = Tcl_NewListObj(3, values);
     if (command == NULL) {
 	Tcl_ListObjAppendList(NULL, Tcl_GetObjResult(interp), tuple);
@@ -5098,7 +5680,9 @@ TextEditUndo(
 	textPtr->sharedTextPtr->dirtyMode = TK_TEXT_DIRTY_UNDO;
     }
 
+    textPtr->sharedTextPtr->undoTextPtr = textPtr;
     status = TkUndoRevert(textPtr->sharedTextPtr->undoStack);
+    textPtr->sharedTextPtr->undoTextPtr = NULL;
 
     if (textPtr->sharedTextPtr->dirtyMode != TK_TEXT_DIRTY_FIXED) {
 	textPtr->sharedTextPtr->dirtyMode = TK_TEXT_DIRTY_NORMAL;
@@ -5109,6 +5693,18 @@ TextEditUndo(
 	TkUndoInsertUndoSeparator(textPtr->sharedTextPtr->undoStack);
     }
 
+    /*
+     * Enforce -maxlines only once the whole compound action has been
+     * reverted, since its records hold absolute line numbers. Trimming
+     * clears the stacks.
+     */
+
+    TextTrimLines(textPtr->sharedTextPtr, NULL);
+
+    if (status == TCL_OK) {
+	TextSeeInsert(textPtr);
+    }
+
     /*
      * Convert undo/redo temporary marks set by TkUndoRevert() into
      * indices left in the interp result.
@@ -5168,13 +5764,26 @@ TextEditRedo(
 	textPtr->sharedTextPtr->dirtyMode = TK_TEXT_DIRTY_REDO;
     }
 
+    textPtr->sharedTextPtr->undoTextPtr = textPtr;
     status = TkUndoApply(textPtr->sharedTextPtr->undoStack);
+    textPtr->sharedTextPtr->undoTextPtr = NULL;
 
     if (textPtr->sharedTextPtr->dirtyMode != TK_TEXT_DIRTY_FIXED) {
 	textPtr->sharedTextPtr->dirtyMode = TK_TEXT_DIRTY_NORMAL;
     }
     textPtr->sharedTextPtr->undo = 1;
 
+    /*
+     * Enforce -maxlines once the whole compound action has been applied,
+     * as in TextEditUndo.
+     */
+
+    TextTrimLines(textPtr->sharedTextPtr, NULL);
+
+    if (status == TCL_OK) {
+	TextSeeInsert(textPtr);
+    }
+
     /*
      * Convert undo/redo temporary marks set by TkUndoApply() into
      * indices left in the interp result.
@@ -5459,6 +6068,113 @@ GenerateModifiedEvent(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * NoteLinesChanged --
+ *
+ *	Records that some lines of the text were replaced by others, so that
+ *	a <<LinesChanged>> event gets sent when the application is idle. The
+ *	lines recorded by earlier calls are renumbered to account for the
+ *	change, so that the event reports where the changed text is at the
+ *	time it is delivered.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	An idle handler may be scheduled.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+NoteLinesChanged(
+    TkSharedText *sharedTextPtr,/* Shared portion of peer widgets. */
+    int line,			/* First line affected by the change, counted
+				 * from 0 over the whole text. */
+    int oldLines,		/* Number of lines after it that the change
+				 * affected (i.e. newlines removed). */
+    int newLines)		/* Number of lines after it that the change
+				 * produced (i.e. newlines inserted). */
+{
+    int first, last;
+
+    if (sharedTextPtr->changedFirst < 0) {
+	sharedTextPtr->changedFirst = line;
+	sharedTextPtr->changedLast = line + newLines;
+	Tcl_DoWhenIdle(LinesChangedProc, sharedTextPtr);
+	return;
+    }
+
+    first = sharedTextPtr->changedFirst;
+    last = sharedTextPtr->changedLast;
+    if (first > line + oldLines) {
+	first += newLines - oldLines;
+    } else if (first > line) {
+	first = line;
+    }
+    if (last > line + oldLines) {
+	last += newLines - oldLines;
+    } else if (last > line + newLines) {
+	last = line + newLines;
+    }
+    sharedTextPtr->changedFirst = (first < line) ? first : line;
+    sharedTextPtr->changedLast = (last > line + newLines) ? last
+	    : line + newLines;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * LinesChangedProc --
+ *
+ *	Idle handler that sends the event
+ *	   event generate $textWidget <<LinesChanged>> -data {first last}
+ *	to all peers of a text widget whose lines overlap those changed since
+ *	the last such event. The line numbers are those of each peer.
+ *
+ * Results:
+ *	None
+ *
+ * Side effects:
+ *	May force the text windows into existence.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+LinesChangedProc(
+    void *clientData)		/* Shared portion of peer widgets. */
+{
+    TkSharedText *sharedTextPtr = (TkSharedText *)clientData;
+    TkText *tPtr;
+    int first, last, start;
+
+    for (tPtr = sharedTextPtr->peers; tPtr != NULL; tPtr = tPtr->next) {
+	if (tPtr->flags & DESTROYED) {
+	    continue;
+	}
+	start = (tPtr->start == NULL) ? 0
+		: TkBTreeLinesTo(NULL, tPtr->start);
+	first = sharedTextPtr->changedFirst - start;
+	last = sharedTextPtr->changedLast - start;
+	if (first < 0) {
+	    first = 0;
+	}
+	if (last >= TkBTreeNumLines(sharedTextPtr->tree, tPtr)) {
+	    last = TkBTreeNumLines(sharedTextPtr->tree, tPtr) - 1;
+	}
+	if (first > last) {
+	    continue;
+	}
+	Tk_MakeWindowExist(tPtr->tkwin);
+	Tk_SendVirtualEvent(tPtr->tkwin, "LinesChanged",
+		Tcl_ObjPrintf("%d %d", first + 1, last + 1));
+    }
+    sharedTextPtr->changedFirst = -1;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -5730,6 +6446,9 @@ SearchCore(
 
     const char *pattern = NULL;	/* For exact searches only. */
     int firstNewLine = -1;	/* For exact searches only. */
+    const char *quickPattern = NULL;
+				/* The pattern, if lines may be checked with
+				 * 'mayMatchProc' before being added. */
     Tcl_RegExp regexp = NULL;	/* For regexp searches only. */
 
     /*
@@ -5805,6 +6524,9 @@ SearchCore(
 
 	if (nl != NULL && nl[1] != '\0') {
 	    firstNewLine = (nl - pattern);
+	} else if (matchLength > 0 && !searchSpecPtr->noCase
+		&& searchSpecPtr->mayMatchProc != NULL) {
+	    quickPattern = pattern;
 	}
     } else {
 	matchLength = 0;	/* Only needed to prevent compiler warnings. */
@@ -5838,6 +6560,18 @@ SearchCore(
 	    goto nextLine;
 	}
 
+	/*
+	 * A line that cannot contain an exact single-line pattern needn't be
+	 * extracted. The start line must be, since passes are counted there.
+	 */
+
+	if (quickPattern != NULL && lineNum != searchSpecPtr->startLine
+		&& !searchSpecPtr->mayMatchProc(lineNum, searchSpecPtr,
+		quickPattern)) {
+	    alreadySearchOffset = -1;
+	    goto nextLine;
+	}
+
 	/*
 	 * Extract the text from the line, storing its length in 'lastOffset'
 	 * (in bytes if exact, chars if regexp), since obviously the length is
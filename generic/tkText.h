@@ -42,7 +42,20 @@ typedef struct TkTextLine {
 				 * or not. This number is only updated
 				 * asychronously. The second of these is the
 				 * last epoch at which the pixel height was
-				 * recalculated. */
+				 * recalculated. When there is at most one
+				 * referring widget, which is by far the most
+				 * common case, this points to
+				 * staticPixelSpace. */
+    int staticPixelSpace[2];	/* Storage for the pixels array of a line
+				 * with at most one referring widget, to save
+				 * a separate allocation for every line. */
+    struct TkTextCharCheckpoints *checkpointsPtr;
+				/* Byte offsets of every few hundredth
+				 * character in the line, built on demand by
+				 * tkTextIndex.c to speed up conversions
+				 * between character and byte indices on long
+				 * lines. NULL means not computed yet; freed
+				 * whenever the contents of the line change. */
 } TkTextLine;
 
 /*
@@ -525,6 +538,8 @@ typedef struct TkSharedText {
     Tcl_Size numTags;		/* Number of tags currently defined for
 				 * widget; needed to keep track of
 				 * priorities. */
+    Tcl_Size numElideTags;	/* Number of tags in tagTable with an -elide
+				 * value. The "sel" tags are not counted. */
     Tcl_HashTable markTable;	/* Hash table that maps from mark names to
 				 * pointers to mark segments. The special
 				 * "insert" and "current" marks are not stored
@@ -550,6 +565,15 @@ typedef struct TkSharedText {
 				 * cached TkTextIndex objects are no longer
 				 * valid. */
     int imageCount;		/* Used for creating unique image names. */
+    int maxLines;		/* If positive, lines are deleted from the
+				 * beginning of the text whenever it has more
+				 * lines than this. */
+    int changedFirst, changedLast;
+				/* First and last lines (counted from 0 over
+				 * the whole text) holding text that was
+				 * inserted or deleted since the last
+				 * <<LinesChanged>> event. changedFirst is -1
+				 * when there are none. */
 
     /*
      * Information related to the undo/redo functionality.
@@ -561,6 +585,8 @@ typedef struct TkSharedText {
     int maxUndo;		/* The maximum depth of the undo stack
 				 * expressed as the maximum number of compound
 				 * statements. */
+    int maxUndoBytes;		/* The maximum number of bytes held by the
+				 * undo stack. */
     int autoSeparators;		/* Non-zero means the separators will be
 				 * inserted automatically. */
     int isDirty;		/* Flag indicating the 'dirtyness' of the
@@ -580,6 +606,10 @@ typedef struct TkSharedText {
 
     Tcl_Size undoMarkId;             /* Counts undo marks temporarily used during
 				   undo and redo operations. */
+    struct TkText *undoTextPtr;	/* Peer whose "edit undo" or "edit redo" is
+				 * in progress, NULL otherwise. */
+    Tcl_Size loadMarkId;	/* Counts the temporary marks that follow the
+				 * insertion point of "load". */
 } TkSharedText;
 
 /*
@@ -593,6 +623,39 @@ typedef enum {
     TK_TEXT_INSERT_NOFOCUS_SOLID
 } TkTextInsertUnfocussed;
 
+/*
+ * The following structure accumulates statistics about the work done for a
+ * text widget, as reported by "pathName debug stats". Times are measured in
+ * microseconds.
+ */
+
+typedef struct TkTextStats {
+    Tcl_WideInt layouts;	/* Display lines laid out. */
+    Tcl_WideInt chunks;		/* Chunks created for those lines. */
+    Tcl_WideInt styleHits;	/* Styles found in the style table. */
+    Tcl_WideInt styleMisses;	/* Styles that had to be created. */
+    Tcl_WideInt heightCalcs;	/* Display lines laid out only to compute
+				 * their height. */
+    Tcl_WideInt metricBatches;	/* Calls to TkTextUpdateLineMetrics. */
+    Tcl_WideInt metricLines;	/* Logical lines whose height was
+				 * recomputed. */
+    Tcl_WideInt redisplays;	/* Calls to DisplayText that drew. */
+    Tcl_WideInt linesRedrawn;	/* Calls to DisplayDLine. */
+    Tcl_WideInt redrawRegions;	/* Regions of the window invalidated. */
+    Tcl_WideInt copies;		/* Scrolls done by copying the window. */
+    Tcl_WideInt tagChanges;	/* Ranges tagged or untagged by the "tag"
+				 * command. */
+    Tcl_WideInt searches;	/* Calls to the "search" command. */
+    Tcl_WideInt layoutTime;	/* Time spent laying out the display lines
+				 * shown in the window. */
+    Tcl_WideInt displayTime;	/* Time spent redrawing, including any
+				 * layout it needed. */
+    Tcl_WideInt metricTime;	/* Time spent updating line metrics,
+				 * including any layout it needed. */
+    Tcl_WideInt tagTime;	/* Time spent changing tags in the B-tree. */
+    Tcl_WideInt searchTime;	/* Time spent in the "search" command. */
+} TkTextStats;
+
 /*
  * A data structure of the following type is kept for each text widget that
  * currently exists for this process:
@@ -782,10 +845,14 @@ typedef struct TkText {
     int maxUndo;		/* The maximum depth of the undo stack
 				 * expressed as the maximum number of compound
 				 * statements. */
+    int maxUndoBytes;		/* The maximum number of bytes held by the
+				 * undo stack. */
     int autoSeparators;		/* Non-zero means the separators will be
 				 * inserted automatically. */
+    int maxLines;		/* Copy of the -maxlines option. */
     Tcl_Obj *afterSyncCmd;	/* Command to be executed when lines are up to
 				 * date */
+    TkTextStats stats;		/* Statistics reported by "debug stats". */
 } TkText;
 
 /*
@@ -904,6 +971,33 @@ typedef struct TkTextElideInfo {
 				 * corresponding tagCnt is 1. */
 } TkTextElideInfo;
 
+/*
+ * The following structure is used to carry the set of tags present at a
+ * position forward while scanning the segments after it, as the display code
+ * does while laying out a line. It is set up once with a walk of the B-tree,
+ * then only the toggle segments passed need to be counted.
+ */
+
+typedef struct TkTextTagCursor {
+    TkTextLine *linePtr;	/* Line containing segPtr. */
+    TkTextSegment *segPtr;	/* First segment whose toggles haven't been
+				 * counted yet, or NULL at the end of
+				 * linePtr. */
+    Tcl_Size segOffset;		/* Byte offset of segPtr within linePtr. */
+    Tcl_Size numTags;		/* Total tags in widget. */
+    int changed;		/* Set whenever the set of tags changes;
+				 * cleared by users of the cursor. */
+    int *tagCnts;		/* Toggle count of the tag with each
+				 * priority; odd if the tag is present. */
+    TkTextTag **tagPtrs;	/* Tag with each priority, filled in once a
+				 * toggle of it has been counted. */
+    TkTextTag **activePtrs;	/* Used by TkBTreeTagCursorTags to return the
+				 * tags present. */
+    int deftagCnts[LOTSA_TAGS];
+    TkTextTag *deftagPtrs[LOTSA_TAGS];
+    TkTextTag *defactivePtrs[LOTSA_TAGS];
+} TkTextTagCursor;
+
 /*
  * The constant below is used to specify a line when what is really wanted is
  * the entire text. For now, just use a very big number.
@@ -1003,6 +1097,16 @@ MODULE_SCOPE TkTextLine *TkBTreeFindPixelLine(TkTextBTree tree,
 			    int *pixelOffset);
 MODULE_SCOPE TkTextTag **TkBTreeGetTags(const TkTextIndex *indexPtr,
 			    const TkText *textPtr, Tcl_Size *numTagsPtr);
+MODULE_SCOPE void	TkBTreeInitTagCursor(const TkText *textPtr,
+			    const TkTextIndex *indexPtr,
+			    TkTextTagCursor *cursorPtr);
+MODULE_SCOPE void	TkBTreeAdvanceTagCursor(TkTextTagCursor *cursorPtr,
+			    const TkTextIndex *indexPtr);
+MODULE_SCOPE TkTextTag **TkBTreeTagCursorTags(TkTextTagCursor *cursorPtr,
+			    const TkText *textPtr, Tcl_Size *numTagsPtr);
+MODULE_SCOPE int	TkBTreeTagCursorElided(const TkTextTagCursor *cursorPtr,
+			    Tcl_Size *priorityPtr);
+MODULE_SCOPE void	TkBTreeFreeTagCursor(TkTextTagCursor *cursorPtr);
 MODULE_SCOPE void	TkBTreeInsertChars(TkTextBTree tree,
 			    TkTextIndex *indexPtr, const char *string);
 MODULE_SCOPE int	TkBTreeLinesTo(const TkText *textPtr,
@@ -1096,6 +1200,10 @@ MODULE_SCOPE void	TkTextFreeElideInfo(TkTextElideInfo *infoPtr);
 MODULE_SCOPE int	TkTextIsElided(const TkText *textPtr,
 			    const TkTextIndex *indexPtr,
 			    TkTextElideInfo *infoPtr);
+MODULE_SCOPE TkTextLine *TkTextNextElideToggleLine(const TkText *textPtr,
+			    TkTextLine *linePtr, TkTextLine *lastPtr);
+MODULE_SCOPE TkTextLine *TkTextPrevElideToggleLine(const TkText *textPtr,
+			    TkTextLine *linePtr);
 MODULE_SCOPE int	TkTextMakePixelIndex(TkText *textPtr,
 			    int pixelIndex, TkTextIndex *indexPtr);
 MODULE_SCOPE void	TkTextInvalidateLineMetrics(
@@ -1134,6 +1242,7 @@ MODULE_SCOPE Tcl_Size TkTextSegToOffset(const TkTextSegment *segPtr,
 			    const TkTextLine *linePtr);
 MODULE_SCOPE void	TkTextSetYView(TkText *textPtr,
 			    TkTextIndex *indexPtr, int pickPlace);
+MODULE_SCOPE Tcl_WideInt TkTextStatsClock(void);
 MODULE_SCOPE int	TkTextTagCmd(TkText *textPtr, Tcl_Interp *interp,
 			    Tcl_Size objc, Tcl_Obj *const objv[]);
 MODULE_SCOPE int	TkTextImageCmd(TkText *textPtr, Tcl_Interp *interp,
@@ -94,6 +94,24 @@ typedef struct Node {
 #define MAX_CHILDREN 12
 #define MIN_CHILDREN 6
 
+/*
+ * A text holding a large file has millions of lines, and allocating each
+ * line record on its own costs an allocation header and rounding up to the
+ * allocator's size class: 64 bytes instead of 48 for every line. Line
+ * records are therefore carved out of blocks of LINES_PER_BLOCK records,
+ * which are large enough to be allocated without rounding. Freed records
+ * are kept for reuse by the same tree; the blocks themselves are only freed
+ * with the tree.
+ */
+
+#define LINES_PER_BLOCK 512
+
+typedef struct LineBlock {
+    struct LineBlock *nextPtr;	/* Next block of the same tree, or NULL. */
+    TkTextLine lines[LINES_PER_BLOCK];
+				/* The line records. */
+} LineBlock;
+
 /*
  * The data structure below defines an entire B-tree. Since text widgets are
  * the only current B-tree clients, 'clients' and 'pixelReferences' are
@@ -113,6 +131,12 @@ typedef struct BTree {
     int startEndCount;
     TkTextLine **startEnd;
     TkText **startEndRef;
+    LineBlock *lineBlockPtr;	/* Blocks the line records of the tree are
+				 * allocated from, most recent first. */
+    int numUnusedLines;		/* Number of records at the end of the most
+				 * recent block that were never used. */
+    TkTextLine *freeLinePtr;	/* Line records that were freed, linked
+				 * through their nextPtr fields. */
 } BTree;
 
 /*
@@ -149,6 +173,7 @@ int tkBTreeDebug = 0;
  * Forward declarations for functions defined in this file:
  */
 
+static TkTextLine *	AllocLine(BTree *treePtr);
 static int		AdjustPixelClient(BTree *treePtr, int defaultHeight,
 			    Node *nodePtr, TkTextLine *start, TkTextLine *end,
 			    int useReference, int newPixelReferences,
@@ -165,15 +190,21 @@ static TkTextSegment *	CharSplitProc(TkTextSegment *segPtr, Tcl_Size index);
 static void		CheckNodeConsistency(Node *nodePtr, int references);
 static void		CleanupLine(TkTextLine *linePtr);
 static void		DeleteSummaries(Summary *tagPtr);
-static void		DestroyNode(Node *nodePtr);
+static void		DestroyNode(BTree *treePtr, Node *nodePtr);
+static void		FreeLine(BTree *treePtr, TkTextLine *linePtr);
+static void		InvalidateCheckpoints(TkTextLine *linePtr);
 static TkTextSegment *	FindTagEnd(TkTextBTree tree, TkTextTag *tagPtr,
 			    TkTextIndex *indexPtr);
+static void		CountToggle(TkTextTagCursor *cursorPtr,
+			    TkTextTag *tagPtr);
 static void		IncCount(TkTextTag *tagPtr, int inc,
 			    TagInfo *tagInfoPtr);
 static void		Rebalance(BTree *treePtr, Node *nodePtr);
 static void		RecomputeNodeCounts(BTree *treePtr, Node *nodePtr);
 static void		RemovePixelClient(BTree *treePtr, Node *nodePtr,
 			    int overwriteWithLast);
+static void		ResizeLinePixels(TkTextLine *linePtr, int oldCount,
+			    int newCount);
 static TkTextSegment *	SplitSeg(TkTextIndex *indexPtr);
 static void		ToggleCheckProc(TkTextSegment *segPtr,
 			    TkTextLine *linePtr);
@@ -273,9 +304,13 @@ TkBTreeCreate(
      * of the tree.
      */
 
+    treePtr = (BTree *)ckalloc(sizeof(BTree));
+    treePtr->lineBlockPtr = NULL;
+    treePtr->numUnusedLines = 0;
+    treePtr->freeLinePtr = NULL;
     rootPtr = (Node *)ckalloc(sizeof(Node));
-    linePtr = (TkTextLine *)ckalloc(sizeof(TkTextLine));
-    linePtr2 = (TkTextLine *)ckalloc(sizeof(TkTextLine));
+    linePtr = AllocLine(treePtr);
+    linePtr2 = AllocLine(treePtr);
 
     rootPtr->parentPtr = NULL;
     rootPtr->nextPtr = NULL;
@@ -291,8 +326,6 @@ TkBTreeCreate(
      */
 
     rootPtr->numPixels = NULL;
-    linePtr->pixels = NULL;
-    linePtr2->pixels = NULL;
 
     linePtr->parentPtr = rootPtr;
     linePtr->nextPtr = linePtr2;
@@ -314,7 +347,6 @@ TkBTreeCreate(
     segPtr->body.chars[0] = '\n';
     segPtr->body.chars[1] = 0;
 
-    treePtr = (BTree *)ckalloc(sizeof(BTree));
     treePtr->sharedTextPtr = sharedTextPtr;
     treePtr->rootPtr = rootPtr;
     treePtr->clients = 0;
@@ -476,11 +508,17 @@ TkBTreeDestroy(
      * itself.
      */
 
-    DestroyNode(treePtr->rootPtr);
+    DestroyNode(treePtr, treePtr->rootPtr);
     if (treePtr->startEnd != NULL) {
 	ckfree(treePtr->startEnd);
 	ckfree(treePtr->startEndRef);
     }
+    while (treePtr->lineBlockPtr != NULL) {
+	LineBlock *blockPtr = treePtr->lineBlockPtr;
+
+	treePtr->lineBlockPtr = blockPtr->nextPtr;
+	ckfree(blockPtr);
+    }
     ckfree(treePtr);
 }
 
@@ -542,8 +580,7 @@ TkBTreeRemoveClient(
 	 * The last reference to the tree.
 	 */
 
-	DestroyNode(treePtr->rootPtr);
-	ckfree(treePtr);
+	TkBTreeDestroy(tree);
 	return;
     } else if (pixelReference == -1) {
 	/*
@@ -743,8 +780,8 @@ AdjustPixelClient(
 		*counting = 0;
 	    }
 	    if (newPixelReferences != treePtr->pixelReferences) {
-		linePtr->pixels = (int *)ckrealloc(linePtr->pixels,
-			sizeof(int) * 2 * newPixelReferences);
+		ResizeLinePixels(linePtr, treePtr->pixelReferences,
+			newPixelReferences);
 	    }
 
 	    /*
@@ -828,17 +865,159 @@ RemovePixelClient(
 		linePtr->pixels[1+2*overwriteWithLast] =
 			linePtr->pixels[1+2*(treePtr->pixelReferences-1)];
 	    }
-	    if (treePtr->pixelReferences == 1) {
-		linePtr->pixels = NULL;
-	    } else {
-		linePtr->pixels = (int *)ckrealloc(linePtr->pixels,
-			sizeof(int) * 2 * (treePtr->pixelReferences-1));
-	    }
+	    ResizeLinePixels(linePtr, treePtr->pixelReferences,
+		    treePtr->pixelReferences - 1);
 	    linePtr = linePtr->nextPtr;
 	}
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResizeLinePixels --
+ *
+ *	Changes the number of referring widgets for which a line has room in
+ *	its pixels array. Lines with room for at most one use the storage in
+ *	the line itself.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be allocated or freed. The values for the first
+ *	min(oldCount, newCount) widgets are preserved.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ResizeLinePixels(
+    TkTextLine *linePtr,	/* Line whose pixels array is to change. */
+    int oldCount,		/* Number of widgets it has room for. */
+    int newCount)		/* Number of widgets it must have room for. */
+{
+    int *pixels = linePtr->pixels;
+
+    if (newCount <= 1) {
+	if (pixels != linePtr->staticPixelSpace) {
+	    if (newCount == 1) {
+		memcpy(linePtr->staticPixelSpace, pixels, sizeof(int) * 2);
+	    }
+	    ckfree(pixels);
+	    linePtr->pixels = linePtr->staticPixelSpace;
+	}
+    } else if (pixels == linePtr->staticPixelSpace) {
+	linePtr->pixels = (int *)ckalloc(sizeof(int) * 2 * newCount);
+	if (oldCount >= 1) {
+	    memcpy(linePtr->pixels, pixels, sizeof(int) * 2);
+	}
+    } else {
+	linePtr->pixels = (int *)ckrealloc(pixels, sizeof(int) * 2 * newCount);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AllocLine --
+ *
+ *	Allocates the record of a new line of a B-tree, from the tree's free
+ *	records or line blocks (see LINES_PER_BLOCK).
+ *
+ * Results:
+ *	A line with room in its pixels array for one referring widget and no
+ *	checkpoints. The other fields are to be filled in by the caller.
+ *
+ * Side effects:
+ *	A new block of line records may be allocated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TkTextLine *
+AllocLine(
+    BTree *treePtr)		/* Tree the line will belong to. */
+{
+    TkTextLine *linePtr;
+
+    if (treePtr->freeLinePtr != NULL) {
+	linePtr = treePtr->freeLinePtr;
+	treePtr->freeLinePtr = linePtr->nextPtr;
+    } else {
+	if (treePtr->numUnusedLines == 0) {
+	    LineBlock *blockPtr = (LineBlock *)ckalloc(sizeof(LineBlock));
+
+	    blockPtr->nextPtr = treePtr->lineBlockPtr;
+	    treePtr->lineBlockPtr = blockPtr;
+	    treePtr->numUnusedLines = LINES_PER_BLOCK;
+	}
+	linePtr = &treePtr->lineBlockPtr->lines[
+		LINES_PER_BLOCK - treePtr->numUnusedLines--];
+    }
+    linePtr->pixels = linePtr->staticPixelSpace;
+    linePtr->checkpointsPtr = NULL;
+    return linePtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeLine --
+ *
+ *	Frees the storage of a line, which must already be empty of segments
+ *	and unlinked from the B-tree.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed, and the line record is kept for reuse by the tree.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreeLine(
+    BTree *treePtr,		/* Tree the line belonged to. */
+    TkTextLine *linePtr)	/* Line to free. */
+{
+    if (linePtr->pixels != linePtr->staticPixelSpace) {
+	ckfree(linePtr->pixels);
+    }
+    InvalidateCheckpoints(linePtr);
+    linePtr->nextPtr = treePtr->freeLinePtr;
+    treePtr->freeLinePtr = linePtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * InvalidateCheckpoints --
+ *
+ *	Discards the character checkpoints of a line (see tkTextIndex.c),
+ *	which must be done whenever characters are added to or removed from
+ *	it.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+InvalidateCheckpoints(
+    TkTextLine *linePtr)	/* Line whose contents change. */
+{
+    if (linePtr->checkpointsPtr != NULL) {
+	ckfree(linePtr->checkpointsPtr);
+	linePtr->checkpointsPtr = NULL;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -858,6 +1037,7 @@ RemovePixelClient(
 
 static void
 DestroyNode(
+    BTree *treePtr,	/* Tree the node belongs to. */
     Node *nodePtr)	/* Destroy from this node downwards. */
 {
     if (nodePtr->level == 0) {
@@ -872,8 +1052,7 @@ DestroyNode(
 		linePtr->segPtr = segPtr->nextPtr;
 		segPtr->typePtr->deleteProc(segPtr, linePtr, 1);
 	    }
-	    ckfree(linePtr->pixels);
-	    ckfree(linePtr);
+	    FreeLine(treePtr, linePtr);
 	}
     } else {
 	Node *childPtr;
@@ -881,7 +1060,7 @@ DestroyNode(
 	while (nodePtr->children.nodePtr != NULL) {
 	    childPtr = nodePtr->children.nodePtr;
 	    nodePtr->children.nodePtr = childPtr->nextPtr;
-	    DestroyNode(childPtr);
+	    DestroyNode(treePtr, childPtr);
 	}
     }
     DeleteSummaries(nodePtr->summaryPtr);
@@ -1044,6 +1223,7 @@ TkBTreeInsertChars(
     prevPtr = SplitSeg(indexPtr);
     linePtr = indexPtr->linePtr;
     curPtr = prevPtr;
+    InvalidateCheckpoints(linePtr);
 
     /*
      * Chop the string up into lines and create a new segment for each line,
@@ -1090,9 +1270,8 @@ TkBTreeInsertChars(
 	 * the remainder of the old line to it.
 	 */
 
-	newLinePtr = (TkTextLine *)ckalloc(sizeof(TkTextLine));
-	newLinePtr->pixels = (int *)
-		ckalloc(sizeof(int) * 2 * treePtr->pixelReferences);
+	newLinePtr = AllocLine(treePtr);
+	ResizeLinePixels(newLinePtr, 1, treePtr->pixelReferences);
 
 	newLinePtr->parentPtr = linePtr->parentPtr;
 	newLinePtr->nextPtr = linePtr->nextPtr;
@@ -1365,6 +1544,7 @@ TkBTreeDeleteIndexRange(
      */
 
     curLinePtr = index1Ptr->linePtr;
+    InvalidateCheckpoints(curLinePtr);
 
     curNodePtr = curLinePtr->parentPtr;
     while (segPtr != lastPtr) {
@@ -1423,8 +1603,7 @@ TkBTreeDeleteIndexRange(
 			checkCount++;
 		    }
 		}
-		ckfree(curLinePtr->pixels);
-		ckfree(curLinePtr);
+		FreeLine(treePtr, curLinePtr);
 	    }
 	    curLinePtr = nextLinePtr;
 	    segPtr = curLinePtr->segPtr;
@@ -1545,8 +1724,7 @@ TkBTreeDeleteIndexRange(
 		checkCount++;
 	    }
 	}
-	ckfree(index2Ptr->linePtr->pixels);
-	ckfree(index2Ptr->linePtr);
+	FreeLine(treePtr, index2Ptr->linePtr);
 
 	Rebalance((BTree *) index2Ptr->tree, curNodePtr);
     }
@@ -2083,6 +2261,9 @@ TkBTreeLinkSegment(
 	segPtr->nextPtr = prevPtr->nextPtr;
 	prevPtr->nextPtr = segPtr;
     }
+    if (segPtr->size > 0) {
+	InvalidateCheckpoints(indexPtr->linePtr);
+    }
     CleanupLine(indexPtr->linePtr);
     if (tkBTreeDebug) {
 	TkBTreeCheck(indexPtr->tree);
@@ -2133,6 +2314,9 @@ TkBTreeUnlinkSegment(
 	}
 	prevPtr->nextPtr = segPtr->nextPtr;
     }
+    if (segPtr->size > 0) {
+	InvalidateCheckpoints(linePtr);
+    }
     CleanupLine(linePtr);
 }
 
@@ -3695,6 +3879,299 @@ TkTextFreeElideInfo(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkBTreeInitTagCursor --
+ *
+ *	Set up a cursor holding the tags present at a given position, which
+ *	TkBTreeAdvanceTagCursor can then move forward cheaply. This is like
+ *	TkBTreeGetTags, except that the tags are kept in an array indexed by
+ *	priority.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The cursor is filled in. It must be freed with TkBTreeFreeTagCursor.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkBTreeInitTagCursor(
+    const TkText *textPtr,	/* Overall information about text widget. */
+    const TkTextIndex *indexPtr,/* Position at which to start. */
+    TkTextTagCursor *cursorPtr)	/* Cursor to set up. */
+{
+    Node *nodePtr;
+    TkTextLine *siblingLinePtr;
+    TkTextSegment *segPtr;
+    Tcl_Size i;
+
+    cursorPtr->numTags = textPtr->sharedTextPtr->numTags;
+    cursorPtr->tagCnts = cursorPtr->deftagCnts;
+    cursorPtr->tagPtrs = cursorPtr->deftagPtrs;
+    cursorPtr->activePtrs = cursorPtr->defactivePtrs;
+    if (LOTSA_TAGS < cursorPtr->numTags) {
+	cursorPtr->tagCnts = (int *)ckalloc(sizeof(int) * cursorPtr->numTags);
+	cursorPtr->tagPtrs = (TkTextTag **)ckalloc(
+		sizeof(TkTextTag *) * cursorPtr->numTags);
+	cursorPtr->activePtrs = (TkTextTag **)ckalloc(
+		sizeof(TkTextTag *) * cursorPtr->numTags);
+    }
+    for (i = 0; i < cursorPtr->numTags; i++) {
+	cursorPtr->tagCnts[i] = 0;
+    }
+
+    /*
+     * Record toggles for tags in lines that are predecessors of
+     * indexPtr->linePtr but under the same level-0 node.
+     */
+
+    for (siblingLinePtr = indexPtr->linePtr->parentPtr->children.linePtr;
+	    siblingLinePtr != indexPtr->linePtr;
+	    siblingLinePtr = siblingLinePtr->nextPtr) {
+	for (segPtr = siblingLinePtr->segPtr; segPtr != NULL;
+		segPtr = segPtr->nextPtr) {
+	    if ((segPtr->typePtr == &tkTextToggleOnType)
+		    || (segPtr->typePtr == &tkTextToggleOffType)) {
+		CountToggle(cursorPtr, segPtr->body.toggle.tagPtr);
+	    }
+	}
+    }
+
+    /*
+     * For each node in the ancestry of this line, record tag toggles for all
+     * siblings that precede that node.
+     */
+
+    for (nodePtr = indexPtr->linePtr->parentPtr; nodePtr->parentPtr != NULL;
+	    nodePtr = nodePtr->parentPtr) {
+	Node *siblingPtr;
+	Summary *summaryPtr;
+
+	for (siblingPtr = nodePtr->parentPtr->children.nodePtr;
+		siblingPtr != nodePtr; siblingPtr = siblingPtr->nextPtr) {
+	    for (summaryPtr = siblingPtr->summaryPtr; summaryPtr != NULL;
+		    summaryPtr = summaryPtr->nextPtr) {
+		if (summaryPtr->toggleCount & 1) {
+		    CountToggle(cursorPtr, summaryPtr->tagPtr);
+		}
+	    }
+	}
+    }
+
+    /*
+     * Finally record the toggles within the line of indexPtr but preceding
+     * it.
+     */
+
+    cursorPtr->linePtr = indexPtr->linePtr;
+    cursorPtr->segPtr = indexPtr->linePtr->segPtr;
+    cursorPtr->segOffset = 0;
+    TkBTreeAdvanceTagCursor(cursorPtr, indexPtr);
+    cursorPtr->changed = 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkBTreeAdvanceTagCursor --
+ *
+ *	Move a tag cursor forward, counting the tag toggles passed on the
+ *	way. The new position may be on a following line, as happens when
+ *	logical lines are merged through eliding of a newline.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The cursor now holds the tags present at indexPtr, which must not be
+ *	before its previous position.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkBTreeAdvanceTagCursor(
+    TkTextTagCursor *cursorPtr,	/* Cursor to move. */
+    const TkTextIndex *indexPtr)/* New position. */
+{
+    TkTextLine *linePtr = cursorPtr->linePtr;
+    TkTextSegment *segPtr = cursorPtr->segPtr;
+    Tcl_Size offset = cursorPtr->segOffset;
+
+    while (1) {
+	if (segPtr == NULL) {
+	    TkTextLine *nextPtr = TkBTreeNextLine(NULL, linePtr);
+
+	    if (nextPtr == NULL) {
+		break;
+	    }
+	    linePtr = nextPtr;
+	    segPtr = linePtr->segPtr;
+	    offset = 0;
+	    continue;
+	}
+	if ((linePtr == indexPtr->linePtr)
+		&& (offset + segPtr->size > indexPtr->byteIndex)) {
+	    break;
+	}
+	if ((segPtr->typePtr == &tkTextToggleOnType)
+		|| (segPtr->typePtr == &tkTextToggleOffType)) {
+	    CountToggle(cursorPtr, segPtr->body.toggle.tagPtr);
+	}
+	offset += segPtr->size;
+	segPtr = segPtr->nextPtr;
+    }
+    cursorPtr->linePtr = linePtr;
+    cursorPtr->segPtr = segPtr;
+    cursorPtr->segOffset = offset;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkBTreeTagCursorTags --
+ *
+ *	Return the tags present at the position of a tag cursor.
+ *
+ * Results:
+ *	The return value is an array, owned by the cursor and valid until it
+ *	is moved, of the tags present in increasing order of priority. The
+ *	number of tags is stored at *numTagsPtr.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+TkTextTag **
+TkBTreeTagCursorTags(
+    TkTextTagCursor *cursorPtr,	/* Cursor to query. */
+    const TkText *textPtr,	/* If non-NULL, then only return tags for this
+				 * text widget (when there are peer
+				 * widgets). */
+    Tcl_Size *numTagsPtr)	/* Store number of tags found. */
+{
+    Tcl_Size i, numTags = 0;
+
+    for (i = 0; i < cursorPtr->numTags; i++) {
+	if (cursorPtr->tagCnts[i] & 1) {
+	    const TkText *tagTextPtr = cursorPtr->tagPtrs[i]->textPtr;
+
+	    if (tagTextPtr==NULL || textPtr==NULL || tagTextPtr==textPtr) {
+		cursorPtr->activePtrs[numTags++] = cursorPtr->tagPtrs[i];
+	    }
+	}
+    }
+    *numTagsPtr = numTags;
+    return cursorPtr->activePtrs;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkBTreeTagCursorElided --
+ *
+ *	Tell whether the text at the position of a tag cursor is elided, as
+ *	TkTextIsElided does.
+ *
+ * Results:
+ *	Returns whether this text should be elided or not. The priority of
+ *	the tag deciding it, or -1 if there is none, is stored at
+ *	*priorityPtr if that is not NULL.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TkBTreeTagCursorElided(
+    const TkTextTagCursor *cursorPtr,
+				/* Cursor to query. */
+    Tcl_Size *priorityPtr)	/* NULL or where to store the priority of the
+				 * tag controlling the elide state. */
+{
+    Tcl_Size i;
+
+    for (i = cursorPtr->numTags - 1; i >= 0; i--) {
+	if ((cursorPtr->tagCnts[i] & 1)
+		&& (cursorPtr->tagPtrs[i]->elide >= 0)) {
+	    if (priorityPtr != NULL) {
+		*priorityPtr = i;
+	    }
+	    return cursorPtr->tagPtrs[i]->elide > 0;
+	}
+    }
+    if (priorityPtr != NULL) {
+	*priorityPtr = -1;
+    }
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkBTreeFreeTagCursor --
+ *
+ *	Free up any memory allocated by TkBTreeInitTagCursor.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory may be freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkBTreeFreeTagCursor(
+    TkTextTagCursor *cursorPtr)	/* Cursor to free. */
+{
+    if (LOTSA_TAGS < cursorPtr->numTags) {
+	ckfree(cursorPtr->tagCnts);
+	ckfree(cursorPtr->tagPtrs);
+	ckfree(cursorPtr->activePtrs);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CountToggle --
+ *
+ *	This is a utility function used by the tag cursor functions. It
+ *	counts one toggle of a tag, or an odd number of them.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The cursor is updated, and marked as changed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CountToggle(
+    TkTextTagCursor *cursorPtr,	/* Cursor to update. */
+    TkTextTag *tagPtr)		/* Handle for tag. */
+{
+    Tcl_Size priority = tagPtr->priority;
+
+    if (priority >= 0 && priority < cursorPtr->numTags) {
+	cursorPtr->tagCnts[priority]++;
+	cursorPtr->tagPtrs[priority] = tagPtr;
+	cursorPtr->changed = 1;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
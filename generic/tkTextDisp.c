@@ -302,6 +302,26 @@ typedef struct DLine {
 #define BOTTOM_LINE	8
 #define OLD_Y_INVALID  16
 
+/*
+ * Start of one display line inside a long logical line, as recorded in the
+ * checkpoint array of a TextDInfo (see DLineCheckpointStart):
+ */
+
+typedef struct DLineCheckpoint {
+    Tcl_Size byteIndex;		/* Byte index, within the logical line, of
+				 * the first character of the display line. */
+    int pixels;			/* Total height of all display lines of the
+				 * logical line above this one. */
+} DLineCheckpoint;
+
+/*
+ * Number of display lines between two consecutive checkpoints. Finding the
+ * display line of an index never lays out more than this many display lines
+ * once the checkpoints below it are known.
+ */
+
+#define DLINE_CHECKPOINT_SPACING 16
+
 /*
  * Overall display information for a text widget:
  */
@@ -422,6 +442,15 @@ typedef struct TextDInfo {
     Tcl_TimerToken scrollbarTimer;
 				/* A token pointing to the current scrollbar
 				 * update callback. */
+    TkTextLine *checkLinePtr;	/* Logical line to which the checkpoints
+				 * below belong, or NULL. */
+    DLineCheckpoint *checkpoints;
+				/* Starts of display lines number
+				 * DLINE_CHECKPOINT_SPACING, twice that, and
+				 * so on, in checkLinePtr. Allocated
+				 * dynamically; NULL if none. */
+    Tcl_Size numCheckpoints;	/* Number of valid entries in checkpoints. */
+    Tcl_Size maxCheckpoints;	/* Number of entries allocated. */
 } TextDInfo;
 
 /*
@@ -507,18 +536,6 @@ static TkTextDispChunk *baseCharChunkPtr = NULL;
 #define DLINE_UNLINK	  1
 #define DLINE_FREE_TEMP	  2
 
-/*
- * The following counters keep statistics about redisplay that can be checked
- * to see how clever this code is at reducing redisplays.
- */
-
-static int numRedisplays;	/* Number of calls to DisplayText. */
-static int linesRedrawn;	/* Number of calls to DisplayDLine. */
-static int numCopies;		/* Number of calls to XCopyArea to copy part
-				 * of the screen. */
-static int lineHeightsRecalculated;
-				/* Number of line layouts purely for height
-				 * calculation purposes.*/
 /*
  * Forward declarations for functions defined later in this file:
  */
@@ -568,7 +585,8 @@ static DLine *		FindDLine(TkText *textPtr, DLine *dlPtr,
 static void		FreeDLines(TkText *textPtr, DLine *firstPtr,
 			    DLine *lastPtr, int action);
 static void		FreeStyle(TkText *textPtr, TextStyle *stylePtr);
-static TextStyle *	GetStyle(const TkText *textPtr, const TkTextIndex *indexPtr);
+static TextStyle *	GetStyle(TkText *textPtr,
+			    TkTextTagCursor *cursorPtr);
 static void		GetXView(Tcl_Interp *interp, const TkText *textPtr,
 			    int report);
 static void		GetYView(Tcl_Interp *interp, TkText *textPtr,
@@ -614,6 +632,23 @@ static void		GenerateWidgetViewSyncEvent(TkText *textPtr, Bool InSync);
 static void		AsyncUpdateYScrollbar(void *clientData);
 static int              IsStartOfNotMergedLine(const TkText *textPtr,
 			    const TkTextIndex *indexPtr);
+static int		SameLineLayout(TkText *textPtr, TkText *peerPtr);
+static void		ShareLineMetrics(TkText *textPtr,
+			    TkTextLine *linePtr, int pixelHeight);
+static void		UpdateElidedLine(TkText *textPtr,
+			    TkTextLine *linePtr);
+static void		SkipElidedLines(TkText *textPtr,
+			    TkTextLine *linePtr, TkTextLine *lastLinePtr,
+			    TkTextIndex *indexPtr);
+static Tcl_Size		DLineCheckpointStart(TkText *textPtr,
+			    TkTextIndex *indexPtr, Tcl_Size byteIndex,
+			    int *pixelsPtr);
+static void		NoteDLineCheckpoint(TkText *textPtr,
+			    const TkTextIndex *indexPtr, Tcl_Size dlineNum,
+			    int pixels);
+static void		InvalidateDLineCheckpoints(TkText *textPtr,
+			    const TkTextIndex *index1Ptr,
+			    const TkTextIndex *index2Ptr);
 
 /*
  * Result values returned by TextGetScrollInfoObj:
@@ -624,6 +659,16 @@ static int              IsStartOfNotMergedLine(const TkText *textPtr,
 #define TKTEXT_SCROLL_UNITS	3
 #define TKTEXT_SCROLL_ERROR	4
 #define TKTEXT_SCROLL_PIXELS	5
+
+/*
+ * Longest time, in milliseconds, that AsyncUpdateLineMetrics keeps on
+ * recalculating line heights before it returns to the event loop. This is
+ * short enough for the widget to stay responsive, and long enough that the
+ * overhead of rescheduling the timer handler doesn't dominate the time
+ * taken to bring a large widget in sync.
+ */
+
+#define METRIC_UPDATE_BUDGET	15
 
 /*
  *----------------------------------------------------------------------
@@ -681,6 +726,10 @@ TkTextCreateDInfo(
     dInfoPtr->metricIndex.linePtr = NULL;
     dInfoPtr->lineUpdateTimer = NULL;
     dInfoPtr->scrollbarTimer = NULL;
+    dInfoPtr->checkLinePtr = NULL;
+    dInfoPtr->checkpoints = NULL;
+    dInfoPtr->numCheckpoints = 0;
+    dInfoPtr->maxCheckpoints = 0;
 
     textPtr->dInfoPtr = dInfoPtr;
 }
@@ -734,6 +783,9 @@ TkTextFreeDInfo(
 	textPtr->refCount--;
 	dInfoPtr->scrollbarTimer = NULL;
     }
+    if (dInfoPtr->checkpoints != NULL) {
+	ckfree(dInfoPtr->checkpoints);
+    }
     ckfree(dInfoPtr);
 }
 
@@ -743,7 +795,7 @@ TkTextFreeDInfo(
  * GetStyle --
  *
  *	This function creates all the information needed to display text at a
- *	particular location.
+ *	particular location, given by a tag cursor.
  *
  * Results:
  *	The return value is a pointer to a TextStyle structure that
@@ -757,9 +809,10 @@ TkTextFreeDInfo(
 
 static TextStyle *
 GetStyle(
-    const TkText *textPtr,		/* Overall information about text widget. */
-    const TkTextIndex *indexPtr)/* The character in the text for which display
-				 * information is wanted. */
+    TkText *textPtr,		/* Overall information about text widget. */
+    TkTextTagCursor *cursorPtr)	/* Holds the tags present at the character
+				 * for which display information is
+				 * wanted. */
 {
     TkTextTag **tagPtrs;
     TkTextTag *tagPtr;
@@ -789,7 +842,7 @@ GetStyle(
      * the tags, saving information for the highest-priority tag).
      */
 
-    tagPtrs = TkBTreeGetTags(indexPtr, textPtr, &numTags);
+    tagPtrs = TkBTreeTagCursorTags(cursorPtr, textPtr, &numTags);
     borderPrio = borderWidthPrio = reliefPrio = bgStipplePrio = -1;
     fgPrio = fontPrio = fgStipplePrio = -1;
     underlinePrio = elidePrio = justifyPrio = offsetPrio = -1;
@@ -982,9 +1035,6 @@ GetStyle(
 	    wrapPrio = tagPtr->priority;
 	}
     }
-    if (tagPtrs != NULL) {
-	ckfree(tagPtrs);
-    }
 
     /*
      * Use an existing style if there's one around that matches.
@@ -993,6 +1043,7 @@ GetStyle(
     hPtr = Tcl_CreateHashEntry(&textPtr->dInfoPtr->styleTable,
 	    (char *) &styleValues, &isNew);
     if (!isNew) {
+	textPtr->stats.styleHits++;
 	stylePtr = (TextStyle *)Tcl_GetHashValue(hPtr);
 	stylePtr->refCount++;
 	return stylePtr;
@@ -1002,6 +1053,7 @@ GetStyle(
      * No existing style matched. Make a new one.
      */
 
+    textPtr->stats.styleMisses++;
     stylePtr = (TextStyle *)ckalloc(sizeof(TextStyle));
     stylePtr->refCount = 1;
     if (styleValues.border != NULL) {
@@ -1172,7 +1224,14 @@ LayoutDLine(
     Tcl_Size byteOffset;
     int ascent, descent, code, elide, elidesize;
     StyleValues *sValuePtr;
-    TkTextElideInfo info;	/* Keep track of elide state. */
+    TkTextTagCursor cursor;	/* Keeps track of the tags present, for
+				 * styles and elide state. */
+    Tcl_Size elidePriority;	/* Priority of the tag controlling the elide
+				 * state. */
+    TextStyle *lastStylePtr;	/* Style of the last chunk, reused as long as
+				 * no tags are toggled. */
+
+    textPtr->stats.layouts++;
 
     /*
      * Create and initialize a new DLine structure.
@@ -1203,13 +1262,15 @@ LayoutDLine(
     paragraphStart = (indexPtr->byteIndex == 0);
 
     /*
-     * Special case entirely elide line as there may be 1000s or more.
+     * Special case entirely elide line as there may be 1000s or more. The
+     * tag cursor is kept up to date with the segments skipped here.
      */
 
-    elide = TkTextIsElided(textPtr, indexPtr, &info);
+    TkBTreeInitTagCursor(textPtr, indexPtr, &cursor);
+    elide = TkBTreeTagCursorElided(&cursor, &elidePriority);
     if (elide && indexPtr->byteIndex == 0) {
 	maxBytes = 0;
-	for (segPtr = info.segPtr; segPtr != NULL; segPtr = segPtr->nextPtr) {
+	for (segPtr = cursor.segPtr; segPtr != NULL; segPtr = segPtr->nextPtr) {
 	    if (segPtr->size > 0) {
 		if (elide == 0) {
 		    /*
@@ -1236,12 +1297,11 @@ LayoutDLine(
 		 * toggled off), or it's a new tag with higher priority.
 		 */
 
+		cursor.tagCnts[tagPtr->priority]++;
+		cursor.tagPtrs[tagPtr->priority] = tagPtr;
+		cursor.changed = 1;
 		if (tagPtr->elide >= 0) {
-		    info.tagCnts[tagPtr->priority]++;
-		    if (info.tagCnts[tagPtr->priority] & 1) {
-			info.tagPtrs[tagPtr->priority] = tagPtr;
-		    }
-		    if (tagPtr->priority >= info.elidePriority) {
+		    if (tagPtr->priority >= elidePriority) {
 			if (segPtr->typePtr == &tkTextToggleOffType) {
 			    /*
 			     * If it is being toggled off, and it has an elide
@@ -1249,7 +1309,7 @@ LayoutDLine(
 			     * priority tag, so this check is redundant:
 			     */
 
-			    if (tagPtr->priority != info.elidePriority) {
+			    if (tagPtr->priority != elidePriority) {
 				Tcl_Panic("Bad tag priority being toggled off");
 			    }
 
@@ -1259,20 +1319,24 @@ LayoutDLine(
 			     */
 
 			    elide = 0;
-			    while (--info.elidePriority > 0) {
-				if (info.tagCnts[info.elidePriority] & 1) {
-				    elide = info.tagPtrs[info.elidePriority]
+			    while (--elidePriority > 0) {
+				if ((cursor.tagCnts[elidePriority] & 1)
+					&& cursor.tagPtrs[elidePriority]
+					->elide >= 0) {
+				    elide = cursor.tagPtrs[elidePriority]
 					    ->elide > 0;
 				    break;
 				}
 			    }
 			} else {
 			    elide = tagPtr->elide > 0;
-			    info.elidePriority = tagPtr->priority;
+			    elidePriority = tagPtr->priority;
 			}
 		    }
 		}
 	    }
+	    cursor.segOffset += segPtr->size;
+	    cursor.segPtr = segPtr->nextPtr;
 	}
 
 	if (elide) {
@@ -1293,11 +1357,19 @@ LayoutDLine(
 			    dlPtr->index.linePtr, 0, 0);
 		}
 	    }
-	    TkTextFreeElideInfo(&info);
+	    TkBTreeFreeTagCursor(&cursor);
 	    return dlPtr;
 	}
+
+	/*
+	 * Only the start of the line is elided. The loop below lays the line
+	 * out again from its first byte, and the cursor can only move
+	 * forward, so set it up afresh.
+	 */
+
+	TkBTreeFreeTagCursor(&cursor);
+	TkBTreeInitTagCursor(textPtr, indexPtr, &cursor);
     }
-    TkTextFreeElideInfo(&info);
 
     /*
      * Each iteration of the loop below creates one TkTextDispChunk for the
@@ -1321,6 +1393,7 @@ LayoutDLine(
     wrapMode = TEXT_WRAPMODE_CHAR;
     tabSize = 0;
     lastCharChunkPtr = NULL;
+    lastStylePtr = NULL;
 
     /*
      * Find the first segment to consider for the line. Can't call
@@ -1428,10 +1501,25 @@ LayoutDLine(
 	}
 	if (chunkPtr == NULL) {
 	    chunkPtr = (TkTextDispChunk *)ckalloc(sizeof(TkTextDispChunk));
+	    textPtr->stats.chunks++;
 	    chunkPtr->nextPtr = NULL;
 	    chunkPtr->clientData = NULL;
 	}
-	chunkPtr->stylePtr = GetStyle(textPtr, &curIndex);
+
+	/*
+	 * Only compute the style again when a tag has been toggled since the
+	 * last chunk.
+	 */
+
+	TkBTreeAdvanceTagCursor(&cursor, &curIndex);
+	if (cursor.changed || lastStylePtr == NULL) {
+	    chunkPtr->stylePtr = GetStyle(textPtr, &cursor);
+	    cursor.changed = 0;
+	} else {
+	    chunkPtr->stylePtr = lastStylePtr;
+	    lastStylePtr->refCount++;
+	}
+	lastStylePtr = chunkPtr->stylePtr;
 	elide = chunkPtr->stylePtr->sValuePtr->elide;
 
 	/*
@@ -1543,6 +1631,7 @@ LayoutDLine(
 	}
 	if (code <= 0) {
 	    FreeStyle(textPtr, chunkPtr->stylePtr);
+	    lastStylePtr = NULL;
 	    if (code < 0) {
 		/*
 		 * This segment doesn't wish to display itself (e.g. most
@@ -1642,6 +1731,7 @@ LayoutDLine(
 
 	chunkPtr = NULL;
     }
+    TkBTreeFreeTagCursor(&cursor);
 #ifdef TK_LAYOUT_WITH_BASE_CHUNKS
     FinalizeBaseChunk(NULL);
 #endif /* TK_LAYOUT_WITH_BASE_CHUNKS */
@@ -1830,11 +1920,13 @@ UpdateDisplayInfo(
     TkTextIndex index;
     TkTextLine *lastLinePtr;
     int y, maxY, xPixelOffset, maxOffset, lineHeight;
+    Tcl_WideInt startTime;
 
     if (!(dInfoPtr->flags & DINFO_OUT_OF_DATE)) {
 	return;
     }
     dInfoPtr->flags &= ~DINFO_OUT_OF_DATE;
+    startTime = TkTextStatsClock();
 
     /*
      * Delete any DLines that are now above the top of the window.
@@ -2321,6 +2413,7 @@ UpdateDisplayInfo(
 	    dlPtr->flags |= OLD_Y_INVALID;
 	}
     }
+    textPtr->stats.layoutTime += TkTextStatsClock() - startTime;
 }
 
 /*
@@ -2360,7 +2453,7 @@ FreeDLines(
     DLine *nextDLinePtr;
 
     if (action == DLINE_FREE_TEMP) {
-	lineHeightsRecalculated++;
+	textPtr->stats.heightCalcs++;
 	if (tkTextDebug) {
 	    char string[TK_POS_CHARS];
 
@@ -2583,7 +2676,7 @@ DisplayDLine(
 #else
     Tk_ClipDrawableToRect(display, pixmap, 0, 0, -1, -1);
 #endif /* TK_NO_DOUBLE_BUFFERING */
-    linesRedrawn++;
+    textPtr->stats.linesRedrawn++;
 }
 
 /*
@@ -2987,10 +3080,14 @@ DisplayLineBackground(
  *	height calculations of individual lines in an asychronous manner.
  *
  *	Currently a timer-handler is used for this purpose, which continuously
- *	reschedules itself. It may well be better to use some other approach
- *	(e.g., a background thread). We can't use an idle-callback because of
- *	a known bug in Tcl/Tk in which idle callbacks are not allowed to
- *	re-schedule themselves. This just causes an effective infinite loop.
+ *	reschedules itself. Each time it runs, it updates blocks of lines
+ *	until METRIC_UPDATE_BUDGET milliseconds have gone by, so that huge
+ *	widgets get in sync quickly without making the application sluggish.
+ *	Line layout uses fonts and other resources that may only be touched
+ *	from the thread owning the widget, so it can't be moved to a
+ *	background thread. We can't use an idle-callback because of a known
+ *	bug in Tcl/Tk in which idle callbacks are not allowed to re-schedule
+ *	themselves. This just causes an effective infinite loop.
  *
  * Results:
  *	None.
@@ -3008,6 +3105,7 @@ AsyncUpdateLineMetrics(
     TkText *textPtr = (TkText *)clientData;
     TextDInfo *dInfoPtr = textPtr->dInfoPtr;
     int lineNum;
+    Tcl_Time start, now;
 
     dInfoPtr->lineUpdateTimer = NULL;
 
@@ -3042,19 +3140,56 @@ AsyncUpdateLineMetrics(
 
     /*
      * Update the lines in blocks of about 24 recalculations, or 250+ lines
-     * examined, so we pass in 256 for 'doThisMuch'.
+     * examined, so we pass in 256 for 'doThisMuch'. Keep going with further
+     * blocks while there is time left. Laying out lines may run the -create
+     * scripts of embedded windows, which could destroy the widget (and its
+     * display information), so check for that after each block.
      */
 
-    lineNum = TkTextUpdateLineMetrics(textPtr, lineNum,
-	    dInfoPtr->lastMetricUpdateLine, 256);
+    Tcl_GetTime(&start);
+    while (1) {
+	lineNum = TkTextUpdateLineMetrics(textPtr, lineNum,
+		dInfoPtr->lastMetricUpdateLine, 256);
+	if (textPtr->flags & DESTROYED) {
+	    break;
+	}
+	if (dInfoPtr->lineUpdateTimer != NULL) {
+	    /*
+	     * A -create script changed the text, which started a new round of
+	     * updates with its own timer and reference to the widget.
+	     */
 
-    dInfoPtr->currentMetricUpdateLine = lineNum;
+	    if (textPtr->refCount-- <= 1) {
+		ckfree(textPtr);
+	    }
+	    return;
+	}
 
-    if (tkTextDebug) {
-	char buffer[2 * TCL_INTEGER_SPACE + 1];
+	dInfoPtr->currentMetricUpdateLine = lineNum;
+
+	if (tkTextDebug) {
+	    char buffer[2 * TCL_INTEGER_SPACE + 1];
+
+	    snprintf(buffer, sizeof(buffer), "%d %d", lineNum, dInfoPtr->lastMetricUpdateLine);
+	    LOG("tk_textInvalidateLine", buffer);
+	}
+
+	if (dInfoPtr->metricEpoch == -1
+		&& lineNum == dInfoPtr->lastMetricUpdateLine) {
+	    break;
+	}
+	Tcl_GetTime(&now);
+	if ((now.sec - start.sec) * 1000 + (now.usec - start.usec) / 1000
+		>= METRIC_UPDATE_BUDGET) {
+	    break;
+	}
+    }
 
-	snprintf(buffer, sizeof(buffer), "%d %d", lineNum, dInfoPtr->lastMetricUpdateLine);
-	LOG("tk_textInvalidateLine", buffer);
+    if (textPtr->flags & DESTROYED) {
+	if (textPtr->refCount-- <= 1) {
+	    ckfree(textPtr);
+	}
+	return;
     }
 
     /*
@@ -3205,12 +3340,17 @@ TkTextUpdateLineMetrics(
 				 * while). */
 {
     TkTextLine *linePtr = NULL;
+    TkTextLine *elidedEndPtr = NULL;
+				/* If not NULL, the lines before this one are
+				 * elided throughout. */
     int count = 0;
     int totalLines = TkBTreeNumLines(textPtr->sharedTextPtr->tree, textPtr);
     int fullUpdateRequested = (lineNum == 0 &&
 			       endLine == totalLines &&
 			       doThisMuch == -1);
 
+    Tcl_WideInt startTime;
+
     if (totalLines == 0) {
 	/*
 	 * Empty peer widget.
@@ -3218,6 +3358,8 @@ TkTextUpdateLineMetrics(
 
 	return endLine;
     }
+    textPtr->stats.metricBatches++;
+    startTime = TkTextStatsClock();
 
     while (1) {
 
@@ -3258,6 +3400,8 @@ TkTextUpdateLineMetrics(
 	}
 
 	if (lineNum < totalLines) {
+	    int displayLines = -1;
+
 	    if (tkTextDebug) {
 		char buffer[4 * TCL_INTEGER_SPACE + 3];
 
@@ -3270,6 +3414,9 @@ TkTextUpdateLineMetrics(
 	     * Now update the line's metrics if necessary.
 	     */
 
+	    if (linePtr == elidedEndPtr) {
+		elidedEndPtr = NULL;
+	    }
 	    if (TkBTreeLinePixelEpoch(textPtr, linePtr)
 		    == textPtr->dInfoPtr->lineMetricUpdateEpoch) {
 
@@ -3278,8 +3425,11 @@ TkTextUpdateLineMetrics(
 		 * to do here.
 		 */
 
+	    } else if (elidedEndPtr != NULL) {
+		UpdateElidedLine(textPtr, linePtr);
 	    } else if (doThisMuch == -1) {
-		count += 8 * TkTextUpdateOneLine(textPtr, linePtr, 0,NULL,0);
+		displayLines = TkTextUpdateOneLine(textPtr, linePtr, 0,NULL,0);
+		count += 8 * displayLines;
 	    } else {
 		TkTextIndex index;
 		TkTextIndex *indexPtr;
@@ -3319,8 +3469,9 @@ TkTextUpdateLineMetrics(
 		 * display line we actually re-layout.
 		 */
 
-		count += 8 * TkTextUpdateOneLine(textPtr, linePtr,
+		displayLines = TkTextUpdateOneLine(textPtr, linePtr,
 			pixelHeight, indexPtr, 1);
+		count += 8 * displayLines;
 
 		if (indexPtr->linePtr == linePtr) {
 
@@ -3353,6 +3504,19 @@ TkTextUpdateLineMetrics(
 
 		textPtr->dInfoPtr->metricEpoch = -1;
 	    }
+
+	    /*
+	     * A line without any display line of non-zero height ends
+	     * elided. The lines after it, up to the next one in which an
+	     * elide tag toggles, are then elided throughout and need not be
+	     * laid out.
+	     */
+
+	    if (displayLines == 0) {
+		elidedEndPtr = TkTextNextElideToggleLine(textPtr, linePtr,
+			TkBTreeFindLine(textPtr->sharedTextPtr->tree, textPtr,
+			totalLines));
+	    }
 	} else {
 
 	    /*
@@ -3371,6 +3535,7 @@ TkTextUpdateLineMetrics(
 	     */
 
 	    lineNum = -1;
+	    elidedEndPtr = NULL;
 	}
 	count++;
 
@@ -3378,6 +3543,7 @@ TkTextUpdateLineMetrics(
 	    break;
 	}
     }
+    textPtr->stats.metricTime += TkTextStatsClock() - startTime;
     if (doThisMuch == -1) {
 
 	/*
@@ -3538,6 +3704,8 @@ TextInvalidateLineMetrics(
 	if ((++dInfoPtr->lineMetricUpdateEpoch) == 0) {
 	    dInfoPtr->lineMetricUpdateEpoch++;
 	}
+	dInfoPtr->checkLinePtr = NULL;
+	dInfoPtr->numCheckpoints = 0;
 
 	/*
 	 * This has the effect of forcing an entire new loop of update checks
@@ -3597,7 +3765,8 @@ TextInvalidateLineMetrics(
  *	time-consuming way of gathering the information we need, so this would
  *	be a good place to look to speed up the calculations. In particular
  *	these calls will map and unmap embedded windows respectively, which I
- *	would hope isn't exactly necessary!
+ *	would hope isn't exactly necessary! Layout starts at the closest
+ *	display line checkpoint of the logical line, and records new ones.
  *
  *----------------------------------------------------------------------
  */
@@ -3613,6 +3782,8 @@ TkTextFindDisplayLineEnd(
 				 * line. */
 {
     TkTextIndex index;
+    Tcl_Size dlineNum;
+    int pixels;
 
     if (!end && IsStartOfNotMergedLine(textPtr, indexPtr)) {
 	/*
@@ -3652,13 +3823,29 @@ TkTextFindDisplayLineEnd(
 	/*
 	 * indexPtr's logical line is actually merged with the previous
 	 * logical line whose eol is elided. Continue searching back to get a
-	 * real line start.
+	 * real line start. The lines above in which no elide tag toggles are
+	 * elided throughout, so go straight to the last one in which one
+	 * does.
 	 */
 
-	index = endOfLastLine;
+	index.linePtr = TkTextPrevElideToggleLine(textPtr, index.linePtr);
 	index.byteIndex = 0;
     }
 
+    /*
+     * Unless the line is merged with the previous one, there is no need to
+     * lay out the display lines from the start of the logical line: start
+     * from the closest known checkpoint instead, which matters for very long
+     * wrapped lines.
+     */
+
+    if (index.linePtr == indexPtr->linePtr) {
+	dlineNum = DLineCheckpointStart(textPtr, &index, indexPtr->byteIndex,
+		&pixels);
+    } else {
+	dlineNum = -1;
+    }
+
     while (1) {
 	DLine *dlPtr;
 	Tcl_Size byteCount;
@@ -3668,6 +3855,11 @@ TkTextFindDisplayLineEnd(
 	byteCount = dlPtr->byteCount;
 
 	TkTextIndexForwBytes(textPtr, &index, byteCount, &nextLineStart);
+	if (dlineNum >= 0) {
+	    dlineNum++;
+	    pixels += dlPtr->height;
+	    NoteDLineCheckpoint(textPtr, &nextLineStart, dlineNum, pixels);
+	}
 
 	/*
 	 * 'byteCount' goes up to the beginning of the next display line, so
@@ -3709,11 +3901,201 @@ TkTextFindDisplayLineEnd(
 	    return;
 	}
 
+	/*
+	 * A line elided from its start is laid out on its own and without
+	 * any chunks, and so is each following line up to the next one in
+	 * which an elide tag toggles. Jump over them.
+	 */
+
+	if ((dlPtr->chunkPtr == NULL)
+		&& (nextLineStart.linePtr != indexPtr->linePtr)) {
+	    nextLineStart.linePtr = TkTextNextElideToggleLine(textPtr,
+		    dlPtr->index.linePtr, indexPtr->linePtr);
+	}
 	FreeDLines(textPtr, dlPtr, NULL, DLINE_FREE_TEMP);
 	index = nextLineStart;
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * DLineCheckpointStart --
+ *
+ *	Find the closest known start of a display line at or before a given
+ *	byte index of a logical line. Every DLINE_CHECKPOINT_SPACING-th
+ *	display line start of the logical line most recently asked about is
+ *	remembered, so that display lines near the end of a very long wrapped
+ *	line can be found without laying out the whole line before them.
+ *
+ *	The logical line must not be merged with the previous one, and
+ *	indexPtr must be at its start.
+ *
+ * Results:
+ *	Moves indexPtr forward to the start of the display line found, and
+ *	returns its number within the logical line (0 for the first display
+ *	line). The total height of the display lines above it is stored in
+ *	*pixelsPtr.
+ *
+ * Side effects:
+ *	If the checkpoints were for another logical line, they are discarded.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+DLineCheckpointStart(
+    TkText *textPtr,		/* Widget record for text widget. */
+    TkTextIndex *indexPtr,	/* Start of the logical line, moved to the
+				 * checkpoint found. */
+    Tcl_Size byteIndex,		/* Byte index within the logical line. */
+    int *pixelsPtr)		/* Height above the checkpoint. */
+{
+    TextDInfo *dInfoPtr = textPtr->dInfoPtr;
+    DLineCheckpoint *checkPtr;
+    Tcl_Size low, high, middle;
+
+    if (dInfoPtr->checkLinePtr != indexPtr->linePtr) {
+	dInfoPtr->checkLinePtr = indexPtr->linePtr;
+	dInfoPtr->numCheckpoints = 0;
+    }
+
+    /*
+     * Binary search for the last checkpoint at or before byteIndex.
+     */
+
+    low = 0;
+    high = dInfoPtr->numCheckpoints;
+    while (low < high) {
+	middle = (low + high) / 2;
+	if (dInfoPtr->checkpoints[middle].byteIndex <= byteIndex) {
+	    low = middle + 1;
+	} else {
+	    high = middle;
+	}
+    }
+    if (low == 0) {
+	*pixelsPtr = 0;
+	return 0;
+    }
+    checkPtr = &dInfoPtr->checkpoints[low - 1];
+    indexPtr->byteIndex = checkPtr->byteIndex;
+    *pixelsPtr = checkPtr->pixels;
+    return low * DLINE_CHECKPOINT_SPACING;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NoteDLineCheckpoint --
+ *
+ *	Called while laying out the display lines of a logical line one after
+ *	the other, starting from a position returned by DLineCheckpointStart,
+ *	to record the next checkpoint when it is reached.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May add a checkpoint.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+NoteDLineCheckpoint(
+    TkText *textPtr,		/* Widget record for text widget. */
+    const TkTextIndex *indexPtr,/* Start of display line number dlineNum. */
+    Tcl_Size dlineNum,		/* Number of that display line within its
+				 * logical line. */
+    int pixels)			/* Total height of the display lines above
+				 * it. */
+{
+    TextDInfo *dInfoPtr = textPtr->dInfoPtr;
+
+    if (indexPtr->linePtr != dInfoPtr->checkLinePtr
+	    || dlineNum != (dInfoPtr->numCheckpoints + 1)
+	    * DLINE_CHECKPOINT_SPACING) {
+	return;
+    }
+    if (dInfoPtr->numCheckpoints == dInfoPtr->maxCheckpoints) {
+	dInfoPtr->maxCheckpoints = (dInfoPtr->maxCheckpoints == 0) ? 16
+		: 2 * dInfoPtr->maxCheckpoints;
+	dInfoPtr->checkpoints = (DLineCheckpoint *)ckrealloc(
+		dInfoPtr->checkpoints,
+		dInfoPtr->maxCheckpoints * sizeof(DLineCheckpoint));
+    }
+    dInfoPtr->checkpoints[dInfoPtr->numCheckpoints].byteIndex =
+	    indexPtr->byteIndex;
+    dInfoPtr->checkpoints[dInfoPtr->numCheckpoints].pixels = pixels;
+    dInfoPtr->numCheckpoints++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * InvalidateDLineCheckpoints --
+ *
+ *	Discard the display line checkpoints which a change to the given
+ *	range of characters may have moved. Display lines that end before
+ *	the range are not affected, except for the last of them: with word
+ *	wrapping, its end depends on the first word of the next display line.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Checkpoints are discarded.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+InvalidateDLineCheckpoints(
+    TkText *textPtr,		/* Widget record for text widget. */
+    const TkTextIndex *index1Ptr,
+				/* First character changed, or NULL for the
+				 * start of the text. */
+    const TkTextIndex *index2Ptr)
+				/* Character just after the last one changed,
+				 * or NULL for the end of the text. */
+{
+    TextDInfo *dInfoPtr = textPtr->dInfoPtr;
+    Tcl_Size num;
+    int line;
+
+    if (dInfoPtr->checkLinePtr == NULL) {
+	return;
+    }
+    if (index1Ptr != NULL
+	    && index1Ptr->linePtr == dInfoPtr->checkLinePtr) {
+	num = dInfoPtr->numCheckpoints;
+	while (num > 0 && dInfoPtr->checkpoints[num - 1].byteIndex
+		>= index1Ptr->byteIndex) {
+	    num--;
+	}
+	dInfoPtr->numCheckpoints = (num > 0) ? num - 1 : 0;
+	return;
+    }
+    if (index2Ptr != NULL && index1Ptr != NULL
+	    && index2Ptr->linePtr == index1Ptr->linePtr) {
+	return;
+    }
+
+    /*
+     * The checkpoints are kept unless their line is inside the range, as it
+     * may be about to be deleted.
+     */
+
+    line = TkBTreeLinesTo(NULL, dInfoPtr->checkLinePtr);
+    if ((index1Ptr == NULL || TkBTreeLinesTo(NULL, index1Ptr->linePtr) < line)
+	    && (index2Ptr == NULL
+	    || TkBTreeLinesTo(NULL, index2Ptr->linePtr) >= line)) {
+	dInfoPtr->checkLinePtr = NULL;
+	dInfoPtr->numCheckpoints = 0;
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -3848,14 +4230,16 @@ TkTextIndexYPixels(
 				 * distance from top of logical line to top of
 				 * index. */
 {
-    int pixelHeight;
+    int pixelHeight, pixels;
     TkTextIndex index;
+    Tcl_Size dlineNum;
     int alreadyStartOfLine = 1;
 
     /*
      * Find the index denoting the closest position being at the same time
      * the start of a logical line above indexPtr and the start of a display
-     * line.
+     * line. Rather than backing up one display line at a time, jump to the
+     * start of the logical line, which is on the first of its display lines.
      */
 
     index = *indexPtr;
@@ -3864,7 +4248,7 @@ TkTextIndexYPixels(
 	if (index.byteIndex == 0) {
 	    break;
 	}
-	TkTextIndexBackBytes(textPtr, &index, 1, &index);
+	index.byteIndex = 0;
 	alreadyStartOfLine = 0;
     }
 
@@ -3883,9 +4267,18 @@ TkTextIndexYPixels(
     /*
      * Iterate through display lines, starting at the logical line belonging
      * to index, adding up the pixel height of each such display line as we
-     * go along, until we go past 'indexPtr'.
+     * go along, until we go past 'indexPtr'. In a long logical line, start
+     * from the closest display line checkpoint.
      */
 
+    if (index.linePtr == indexPtr->linePtr) {
+	dlineNum = DLineCheckpointStart(textPtr, &index, indexPtr->byteIndex,
+		&pixels);
+	pixelHeight += pixels;
+    } else {
+	dlineNum = -1;
+    }
+
     while (1) {
 	int bytes, height, compare;
 
@@ -3909,6 +4302,11 @@ TkTextIndexYPixels(
 	if (height > 0) {
 	    pixelHeight += height;
 	}
+	if (dlineNum >= 0) {
+	    dlineNum++;
+	    pixels += height;
+	    NoteDLineCheckpoint(textPtr, &index, dlineNum, pixels);
+	}
 
 	if (compare == 0) {
 	    return pixelHeight;
@@ -3964,6 +4362,7 @@ TkTextUpdateOneLine(
     int displayLines;
     int mergedLines;
 
+    textPtr->stats.metricLines++;
     if (indexPtr == NULL) {
 	index.tree = textPtr->sharedTextPtr->tree;
 	index.linePtr = linePtr;
@@ -4106,6 +4505,10 @@ TkTextUpdateOneLine(
 	    }
 	}
 
+	if (mergedLines == 0) {
+	    ShareLineMetrics(textPtr, linePtr, pixelHeight);
+	}
+
 	if (!changed) {
 	    /*
 	     * If there's nothing to change, then we can already return.
@@ -4141,7 +4544,182 @@ TkTextUpdateOneLine(
     }
     return displayLines;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SameLineLayout --
+ *
+ *	Tell whether two peer text widgets lay out their lines identically,
+ *	because everything in their configuration on which the height of a
+ *	line depends is the same.
+ *
+ * Results:
+ *	Returns 1 if the widgets have the same layout, 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SameLineLayout(
+    TkText *textPtr,		/* Widget record for text widget. */
+    TkText *peerPtr)		/* Widget record for one of its peers. */
+{
+    TextDInfo *dInfoPtr = textPtr->dInfoPtr;
+    TextDInfo *peerInfoPtr = peerPtr->dInfoPtr;
+    Tcl_Obj *objs[3][2];
+    int i, pixels1, pixels2;
+
+    if ((textPtr->tkfont != peerPtr->tkfont)
+	    || (textPtr->wrapMode != peerPtr->wrapMode)
+	    || (textPtr->tabStyle != peerPtr->tabStyle)
+	    || (textPtr->start != peerPtr->start)
+	    || (textPtr->end != peerPtr->end)
+	    || (dInfoPtr->maxX - dInfoPtr->x
+		    != peerInfoPtr->maxX - peerInfoPtr->x)
+	    || textPtr->selTagPtr->affectsDisplayGeometry
+	    || peerPtr->selTagPtr->affectsDisplayGeometry) {
+	return 0;
+    }
+    if ((textPtr->tabOptionObj == NULL) != (peerPtr->tabOptionObj == NULL)
+	    || ((textPtr->tabOptionObj != NULL) && strcmp(
+	    Tcl_GetString(textPtr->tabOptionObj),
+	    Tcl_GetString(peerPtr->tabOptionObj)) != 0)) {
+	return 0;
+    }
+
+    objs[0][0] = textPtr->spacing1Obj;
+    objs[0][1] = peerPtr->spacing1Obj;
+    objs[1][0] = textPtr->spacing2Obj;
+    objs[1][1] = peerPtr->spacing2Obj;
+    objs[2][0] = textPtr->spacing3Obj;
+    objs[2][1] = peerPtr->spacing3Obj;
+    for (i = 0; i < 3; i++) {
+	Tk_GetPixelsFromObj(NULL, textPtr->tkwin, objs[i][0], &pixels1);
+	Tk_GetPixelsFromObj(NULL, peerPtr->tkwin, objs[i][1], &pixels2);
+	if (pixels1 != pixels2) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShareLineMetrics --
+ *
+ *	Pass the height of a logical line, just calculated by one text
+ *	widget, on to those of its peers which lay it out identically, so
+ *	that they don't have to calculate it again. Lines which contain
+ *	embedded windows are not shared, since each peer has its own
+ *	windows.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The height of the line may be updated in some peers, and their
+ *	scrollbars scheduled for update.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ShareLineMetrics(
+    TkText *textPtr,		/* Widget record for text widget. */
+    TkTextLine *linePtr,	/* Line whose height was calculated. */
+    int pixelHeight)		/* Its height. */
+{
+    TkText *peerPtr;
+    TkTextSegment *segPtr;
+
+    if (textPtr->sharedTextPtr->peers->next == NULL) {
+	return;
+    }
+    for (segPtr = linePtr->segPtr; segPtr != NULL; segPtr = segPtr->nextPtr) {
+	if (segPtr->typePtr == &tkTextEmbWindowType) {
+	    return;
+	}
+    }
+
+    for (peerPtr = textPtr->sharedTextPtr->peers; peerPtr != NULL;
+	    peerPtr = peerPtr->next) {
+	TextDInfo *peerInfoPtr = peerPtr->dInfoPtr;
+
+	if ((peerPtr == textPtr) || (peerInfoPtr == NULL)
+		|| (peerPtr->flags & (DESTROYED|OPTIONS_FREED))
+		|| (peerPtr->pixelReference < 0)
+		|| (TkBTreeLinePixelEpoch(peerPtr, linePtr)
+		== peerInfoPtr->lineMetricUpdateEpoch)
+		|| !SameLineLayout(textPtr, peerPtr)) {
+	    continue;
+	}
+	if (peerInfoPtr->metricIndex.linePtr == linePtr) {
+	    peerInfoPtr->metricEpoch = -1;
+	}
+	TkBTreeLinePixelEpoch(peerPtr, linePtr) =
+		peerInfoPtr->lineMetricUpdateEpoch;
+	if (TkBTreeLinePixelCount(peerPtr, linePtr) != pixelHeight) {
+	    TkBTreeAdjustPixelHeight(peerPtr, linePtr, pixelHeight, 0);
+	    if (peerInfoPtr->scrollbarTimer == NULL) {
+		peerPtr->refCount++;
+		peerInfoPtr->scrollbarTimer = Tcl_CreateTimerHandler(200,
+			AsyncUpdateYScrollbar, peerPtr);
+	    }
+	}
+    }
+}
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * UpdateElidedLine --
+ *
+ *	Bring the height of a logical line that is elided throughout up to
+ *	date. This is what TkTextUpdateOneLine would find, without laying the
+ *	line out: such a line has no height.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The line's height is set to zero, and the scrollbar update scheduled
+ *	if that changed it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UpdateElidedLine(
+    TkText *textPtr,		/* Widget record for text widget. */
+    TkTextLine *linePtr)	/* Line elided from start to end. */
+{
+    int pixelHeight;
+
+    TkBTreeLinePixelEpoch(textPtr, linePtr)
+	    = textPtr->dInfoPtr->lineMetricUpdateEpoch;
+    if (TkBTreeLinePixelCount(textPtr, linePtr) == 0) {
+	return;
+    }
+    pixelHeight = TkBTreeAdjustPixelHeight(textPtr, linePtr, 0, 0);
+
+    if (tkTextDebug) {
+	char buffer[2 * TCL_INTEGER_SPACE + 1];
+
+	snprintf(buffer, sizeof(buffer), "%d %d", TkBTreeLinesTo(textPtr,linePtr), pixelHeight);
+	LOG("tk_textNumPixels", buffer);
+    }
+    if (textPtr->dInfoPtr->scrollbarTimer == NULL) {
+	textPtr->refCount++;
+	textPtr->dInfoPtr->scrollbarTimer = Tcl_CreateTimerHandler(200,
+		AsyncUpdateYScrollbar, textPtr);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -4174,6 +4752,8 @@ DisplayText(
     Tcl_Interp *interp;
     int padX, padY;
     int borderWidth, highlightWidth;
+    Tcl_WideInt startTime = 0;	/* Initialization needed only to stop
+				 * compiler warnings. */
 
 
     if ((textPtr->tkwin == NULL) || (textPtr->flags & DESTROYED)) {
@@ -4197,7 +4777,8 @@ DisplayText(
 	dInfoPtr->flags &= ~REDRAW_PENDING;
 	goto doScrollbars;
     }
-    numRedisplays++;
+    textPtr->stats.redisplays++;
+    startTime = TkTextStatsClock();
     if (tkTextDebug) {
 	CLEAR("tk_textRedraw");
     }
@@ -4354,7 +4935,7 @@ DisplayText(
 	    TextInvalidateRegion(textPtr, damageRgn);
 #endif
 	}
-	numCopies++;
+	textPtr->stats.copies++;
 	TkDestroyRegion(damageRgn);
     }
 
@@ -4631,6 +5212,7 @@ DisplayText(
 		dInfoPtr->topOfEof-bottomY, 0, TK_RELIEF_FLAT);
     }
     dInfoPtr->topOfEof = bottomY;
+    textPtr->stats.displayTime += TkTextStatsClock() - startTime;
 
     /*
      * Update the vertical scrollbar, if there is one. Note: it's important to
@@ -4774,6 +5356,8 @@ TextInvalidateRegion(
     int padX, padY;
     int borderWidth, highlightWidth;
 
+    textPtr->stats.redrawRegions++;
+
     /*
      * Find all lines that overlap the given region and mark them for
      * redisplay.
@@ -4885,6 +5469,7 @@ TextChanged(
 	Tcl_DoWhenIdle(DisplayText, textPtr);
     }
     dInfoPtr->flags |= REDRAW_PENDING|DINFO_OUT_OF_DATE|REPICK_NEEDED;
+    InvalidateDLineCheckpoints(textPtr, index1Ptr, index2Ptr);
 
     /*
      * Find the DLines corresponding to index1Ptr and index2Ptr. There is one
@@ -5063,6 +5648,7 @@ TextRedrawTag(
 	}
 	TkTextInvalidateLineMetrics(NULL, textPtr, startLine, lineCount,
 		TK_TEXT_INVALIDATE_ONLY);
+	InvalidateDLineCheckpoints(textPtr, index1Ptr, index2Ptr);
     }
 
     /*
@@ -5249,6 +5835,8 @@ TkTextRelayoutWindow(
 
     FreeDLines(textPtr, dInfoPtr->dLinePtr, NULL, DLINE_UNLINK);
     dInfoPtr->dLinePtr = NULL;
+    dInfoPtr->checkLinePtr = NULL;
+    dInfoPtr->numCheckpoints = 0;
 
     /*
      * Recompute some overall things for the layout. Even if the window gets
@@ -5573,6 +6161,10 @@ TkTextMeasureDown(
 	}
 	distance -= dlPtr->height;
 	TkTextIndexForwBytes(textPtr, srcPtr, dlPtr->byteCount, &loop);
+	if ((distance > 0) && (dlPtr->chunkPtr == NULL)) {
+	    SkipElidedLines(textPtr, dlPtr->index.linePtr, lastLinePtr,
+		    &loop);
+	}
 	FreeDLines(textPtr, dlPtr, NULL, DLINE_FREE_TEMP);
 	if (loop.linePtr == lastLinePtr) {
 	    break;
@@ -5583,6 +6175,49 @@ TkTextMeasureDown(
     return distance;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * SkipElidedLines --
+ *
+ *	Given a line elided from its start, which is laid out as a single
+ *	display line without height, skip the following lines that are
+ *	elided throughout in the same way, up to the next line in which an
+ *	elide tag toggles.
+ *
+ * Results:
+ *	*indexPtr, the start of the line after linePtr, is moved to the start
+ *	of that line. If there is none before lastLinePtr, it is moved to the
+ *	start of the line just before lastLinePtr instead, which is where
+ *	going through the lines one by one would stop.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static void
+SkipElidedLines(
+    TkText *textPtr,		/* Text widget in which to skip. */
+    TkTextLine *linePtr,	/* Line elided from its start. */
+    TkTextLine *lastLinePtr,	/* Last (artificial) line of the widget. */
+    TkTextIndex *indexPtr)	/* Start of the line after linePtr. */
+{
+    TkTextLine *nextPtr;
+
+    if (indexPtr->linePtr == lastLinePtr) {
+	return;
+    }
+    nextPtr = TkTextNextElideToggleLine(textPtr, linePtr, lastLinePtr);
+    if (nextPtr == lastLinePtr) {
+	nextPtr = TkBTreeFindLine(indexPtr->tree, textPtr,
+		TkBTreeLinesTo(textPtr, lastLinePtr) - 1);
+    }
+    indexPtr->linePtr = nextPtr;
+    indexPtr->byteIndex = 0;
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -5628,6 +6263,12 @@ MeasureUp(
 				 * current line. */
     TkTextIndex index;
     DLine *dlPtr, *lowestPtr;
+    TkTextLine *elidedPtr;	/* Line just laid out, if it is elided from
+				 * its start. */
+    Tcl_Size segStart = 0;	/* Byte index at which the part of the line
+				 * laid out last started, if it was laid out
+				 * from a display line checkpoint. */
+    int pixels;
 
     bytesToCount = srcPtr->byteIndex + 1;
     index.tree = srcPtr->tree;
@@ -5640,12 +6281,33 @@ MeasureUp(
 	 * through srcPtr (bytesToCount is non-infinite to accomplish this).
 	 * Make a list of all the display lines in backwards order (the lowest
 	 * DLine on the screen is first in the list).
+	 *
+	 * If that first line is a long wrapped line, only the display lines
+	 * from the closest checkpoint up are laid out at first, and the parts
+	 * above, from one checkpoint to the next, only as far as needed.
 	 */
 
-	index.linePtr = TkBTreeFindLine(srcPtr->tree, textPtr, lineNum);
-	index.byteIndex = 0;
-	TkTextFindDisplayLineEnd(textPtr, &index, 0, NULL);
-	lineNum = TkBTreeLinesTo(textPtr, index.linePtr);
+	if (segStart > 0) {
+	    bytesToCount = segStart;
+	    index.linePtr = srcPtr->linePtr;
+	    index.byteIndex = 0;
+	    (void) DLineCheckpointStart(textPtr, &index, segStart - 1,
+		    &pixels);
+	    bytesToCount -= index.byteIndex;
+	    segStart = index.byteIndex;
+	    lineNum++;
+	} else {
+	    index.linePtr = TkBTreeFindLine(srcPtr->tree, textPtr, lineNum);
+	    index.byteIndex = 0;
+	    TkTextFindDisplayLineEnd(textPtr, &index, 0, NULL);
+	    lineNum = TkBTreeLinesTo(textPtr, index.linePtr);
+	    if (bytesToCount != INT_MAX && index.linePtr == srcPtr->linePtr) {
+		(void) DLineCheckpointStart(textPtr, &index,
+			srcPtr->byteIndex, &pixels);
+		bytesToCount -= index.byteIndex;
+		segStart = index.byteIndex;
+	    }
+	}
 	lowestPtr = NULL;
 	do {
 	    dlPtr = LayoutDLine(textPtr, &index);
@@ -5692,11 +6354,26 @@ MeasureUp(
 	 * next display line to lay out.
 	 */
 
+	elidedPtr = NULL;
+	if ((segStart == 0) && (lowestPtr->nextPtr == NULL)
+		&& (lowestPtr->chunkPtr == NULL)) {
+	    elidedPtr = lowestPtr->index.linePtr;
+	}
 	FreeDLines(textPtr, lowestPtr, NULL, DLINE_FREE);
 	if (distance <= 0) {
 	    return;
 	}
 	bytesToCount = INT_MAX;		/* Consider all chars. in next line. */
+
+	/*
+	 * The lines above an elided one, up to the last one in which an
+	 * elide tag toggles, are elided throughout and have no height.
+	 */
+
+	if ((elidedPtr != NULL) && (lineNum > 0)) {
+	    lineNum = TkBTreeLinesTo(textPtr,
+		    TkTextPrevElideToggleLine(textPtr, elidedPtr)) + 1;
+	}
     }
 
     /*
@@ -6040,7 +6717,7 @@ YScrollByLines(
 {
     int i, bytesToCount, lineNum;
     TkTextIndex newIdx, index;
-    TkTextLine *lastLinePtr;
+    TkTextLine *lastLinePtr, *elidedPtr;
     TextDInfo *dInfoPtr = textPtr->dInfoPtr;
     DLine *dlPtr, *lowestPtr;
 
@@ -6100,11 +6777,38 @@ YScrollByLines(
 	     * the next display line to lay out.
 	     */
 
+	    elidedPtr = NULL;
+	    if ((lowestPtr->nextPtr == NULL) && (lowestPtr->chunkPtr == NULL)) {
+		elidedPtr = lowestPtr->index.linePtr;
+	    }
 	    FreeDLines(textPtr, lowestPtr, NULL, DLINE_FREE);
 	    if (offset >= 0) {
 		goto scheduleUpdate;
 	    }
 	    bytesToCount = INT_MAX;
+
+	    /*
+	     * Each line above an elided one, up to the last one in which an
+	     * elide tag toggles, is elided throughout and makes a single
+	     * display line without height. Count them all at once.
+	     */
+
+	    if ((elidedPtr != NULL) && (lineNum > 0)) {
+		int skip = lineNum - 1 - TkBTreeLinesTo(textPtr,
+			TkTextPrevElideToggleLine(textPtr, elidedPtr));
+
+		if (offset + skip >= 0) {
+		    TkTextMakeByteIndex(textPtr->sharedTextPtr->tree, textPtr,
+			    lineNum + offset, 0, &textPtr->topIndex);
+		    if (!IsStartOfNotMergedLine(textPtr, &textPtr->topIndex)) {
+			TkTextFindDisplayLineEnd(textPtr, &textPtr->topIndex,
+				0, NULL);
+		    }
+		    goto scheduleUpdate;
+		}
+		offset += skip;
+		lineNum -= skip;
+	    }
 	}
 
 	/*
@@ -6132,6 +6836,10 @@ YScrollByLines(
 	    dlPtr->nextPtr = NULL;
 	    TkTextIndexForwBytes(textPtr, &textPtr->topIndex,
 		    dlPtr->byteCount, &newIdx);
+	    if (dlPtr->chunkPtr == NULL) {
+		SkipElidedLines(textPtr, dlPtr->index.linePtr, lastLinePtr,
+			&newIdx);
+	    }
 	    FreeDLines(textPtr, dlPtr, NULL, DLINE_FREE);
 	    if (newIdx.linePtr == lastLinePtr) {
 		break;
@@ -6591,6 +7299,7 @@ GetYPixelCount(
 				 * index. */
 {
     TkTextLine *linePtr = dlPtr->index.linePtr;
+    TkTextIndex index;
     int count;
 
     /*
@@ -6610,6 +7319,21 @@ GetYPixelCount(
 	return count;
     }
 
+    /*
+     * If the logical line is not merged with the previous one, measure down
+     * to dlPtr from the closest display line checkpoint of the line. This
+     * keeps scrolling through a very long wrapped line from laying out all
+     * of it each time.
+     */
+
+    index.tree = dlPtr->index.tree;
+    index.linePtr = linePtr;
+    index.byteIndex = 0;
+    index.textPtr = NULL;
+    if (IsStartOfNotMergedLine(textPtr, &index)) {
+	return TkTextIndexYPixels(textPtr, &dlPtr->index);
+    }
+
     /*
      * Add on the logical line's height to reach one pixel beyond the bottom
      * of the logical line. And then subtract off the heights of all the
@@ -6619,8 +7343,8 @@ GetYPixelCount(
      * logical line until we reach dlPtr, but since none of those are
      * pre-calculated, it'll usually take a lot longer. (But there are cases
      * where it would be more efficient: say if we're on the second of 1000
-     * wrapped lines all from a single logical line - but that sort of
-     * optimization is left for the future).
+     * wrapped lines all from a single logical line - that case is handled
+     * above for lines which are not merged).
      */
 
     count += TkBTreeLinePixelCount(textPtr, linePtr);
@@ -6636,7 +7360,6 @@ GetYPixelCount(
 	     * dlPtr to the line-start? We just assume the former.
 	     */
 
-	    TkTextIndex index;
 	    int notFirst = 0;
 
 	    while (1) {
@@ -25,6 +25,30 @@
 
 #define LAST_CHAR 1000000
 
+/*
+ * Number of characters between two checkpoints of a line. Conversions between
+ * character and byte indices within the first checkpoint interval of a line
+ * are done by simply walking the line, without building checkpoints.
+ */
+
+#define CHECKPOINT_SPACING 256
+
+/*
+ * The checkpoints of a line, which record the byte offset of every
+ * CHECKPOINT_SPACING'th character (as counted by "line.char" indices, so
+ * embedded windows and images count as one character each). The structure
+ * is owned by the line, see the checkpointsPtr field of TkTextLine.
+ */
+
+typedef struct TkTextCharCheckpoints {
+    Tcl_Size numChars;		/* Total number of characters in the line,
+				 * including the terminating newline. */
+    Tcl_Size numBytes;		/* Total number of bytes in the line. */
+    Tcl_Size offsets[TKFLEXARRAY];
+				/* offsets[i] is the byte offset of character
+				 * i * CHECKPOINT_SPACING. */
+} TkTextCharCheckpoints;
+
 /*
  * Modifiers for index parsing: 'display', 'any' or nothing.
  */
@@ -47,6 +71,15 @@ static int		GetIndex(Tcl_Interp *interp, TkSharedText *sharedPtr,
 static int              IndexCountBytesOrdered(const TkText *textPtr,
 			    const TkTextIndex *indexPtr1,
 			    const TkTextIndex *indexPtr2);
+static TkTextCharCheckpoints *GetCharCheckpoints(TkTextLine *linePtr);
+static int		WorthCheckpoints(TkTextLine *linePtr,
+			    TkTextSegment *segPtr, Tcl_Size byteOffset);
+static Tcl_Size		CheckpointByteToChar(TkTextLine *linePtr,
+			    const TkTextCharCheckpoints *cpPtr,
+			    Tcl_Size byteIndex);
+static Tcl_Size		CheckpointCharToByte(TkTextLine *linePtr,
+			    const TkTextCharCheckpoints *cpPtr,
+			    Tcl_Size charIndex);
 
 /*
  * The "textindex" Tcl_Obj definition:
@@ -503,6 +536,23 @@ TkTextMakeCharIndex(
 	charIndex = 0;
     }
 
+    /*
+     * Far into a line, start from the nearest checkpoint rather than walking
+     * the whole line.
+     */
+
+    if (charIndex >= CHECKPOINT_SPACING) {
+	TkTextCharCheckpoints *cpPtr = GetCharCheckpoints(indexPtr->linePtr);
+
+	if (charIndex >= cpPtr->numChars) {
+	    indexPtr->byteIndex = cpPtr->numBytes - sizeof(char);
+	} else {
+	    indexPtr->byteIndex = CheckpointCharToByte(indexPtr->linePtr,
+		    cpPtr, charIndex);
+	}
+	return indexPtr;
+    }
+
     /*
      * Verify that the index is within the range of the line. If not, just use
      * the index of the last character in the line.
@@ -1107,6 +1157,15 @@ TkTextPrintIndex(
     charIndex = 0;
     linePtr = indexPtr->linePtr;
 
+    if (numBytes >= CHECKPOINT_SPACING) {
+	TkTextCharCheckpoints *cpPtr = GetCharCheckpoints(linePtr);
+
+	if (numBytes < cpPtr->numBytes) {
+	    charIndex = CheckpointByteToChar(linePtr, cpPtr, numBytes);
+	    goto done;
+	}
+    }
+
     for (segPtr = linePtr->segPtr; ; segPtr = segPtr->nextPtr) {
 	if (segPtr == NULL) {
 	    /*
@@ -1134,6 +1193,7 @@ TkTextPrintIndex(
 	charIndex += numBytes;
     }
 
+  done:
     return snprintf(string, TK_POS_CHARS, "%d.%" TCL_SIZE_MODIFIER "d",
 	    TkBTreeLinesTo(textPtr, indexPtr->linePtr) + 1, charIndex);
 }
@@ -1591,6 +1651,34 @@ TkTextIndexForwChars(
     }
 
     while (1) {
+	/*
+	 * When counting plain indices a long way into a long line, use the
+	 * line's checkpoints to skip over its characters. Short lines are
+	 * simply walked, so that crossing many of them doesn't build
+	 * checkpoints for each.
+	 */
+
+	if (!checkElided && (type & COUNT_INDICES)
+		&& (charCount >= CHECKPOINT_SPACING)
+		&& WorthCheckpoints(dstPtr->linePtr, segPtr, byteOffset)) {
+	    TkTextCharCheckpoints *cpPtr = GetCharCheckpoints(dstPtr->linePtr);
+
+	    if (dstPtr->byteIndex < cpPtr->numBytes) {
+		Tcl_Size charIndex = CheckpointByteToChar(dstPtr->linePtr,
+			cpPtr, dstPtr->byteIndex) + charCount;
+
+		if (charIndex < cpPtr->numChars) {
+		    dstPtr->byteIndex = CheckpointCharToByte(dstPtr->linePtr,
+			    cpPtr, charIndex);
+		    goto forwardCharDone;
+		}
+		charCount = (int)(charIndex - cpPtr->numChars);
+		dstPtr->byteIndex = cpPtr->numBytes;
+		byteOffset = 0;
+		segPtr = NULL;
+	    }
+	}
+
 	/*
 	 * Go through each segment in line looking for specified character
 	 * index.
@@ -1687,6 +1775,17 @@ TkTextIndexForwChars(
 	    dstPtr->byteIndex -= sizeof(char);
 	    goto forwardCharDone;
 	}
+
+	/*
+	 * Lines in the middle of an elided range cannot change the count, so
+	 * jump straight to the next line where an elide tag toggles.
+	 */
+
+	if (elide) {
+	    linePtr = TkTextNextElideToggleLine(textPtr, dstPtr->linePtr,
+		    TkBTreeFindLine(dstPtr->tree, textPtr,
+		    TkBTreeNumLines(dstPtr->tree, textPtr)));
+	}
 	dstPtr->linePtr = linePtr;
 	dstPtr->byteIndex = 0;
 	segPtr = dstPtr->linePtr->segPtr;
@@ -1966,7 +2065,12 @@ TkTextIndexCount(
 	 * one byte (for the terminal '\n' character) and return that index.
 	 */
 
-	linePtr1 = TkBTreeNextLine(textPtr, linePtr1);
+	if (elide && (linePtr1 != indexPtr2->linePtr)) {
+	    linePtr1 = TkTextNextElideToggleLine(textPtr, linePtr1,
+		    indexPtr2->linePtr);
+	} else {
+	    linePtr1 = TkBTreeNextLine(textPtr, linePtr1);
+	}
 	if (linePtr1 == NULL) {
 	    Tcl_Panic("Reached end of text widget when counting characters");
 	}
@@ -2107,6 +2211,30 @@ TkTextIndexBackChars(
 
     lineIndex = -1;
 
+    /*
+     * When counting plain indices back to a place far into the same line,
+     * use the line's checkpoints rather than walking the characters, if
+     * there are enough characters before the index to make that worth it.
+     */
+
+    if (!checkElided && (type & COUNT_INDICES)
+	    && (charCount >= CHECKPOINT_SPACING)
+	    && (dstPtr->byteIndex >= CHECKPOINT_SPACING
+	    || dstPtr->linePtr->checkpointsPtr != NULL)) {
+	TkTextCharCheckpoints *cpPtr = GetCharCheckpoints(dstPtr->linePtr);
+
+	if (dstPtr->byteIndex < cpPtr->numBytes) {
+	    Tcl_Size charIndex = CheckpointByteToChar(dstPtr->linePtr, cpPtr,
+		    dstPtr->byteIndex);
+
+	    if (charIndex >= charCount) {
+		dstPtr->byteIndex = CheckpointCharToByte(dstPtr->linePtr,
+			cpPtr, charIndex - charCount);
+		return;
+	    }
+	}
+    }
+
     segSize = dstPtr->byteIndex;
 
     if (checkElided) {
@@ -2246,8 +2374,15 @@ TkTextIndexBackChars(
 	    dstPtr->byteIndex = 0;
 	    goto backwardCharDone;
 	}
-	lineIndex--;
-	dstPtr->linePtr = TkBTreeFindLine(dstPtr->tree, textPtr, lineIndex);
+	if (elide) {
+	    dstPtr->linePtr = TkTextPrevElideToggleLine(textPtr,
+		    dstPtr->linePtr);
+	    lineIndex = TkBTreeLinesTo(textPtr, dstPtr->linePtr);
+	} else {
+	    lineIndex--;
+	    dstPtr->linePtr = TkBTreeFindLine(dstPtr->tree, textPtr,
+		    lineIndex);
+	}
 
 	/*
 	 * Compute the length of the line and add that to dstPtr->byteIndex.
@@ -2269,6 +2404,364 @@ TkTextIndexBackChars(
     }
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * WorthCheckpoints --
+ *
+ *	Decides whether to move forward through a line with its checkpoints:
+ *	either the line already has them, or at least CHECKPOINT_SPACING
+ *	bytes of it remain after the given position.
+ *
+ * Results:
+ *	1 if the checkpoints should be used, 0 if the line should be walked.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+WorthCheckpoints(
+    TkTextLine *linePtr,	/* Line to move through. */
+    TkTextSegment *segPtr,	/* Segment of the line holding the position. */
+    Tcl_Size byteOffset)	/* Offset of the position in segPtr. */
+{
+    Tcl_Size numBytes = -byteOffset;
+
+    if (linePtr->checkpointsPtr != NULL) {
+	return 1;
+    }
+    for ( ; segPtr != NULL; segPtr = segPtr->nextPtr) {
+	numBytes += segPtr->size;
+	if (numBytes >= CHECKPOINT_SPACING) {
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * GetCharCheckpoints --
+ *
+ *	Returns the checkpoints of a line, computing them if necessary.
+ *
+ * Results:
+ *	A pointer to the checkpoints, which remain owned by the line and are
+ *	valid until its contents change.
+ *
+ * Side effects:
+ *	The first call after the line has changed walks the whole line and
+ *	allocates memory.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static TkTextCharCheckpoints *
+GetCharCheckpoints(
+    TkTextLine *linePtr)	/* Line whose checkpoints are wanted. */
+{
+    TkTextCharCheckpoints *cpPtr = linePtr->checkpointsPtr;
+    TkTextSegment *segPtr;
+    Tcl_Size numChars = 0, numBytes = 0, i, n;
+    const char *p, *start, *end;
+    int ch;
+
+    if (cpPtr != NULL) {
+	return cpPtr;
+    }
+
+    for (segPtr = linePtr->segPtr; segPtr != NULL; segPtr = segPtr->nextPtr) {
+	if (segPtr->typePtr == &tkTextCharType) {
+	    numChars += Tcl_NumUtfChars(segPtr->body.chars, segPtr->size);
+	} else {
+	    numChars += segPtr->size;
+	}
+	numBytes += segPtr->size;
+    }
+
+    cpPtr = (TkTextCharCheckpoints *)ckalloc(
+	    offsetof(TkTextCharCheckpoints, offsets) + sizeof(Tcl_Size)
+	    * ((numChars + CHECKPOINT_SPACING - 1) / CHECKPOINT_SPACING));
+    cpPtr->numChars = numChars;
+    cpPtr->numBytes = numBytes;
+
+    numChars = numBytes = 0;
+    for (segPtr = linePtr->segPtr; segPtr != NULL; segPtr = segPtr->nextPtr) {
+	if (segPtr->typePtr == &tkTextCharType) {
+	    start = segPtr->body.chars;
+	    end = start + segPtr->size;
+	    for (p = start; p < end; p += Tcl_UtfToUniChar(p, &ch)) {
+		if (numChars % CHECKPOINT_SPACING == 0
+			&& numChars < cpPtr->numChars) {
+		    cpPtr->offsets[numChars / CHECKPOINT_SPACING] =
+			    numBytes + (p - start);
+		}
+		numChars++;
+	    }
+	} else {
+	    for (i = 0, n = segPtr->size; i < n; i++, numChars++) {
+		if (numChars % CHECKPOINT_SPACING == 0) {
+		    cpPtr->offsets[numChars / CHECKPOINT_SPACING] =
+			    numBytes + i;
+		}
+	    }
+	}
+	numBytes += segPtr->size;
+    }
+
+    linePtr->checkpointsPtr = cpPtr;
+    return cpPtr;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * CheckpointCharToByte, CheckpointByteToChar --
+ *
+ *	Convert between character and byte offsets within a line, starting
+ *	from the closest preceding checkpoint. The offset to convert must
+ *	refer to a character of the line (i.e. be less than cpPtr->numChars
+ *	or cpPtr->numBytes respectively).
+ *
+ * Results:
+ *	The byte (respectively character) offset within the line.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static Tcl_Size
+CheckpointCharToByte(
+    TkTextLine *linePtr,	/* Line the offset refers to. */
+    const TkTextCharCheckpoints *cpPtr,
+				/* Checkpoints of linePtr. */
+    Tcl_Size charIndex)		/* Character offset to convert. */
+{
+    TkTextSegment *segPtr;
+    Tcl_Size byteIndex, segStart, count;
+    const char *p, *end;
+    int ch;
+
+    byteIndex = cpPtr->offsets[charIndex / CHECKPOINT_SPACING];
+    count = charIndex % CHECKPOINT_SPACING;
+    segStart = 0;
+    for (segPtr = linePtr->segPtr; segStart + segPtr->size <= byteIndex;
+	    segPtr = segPtr->nextPtr) {
+	segStart += segPtr->size;
+    }
+
+    while (count > 0) {
+	if (segPtr->typePtr == &tkTextCharType) {
+	    p = segPtr->body.chars + (byteIndex - segStart);
+	    end = segPtr->body.chars + segPtr->size;
+	    for ( ; count > 0 && p < end; count--) {
+		p += Tcl_UtfToUniChar(p, &ch);
+	    }
+	    byteIndex = segStart + (p - segPtr->body.chars);
+	} else if (count < segStart + segPtr->size - byteIndex) {
+	    byteIndex += count;
+	    count = 0;
+	} else {
+	    count -= segStart + segPtr->size - byteIndex;
+	    byteIndex = segStart + segPtr->size;
+	}
+	segStart += segPtr->size;
+	segPtr = segPtr->nextPtr;
+    }
+    return byteIndex;
+}
+
+static Tcl_Size
+CheckpointByteToChar(
+    TkTextLine *linePtr,	/* Line the offset refers to. */
+    const TkTextCharCheckpoints *cpPtr,
+				/* Checkpoints of linePtr. */
+    Tcl_Size byteIndex)		/* Byte offset to convert. */
+{
+    TkTextSegment *segPtr;
+    Tcl_Size low, high, mid, pos, stop, segStart, charIndex;
+
+    /*
+     * Find the last checkpoint at or before byteIndex.
+     */
+
+    low = 0;
+    high = (cpPtr->numChars - 1) / CHECKPOINT_SPACING;
+    while (low < high) {
+	mid = (low + high + 1) / 2;
+	if (cpPtr->offsets[mid] <= byteIndex) {
+	    low = mid;
+	} else {
+	    high = mid - 1;
+	}
+    }
+    charIndex = low * CHECKPOINT_SPACING;
+    pos = cpPtr->offsets[low];
+
+    segStart = 0;
+    for (segPtr = linePtr->segPtr; segStart + segPtr->size <= pos;
+	    segPtr = segPtr->nextPtr) {
+	segStart += segPtr->size;
+    }
+
+    while (pos < byteIndex) {
+	stop = segStart + segPtr->size;
+	if (stop > byteIndex) {
+	    stop = byteIndex;
+	}
+	if (segPtr->typePtr == &tkTextCharType) {
+	    charIndex += Tcl_NumUtfChars(segPtr->body.chars + (pos - segStart),
+		    stop - pos);
+	} else {
+	    charIndex += stop - pos;
+	}
+	pos = stop;
+	segStart += segPtr->size;
+	segPtr = segPtr->nextPtr;
+    }
+    return charIndex;
+}
+
+/*
+ *---------------------------------------------------------------------------
+ *
+ * TkTextNextElideToggleLine, TkTextPrevElideToggleLine --
+ *
+ *	Used while walking through an elided range, to skip the lines in
+ *	which no tag with an -elide value toggles: those lines are elided
+ *	from start to end and cannot change the elide state. The display code
+ *	uses them in the same way for ranges of wholly elided lines. The toggles are
+ *	found through the per-node tag summaries of the B-tree, so the cost
+ *	does not depend on the number of lines skipped. The scan of the tag
+ *	table stops once all tags in it with an -elide value have been seen;
+ *	the "sel" tag of the widget is checked separately.
+ *
+ * Results:
+ *	TkTextNextElideToggleLine returns the first line after linePtr
+ *	containing such a toggle, or lastPtr if there is none before it.
+ *	TkTextPrevElideToggleLine returns the last line before linePtr
+ *	containing such a toggle, or the first line of the widget if there is
+ *	none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+TkTextLine *
+TkTextNextElideToggleLine(
+    const TkText *textPtr,	/* Overall information about text widget. */
+    TkTextLine *linePtr,	/* Line whose end has been reached. */
+    TkTextLine *lastPtr)	/* Don't go beyond this line. */
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    TkTextSearch tSearch;
+    TkTextIndex index1, index2, best;
+    TkTextSegment *segPtr;
+    TkTextTag *tagPtr;
+    Tcl_Size numElideTags = textPtr->sharedTextPtr->numElideTags;
+
+    /*
+     * The search starts at the newline of linePtr, so that toggles at the
+     * very start of the next line are still returned.
+     */
+
+    index1.tree = textPtr->sharedTextPtr->tree;
+    index1.linePtr = linePtr;
+    index1.byteIndex = -1;
+    index1.textPtr = NULL;
+    for (segPtr = linePtr->segPtr; segPtr != NULL; segPtr = segPtr->nextPtr) {
+	index1.byteIndex += segPtr->size;
+    }
+    index2 = index1;
+    index2.linePtr = lastPtr;
+    index2.byteIndex = 0;
+    best = index2;
+
+    for (hPtr = Tcl_FirstHashEntry(&textPtr->sharedTextPtr->tagTable,
+	    &search); hPtr != NULL && numElideTags > 0;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	tagPtr = (TkTextTag *)Tcl_GetHashValue(hPtr);
+	if (tagPtr->elide < 0) {
+	    continue;
+	}
+	numElideTags--;
+	if (tagPtr->toggleCount == 0) {
+	    continue;
+	}
+	TkBTreeStartSearch(&index1, &best, tagPtr, &tSearch);
+	if (TkBTreeNextTag(&tSearch)) {
+	    best = tSearch.curIndex;
+	}
+    }
+
+    /*
+     * The "sel" tag of the widget is not in the tag table.
+     */
+
+    tagPtr = textPtr->selTagPtr;
+    if ((tagPtr->elide >= 0) && (tagPtr->toggleCount > 0)) {
+	TkBTreeStartSearch(&index1, &best, tagPtr, &tSearch);
+	if (TkBTreeNextTag(&tSearch)) {
+	    best = tSearch.curIndex;
+	}
+    }
+    return best.linePtr;
+}
+
+TkTextLine *
+TkTextPrevElideToggleLine(
+    const TkText *textPtr,	/* Overall information about text widget. */
+    TkTextLine *linePtr)	/* Line whose start has been reached. */
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    TkTextSearch tSearch;
+    TkTextIndex index1, best;
+    TkTextTag *tagPtr;
+    Tcl_Size numElideTags = textPtr->sharedTextPtr->numElideTags;
+
+    index1.tree = textPtr->sharedTextPtr->tree;
+    index1.linePtr = linePtr;
+    index1.byteIndex = 0;
+    index1.textPtr = NULL;
+    best = index1;
+    best.linePtr = TkBTreeFindLine(index1.tree, textPtr, 0);
+
+    for (hPtr = Tcl_FirstHashEntry(&textPtr->sharedTextPtr->tagTable,
+	    &search); hPtr != NULL && numElideTags > 0;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	tagPtr = (TkTextTag *)Tcl_GetHashValue(hPtr);
+	if (tagPtr->elide < 0) {
+	    continue;
+	}
+	numElideTags--;
+	if (tagPtr->toggleCount == 0) {
+	    continue;
+	}
+	TkBTreeStartSearchBack(&index1, &best, tagPtr, &tSearch);
+	if (TkBTreePrevTag(&tSearch)) {
+	    best = tSearch.curIndex;
+	}
+    }
+    tagPtr = textPtr->selTagPtr;
+    if ((tagPtr->elide >= 0) && (tagPtr->toggleCount > 0)) {
+	TkBTreeStartSearchBack(&index1, &best, tagPtr, &tSearch);
+	if (TkBTreePrevTag(&tSearch)) {
+	    best = tSearch.curIndex;
+	}
+    }
+    return best.linePtr;
+}
+
 /*
  *----------------------------------------------------------------------
  *
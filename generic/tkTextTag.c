@@ -94,6 +94,7 @@ static void		SortTags(int numTags, TkTextTag **tagArrayPtr);
 static int		TagSortProc(const void *first, const void *second);
 static void		TagBindEvent(TkText *textPtr, XEvent *eventPtr,
 			    int numTags, TkTextTag **tagArrayPtr);
+static void		TagSelectionChanged(TkText *textPtr, int addTag);
 
 /*
  *--------------------------------------------------------------
@@ -124,12 +125,13 @@ TkTextTagCmd(
 {
     static const char *const tagOptionStrings[] = {
 	"add", "bind", "cget", "configure", "delete", "lower", "names",
-	"nextrange", "prevrange", "raise", "ranges", "remove", NULL
+	"nextrange", "prevrange", "raise", "ranges", "remove", "replace",
+	NULL
     };
     enum tagOptions {
 	TAG_ADD, TAG_BIND, TAG_CGET, TAG_CONFIGURE, TAG_DELETE, TAG_LOWER,
 	TAG_NAMES, TAG_NEXTRANGE, TAG_PREVRANGE, TAG_RAISE, TAG_RANGES,
-	TAG_REMOVE
+	TAG_REMOVE, TAG_REPLACE
     };
     int optionIndex;
     Tcl_Size i;
@@ -149,7 +151,8 @@ TkTextTagCmd(
     switch ((enum tagOptions)optionIndex) {
     case TAG_ADD:
     case TAG_REMOVE: {
-	int addTag;
+	int addTag, changed;
+	Tcl_WideInt startTime;
 
 	if (((enum tagOptions)optionIndex) == TAG_ADD) {
 	    addTag = 1;
@@ -199,13 +202,16 @@ TkTextTagCmd(
 
 		TkTextEventuallyRepick(textPtr);
 	    }
-	    if (TkBTreeTag(&index1, &index2, tagPtr, addTag)) {
+	    startTime = TkTextStatsClock();
+	    changed = TkBTreeTag(&index1, &index2, tagPtr, addTag);
+	    textPtr->stats.tagChanges++;
+	    textPtr->stats.tagTime += TkTextStatsClock() - startTime;
+	    if (changed) {
 		/*
 		 * If the tag is "sel", and we actually adjusted something
 		 * then grab the selection if we're supposed to export it and
 		 * don't already have it.
 		 *
-		 * Also, invalidate partially-completed selection retrievals.
 		 * We only need to check whether the tag is "sel" for this
 		 * textPtr (not for other peer widget's "sel" tags) because we
 		 * cannot reach this code path with a different widget's "sel"
@@ -213,27 +219,102 @@ TkTextTagCmd(
 		 */
 
 		if (tagPtr == textPtr->selTagPtr) {
-		    /*
-		     * Send an event that the selection changed. This is
-		     * equivalent to:
-		     *	   event generate $textWidget <<Selection>>
-		     */
-
-		    TkTextSelectionEvent(textPtr);
-
-		    if (addTag && textPtr->exportSelection
-			    && (!Tcl_IsSafe(textPtr->interp))
-			    && !(textPtr->flags & GOT_SELECTION)) {
-			Tk_OwnSelection(textPtr->tkwin, XA_PRIMARY,
-				TkTextLostSelection, textPtr);
-			textPtr->flags |= GOT_SELECTION;
-		    }
-		    textPtr->abortSelections = 1;
+		    TagSelectionChanged(textPtr, addTag);
 		}
 	    }
 	}
 	break;
     }
+    case TAG_REPLACE: {
+	Tcl_Size numRanges;
+	Tcl_Obj **rangeObjs;
+	TkTextIndex *rangePtr;
+	int changed;
+	Tcl_WideInt startTime;
+
+	if ((objc != 6) && (objc != 7)) {
+	    Tcl_WrongNumArgs(interp, 3, objv,
+		    "tagName index1 index2 ?ranges?");
+	    return TCL_ERROR;
+	}
+	if ((TkTextGetObjIndex(interp, textPtr, objv[4], &index1) != TCL_OK)
+		|| (TkTextGetObjIndex(interp, textPtr, objv[5],
+			&index2) != TCL_OK)) {
+	    return TCL_ERROR;
+	}
+	numRanges = 0;
+	rangeObjs = NULL;
+	if ((objc == 7) && (Tcl_ListObjGetElements(interp, objv[6],
+		&numRanges, &rangeObjs) != TCL_OK)) {
+	    return TCL_ERROR;
+	}
+	if (numRanges % 2) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "ranges must contain an even number of indices", TCL_INDEX_NONE));
+	    Tcl_SetErrorCode(interp, "TK", "TEXT", "TAG_RANGES", (char *)NULL);
+	    return TCL_ERROR;
+	}
+
+	/*
+	 * Parse all the ranges before changing anything, clipping them to
+	 * index1..index2.
+	 */
+
+	rangePtr = (TkTextIndex *)ckalloc(sizeof(TkTextIndex) * (numRanges + 1));
+	for (i = 0; i < numRanges; i++) {
+	    if (TkTextGetObjIndex(interp, textPtr, rangeObjs[i],
+		    &rangePtr[i]) != TCL_OK) {
+		ckfree(rangePtr);
+		return TCL_ERROR;
+	    }
+	    if (TkTextIndexCmp(&rangePtr[i], &index1) < 0) {
+		rangePtr[i] = index1;
+	    } else if (TkTextIndexCmp(&rangePtr[i], &index2) > 0) {
+		rangePtr[i] = index2;
+	    }
+	}
+	if (TkTextIndexCmp(&index1, &index2) >= 0) {
+	    ckfree(rangePtr);
+	    return TCL_OK;
+	}
+
+	tagPtr = TkTextCreateTag(textPtr, Tcl_GetString(objv[3]), NULL);
+	if (tagPtr->elide > 0) {
+	    textPtr->sharedTextPtr->stateEpoch++;
+	}
+
+	/*
+	 * Redraw whatever has the tag before and after the change, which
+	 * covers all the characters gaining or losing it. The display is
+	 * only recomputed once, when it is next redrawn.
+	 */
+
+	if (tagPtr->affectsDisplay) {
+	    TkTextRedrawTag(textPtr->sharedTextPtr, NULL, &index1, &index2,
+		    tagPtr, 1);
+	} else {
+	    TkTextEventuallyRepick(textPtr);
+	}
+	startTime = TkTextStatsClock();
+	changed = TkBTreeTag(&index1, &index2, tagPtr, 0);
+	textPtr->stats.tagChanges++;
+	for (i = 0; i < numRanges; i += 2) {
+	    if (TkTextIndexCmp(&rangePtr[i], &rangePtr[i+1]) < 0) {
+		changed |= TkBTreeTag(&rangePtr[i], &rangePtr[i+1], tagPtr, 1);
+		textPtr->stats.tagChanges++;
+	    }
+	}
+	textPtr->stats.tagTime += TkTextStatsClock() - startTime;
+	ckfree(rangePtr);
+	if (tagPtr->affectsDisplay) {
+	    TkTextRedrawTag(textPtr->sharedTextPtr, NULL, &index1, &index2,
+		    tagPtr, 1);
+	}
+	if (changed && (tagPtr == textPtr->selTagPtr)) {
+	    TagSelectionChanged(textPtr, numRanges > 0);
+	}
+	break;
+    }
     case TAG_BIND:
 	if ((objc < 4) || (objc > 6)) {
 	    Tcl_WrongNumArgs(interp, 3, objv, "tagName ?sequence? ?command?");
@@ -351,10 +432,16 @@ TkTextTagCmd(
 	    Tcl_SetObjResult(interp, objPtr);
 	    return TCL_OK;
 	} else {
+	    int hadElide = (tagPtr->elide >= 0);
+
 	    if (Tk_SetOptions(interp, tagPtr, tagPtr->optionTable,
 		    objc-4, objv+4, textPtr->tkwin, NULL, NULL) != TCL_OK) {
 		return TCL_ERROR;
 	    }
+	    if ((tagPtr != textPtr->selTagPtr)
+		    && (hadElide != (tagPtr->elide >= 0))) {
+		textPtr->sharedTextPtr->numElideTags += hadElide ? -1 : 1;
+	    }
 
 	    /*
 	     * Some of the configuration options, like -underline and
@@ -857,6 +944,48 @@ TkTextTagCmd(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TagSelectionChanged --
+ *
+ *	Called after the "tag" widget command has changed the "sel" tag of a
+ *	text widget.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A <<Selection>> event is sent, the selection is claimed if characters
+ *	were selected and the widget exports its selection, and
+ *	partially-completed selection retrievals are invalidated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TagSelectionChanged(
+    TkText *textPtr,		/* Widget whose selection changed. */
+    int addTag)			/* Non-zero if characters were added to the
+				 * selection. */
+{
+    /*
+     * Send an event that the selection changed. This is equivalent to:
+     *	   event generate $textWidget <<Selection>>
+     */
+
+    TkTextSelectionEvent(textPtr);
+
+    if (addTag && textPtr->exportSelection
+	    && (!Tcl_IsSafe(textPtr->interp))
+	    && !(textPtr->flags & GOT_SELECTION)) {
+	Tk_OwnSelection(textPtr->tkwin, XA_PRIMARY, TkTextLostSelection,
+		textPtr);
+	textPtr->flags |= GOT_SELECTION;
+    }
+    textPtr->abortSelections = 1;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -1107,6 +1236,10 @@ TkTextFreeTag(
 {
     int i;
 
+    if ((tagPtr->elide >= 0) && (tagPtr != textPtr->selTagPtr)) {
+	textPtr->sharedTextPtr->numElideTags--;
+    }
+
     /*
      * Let Tk do most of the hard work for us.
      */
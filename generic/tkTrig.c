@@ -407,6 +407,129 @@ TkThickPolyLineToArea(
     return inside;
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * EdgeToPoint --
+ *
+ *	Compute the distance from a point to one edge of a polygon, and count
+ *	whether the edge crosses a ray extending vertically upwards from the
+ *	point to infinity.
+ *
+ * Results:
+ *	The return value is the distance of the point from the edge. If the
+ *	edge crosses the ray, *intersectionsPtr is incremented.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double
+EdgeToPoint(
+    const double *pPtr,		/* Points to the end-points of the edge:
+				 * x0, y0, x1, y1. */
+    const double *pointPtr,	/* Points to coords for point. */
+    int *intersectionsPtr)	/* Incremented if the edge crosses the
+				 * vertical ray from the point. */
+{
+    double x, y;
+
+    /*
+     * Compute the point on the edge closest to the point and update the
+     * intersection count. This must be done separately for vertical edges,
+     * horizontal edges, and other edges.
+     *
+     * TRICKY POINT: when computing intersections, include left x-coordinate
+     * of line within its range, but not y-coordinate. Otherwise if the point
+     * lies exactly below a vertex we'll count it as two intersections.
+     */
+
+    if (pPtr[2] == pPtr[0]) {
+
+	/*
+	 * Vertical edge.
+	 */
+
+	x = pPtr[0];
+	if (pPtr[1] >= pPtr[3]) {
+	    y = MIN(pPtr[1], pointPtr[1]);
+	    y = MAX(y, pPtr[3]);
+	} else {
+	    y = MIN(pPtr[3], pointPtr[1]);
+	    y = MAX(y, pPtr[1]);
+	}
+    } else if (pPtr[3] == pPtr[1]) {
+
+	/*
+	 * Horizontal edge.
+	 */
+
+	y = pPtr[1];
+	if (pPtr[0] >= pPtr[2]) {
+	    x = MIN(pPtr[0], pointPtr[0]);
+	    x = MAX(x, pPtr[2]);
+	    if ((pointPtr[1] < y) && (pointPtr[0] < pPtr[0])
+		    && (pointPtr[0] >= pPtr[2])) {
+		(*intersectionsPtr)++;
+	    }
+	} else {
+	    x = MIN(pPtr[2], pointPtr[0]);
+	    x = MAX(x, pPtr[0]);
+	    if ((pointPtr[1] < y) && (pointPtr[0] < pPtr[2])
+		    && (pointPtr[0] >= pPtr[0])) {
+		(*intersectionsPtr)++;
+	    }
+	}
+    } else {
+	double m1, b1, m2, b2;
+	int lower;		/* Non-zero means point below line. */
+
+	/*
+	 * The edge is neither horizontal nor vertical. Convert the edge to a
+	 * line equation of the form y = m1*x + b1. Then compute a line
+	 * perpendicular to this edge but passing through the point, also in
+	 * the form y = m2*x + b2.
+	 */
+
+	m1 = (pPtr[3] - pPtr[1])/(pPtr[2] - pPtr[0]);
+	b1 = pPtr[1] - m1*pPtr[0];
+	m2 = -1.0/m1;
+	b2 = pointPtr[1] - m2*pointPtr[0];
+	x = (b2 - b1)/(m1 - m2);
+	y = m1*x + b1;
+	if (pPtr[0] > pPtr[2]) {
+	    if (x > pPtr[0]) {
+		x = pPtr[0];
+		y = pPtr[1];
+	    } else if (x < pPtr[2]) {
+		x = pPtr[2];
+		y = pPtr[3];
+	    }
+	} else {
+	    if (x > pPtr[2]) {
+		x = pPtr[2];
+		y = pPtr[3];
+	    } else if (x < pPtr[0]) {
+		x = pPtr[0];
+		y = pPtr[1];
+	    }
+	}
+	lower = (m1*pointPtr[0] + b1) > pointPtr[1];
+	if (lower && (pointPtr[0] >= MIN(pPtr[0], pPtr[2]))
+		&& (pointPtr[0] < MAX(pPtr[0], pPtr[2]))) {
+	    (*intersectionsPtr)++;
+	}
+    }
+
+    /*
+     * Compute the distance to the closest point.
+     */
+
+    return hypot(pointPtr[0] - x, pointPtr[1] - y);
+}
+
 /*
  *--------------------------------------------------------------
  *
@@ -444,107 +567,14 @@ TkPolygonToPoint(
     /*
      * Iterate through all of the edges in the polygon, updating bestDist and
      * intersections.
-     *
-     * TRICKY POINT: when computing intersections, include left x-coordinate
-     * of line within its range, but not y-coordinate. Otherwise if the point
-     * lies exactly below a vertex we'll count it as two intersections.
      */
 
     bestDist = 1.0e36;
     intersections = 0;
 
     for (count = numPoints, pPtr = polyPtr; count > 1; count--, pPtr += 2) {
-	double x, y, dist;
-
-	/*
-	 * Compute the point on the current edge closest to the point and
-	 * update the intersection count. This must be done separately for
-	 * vertical edges, horizontal edges, and other edges.
-	 */
-
-	if (pPtr[2] == pPtr[0]) {
-
-	    /*
-	     * Vertical edge.
-	     */
-
-	    x = pPtr[0];
-	    if (pPtr[1] >= pPtr[3]) {
-		y = MIN(pPtr[1], pointPtr[1]);
-		y = MAX(y, pPtr[3]);
-	    } else {
-		y = MIN(pPtr[3], pointPtr[1]);
-		y = MAX(y, pPtr[1]);
-	    }
-	} else if (pPtr[3] == pPtr[1]) {
+	double dist = EdgeToPoint(pPtr, pointPtr, &intersections);
 
-	    /*
-	     * Horizontal edge.
-	     */
-
-	    y = pPtr[1];
-	    if (pPtr[0] >= pPtr[2]) {
-		x = MIN(pPtr[0], pointPtr[0]);
-		x = MAX(x, pPtr[2]);
-		if ((pointPtr[1] < y) && (pointPtr[0] < pPtr[0])
-			&& (pointPtr[0] >= pPtr[2])) {
-		    intersections++;
-		}
-	    } else {
-		x = MIN(pPtr[2], pointPtr[0]);
-		x = MAX(x, pPtr[0]);
-		if ((pointPtr[1] < y) && (pointPtr[0] < pPtr[2])
-			&& (pointPtr[0] >= pPtr[0])) {
-		    intersections++;
-		}
-	    }
-	} else {
-	    double m1, b1, m2, b2;
-	    int lower;		/* Non-zero means point below line. */
-
-	    /*
-	     * The edge is neither horizontal nor vertical. Convert the edge
-	     * to a line equation of the form y = m1*x + b1. Then compute a
-	     * line perpendicular to this edge but passing through the point,
-	     * also in the form y = m2*x + b2.
-	     */
-
-	    m1 = (pPtr[3] - pPtr[1])/(pPtr[2] - pPtr[0]);
-	    b1 = pPtr[1] - m1*pPtr[0];
-	    m2 = -1.0/m1;
-	    b2 = pointPtr[1] - m2*pointPtr[0];
-	    x = (b2 - b1)/(m1 - m2);
-	    y = m1*x + b1;
-	    if (pPtr[0] > pPtr[2]) {
-		if (x > pPtr[0]) {
-		    x = pPtr[0];
-		    y = pPtr[1];
-		} else if (x < pPtr[2]) {
-		    x = pPtr[2];
-		    y = pPtr[3];
-		}
-	    } else {
-		if (x > pPtr[2]) {
-		    x = pPtr[2];
-		    y = pPtr[3];
-		} else if (x < pPtr[0]) {
-		    x = pPtr[0];
-		    y = pPtr[1];
-		}
-	    }
-	    lower = (m1*pointPtr[0] + b1) > pointPtr[1];
-	    if (lower && (pointPtr[0] >= MIN(pPtr[0], pPtr[2]))
-		    && (pointPtr[0] < MAX(pPtr[0], pPtr[2]))) {
-		intersections++;
-	    }
-	}
-
-	/*
-	 * Compute the distance to the closest point, and see if that is the
-	 * best distance seen so far.
-	 */
-
-	dist = hypot(pointPtr[0] - x, pointPtr[1] - y);
 	if (dist < bestDist) {
 	    bestDist = dist;
 	}
@@ -1741,6 +1771,607 @@ TkGetButtPoints(
     }
 }
 
+/*
+ *--------------------------------------------------------------
+ *
+ * TkGetSegmentOutline --
+ *
+ *	Compute the polygonal shape that one segment of a thick polyline
+ *	covers, taking the caps at the ends of the polyline and the joints
+ *	with the neighbouring segments into account. This produces the same
+ *	shapes as the sequential walks in TkThickPolyLineToArea and the line
+ *	and polygon items, but for a single segment, so that the segments can
+ *	be visited in any order.
+ *
+ * Results:
+ *	The closed 5-point outline of the segment is stored at polyPtr. If
+ *	the joint at the start of the segment is beveled, the closed 5-point
+ *	wedge that fills it is stored at wedgePtr and 1 is returned; otherwise
+ *	0 is returned. Round caps and joints are left to the caller.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkGetSegmentOutline(
+    double *coordPtr,		/* Points of the polyline: x0, y0, x1, y1,
+				 * ... */
+    Tcl_Size numPoints,		/* Number of points at coordPtr. */
+    Tcl_Size index,		/* Index of the segment, which runs from
+				 * point index to point index+1. */
+    double width,		/* Width of the polyline. */
+    int capStyle,		/* How are end-points of polyline drawn?
+				 * CapRound, CapButt, or CapProjecting. */
+    int joinStyle,		/* How are joints in polyline drawn?
+				 * JoinMiter, JoinRound, or JoinBevel. */
+    double *polyPtr,		/* Where to store 10 coordinates of the
+				 * segment outline. */
+    double *wedgePtr)		/* Where to store 10 coordinates of the bevel
+				 * wedge, if any. */
+{
+    double *p = coordPtr + 2*index;
+    int wedge = 0;
+
+    if (index == 0) {
+	TkGetButtPoints(p+2, p, width, capStyle == CapProjecting,
+		polyPtr, polyPtr+2);
+    } else if ((joinStyle != JoinMiter)
+	    || !TkGetMiterPoints(p-2, p, p+2, width, polyPtr+2, polyPtr)) {
+	TkGetButtPoints(p+2, p, width, 0, polyPtr, polyPtr+2);
+
+	/*
+	 * Mitered joints that are too sharp are treated as beveled, just like
+	 * the drawing code does.
+	 */
+
+	if (joinStyle != JoinRound) {
+	    wedgePtr[0] = polyPtr[0];
+	    wedgePtr[1] = polyPtr[1];
+	    wedgePtr[2] = polyPtr[2];
+	    wedgePtr[3] = polyPtr[3];
+	    TkGetButtPoints(p-2, p, width, 0, wedgePtr+4, wedgePtr+6);
+	    wedgePtr[8] = polyPtr[0];
+	    wedgePtr[9] = polyPtr[1];
+	    wedge = 1;
+	}
+    }
+
+    if (index == numPoints - 2) {
+	TkGetButtPoints(p, p+2, width, capStyle == CapProjecting,
+		polyPtr+4, polyPtr+6);
+    } else if ((joinStyle != JoinMiter)
+	    || !TkGetMiterPoints(p, p+2, p+4, width, polyPtr+4, polyPtr+6)) {
+	TkGetButtPoints(p, p+2, width, 0, polyPtr+4, polyPtr+6);
+    }
+    polyPtr[8] = polyPtr[0];
+    polyPtr[9] = polyPtr[1];
+    return wedge;
+}
+
+/*
+ * The segment tree is an implicit binary tree of bounding boxes over runs of
+ * consecutive segments. Each leaf covers SEGMENTS_PER_LEAF segments; the
+ * number of leaves is rounded up to a power of two, and leaves past the end
+ * of the polyline get empty (inverted) bounding boxes.
+ */
+
+#define SEGMENTS_PER_LEAF	8
+
+/*
+ * Value used by SegmentTreeToArea before any segment has been classified.
+ */
+
+#define AREA_UNKNOWN		2
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkSegmentTreeCreate --
+ *
+ *	Build a bounding-volume hierarchy over the segments of a polyline, so
+ *	that hit-testing a line or polygon item with many points doesn't have
+ *	to look at every segment.
+ *
+ * Results:
+ *	The return value is a new tree, which holds its own copy of the
+ *	points. The caller must release it with TkSegmentTreeFree.
+ *
+ * Side effects:
+ *	Memory is allocated.
+ *
+ *--------------------------------------------------------------
+ */
+
+TkSegmentTree *
+TkSegmentTreeCreate(
+    const double *coordPtr,	/* Points of the polyline: x0, y0, x1, y1,
+				 * ... */
+    Tcl_Size numPoints)		/* Number of points at coordPtr; must be at
+				 * least 2. */
+{
+    TkSegmentTree *treePtr;
+    Tcl_Size numSegments = numPoints - 1, numLeaves, i, first, last;
+    double *bbox;
+    const double *p;
+
+    numLeaves = 1;
+    while (numLeaves * SEGMENTS_PER_LEAF < numSegments) {
+	numLeaves *= 2;
+    }
+
+    treePtr = (TkSegmentTree *)ckalloc(sizeof(TkSegmentTree));
+    treePtr->coordPtr = (double *)ckalloc(
+	    (2*numPoints + 8*numLeaves) * sizeof(double));
+    memcpy(treePtr->coordPtr, coordPtr, 2*numPoints * sizeof(double));
+    treePtr->numPoints = numPoints;
+    treePtr->numLeaves = numLeaves;
+    treePtr->bboxPtr = treePtr->coordPtr + 2*numPoints;
+
+    /*
+     * Fill in the leaves from the points, then the interior nodes from their
+     * children.
+     */
+
+    for (i = 0; i < numLeaves; i++) {
+	bbox = treePtr->bboxPtr + 4*(numLeaves + i);
+	bbox[0] = bbox[1] = 1.0e36;
+	bbox[2] = bbox[3] = -1.0e36;
+	first = i * SEGMENTS_PER_LEAF;
+	last = MIN(first + SEGMENTS_PER_LEAF, numSegments);
+	if (first >= last) {
+	    continue;
+	}
+	for (p = coordPtr + 2*first; first <= last; first++, p += 2) {
+	    bbox[0] = MIN(bbox[0], p[0]);
+	    bbox[1] = MIN(bbox[1], p[1]);
+	    bbox[2] = MAX(bbox[2], p[0]);
+	    bbox[3] = MAX(bbox[3], p[1]);
+	}
+    }
+    for (i = numLeaves - 1; i > 0; i--) {
+	double *child = treePtr->bboxPtr + 8*i;
+
+	bbox = treePtr->bboxPtr + 4*i;
+	bbox[0] = MIN(child[0], child[4]);
+	bbox[1] = MIN(child[1], child[5]);
+	bbox[2] = MAX(child[2], child[6]);
+	bbox[3] = MAX(child[3], child[7]);
+    }
+    return treePtr;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkSegmentTreeFree --
+ *
+ *	Release a tree built by TkSegmentTreeCreate.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *--------------------------------------------------------------
+ */
+
+void
+TkSegmentTreeFree(
+    TkSegmentTree *treePtr)	/* Tree to free; may be NULL. */
+{
+    if (treePtr != NULL) {
+	ckfree(treePtr->coordPtr);
+	ckfree(treePtr);
+    }
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * BboxToPoint --
+ *
+ *	Compute the distance from a point to a bounding box of the tree,
+ *	after growing the box by margin on every side.
+ *
+ * Results:
+ *	The distance, which is 0 if the point is inside the grown box and
+ *	1.0e36 if the box is empty.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double
+BboxToPoint(
+    const double *bbox,
+    double margin,
+    const double *pointPtr)
+{
+    double dx, dy;
+
+    if (bbox[0] > bbox[2]) {
+	return 1.0e36;
+    }
+    dx = MAX(bbox[0] - margin - pointPtr[0], pointPtr[0] - bbox[2] - margin);
+    dy = MAX(bbox[1] - margin - pointPtr[1], pointPtr[1] - bbox[3] - margin);
+    if (dx <= 0.0) {
+	return MAX(dy, 0.0);
+    } else if (dy <= 0.0) {
+	return dx;
+    }
+    return hypot(dx, dy);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * SegmentTreeToPoint --
+ *
+ *	Recursive helper for TkSegmentTreeToPoint: searches the subtree rooted
+ *	at node, visiting the nearer child first and skipping children that
+ *	can't hold anything closer than the best distance found so far.
+ *
+ * Results:
+ *	The smaller of bestDist and the distances of the segments visited.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static double
+SegmentTreeToPoint(
+    TkSegmentTree *treePtr,
+    Tcl_Size node,
+    double margin,
+    double *pointPtr,
+    double bestDist,
+    TkSegmentPointProc *proc,
+    void *clientData)
+{
+    double dist1, dist2;
+    Tcl_Size child;
+
+    if (node >= treePtr->numLeaves) {
+	Tcl_Size i, last;
+
+	i = (node - treePtr->numLeaves) * SEGMENTS_PER_LEAF;
+	last = MIN(i + SEGMENTS_PER_LEAF, treePtr->numPoints - 1);
+	for ( ; i < last; i++) {
+	    double dist = proc(clientData, i, pointPtr);
+
+	    if (dist <= 0.0) {
+		return 0.0;
+	    } else if (dist < bestDist) {
+		bestDist = dist;
+	    }
+	}
+	return bestDist;
+    }
+
+    child = 2*node;
+    dist1 = BboxToPoint(treePtr->bboxPtr + 4*child, margin, pointPtr);
+    dist2 = BboxToPoint(treePtr->bboxPtr + 4*(child+1), margin, pointPtr);
+    if (dist2 < dist1) {
+	double tmp = dist1;
+
+	dist1 = dist2;
+	dist2 = tmp;
+	child++;
+    }
+    if (dist1 < bestDist) {
+	bestDist = SegmentTreeToPoint(treePtr, child, margin, pointPtr,
+		bestDist, proc, clientData);
+	if (bestDist <= 0.0) {
+	    return 0.0;
+	}
+    }
+    if (dist2 < bestDist) {
+	bestDist = SegmentTreeToPoint(treePtr, child ^ 1, margin, pointPtr,
+		bestDist, proc, clientData);
+    }
+    return bestDist;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkSegmentTreeToPoint --
+ *
+ *	Compute the distance from a point to the shapes covered by the
+ *	segments of a tree. The shape of each segment is measured by proc,
+ *	and must lie within margin of the bounding box of the segment's
+ *	end-points.
+ *
+ * Results:
+ *	The return value is the smaller of bestDist and the distance from the
+ *	point to the closest segment shape; 0 if the point is inside one.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+double
+TkSegmentTreeToPoint(
+    TkSegmentTree *treePtr,	/* Tree to search. */
+    double margin,		/* How far a segment shape may extend beyond
+				 * the end-points of the segment. */
+    double *pointPtr,		/* Points to coords for point. */
+    double bestDist,		/* Best distance found so far by the
+				 * caller. */
+    TkSegmentPointProc *proc,	/* Computes the distance from the point to
+				 * one segment shape. */
+    void *clientData)		/* Arbitrary value to pass to proc. */
+{
+    if ((bestDist > 0.0) && (BboxToPoint(treePtr->bboxPtr + 4, margin,
+	    pointPtr) < bestDist)) {
+	bestDist = SegmentTreeToPoint(treePtr, 1, margin, pointPtr, bestDist,
+		proc, clientData);
+    }
+    return bestDist;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * SegmentTreeToArea --
+ *
+ *	Recursive helper for TkSegmentTreeToArea: classifies the subtree
+ *	rooted at node against the rectangle, merging the result into
+ *	*statePtr.
+ *
+ * Results:
+ *	Returns 0 as soon as the segments are known to overlap the rectangle
+ *	(or to lie partly inside and partly outside it), 1 otherwise.
+ *
+ * Side effects:
+ *	*statePtr is updated.
+ *
+ *--------------------------------------------------------------
+ */
+
+static int
+SegmentTreeToArea(
+    TkSegmentTree *treePtr,
+    Tcl_Size node,
+    double margin,
+    double *rectPtr,
+    int *statePtr,
+    TkSegmentAreaProc *proc,
+    void *clientData)
+{
+    const double *bbox = treePtr->bboxPtr + 4*node;
+    int state;
+
+    if (bbox[0] > bbox[2]) {
+	return 1;
+    }
+    if ((bbox[2] + margin < rectPtr[0]) || (bbox[0] - margin > rectPtr[2])
+	    || (bbox[3] + margin < rectPtr[1])
+	    || (bbox[1] - margin > rectPtr[3])) {
+	state = -1;
+    } else if ((bbox[0] - margin >= rectPtr[0])
+	    && (bbox[2] + margin <= rectPtr[2])
+	    && (bbox[1] - margin >= rectPtr[1])
+	    && (bbox[3] + margin <= rectPtr[3])) {
+	state = 1;
+    } else if (node >= treePtr->numLeaves) {
+	Tcl_Size i, last;
+
+	i = (node - treePtr->numLeaves) * SEGMENTS_PER_LEAF;
+	last = MIN(i + SEGMENTS_PER_LEAF, treePtr->numPoints - 1);
+	for ( ; i < last; i++) {
+	    state = proc(clientData, i, rectPtr);
+	    if ((state == 0)
+		    || ((*statePtr != AREA_UNKNOWN) && (state != *statePtr))) {
+		*statePtr = 0;
+		return 0;
+	    }
+	    *statePtr = state;
+	}
+	return 1;
+    } else {
+	return SegmentTreeToArea(treePtr, 2*node, margin, rectPtr, statePtr,
+		proc, clientData)
+		&& SegmentTreeToArea(treePtr, 2*node+1, margin, rectPtr,
+		statePtr, proc, clientData);
+    }
+
+    if ((*statePtr != AREA_UNKNOWN) && (state != *statePtr)) {
+	*statePtr = 0;
+	return 0;
+    }
+    *statePtr = state;
+    return 1;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkSegmentTreeToArea --
+ *
+ *	Determine whether the shapes covered by the segments of a tree lie
+ *	entirely inside, entirely outside, or overlapping a given rectangular
+ *	area. The shape of each segment is classified by proc, and must lie
+ *	within margin of the bounding box of the segment's end-points.
+ *
+ * Results:
+ *	-1 is returned if all of the shapes are entirely outside the area, 0
+ *	if they overlap it, and 1 if they are all entirely inside it.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkSegmentTreeToArea(
+    TkSegmentTree *treePtr,	/* Tree to search. */
+    double margin,		/* How far a segment shape may extend beyond
+				 * the end-points of the segment. */
+    double *rectPtr,		/* Rectangle to check against: x1, y1, x2,
+				 * y2, with x1 <= x2 and y1 <= y2. */
+    TkSegmentAreaProc *proc,	/* Classifies one segment shape against the
+				 * rectangle, returning -1, 0 or 1. */
+    void *clientData)		/* Arbitrary value to pass to proc. */
+{
+    int state = AREA_UNKNOWN;
+
+    SegmentTreeToArea(treePtr, 1, margin, rectPtr, &state, proc, clientData);
+    return (state == AREA_UNKNOWN) ? -1 : state;
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * SegmentTreeCrossings --
+ *
+ *	Count the segments in the subtree rooted at node that cross a ray
+ *	extending vertically upwards from a point, as TkPolygonToPoint does.
+ *	Only the subtrees whose bounding box straddles the ray are visited.
+ *
+ * Results:
+ *	The number of crossings.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+static Tcl_Size
+SegmentTreeCrossings(
+    TkSegmentTree *treePtr,
+    Tcl_Size node,
+    const double *pointPtr)
+{
+    const double *bbox = treePtr->bboxPtr + 4*node;
+
+    if ((pointPtr[0] < bbox[0]) || (pointPtr[0] >= bbox[2])
+	    || (pointPtr[1] >= bbox[3])) {
+	return 0;
+    }
+    if (node >= treePtr->numLeaves) {
+	Tcl_Size i, last;
+	int intersections = 0;
+
+	i = (node - treePtr->numLeaves) * SEGMENTS_PER_LEAF;
+	last = MIN(i + SEGMENTS_PER_LEAF, treePtr->numPoints - 1);
+	for ( ; i < last; i++) {
+	    EdgeToPoint(treePtr->coordPtr + 2*i, pointPtr, &intersections);
+	}
+	return intersections;
+    }
+    return SegmentTreeCrossings(treePtr, 2*node, pointPtr)
+	    + SegmentTreeCrossings(treePtr, 2*node+1, pointPtr);
+}
+
+static double
+EdgeProc(
+    void *clientData,
+    Tcl_Size index,
+    double *pointPtr)
+{
+    int intersections = 0;
+
+    return EdgeToPoint((double *)clientData + 2*index, pointPtr,
+	    &intersections);
+}
+
+static int
+EdgeAreaProc(
+    void *clientData,
+    Tcl_Size index,
+    double *rectPtr)
+{
+    double *pPtr = (double *)clientData + 2*index;
+
+    return TkLineToArea(pPtr, pPtr+2, rectPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkSegmentTreePolygonToPoint --
+ *
+ *	Compute the distance from a point to the polygon formed by the points
+ *	of a tree. This is equivalent to TkPolygonToPoint.
+ *
+ * Results:
+ *	The return value is 0.0 if the point referred to by pointPtr is within
+ *	the polygon. Otherwise the return value is the distance of the point
+ *	from the polygon.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+double
+TkSegmentTreePolygonToPoint(
+    TkSegmentTree *treePtr,	/* Tree built from a closed polygon. */
+    double *pointPtr)		/* Points to coords for point. */
+{
+    if (SegmentTreeCrossings(treePtr, 1, pointPtr) & 0x1) {
+	return 0.0;
+    }
+    return TkSegmentTreeToPoint(treePtr, 0.0, pointPtr, 1.0e36, EdgeProc,
+	    treePtr->coordPtr);
+}
+
+/*
+ *--------------------------------------------------------------
+ *
+ * TkSegmentTreePolygonToArea --
+ *
+ *	Determine whether the polygon formed by the points of a tree lies
+ *	entirely inside, entirely outside, or overlapping a given rectangular
+ *	area. This is equivalent to TkPolygonToArea.
+ *
+ * Results:
+ *	-1 is returned if the polygon is entirely outside the area, 0 if it
+ *	overlaps, and 1 if it is entirely inside the given area.
+ *
+ * Side effects:
+ *	None.
+ *
+ *--------------------------------------------------------------
+ */
+
+int
+TkSegmentTreePolygonToArea(
+    TkSegmentTree *treePtr,	/* Tree built from a closed polygon. */
+    double *rectPtr)		/* Rectangle to check against: x1, y1, x2,
+				 * y2, with x1 <= x2 and y1 <= y2. */
+{
+    int state;
+
+    state = TkSegmentTreeToArea(treePtr, 0.0, rectPtr, EdgeAreaProc,
+	    treePtr->coordPtr);
+
+    /*
+     * If all of the edges are outside the rectangle, the rectangle could
+     * still be entirely enclosed by the polygon.
+     */
+
+    if ((state == -1)
+	    && (TkSegmentTreePolygonToPoint(treePtr, rectPtr) == 0.0)) {
+	return 0;
+    }
+    return state;
+}
+
 /*
  * Local Variables:
  * mode: c
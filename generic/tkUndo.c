@@ -15,6 +15,16 @@
 
 static int		EvaluateActionList(Tcl_Interp *interp,
 			    TkUndoSubAtom *action);
+static void		FreeAtom(TkUndoAtom *elem);
+static void		FreeSubAtoms(TkUndoSubAtom *sub);
+static TkUndoSubAtom *	MakeRecordSubAtom(TkUndoRecordProc *recordProc,
+			    void *clientData, TkUndoRecordType type,
+			    TkUndoRecord *recordPtr);
+static int		MergeRecord(TkUndoRecord *recordPtr,
+			    TkUndoRecordType type, Tcl_Size line,
+			    Tcl_Size byteIndex, Tcl_Obj *textObj);
+static Tcl_Size		SubAtomsSize(TkUndoSubAtom *sub);
+static void		TrimUndoBytes(TkUndoRedoStack *stack);
 
 /*
  *----------------------------------------------------------------------
@@ -96,6 +106,7 @@ TkUndoInsertSeparator(
     if (*stack!=NULL && (*stack)->type!=TK_UNDO_SEPARATOR) {
 	separator = (TkUndoAtom *)ckalloc(sizeof(TkUndoAtom));
 	separator->type = TK_UNDO_SEPARATOR;
+	separator->size = 0;
 	TkUndoPushStack(stack,separator);
 	return 1;
     }
@@ -125,34 +136,61 @@ TkUndoClearStack(
     TkUndoAtom *elem;
 
     while ((elem = TkUndoPopStack(stack)) != NULL) {
-	if (elem->type != TK_UNDO_SEPARATOR) {
-	    TkUndoSubAtom *sub;
+	FreeAtom(elem);
+    }
+    *stack = NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreeAtom, FreeSubAtoms --
+ *
+ *	Free an element of an undo or redo stack, or a linked list of
+ *	sub-atoms, together with the objects and records they refer to.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Memory is freed.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	    sub = elem->apply;
-	    while (sub != NULL) {
-		TkUndoSubAtom *next = sub->next;
+static void
+FreeAtom(
+    TkUndoAtom *elem)		/* Element to free. */
+{
+    if (elem->type != TK_UNDO_SEPARATOR) {
+	/*
+	 * The record of a record atom is shared by its apply and revert
+	 * sub-atoms, so it is freed here rather than with each of them.
+	 */
 
-		if (sub->action != NULL) {
-		    Tcl_DecrRefCount(sub->action);
-		}
-		ckfree(sub);
-		sub = next;
-	    }
+	if (elem->apply != NULL && elem->apply->recordPtr != NULL) {
+	    Tcl_DecrRefCount(elem->apply->recordPtr->textObj);
+	    ckfree(elem->apply->recordPtr);
+	}
+	FreeSubAtoms(elem->apply);
+	FreeSubAtoms(elem->revert);
+    }
+    ckfree(elem);
+}
 
-	    sub = elem->revert;
-	    while (sub != NULL) {
-		TkUndoSubAtom *next = sub->next;
+static void
+FreeSubAtoms(
+    TkUndoSubAtom *sub)		/* Head of the list to free. */
+{
+    while (sub != NULL) {
+	TkUndoSubAtom *next = sub->next;
 
-		if (sub->action != NULL) {
-		    Tcl_DecrRefCount(sub->action);
-		}
-		ckfree(sub);
-		sub = next;
-	    }
+	if (sub->action != NULL) {
+	    Tcl_DecrRefCount(sub->action);
 	}
-	ckfree(elem);
+	ckfree(sub);
+	sub = next;
     }
-    *stack = NULL;
 }
 
 /*
@@ -185,9 +223,226 @@ TkUndoPushAction(
     atom->type = TK_UNDO_ACTION;
     atom->apply = apply;
     atom->revert = revert;
+    atom->size = sizeof(TkUndoAtom) + SubAtomsSize(apply)
+	    + SubAtomsSize(revert);
 
     TkUndoPushStack(&stack->undoStack, atom);
+    stack->bytes += atom->size;
+    TkUndoClearStack(&stack->redoStack);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SubAtomsSize --
+ *
+ *	Estimate the memory held by a linked list of sub-atoms, counting the
+ *	string representation of their scripts.
+ *
+ * Results:
+ *	A number of bytes.
+ *
+ * Side effects:
+ *	The string representation of the scripts may be generated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+SubAtomsSize(
+    TkUndoSubAtom *sub)		/* Head of the list. */
+{
+    Tcl_Size size = 0, length;
+
+    for ( ; sub != NULL; sub = sub->next) {
+	size += sizeof(TkUndoSubAtom);
+	if (sub->action != NULL) {
+	    (void) Tcl_GetStringFromObj(sub->action, &length);
+	    size += length;
+	}
+    }
+    return size;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkUndoPushRecord --
+ *
+ *	Push the record of an insertion or deletion of text on the undo
+ *	stack. Compared with the scripts of TkUndoPushAction, the record only
+ *	costs the position of the change and a reference to 'textObj'. Both
+ *	undo and redo call 'recordProc', with TK_UNDO_INSERT or
+ *	TK_UNDO_DELETE as appropriate, to replay the change.
+ *
+ *	If the top of the undo stack is a record of the same kind that the
+ *	change continues on the same line (typing, or deleting with the
+ *	BackSpace or Delete key), the text is merged into that record instead
+ *	of a new one being pushed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	A refCount is retained on 'textObj'. The redo stack is cleared.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkUndoPushRecord(
+    TkUndoRedoStack *stack,	/* An Undo/Redo stack */
+    TkUndoRecordProc *recordProc,
+				/* Callback function to replay the record. */
+    void *clientData,		/* Data to pass to the callback function. */
+    TkUndoRecordType type,	/* The change that was made. */
+    Tcl_Size line,		/* Line of the first character changed. */
+    Tcl_Size byteIndex,		/* Byte offset of that character in its
+				 * line. */
+    Tcl_Obj *textObj)		/* Text inserted or deleted. */
+{
+    TkUndoAtom *atom = stack->undoStack;
+    TkUndoRecord *recordPtr;
+    Tcl_Size length;
+
     TkUndoClearStack(&stack->redoStack);
+    (void) Tcl_GetStringFromObj(textObj, &length);
+
+    if (atom != NULL && atom->type == TK_UNDO_ACTION
+	    && atom->apply != NULL && atom->apply->recordPtr != NULL
+	    && atom->apply->recordProc == recordProc
+	    && atom->apply->clientData == clientData
+	    && atom->apply->recordType == type
+	    && MergeRecord(atom->apply->recordPtr, type, line, byteIndex,
+		    textObj)) {
+	atom->size += length;
+	stack->bytes += length;
+	return;
+    }
+
+    recordPtr = (TkUndoRecord *)ckalloc(sizeof(TkUndoRecord));
+    recordPtr->line = line;
+    recordPtr->byteIndex = byteIndex;
+    recordPtr->textObj = textObj;
+    Tcl_IncrRefCount(textObj);
+
+    atom = (TkUndoAtom *)ckalloc(sizeof(TkUndoAtom));
+    atom->type = TK_UNDO_ACTION;
+    atom->apply = MakeRecordSubAtom(recordProc, clientData, type, recordPtr);
+    atom->revert = MakeRecordSubAtom(recordProc, clientData,
+	    (type == TK_UNDO_INSERT) ? TK_UNDO_DELETE : TK_UNDO_INSERT,
+	    recordPtr);
+    atom->size = sizeof(TkUndoAtom) + 2 * sizeof(TkUndoSubAtom)
+	    + sizeof(TkUndoRecord) + length;
+
+    TkUndoPushStack(&stack->undoStack, atom);
+    stack->bytes += atom->size;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MakeRecordSubAtom --
+ *
+ *	Create a sub-atom that replays a record through 'recordProc'.
+ *
+ * Results:
+ *	The newly created subAtom.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TkUndoSubAtom *
+MakeRecordSubAtom(
+    TkUndoRecordProc *recordProc,
+    void *clientData,
+    TkUndoRecordType type,
+    TkUndoRecord *recordPtr)
+{
+    TkUndoSubAtom *atom = (TkUndoSubAtom *)ckalloc(sizeof(TkUndoSubAtom));
+
+    atom->command = NULL;
+    atom->funcPtr = NULL;
+    atom->clientData = clientData;
+    atom->recordProc = recordProc;
+    atom->recordType = type;
+    atom->recordPtr = recordPtr;
+    atom->action = NULL;
+    atom->next = NULL;
+    return atom;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MergeRecord --
+ *
+ *	Try to extend a record with a change that continues it: text typed
+ *	at its end, or text deleted just before or at its position. Only
+ *	changes within a single line are merged; a newline starts a new
+ *	record.
+ *
+ * Results:
+ *	1 if the change was merged into the record, 0 otherwise.
+ *
+ * Side effects:
+ *	The text and position of the record may change.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+MergeRecord(
+    TkUndoRecord *recordPtr,	/* Record on top of the undo stack. */
+    TkUndoRecordType type,	/* Kind of both the record and change. */
+    Tcl_Size line,		/* Position of the change. */
+    Tcl_Size byteIndex,
+    Tcl_Obj *textObj)		/* Text of the change. */
+{
+    Tcl_Size length, oldLength;
+    const char *string = Tcl_GetStringFromObj(textObj, &length);
+    const char *oldString = Tcl_GetStringFromObj(recordPtr->textObj,
+	    &oldLength);
+    Tcl_Obj *newObj;
+
+    if ((line != recordPtr->line) || memchr(string, '\n', length)
+	    || memchr(oldString, '\n', oldLength)) {
+	return 0;
+    }
+
+    if (byteIndex == recordPtr->byteIndex
+	    + ((type == TK_UNDO_INSERT) ? oldLength : 0)) {
+	/*
+	 * Typing at the end of the inserted text, or deleting forwards from
+	 * the same position: append.
+	 */
+
+	if (Tcl_IsShared(recordPtr->textObj)) {
+	    newObj = Tcl_DuplicateObj(recordPtr->textObj);
+	    Tcl_IncrRefCount(newObj);
+	    Tcl_DecrRefCount(recordPtr->textObj);
+	    recordPtr->textObj = newObj;
+	}
+	Tcl_AppendObjToObj(recordPtr->textObj, textObj);
+    } else if ((type == TK_UNDO_DELETE)
+	    && (byteIndex + length == recordPtr->byteIndex)) {
+	/*
+	 * Deleting backwards: prepend.
+	 */
+
+	newObj = Tcl_DuplicateObj(textObj);
+	Tcl_AppendObjToObj(newObj, recordPtr->textObj);
+	Tcl_IncrRefCount(newObj);
+	Tcl_DecrRefCount(recordPtr->textObj);
+	recordPtr->textObj = newObj;
+	recordPtr->byteIndex = byteIndex;
+    } else {
+	return 0;
+    }
+    return 1;
 }
 
 /*
@@ -241,6 +496,8 @@ TkUndoMakeCmdSubAtom(
     atom->command = command;
     atom->funcPtr = NULL;
     atom->clientData = NULL;
+    atom->recordProc = NULL;
+    atom->recordPtr = NULL;
     atom->next = NULL;
     atom->action = actionScript;
     if (atom->action != NULL) {
@@ -303,6 +560,8 @@ TkUndoMakeSubAtom(
     atom->command = NULL;
     atom->funcPtr = funcPtr;
     atom->clientData = clientData;
+    atom->recordProc = NULL;
+    atom->recordPtr = NULL;
     atom->next = NULL;
     atom->action = actionScript;
     if (atom->action != NULL) {
@@ -347,6 +606,8 @@ TkUndoInitStack(
     stack->interp = interp;
     stack->maxdepth = maxdepth;
     stack->depth = 0;
+    stack->maxBytes = 0;
+    stack->bytes = 0;
     return stack;
 }
 
@@ -396,34 +657,103 @@ TkUndoSetMaxDepth(
 	prevelem->next = NULL;
 	while (elem != NULL) {
 	    prevelem = elem;
-	    if (elem->type != TK_UNDO_SEPARATOR) {
-		TkUndoSubAtom *sub = elem->apply;
-		while (sub != NULL) {
-		    TkUndoSubAtom *next = sub->next;
-
-		    if (sub->action != NULL) {
-			Tcl_DecrRefCount(sub->action);
-		    }
-		    ckfree(sub);
-		    sub = next;
-		}
-		sub = elem->revert;
-		while (sub != NULL) {
-		    TkUndoSubAtom *next = sub->next;
-
-		    if (sub->action != NULL) {
-			Tcl_DecrRefCount(sub->action);
-		    }
-		    ckfree(sub);
-		    sub = next;
-		}
-	    }
 	    elem = elem->next;
-	    ckfree(prevelem);
+	    stack->bytes -= prevelem->size;
+	    FreeAtom(prevelem);
 	}
 	stack->depth = stack->maxdepth;
     }
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TkUndoSetMaxBytes --
+ *
+ *	Set the maximum amount of memory held by the undo stack. This bounds
+ *	the stack by the size of the changes on it rather than their number,
+ *	so a few huge pastes don't pin arbitrary amounts of memory.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May delete the oldest compound actions from the undo stack. The most
+ *	recent compound action is always kept.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TkUndoSetMaxBytes(
+    TkUndoRedoStack *stack,	/* An Undo/Redo stack */
+    Tcl_Size maxBytes)		/* The maximum number of bytes, or 0 */
+{
+    stack->maxBytes = maxBytes;
+    TrimUndoBytes(stack);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TrimUndoBytes --
+ *
+ *	Delete the oldest compound actions from the undo stack until it holds
+ *	no more than stack->maxBytes bytes, keeping at least the most recent
+ *	compound action.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Elements are removed from the bottom of the undo stack.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+TrimUndoBytes(
+    TkUndoRedoStack *stack)	/* An Undo/Redo stack */
+{
+    TkUndoAtom *elem, *keep = NULL;
+    Tcl_Size bytes = 0;
+
+    if (stack->maxBytes <= 0 || stack->bytes <= stack->maxBytes) {
+	return;
+    }
+
+    /*
+     * Find the oldest separator such that the compound actions above it
+     * fit, or else the separator ending the most recent compound action.
+     */
+
+    for (elem = stack->undoStack; elem != NULL; elem = elem->next) {
+	if (elem->type != TK_UNDO_SEPARATOR) {
+	    bytes += elem->size;
+	} else if (keep == NULL || bytes <= stack->maxBytes) {
+	    if (bytes > 0) {
+		keep = elem;
+	    }
+	} else {
+	    break;
+	}
+    }
+    if (keep == NULL || bytes <= stack->maxBytes) {
+	return;
+    }
+
+    elem = keep->next;
+    keep->next = NULL;
+    while (elem != NULL) {
+	keep = elem;
+	elem = elem->next;
+	if (keep->type == TK_UNDO_SEPARATOR && stack->depth > 0) {
+	    stack->depth--;
+	}
+	stack->bytes -= keep->size;
+	FreeAtom(keep);
+    }
+}
 
 /*
  *----------------------------------------------------------------------
@@ -448,6 +778,7 @@ TkUndoClearStacks(
     TkUndoClearStack(&stack->undoStack);
     TkUndoClearStack(&stack->redoStack);
     stack->depth = 0;
+    stack->bytes = 0;
 }
 
 /*
@@ -545,6 +876,7 @@ TkUndoInsertUndoSeparator(
     if (TkUndoInsertSeparator(&stack->undoStack)) {
 	stack->depth++;
 	TkUndoSetMaxDepth(stack, stack->maxdepth);
+	TrimUndoBytes(stack);
     }
 }
 
@@ -598,6 +930,7 @@ TkUndoRevert(
 
 	EvaluateActionList(stack->interp, elem->revert);
 
+	stack->bytes -= elem->size;
 	TkUndoPushStack(&stack->redoStack, elem);
 	elem = TkUndoPopStack(&stack->undoStack);
     }
@@ -660,6 +993,7 @@ TkUndoApply(
 
 	EvaluateActionList(stack->interp, elem->apply);
 
+	stack->bytes += elem->size;
 	TkUndoPushStack(&stack->undoStack, elem);
 	elem = TkUndoPopStack(&stack->redoStack);
     }
@@ -700,7 +1034,10 @@ EvaluateActionList(
     int result = TCL_OK;
 
     while (action != NULL) {
-	if (action->funcPtr != NULL) {
+	if (action->recordProc != NULL) {
+	    result = action->recordProc(interp, action->clientData,
+		    action->recordType, action->recordPtr);
+	} else if (action->funcPtr != NULL) {
 	    result = action->funcPtr(interp, action->clientData,
 		    action->action);
 	} else if (action->command != NULL) {
@@ -33,6 +33,28 @@ typedef enum {
 typedef int (TkUndoProc)(Tcl_Interp *interp, void *clientData,
 			Tcl_Obj *objPtr);
 
+/*
+ * Insertions and deletions of text can also be stored as native records
+ * (see TkUndoPushRecord) rather than as scripts. A record only holds the
+ * position of the change and a reference to the text involved, and is
+ * replayed by a C callback directly on the widget's data structures.
+ */
+
+typedef enum {
+    TK_UNDO_INSERT,		/* Insert the text at the position. */
+    TK_UNDO_DELETE		/* Delete the text found at the position. */
+} TkUndoRecordType;
+
+typedef struct TkUndoRecord {
+    Tcl_Size line;		/* Line of the first character changed. */
+    Tcl_Size byteIndex;		/* Byte offset of that character within its
+				 * line. */
+    Tcl_Obj *textObj;		/* The text inserted or deleted. */
+} TkUndoRecord;
+
+typedef int (TkUndoRecordProc)(Tcl_Interp *interp, void *clientData,
+			TkUndoRecordType type, TkUndoRecord *recordPtr);
+
 /*
  * Struct defining a single action, one or more of which may be defined (and
  * stored in a linked list) separately for each undo and redo action of an
@@ -47,7 +69,15 @@ typedef struct TkUndoSubAtom {
 				 * contain everything. */
     TkUndoProc *funcPtr;	/* Function pointer for callback to perform
 				 * undo/redo actions. */
-    void *clientData;	/* Data for 'funcPtr'. */
+    void *clientData;	/* Data for 'funcPtr' or 'recordProc'. */
+    TkUndoRecordProc *recordProc;
+				/* Function pointer for callback to replay
+				 * 'recordPtr', or NULL if this is not a
+				 * record sub-atom. */
+    TkUndoRecordType recordType;/* The change made by replaying the
+				 * record. */
+    TkUndoRecord *recordPtr;	/* Record shared by the apply and revert
+				 * sub-atoms of an atom. */
     Tcl_Obj *action;		/* Command to apply the action that was
 				 * taken. */
     struct TkUndoSubAtom *next;	/* Pointer to the next element in the linked
@@ -65,6 +95,8 @@ typedef struct TkUndoAtom {
 				 * for this operation. */
     TkUndoSubAtom *revert;	/* Linked list of 'revert' actions to perform
 				 * for this operation. */
+    Tcl_Size size;		/* Approximate number of bytes of memory held
+				 * by this atom. */
     struct TkUndoAtom *next;	/* Pointer to the next element in the
 				 * stack. */
 } TkUndoAtom;
@@ -80,6 +112,9 @@ typedef struct TkUndoRedoStack {
 				 * revert and apply scripts. */
     int maxdepth;
     int depth;
+    Tcl_Size maxBytes;		/* Maximum number of bytes held by the undo
+				 * stack, or 0 for no limit. */
+    Tcl_Size bytes;		/* Number of bytes held by the undo stack. */
 } TkUndoRedoStack;
 
 /*
@@ -97,6 +132,8 @@ MODULE_SCOPE void	TkUndoClearStack(TkUndoAtom **stack);
 
 MODULE_SCOPE TkUndoRedoStack *TkUndoInitStack(Tcl_Interp *interp, int maxdepth);
 MODULE_SCOPE void	TkUndoSetMaxDepth(TkUndoRedoStack *stack, int maxdepth);
+MODULE_SCOPE void	TkUndoSetMaxBytes(TkUndoRedoStack *stack,
+			    Tcl_Size maxBytes);
 MODULE_SCOPE void	TkUndoClearStacks(TkUndoRedoStack *stack);
 MODULE_SCOPE void	TkUndoFreeStack(TkUndoRedoStack *stack);
 MODULE_SCOPE int	TkUndoCanRedo(TkUndoRedoStack *stack);
@@ -109,6 +146,10 @@ MODULE_SCOPE TkUndoSubAtom *TkUndoMakeSubAtom(TkUndoProc *funcPtr,
 			    TkUndoSubAtom *subAtomList);
 MODULE_SCOPE void	TkUndoPushAction(TkUndoRedoStack *stack,
 			    TkUndoSubAtom *apply, TkUndoSubAtom *revert);
+MODULE_SCOPE void	TkUndoPushRecord(TkUndoRedoStack *stack,
+			    TkUndoRecordProc *recordProc, void *clientData,
+			    TkUndoRecordType type, Tcl_Size line,
+			    Tcl_Size byteIndex, Tcl_Obj *textObj);
 MODULE_SCOPE int	TkUndoRevert(TkUndoRedoStack *stack);
 MODULE_SCOPE int	TkUndoApply(TkUndoRedoStack *stack);
 
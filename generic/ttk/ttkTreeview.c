@@ -35,6 +35,15 @@ static const int HALO	= 4;	/* heading separator */
  *	item->next	==> item->next->parent == item->parent
  *	item->next	==> item->next->prev == item
  *	item->prev	==> item->prev->next == item
+ *
+ * The children of each item are also kept in a treap (a binary search
+ * tree by sibling order, heap-ordered by priority), whose nodes sum up
+ * the number of items, rows and visible items below them.  This gives
+ * the index of an item, the item at an index, and the item at a row in
+ * logarithmic time; positions are computed when needed rather than
+ * renumbered after each change.
+ *	item->children	<==> item->tRoot
+ *	item->tUp	==> item->tUp->priority >= item->priority
  */
 
 typedef struct TreeItemRec TreeItem;
@@ -67,11 +76,25 @@ struct TreeItemRec {
      */
     Ttk_TagSet	tagset;
     Ttk_ImageSpec *imagespec;
-    int itemPos;		/* Counting items */
-    int visiblePos;		/* Counting visible items */
-    int rowPos;			/* Counting rows (visible physical space) */
+    int row;			/* Row supplied by -rowcommand, or -1 */
+
+    /*
+     * Order statistics (see above):
+     */
+    TreeItem	*tRoot;		/* Treap of child items */
+    TreeItem	*tLeft;		/* Treap links among siblings */
+    TreeItem	*tRight;
+    TreeItem	*tUp;
+    unsigned	priority;	/* Treap priority */
+    int		nRows;		/* Rows of the item and visible descendants */
+    int		nVisible;	/* Visible items among them */
+    int		tItems;		/* Sums over the treap rooted here */
+    int		tRows;
+    int		tVisible;
 };
 
+#define TSUM(t, field)	((t) ? (t)->field : 0)
+
 #define ITEM_OPTION_TAGS_CHANGED	0x100
 #define ITEM_OPTION_IMAGE_CHANGED	0x200
 
@@ -108,6 +131,22 @@ static const Tk_OptionSpec ItemOptionSpecs[] = {
 static void RemoveTag(TreeItem *, Ttk_Tag);
 static void RemoveTagFromCellsAtItem(TreeItem *, Ttk_Tag);
 
+/* + ItemPriority --
+ *	Pseudo-random treap priority, obtained by hashing the item address.
+ */
+static unsigned ItemPriority(TreeItem *item)
+{
+    size_t addr = (size_t)item;
+    unsigned h = (unsigned)(addr >> 3) ^ (unsigned)((addr >> 16) >> 16);
+
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
 /* + NewItem --
  *	Allocate a new, uninitialized, unlinked item
  */
@@ -133,6 +172,12 @@ static TreeItem *NewItem(void)
 
     item->tagset = NULL;
     item->imagespec = NULL;
+    item->row = -1;
+
+    item->tRoot = item->tLeft = item->tRight = item->tUp = NULL;
+    item->priority = ItemPriority(item);
+    item->nRows = item->nVisible = 1;
+    item->tItems = item->tRows = item->tVisible = 1;
 
     return item;
 }
@@ -167,11 +212,110 @@ static void FreeItem(TreeItem *item)
 
 static void FreeItemCB(void *clientData) { FreeItem((TreeItem *)clientData); }
 
+/* + UpdateSums --
+ *	Recompute the treap sums of an item from its treap children.
+ */
+static void UpdateSums(TreeItem *t)
+{
+    t->tItems = 1 + TSUM(t->tLeft, tItems) + TSUM(t->tRight, tItems);
+    t->tRows = t->nRows + TSUM(t->tLeft, tRows) + TSUM(t->tRight, tRows);
+    t->tVisible = t->nVisible
+	    + TSUM(t->tLeft, tVisible) + TSUM(t->tRight, tVisible);
+}
+
+/* + RotateUp --
+ *	Rotate an item above its treap parent.
+ */
+static void RotateUp(TreeItem *t)
+{
+    TreeItem *up = t->tUp, *top = up->tUp;
+
+    if (up->tLeft == t) {
+	up->tLeft = t->tRight;
+	if (up->tLeft) {
+	    up->tLeft->tUp = up;
+	}
+	t->tRight = up;
+    } else {
+	up->tRight = t->tLeft;
+	if (up->tRight) {
+	    up->tRight->tUp = up;
+	}
+	t->tLeft = up;
+    }
+    up->tUp = t;
+    t->tUp = top;
+    if (!top) {
+	t->parent->tRoot = t;
+    } else if (top->tLeft == up) {
+	top->tLeft = t;
+    } else {
+	top->tRight = t;
+    }
+    UpdateSums(up);
+    UpdateSums(t);
+}
+
+/* + UpdateExtent --
+ *	Recompute the rows taken by an item after its -height, -hidden or
+ *	-open options or its children changed, and propagate the change
+ *	to its ancestors.
+ */
+static void UpdateExtent(TreeItem *item)
+{
+    TreeItem *t;
+
+    while (item) {
+	if (item->hidden) {
+	    item->nRows = item->nVisible = 0;
+	} else {
+	    item->nRows = item->height;
+	    item->nVisible = 1;
+	    if (item->state & TTK_STATE_OPEN) {
+		item->nRows += TSUM(item->tRoot, tRows);
+		item->nVisible += TSUM(item->tRoot, tVisible);
+	    }
+	}
+	for (t = item; t; t = t->tUp) {
+	    UpdateSums(t);
+	}
+	item = item->parent;
+    }
+}
+
 /* + DetachItem --
  *	Unlink an item from the tree.
  */
 static void DetachItem(TreeItem *item)
 {
+    TreeItem *parent = item->parent, *t;
+
+    if (parent) {
+	/* Rotate the item down to a leaf of the treap, and remove it:
+	 */
+	while (item->tLeft || item->tRight) {
+	    if (!item->tLeft || (item->tRight
+		    && item->tRight->priority > item->tLeft->priority)) {
+		RotateUp(item->tRight);
+	    } else {
+		RotateUp(item->tLeft);
+	    }
+	}
+	t = item->tUp;
+	if (!t) {
+	    parent->tRoot = NULL;
+	} else if (t->tLeft == item) {
+	    t->tLeft = NULL;
+	} else {
+	    t->tRight = NULL;
+	}
+	item->tUp = NULL;
+	UpdateSums(item);
+	for (; t; t = t->tUp) {
+	    UpdateSums(t);
+	}
+    }
+
     if (item->parent && item->parent->children == item)
 	item->parent->children = item->next;
     if (item->prev)
@@ -179,6 +323,10 @@ static void DetachItem(TreeItem *item)
     if (item->next)
 	item->next->prev = item->prev;
     item->next = item->prev = item->parent = NULL;
+
+    if (parent) {
+	UpdateExtent(parent);
+    }
 }
 
 /* + InsertItem --
@@ -190,6 +338,8 @@ static void DetachItem(TreeItem *item)
  */
 static void InsertItem(TreeItem *parent, TreeItem *prev, TreeItem *item)
 {
+    TreeItem *t;
+
     item->parent = parent;
     item->prev = prev;
     if (prev) {
@@ -202,6 +352,71 @@ static void InsertItem(TreeItem *parent, TreeItem *prev, TreeItem *item)
     if (item->next) {
 	item->next->prev = item;
     }
+
+    /* Link into the treap just after prev, and rotate up by priority:
+     */
+    if (!prev) {
+	t = parent->tRoot;
+	while (t && t->tLeft) {
+	    t = t->tLeft;
+	}
+    } else if (prev->tRight) {
+	t = prev->tRight;
+	while (t->tLeft) {
+	    t = t->tLeft;
+	}
+    } else {
+	t = prev;
+    }
+    item->tUp = t;
+    if (!t) {
+	parent->tRoot = item;
+    } else if (t == prev) {
+	t->tRight = item;
+    } else {
+	t->tLeft = item;
+    }
+    UpdateSums(item);
+    while (item->tUp && item->tUp->priority < item->priority) {
+	RotateUp(item);
+    }
+    UpdateExtent(item);
+}
+
+/* + ItemIndex --
+ *	Return the index of an item among its siblings.
+ */
+static Tcl_Size ItemIndex(TreeItem *item)
+{
+    Tcl_Size index = TSUM(item->tLeft, tItems);
+
+    for (; item->tUp; item = item->tUp) {
+	if (item->tUp->tRight == item) {
+	    index += 1 + TSUM(item->tUp->tLeft, tItems);
+	}
+    }
+    return index;
+}
+
+/* + NthChild --
+ *	Return the child of an item at the specified index, if any.
+ */
+static TreeItem *NthChild(TreeItem *parent, Tcl_Size index)
+{
+    TreeItem *t = parent->tRoot;
+
+    while (t) {
+	Tcl_Size nLeft = TSUM(t->tLeft, tItems);
+	if (index < nLeft) {
+	    t = t->tLeft;
+	} else if (index == nLeft) {
+	    break;
+	} else {
+	    index -= nLeft + 1;
+	    t = t->tRight;
+	}
+    }
+    return t;
 }
 
 /* + NextPreorder --
@@ -273,6 +488,22 @@ static const Tk_OptionSpec DisplayOptionSpecs[] = {
 
 static const Tk_OptionSpec *TagOptionSpecs = &DisplayOptionSpecs[2];
 
+/* Display items resolved during a redraw, shared by all rows and cells
+ * with the same tags, state and stripe (see CachedDisplayItem):
+ */
+#define DISPLAY_CACHE_SIZE 32
+
+enum { DISPLAY_ITEM, DISPLAY_TREE_CELL, DISPLAY_CELL };
+
+typedef struct {
+    Ttk_TagSet itemTags;	/* Tags of the item */
+    Ttk_TagSet cellTags;	/* Tags of the cell, NULL for DISPLAY_ITEM */
+    int kind;			/* DISPLAY_* */
+    Ttk_State state;
+    int odd;			/* Drawn with the striped background */
+    DisplayItem displayItem;
+} DisplayCacheEntry;
+
 /*------------------------------------------------------------------------
  * +++ Columns.
  *
@@ -447,6 +678,8 @@ typedef struct {
     Ttk_Layout headingLayout;
     Ttk_Layout rowLayout;
     Ttk_Layout separatorLayout;
+    Ttk_Element itemElements[3];	/* Anchored elements of itemLayout */
+    Ttk_Element cellElements[3];	/* Anchored elements of cellLayout */
 
     int headingHeight;		/* Space for headings */
     int rowHeight;		/* Height of each item */
@@ -463,7 +696,6 @@ typedef struct {
     TreeColumn *columns;	/* Array of column options for data columns */
 
     TreeItem *focus;		/* Current focus item */
-    TreeItem *endPtr;		/* See EndPosition() */
 
     /* Widget options:
      */
@@ -485,6 +717,17 @@ typedef struct {
     Scrollable yscroll;
     ScrollHandle yscrollHandle;
 
+    Tcl_Obj *rowCommandObj;	/* -rowcommand */
+    int rowCount;		/* -rowcount */
+
+    /* Virtual rows (see the "Virtual rows" section):
+     */
+    Tcl_HashTable rowTable;	/* Map: row number -> materialized item */
+    int rowEpoch;		/* Incremented each time the rows are flushed */
+    int fetchPending;		/* FetchRowsProc idle handler scheduled */
+    int fetchFailed;		/* -rowcommand failed in FetchRowsProc */
+    int virtualMode;		/* Whether the items come from -rowcommand */
+
     /* Derived resources:
      */
     Tcl_HashTable columnNames;	/* Map: column name -> column table entry */
@@ -494,11 +737,16 @@ typedef struct {
     int titleWidth;		/* Width of non-scrolled columns */
     int titleRows;		/* Height of non-scrolled items, in rows */
     int totalRows;		/* Height of non-hidden items, in rows */
-    int rowPosNeedsUpdate;	/* Internal rowPos data needs update */
+    int rowPosNeedsUpdate;	/* titleRows and totalRows need update */
     Ttk_Box headingArea;	/* Display area for column headings */
     Ttk_Box treeArea;	/* Display area for tree */
     int slack;			/* Slack space (see Resizing section) */
     unsigned showFlags;		/* bitmask of subparts to display */
+
+    /* Valid during a redraw only:
+     */
+    DisplayCacheEntry displayCache[DISPLAY_CACHE_SIZE];
+    int nDisplayCache;		/* Entries used in displayCache */
 } TreePart;
 
 typedef struct {
@@ -511,6 +759,7 @@ typedef struct {
 #define DCOLUMNS_CHANGED	(USER_MASK<<1)
 #define SCROLLCMD_CHANGED	(USER_MASK<<2)
 #define SHOW_CHANGED		(USER_MASK<<3)
+#define ROWS_CHANGED		(USER_MASK<<4)
 
 static const char *const SelectModeStrings[] = { "none", "browse", "extended", NULL };
 static const char *const SelectTypeStrings[] = { "item", "cell", NULL };
@@ -549,6 +798,13 @@ static const Tk_OptionSpec TreeviewOptionSpecs[] = {
 	DEF_STRIPED, TCL_INDEX_NONE, offsetof(Treeview,tree.striped),
 	0, 0, GEOMETRY_CHANGED},
 
+    {TK_OPTION_STRING, "-rowcommand", "rowCommand", "RowCommand",
+	NULL, offsetof(Treeview,tree.rowCommandObj), TCL_INDEX_NONE,
+	TK_OPTION_NULL_OK, 0, ROWS_CHANGED | GEOMETRY_CHANGED},
+    {TK_OPTION_INT, "-rowcount", "rowCount", "RowCount",
+	"0", TCL_INDEX_NONE, offsetof(Treeview,tree.rowCount),
+	0, 0, ROWS_CHANGED | GEOMETRY_CHANGED},
+
     {TK_OPTION_STRING, "-xscrollcommand", "xScrollCommand", "ScrollCommand",
 	NULL, offsetof(Treeview, tree.xscroll.scrollCmdObj), TCL_INDEX_NONE,
 	TK_OPTION_NULL_OK, 0, SCROLLCMD_CHANGED},
@@ -615,27 +871,36 @@ static void DisplayLayout(
     Ttk_DrawLayout(layout, state, d);
 }
 
+/* FindAnchoredElements --
+ *	Look up the image, text, and focus elements of an item or cell
+ *	layout, for DisplayLayoutTree.
+ */
+static void FindAnchoredElements(Ttk_Layout layout, Ttk_Element elements[3])
+{
+    elements[0] = Ttk_FindElement(layout, "image");
+    elements[1] = Ttk_FindElement(layout, "text");
+    elements[2] = Ttk_FindElement(layout, "focus");
+}
+
 /* DisplayLayoutTree --
  *	Like DisplayLayout, but for the tree column.
+ *	elements are the anchored elements found by FindAnchoredElements.
  */
 static void DisplayLayoutTree(
     Tk_Anchor imageAnchor, Tk_Anchor textAnchor,
-    Ttk_Layout layout, void *recordPtr, Ttk_State state, Ttk_Box b, Drawable d)
+    Ttk_Layout layout, Ttk_Element elements[3],
+    void *recordPtr, Ttk_State state, Ttk_Box b, Drawable d)
 {
-    Ttk_Element elem;
     Ttk_RebindSublayout(layout, recordPtr);
 
-    elem = Ttk_FindElement(layout, "image");
-    if (elem != NULL) {
-	Ttk_AnchorElement(elem, imageAnchor);
+    if (elements[0] != NULL) {
+	Ttk_AnchorElement(elements[0], imageAnchor);
     }
-    elem = Ttk_FindElement(layout, "text");
-    if (elem != NULL) {
-	Ttk_AnchorElement(elem, textAnchor);
+    if (elements[1] != NULL) {
+	Ttk_AnchorElement(elements[1], textAnchor);
     }
-    elem = Ttk_FindElement(layout, "focus");
-    if (elem != NULL) {
-	Ttk_AnchorElement(elem, textAnchor);
+    if (elements[2] != NULL) {
+	Ttk_AnchorElement(elements[2], textAnchor);
     }
 
     Ttk_PlaceLayout(layout, state, b);
@@ -1251,6 +1516,10 @@ static void TreeviewBindEventProc(void *clientData, XEvent *event)
  * +++ Initialization and cleanup.
  */
 
+static void FetchRowsProc(void *clientData); /*forward*/
+static void FlushRows(Treeview *tv); /*forward*/
+static void DeleteChildren(Treeview *tv, TreeItem *item); /*forward*/
+
 static void TreeviewInitialize(Tcl_Interp *interp, void *recordPtr)
 {
     Treeview *tv = (Treeview *)recordPtr;
@@ -1307,7 +1576,13 @@ static void TreeviewInitialize(Tcl_Interp *interp, void *recordPtr)
     Tcl_InitHashTable(&tv->tree.items, TCL_STRING_KEYS);
     tv->tree.serial = 0;
 
-    tv->tree.focus = tv->tree.endPtr = 0;
+    tv->tree.focus = 0;
+
+    Tcl_InitHashTable(&tv->tree.rowTable, TCL_ONE_WORD_KEYS);
+    tv->tree.rowEpoch = 0;
+    tv->tree.fetchPending = 0;
+    tv->tree.fetchFailed = 0;
+    tv->tree.virtualMode = 0;
 
     /* Create root item "":
      */
@@ -1350,6 +1625,11 @@ static void TreeviewCleanup(void *recordPtr)
     if (tv->tree.displayColumns)
 	ckfree(tv->tree.displayColumns);
 
+    if (tv->tree.fetchPending) {
+	Tcl_CancelIdleCall(FetchRowsProc, tv);
+    }
+    Tcl_DeleteHashTable(&tv->tree.rowTable);
+
     foreachHashEntry(&tv->tree.items, FreeItemCB);
     Tcl_DeleteHashTable(&tv->tree.items);
 
@@ -1395,6 +1675,12 @@ TreeviewConfigure(Tcl_Interp *interp, void *recordPtr, int mask)
 	Tcl_SetErrorCode(interp, "TTK", "TREE", "TITLEITEMS", (char *)NULL);
 	return TCL_ERROR;
     }
+    if (tv->tree.rowCount < 0) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"\"%d\" is out of range", tv->tree.rowCount));
+	Tcl_SetErrorCode(interp, "TTK", "TREE", "ROWCOUNT", (char *)NULL);
+	return TCL_ERROR;
+    }
     if (mask & SCROLLCMD_CHANGED) {
 	TtkScrollbarUpdateRequired(tv->tree.xscrollHandle);
 	TtkScrollbarUpdateRequired(tv->tree.yscrollHandle);
@@ -1409,6 +1695,17 @@ TreeviewConfigure(Tcl_Interp *interp, void *recordPtr, int mask)
 	return TCL_ERROR;
     }
 
+    if ((tv->tree.rowCommandObj != NULL) != tv->tree.virtualMode) {
+	/* Items of the other mode cannot be kept; unmap the rows first,
+	 * so that no row refers to a deleted item:
+	 */
+	FlushRows(tv);
+	DeleteChildren(tv, tv->tree.root);
+	tv->tree.virtualMode = (tv->tree.rowCommandObj != NULL);
+    } else if ((mask & ROWS_CHANGED) && tv->tree.virtualMode) {
+	FlushRows(tv);
+    }
+
     tv->tree.rowPosNeedsUpdate = 1;
     tv->tree.showFlags = showFlags;
 
@@ -1499,6 +1796,7 @@ static int ConfigureItem(
 	if (item->imagespec) { TtkFreeImageSpec(item->imagespec); }
 	item->imagespec = newImageSpec;
     }
+    UpdateExtent(item);
     tv->tree.rowPosNeedsUpdate = 1;
     TtkRedisplayWidget(&tv->core);
     return TCL_OK;
@@ -1600,81 +1898,156 @@ error:
  * +++ Geometry routines.
  */
 
-/* + UpdatePositionItem --
- *	Update position data for all visible items.
+/* + ItemRow --
+ *	Returns the row of an item, or -1 if it is not viewable because it
+ *	or one of its ancestors is hidden, closed or detached.  Also stores
+ *	its position among viewable items in *visiblePosPtr, if not NULL.
  */
-static void UpdatePositionItem(
-    Treeview *tv, TreeItem *item, int hidden,
-    int *rowPos, int *itemPos, int *visiblePos)
+static int ItemRow(Treeview *tv, TreeItem *item, int *visiblePosPtr)
 {
-    TreeItem *child = item->children;
-    item->itemPos = *itemPos;
-    *itemPos += 1;
+    TreeItem *p, *t;
+    int row = 0, visiblePos = 0;
 
-    if (item->hidden) {
-	hidden = 1;
+    if (tv->tree.virtualMode) {
+	row = visiblePos = item->row;
+	goto done;
     }
+    if (item == tv->tree.root || tv->tree.root->hidden) {
+	goto hidden;
+    }
+    for (p = item; p != tv->tree.root; p = p->parent) {
+	if (!p->parent || p->hidden
+		|| (p != item && !(p->state & TTK_STATE_OPEN))) {
+	    goto hidden;
+	}
 
-    if (hidden) {
-	item->rowPos = -1;
-	item->visiblePos = -1;
-    } else {
-	item->rowPos = *rowPos;
-	item->visiblePos = *visiblePos;
-	if (*visiblePos == tv->tree.nTitleItems) {
-	    tv->tree.titleRows = *rowPos;
+	/* Count the rows of the previous siblings:
+	 */
+	row += TSUM(p->tLeft, tRows);
+	visiblePos += TSUM(p->tLeft, tVisible);
+	for (t = p; t->tUp; t = t->tUp) {
+	    if (t->tUp->tRight == t) {
+		row += t->tUp->nRows + TSUM(t->tUp->tLeft, tRows);
+		visiblePos += t->tUp->nVisible + TSUM(t->tUp->tLeft, tVisible);
+	    }
+	}
+	if (p->parent != tv->tree.root) {
+	    row += p->parent->height;
+	    visiblePos += 1;
 	}
+    }
+    goto done;
 
-	*visiblePos += 1;
-	*rowPos += item->height;
+hidden:
+    row = visiblePos = -1;
+done:
+    if (visiblePosPtr) {
+	*visiblePosPtr = visiblePos;
     }
+    return row;
+}
+
+/* + ItemAtPosition --
+ *	Returns the viewable item at the specified row (if visible is 0)
+ *	or at the specified position among viewable items (if visible is
+ *	1), or NULL if there is none.
+ */
+static TreeItem *ItemAtPosition(Treeview *tv, int pos, int visible)
+{
+    TreeItem *parent = tv->tree.root, *t;
+    int nLeft, nHere;
 
-    if (!(item->state & TTK_STATE_OPEN)) {
-	hidden = 1;
+    if (pos < 0 || tv->tree.root->hidden) {
+	return NULL;
     }
-    while (child) {
-	UpdatePositionItem(tv, child, hidden, rowPos, itemPos, visiblePos);
-	child = child->next;
+    for (;;) {
+	/* Find the child whose rows include pos:
+	 */
+	t = parent->tRoot;
+	while (t) {
+	    nLeft = visible ? TSUM(t->tLeft, tVisible) : TSUM(t->tLeft, tRows);
+	    if (pos < nLeft) {
+		t = t->tLeft;
+		continue;
+	    }
+	    pos -= nLeft;
+	    nHere = visible ? t->nVisible : t->nRows;
+	    if (pos < nHere) {
+		break;
+	    }
+	    pos -= nHere;
+	    t = t->tRight;
+	}
+	if (!t) {
+	    return NULL;
+	}
+
+	/* Either this is the item itself, or one of its descendants:
+	 */
+	nHere = visible ? 1 : t->height;
+	if (pos < nHere) {
+	    return t;
+	}
+	pos -= nHere;
+	parent = t;
     }
 }
 
 /* + UpdatePositionTree --
- *	Update position data for all visible items.
+ *	Update the number of title rows and of rows in the tree.
  */
 static void UpdatePositionTree(Treeview *tv)
 {
-    /* -1 for the invisible root */
-    int rowPos = -1, itemPos = -1, visiblePos = -1;
-    tv->tree.titleRows = 0;
-    UpdatePositionItem(tv, tv->tree.root, 0, &rowPos, &itemPos, &visiblePos);
-    tv->tree.totalRows = rowPos;
+    TreeItem *item;
+
+    if (tv->tree.virtualMode) {
+	tv->tree.titleRows = tv->tree.nTitleItems < tv->tree.rowCount
+		? (int)tv->tree.nTitleItems : tv->tree.rowCount;
+	tv->tree.totalRows = tv->tree.rowCount;
+    } else {
+	item = ItemAtPosition(tv, (int)tv->tree.nTitleItems, 1);
+	tv->tree.titleRows = item ? ItemRow(tv, item, NULL) : 0;
+	tv->tree.totalRows = tv->tree.root->hidden
+		? 0 : TSUM(tv->tree.root->tRoot, tRows);
+    }
     tv->tree.rowPosNeedsUpdate = 0;
 }
 
-/* + IdentifyItem --
- *	Locate the item at the specified y position, if any.
+/* + IdentifyRow --
+ *	Returns the row at the specified y position, or -1 if none.
  */
-static TreeItem *IdentifyItem(Treeview *tv, int y)
+static int IdentifyRow(Treeview *tv, int y)
 {
-    TreeItem *item;
-    int rowHeight = tv->tree.rowHeight;
     int ypos = tv->tree.treeArea.y;
-    int nextRow, row;
+    int row;
     if (y < ypos) {
-	return NULL;
+	return -1;
     }
     if (tv->tree.rowPosNeedsUpdate) {
 	UpdatePositionTree(tv);
     }
-    row = (y - ypos) / rowHeight;
+    row = (y - ypos) / tv->tree.rowHeight;
     if (row >= tv->tree.titleRows) {
 	row += tv->tree.yscroll.first;
     }
-    for (item = tv->tree.root->children; item; item = NextPreorder(item)) {
-	nextRow = item->rowPos + item->height;
-	if (item->rowPos <= row && row < nextRow) break;
+    return row;
+}
+
+/* + IdentifyItem --
+ *	Locate the item at the specified y position, if any.
+ */
+static TreeItem *IdentifyItem(Treeview *tv, int y)
+{
+    int row = IdentifyRow(tv, y);
+    if (row < 0) {
+	return NULL;
+    }
+    if (tv->tree.virtualMode) {
+	Tcl_HashEntry *entryPtr =
+		Tcl_FindHashEntry(&tv->tree.rowTable, INT2PTR(row));
+	return entryPtr ? (TreeItem *)Tcl_GetHashValue(entryPtr) : NULL;
     }
-    return item;
+    return ItemAtPosition(tv, row, 0);
 }
 
 /* + IdentifyDisplayColumn --
@@ -1722,6 +2095,45 @@ static int ItemDepth(TreeItem *item)
     return depth-1;
 }
 
+/* + CompareItems --
+ *	Compare the positions of two items in preorder traversal order;
+ *	returns a negative, zero or positive number as for strcmp().
+ */
+static Tcl_Size CompareItems(Treeview *tv, TreeItem *a, TreeItem *b)
+{
+    int depthA = ItemDepth(a), depthB = ItemDepth(b);
+
+    if (tv->tree.virtualMode) {
+	return a->row - b->row;
+    }
+
+    /* An ancestor comes before its descendants:
+     */
+    for (; depthA > depthB; --depthA) {
+	a = a->parent;
+	if (a == b) {
+	    return 1;
+	}
+    }
+    for (; depthB > depthA; --depthB) {
+	b = b->parent;
+	if (a == b) {
+	    return -1;
+	}
+    }
+    if (a == b) {
+	return 0;
+    }
+
+    /* Otherwise compare the siblings among their ancestors:
+     */
+    while (a->parent != b->parent) {
+	a = a->parent;
+	b = b->parent;
+    }
+    return ItemIndex(a) - ItemIndex(b);
+}
+
 /* + DisplayRow --
  *	Returns the position row has on screen, or -1 if off-screen.
  */
@@ -1741,6 +2153,26 @@ static int DisplayRow(int row, Treeview *tv)
     return row - tv->tree.yscroll.first + tv->tree.titleRows;
 }
 
+/* + VisibleRowRange --
+ *	Returns the range of scrolled rows on screen; rows 0 to
+ *	titleRows-1 are always on screen too.
+ */
+static void VisibleRowRange(Treeview *tv, int *firstPtr, int *lastPtr)
+{
+    int visibleRows;
+
+    if (tv->tree.rowPosNeedsUpdate) {
+	UpdatePositionTree(tv);
+    }
+    visibleRows = tv->tree.treeArea.height / tv->tree.rowHeight
+	    - tv->tree.titleRows;
+    *firstPtr = tv->tree.titleRows + tv->tree.yscroll.first;
+    *lastPtr = *firstPtr + visibleRows;
+    if (*lastPtr >= tv->tree.totalRows) {
+	*lastPtr = tv->tree.totalRows - 1;
+    }
+}
+
 /* Is an item detached? The root is never detached. */
 static int IsDetached(Treeview* tv, TreeItem* item)
 {
@@ -1782,7 +2214,7 @@ static int BoundingBox(
     if (tv->tree.rowPosNeedsUpdate) {
 	UpdatePositionTree(tv);
     }
-    dispRow = DisplayRow(item->rowPos, tv);
+    dispRow = DisplayRow(ItemRow(tv, item, NULL), tv);
     if (dispRow < 0) {
 	/* not viewable, or off-screen */
 	return 0;
@@ -1924,6 +2356,8 @@ static Ttk_Layout TreeviewGetLayout(
     )) {
 	return 0;
     }
+    FindAnchoredElements(tv->tree.itemLayout, tv->tree.itemElements);
+    FindAnchoredElements(tv->tree.cellLayout, tv->tree.cellElements);
 
     /* Compute heading height.
      */
@@ -2122,29 +2556,125 @@ static void DrawSeparators(Treeview *tv, Drawable d)
  *	By copying it between each level, and NULL-ing stripedBgObj,
  *	it can be detected if the next level overrides it.
  */
- static void OverrideStriped(
-    Treeview *tv, TreeItem *item, DisplayItem *displayItem)
+ static void OverrideStriped(int odd, DisplayItem *displayItem)
 {
-    int striped = item->visiblePos % 2 && tv->tree.striped;
-    if (striped && displayItem->stripedBgObj) {
+    if (odd && displayItem->stripedBgObj) {
 	displayItem->backgroundObj = displayItem->stripedBgObj;
 	displayItem->stripedBgObj = NULL;
     }
 }
 
+/* + StripeParity --
+ *	Return 1 if an item is drawn with the striped background, 0 if not.
+ */
+static int StripeParity(Treeview *tv, TreeItem *item)
+{
+    int visiblePos;
+
+    if (!tv->tree.striped) {
+	return 0;
+    }
+    ItemRow(tv, item, &visiblePos);
+    return visiblePos % 2;
+}
+
+/* + PrepareDisplayItem --
+ *	Fill in a displayItem record for an item with the specified tags.
+ */
+static void PrepareDisplayItem(
+    Treeview *tv, Ttk_TagSet tagset, int odd,
+    DisplayItem *displayItem, Ttk_State state)
+{
+    Ttk_Style style = Ttk_LayoutStyle(tv->core.layout);
+
+    Ttk_TagSetDefaults(tv->tree.tagTable, style, displayItem);
+    OverrideStriped(odd, displayItem);
+    Ttk_TagSetValues(tv->tree.tagTable, tagset, displayItem);
+    OverrideStriped(odd, displayItem);
+    Ttk_TagSetApplyStyle(tv->tree.tagTable, style, state, displayItem);
+}
+
+/* + PrepareCellItem --
+ *	Apply the tags of a cell to a copy of its item's displayItem.
+ */
+static void PrepareCellItem(
+    Treeview *tv, Ttk_TagSet tagset, int odd,
+    DisplayItem *displayItem, Ttk_State state)
+{
+    Ttk_Style style = Ttk_LayoutStyle(tv->core.layout);
+
+    Ttk_TagSetValues(tv->tree.tagTable, tagset, displayItem);
+    OverrideStriped(odd, displayItem);
+    Ttk_TagSetApplyStyle(tv->tree.tagTable, style, state, displayItem);
+}
+
 /* + PrepareItem --
  *	Fill in a displayItem record.
  */
 static void PrepareItem(
     Treeview *tv, TreeItem *item, DisplayItem *displayItem, Ttk_State state)
 {
-    Ttk_Style style = Ttk_LayoutStyle(tv->core.layout);
+    PrepareDisplayItem(
+	    tv, item->tagset, StripeParity(tv, item), displayItem, state);
+}
 
-    Ttk_TagSetDefaults(tv->tree.tagTable, style, displayItem);
-    OverrideStriped(tv, item, displayItem);
-    Ttk_TagSetValues(tv->tree.tagTable, item->tagset, displayItem);
-    OverrideStriped(tv, item, displayItem);
-    Ttk_TagSetApplyStyle(tv->tree.tagTable, style, state, displayItem);
+/* + SameTagSet --
+ *	Return 1 if two tag sets hold the same tags, 0 if not.
+ */
+static int SameTagSet(Ttk_TagSet a, Ttk_TagSet b)
+{
+    if (a == b) {
+	return 1;
+    }
+    if (!a || !b || a->nTags != b->nTags) {
+	return 0;
+    }
+    return !memcmp(a->tags, b->tags, a->nTags * sizeof(Ttk_Tag));
+}
+
+/* + CachedDisplayItem --
+ *	Fill in a displayItem record for an item, or for one of its cells
+ *	from the item's displayItem in base, reusing the record prepared
+ *	for an earlier row or cell with the same tags, state, and stripe.
+ *
+ *	Tags, styles and columns cannot change while the widget is being
+ *	drawn, so the cache is simply emptied at the start of each redraw
+ *	(see DrawTreeArea), and never needs to be invalidated.
+ */
+static void CachedDisplayItem(
+    Treeview *tv, TreeItem *item, Ttk_TagSet cellTags, int kind,
+    const DisplayItem *base, int odd,
+    DisplayItem *displayItem, Ttk_State state)
+{
+    DisplayCacheEntry *entry;
+    int i;
+
+    for (i = 0; i < tv->tree.nDisplayCache; ++i) {
+	entry = &tv->tree.displayCache[i];
+	if (entry->kind == kind && entry->state == state && entry->odd == odd
+		&& SameTagSet(entry->itemTags, item->tagset)
+		&& SameTagSet(entry->cellTags, cellTags)) {
+	    *displayItem = entry->displayItem;
+	    return;
+	}
+    }
+
+    if (base) {
+	*displayItem = *base;
+	PrepareCellItem(tv, cellTags, odd, displayItem, state);
+    } else {
+	PrepareDisplayItem(tv, item->tagset, odd, displayItem, state);
+    }
+
+    if (tv->tree.nDisplayCache < DISPLAY_CACHE_SIZE) {
+	entry = &tv->tree.displayCache[tv->tree.nDisplayCache++];
+	entry->itemTags = item->tagset;
+	entry->cellTags = cellTags;
+	entry->kind = kind;
+	entry->state = state;
+	entry->odd = odd;
+	entry->displayItem = *displayItem;
+    }
 }
 
 /* Fill in data from item to temporary storage in columns. */
@@ -2189,12 +2719,11 @@ static void PrepareCells(
  *	Draw data cells for specified item.
  */
 static void DrawCells(
-    Treeview *tv, TreeItem *item,
+    Treeview *tv, TreeItem *item, int odd,
     DisplayItem *displayItem, DisplayItem *displayItemSel,
     Drawable d, int x, int y, int title)
 {
     Ttk_Layout layout = tv->tree.cellLayout;
-    Ttk_Style style = Ttk_LayoutStyle(tv->core.layout);
     Ttk_State state = ItemState(tv, item);
     short horizPad = round(4 * TkScalingLevel(tv->core.tkwin));
     Ttk_Padding cellPadding = {horizPad, 0, horizPad, 0};
@@ -2246,13 +2775,9 @@ static void DrawCells(
 	}
 
 	if (column->tagset) {
-	    displayItemLocal = *displayItemUsed;
+	    CachedDisplayItem(tv, item, column->tagset, DISPLAY_CELL,
+		    displayItemUsed, odd, &displayItemLocal, stateCell);
 	    displayItemUsed = &displayItemLocal;
-	    Ttk_TagSetValues(tv->tree.tagTable, column->tagset,
-		    displayItemUsed);
-	    OverrideStriped(tv, item, displayItemUsed);
-	    Ttk_TagSetApplyStyle(tv->tree.tagTable, style, stateCell,
-		    displayItemUsed);
 	}
 
 	displayItemUsed->textObj = column->data;
@@ -2276,23 +2801,23 @@ static void DrawCells(
 	    parcel = Ttk_PadBox(parcel, cellPadding);
 	}
 
-	DisplayLayoutTree(imageAnchor, textAnchor,
-		layout, displayItemUsed, state, parcel, d);
+	DisplayLayoutTree(imageAnchor, textAnchor, layout,
+		tv->tree.cellElements, displayItemUsed, state, parcel, d);
     }
 }
 
 /* + DrawItem --
- *	Draw an item (row background, tree label, and cells).
+ *	Draw an item (row background, tree label, and cells) at the
+ *	specified row.
  */
 static void DrawItem(
-    Treeview *tv, TreeItem *item, Drawable d, int depth)
+    Treeview *tv, TreeItem *item, Drawable d, int depth, int row)
 {
-    Ttk_Style style = Ttk_LayoutStyle(tv->core.layout);
     Ttk_State state = ItemState(tv, item);
     DisplayItem displayItem, displayItemSel, displayItemLocal;
-    int x, y, h, xTitle, dispRow, rowHeight;
+    int x, y, h, xTitle, dispRow, rowHeight, odd;
 
-    dispRow = DisplayRow(item->rowPos, tv);
+    dispRow = DisplayRow(row, tv);
     h = tv->tree.rowHeight * dispRow;
     if (h >= tv->tree.treeArea.height) {
 	/* The item is outside the visible area */
@@ -2304,8 +2829,11 @@ static void DrawItem(
     xTitle = tv->tree.treeArea.x;
     y = tv->tree.treeArea.y + h;
 
-    PrepareItem(tv, item, &displayItem, state);
-    PrepareItem(tv, item, &displayItemSel, state | TTK_STATE_SELECTED);
+    odd = StripeParity(tv, item);
+    CachedDisplayItem(tv, item, NULL, DISPLAY_ITEM, NULL, odd,
+	    &displayItem, state);
+    CachedDisplayItem(tv, item, NULL, DISPLAY_ITEM, NULL, odd,
+	    &displayItemSel, state | TTK_STATE_SELECTED);
 
     /* Draw row background:
      */
@@ -2324,7 +2852,7 @@ static void DrawItem(
     /* Draw data cells:
      */
     PrepareCells(tv, item);
-    DrawCells(tv, item, &displayItem, &displayItemSel, d, x, y, 0);
+    DrawCells(tv, item, odd, &displayItem, &displayItemSel, d, x, y, 0);
 
     /* Draw row background for non-scrolled area:
      */
@@ -2355,13 +2883,9 @@ static void DrawItem(
 	}
 
 	if (column->tagset) {
-	    displayItemLocal = *displayItemUsed;
+	    CachedDisplayItem(tv, item, column->tagset, DISPLAY_TREE_CELL,
+		    displayItemUsed, odd, &displayItemLocal, stateCell);
 	    displayItemUsed = &displayItemLocal;
-	    Ttk_TagSetValues(tv->tree.tagTable, column->tagset,
-		    displayItemUsed);
-	    OverrideStriped(tv, item, displayItemUsed);
-	    Ttk_TagSetApplyStyle(tv->tree.tagTable, style, stateCell,
-		    displayItemUsed);
 	}
 
 	displayItem.anchorObj = tv->tree.column0.anchorObj;
@@ -2385,47 +2909,103 @@ static void DrawItem(
 	}
 
 	parcel = Ttk_PadBox(parcel, cellPadding);
-	DisplayLayoutTree(imageAnchor, textAnchor,
-		tv->tree.itemLayout, displayItemUsed, state, parcel, d);
+	DisplayLayoutTree(imageAnchor, textAnchor, tv->tree.itemLayout,
+		tv->tree.itemElements, displayItemUsed, state, parcel, d);
 	xTitle += colwidth;
     }
 
     /* Draw non-scrolled data cells:
      */
     if (tv->tree.nTitleColumns > 1) {
-	DrawCells(tv, item, &displayItem, &displayItemSel, d, xTitle, y, 1);
+	DrawCells(tv, item, odd, &displayItem, &displayItemSel,
+		d, xTitle, y, 1);
     }
 }
 
-/* + DrawSubtree --
- *	Draw an item and all of its (viewable) descendants.
+/* + NextViewable --
+ *	Return the next viewable item in preorder traversal order,
+ *	skipping hidden items and the descendants of closed items,
+ *	and keep track of its depth.
  */
+static TreeItem *NextViewable(Treeview *tv, TreeItem *item, int *depthPtr)
+{
+    int descend = (item->state & TTK_STATE_OPEN) && item->children;
 
-static void DrawForest(	/* forward */
-    Treeview *tv, TreeItem *item, Drawable d, int depth);
+    for (;;) {
+	if (descend) {
+	    item = item->children;
+	    ++*depthPtr;
+	} else {
+	    while (!item->next) {
+		item = item->parent;
+		--*depthPtr;
+		if (!item || item == tv->tree.root) {
+		    return NULL;
+		}
+	    }
+	    item = item->next;
+	}
+	if (!item->hidden) {
+	    return item;
+	}
+	descend = 0;
+    }
+}
 
-static void DrawSubtree(
-    Treeview *tv, TreeItem *item, Drawable d, int depth)
+/* + DrawItems --
+ *	Draw the items from the specified first row to the last one.
+ *	The first item is found through the row counts of the tree,
+ *	so that the cost does not depend on the number of items.
+ */
+static void DrawItems(Treeview *tv, Drawable d, int first, int last)
 {
-    int dispRow = DisplayRow(item->rowPos, tv);
-    if (dispRow >= 0) {
-	DrawItem(tv, item, d, depth);
-    }
+    TreeItem *item = ItemAtPosition(tv, first, 0);
+    int depth, row;
 
-    if (item->state & TTK_STATE_OPEN) {
-	DrawForest(tv, item->children, d, depth + 1);
+    if (!item) {
+	return;
+    }
+    depth = ItemDepth(item);
+    row = ItemRow(tv, item, NULL);
+    while (item && row <= last) {
+	if (DisplayRow(row, tv) >= 0) {
+	    DrawItem(tv, item, d, depth, row);
+	}
+	row += item->height;
+	item = NextViewable(tv, item, &depth);
     }
 }
 
-/* + DrawForest --
- *	Draw a sequence of items and their visible descendants.
+/* + DrawRows --
+ *	Draw the visible rows of a treeview with -rowcommand.
+ *	Rows which are not materialized yet are left blank and
+ *	fetched later by FetchRowsProc; no script may run here.
  */
-static void DrawForest(
-    Treeview *tv, TreeItem *item, Drawable d, int depth)
+static void DrawRows(Treeview *tv, Drawable d)
 {
-    while (item) {
-	DrawSubtree(tv, item, d, depth);
-	item = item->next;
+    Tcl_HashEntry *entryPtr;
+    TreeItem *item;
+    int row, first, last;
+
+    VisibleRowRange(tv, &first, &last);
+    for (row = 0; row <= last; ++row) {
+	if (row == tv->tree.titleRows) {
+	    /* Skip from the title rows to the scrolled ones */
+	    row = first;
+	    if (row > last) {
+		break;
+	    }
+	}
+	entryPtr = Tcl_FindHashEntry(&tv->tree.rowTable, INT2PTR(row));
+	if (entryPtr) {
+	    item = (TreeItem *)Tcl_GetHashValue(entryPtr);
+	    if (DisplayRow(row, tv) >= 0) {
+		DrawItem(tv, item, d, 0, row);
+	    }
+	} else if (!tv->tree.fetchPending && !tv->tree.fetchFailed) {
+	    tv->tree.fetchPending = 1;
+	    Tcl_DoWhenIdle(FetchRowsProc, tv);
+	}
     }
 }
 
@@ -2433,10 +3013,19 @@ static void DrawForest(
  *     Draw the tree area including the headings, if any
  */
 static void DrawTreeArea(Treeview *tv, Drawable d) {
+    int first, last;
+
+    tv->tree.nDisplayCache = 0;
     if (tv->tree.showFlags & SHOW_HEADINGS) {
 	DrawHeadings(tv, d);
     }
-    DrawForest(tv, tv->tree.root->children, d, 0);
+    if (tv->tree.virtualMode) {
+	DrawRows(tv, d);
+    } else {
+	VisibleRowRange(tv, &first, &last);
+	DrawItems(tv, d, 0, tv->tree.titleRows - 1);
+	DrawItems(tv, d, first, last);
+    }
     DrawSeparators(tv, d);
 }
 
@@ -2536,47 +3125,26 @@ static void TreeviewDisplay(void *clientData, Drawable d)
  */
 static TreeItem *InsertPosition(TreeItem *parent, int index)
 {
-    TreeItem *prev = 0, *next = parent->children;
+    Tcl_Size nChildren = TSUM(parent->tRoot, tItems);
 
-    while (next != 0 && index > 0) {
-	--index;
-	prev = next;
-	next = prev->next;
+    if (index <= 0) {
+	return 0;
     }
-
-    return prev;
+    return NthChild(parent, (index < nChildren ? index : nChildren) - 1);
 }
 
 /* + EndPosition --
  *	Locate the last child of the specified node.
- *
- *	To avoid quadratic-time behavior in the common cases
- *	where the treeview is populated in breadth-first or
- *	depth-first order using [$tv insert $parent end ...],
- *	we cache the result from the last call to EndPosition()
- *	and start the search from there on a cache hit.
- *
  */
-static TreeItem *EndPosition(Treeview *tv, TreeItem *parent)
+static TreeItem *EndPosition(TreeItem *parent)
 {
-    TreeItem *endPtr = tv->tree.endPtr;
+    TreeItem *t = parent->tRoot;
 
-    while (endPtr && endPtr->parent != parent) {
-	endPtr = endPtr->parent;
-    }
-    if (!endPtr) {
-	endPtr = parent->children;
+    while (t && t->tRight) {
+	t = t->tRight;
     }
-
-    if (endPtr) {
-	while (endPtr->next) {
-	    endPtr = endPtr->next;
-	}
-	tv->tree.endPtr = endPtr;
-    }
-
-    return endPtr;
-}
+    return t;
+}
 
 /* + AncestryCheck --
  *	Verify that specified item is not an ancestor of the specified parent;
@@ -2619,6 +3187,347 @@ static TreeItem *DeleteItems(TreeItem *item, TreeItem *delq)
     return delq;
 }
 
+/* + DeleteChildren --
+ *	Delete all descendants of the specified item.
+ */
+static void DeleteChildren(Treeview *tv, TreeItem *item)
+{
+    TreeItem *delq = 0;
+
+    while (item->children) {
+	delq = DeleteItems(item->children, delq);
+    }
+    while (delq) {
+	TreeItem *next = delq->next;
+	if (tv->tree.focus == delq)
+	    tv->tree.focus = 0;
+	FreeItem(delq);
+	delq = next;
+    }
+    tv->tree.rowPosNeedsUpdate = 1;
+}
+
+/* + VirtualCheck --
+ *	Verify that the items of the treeview may be rearranged, which
+ *	is not the case with -rowcommand; returns 1 if OK, 0 and leaves
+ *	an error message in interp otherwise.
+ */
+static int VirtualCheck(Tcl_Interp *interp, Treeview *tv)
+{
+    if (tv->tree.virtualMode) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"Cannot rearrange the items of a treeview with -rowcommand",
+		-1));
+	Tcl_SetErrorCode(interp, "TTK", "TREE", "VIRTUAL", (char *)NULL);
+	return 0;
+    }
+    return 1;
+}
+
+/*------------------------------------------------------------------------
+ * +++ Virtual rows.
+ *
+ *	With -rowcommand, the treeview is a flat list of -rowcount rows and
+ *	only the rows which are needed are materialized as items: the
+ *	command is called with the row number and returns the item id
+ *	followed by item options.  Rows on screen are fetched by an idle
+ *	handler, since no script may run while the widget is drawn, and
+ *	rows asked for by [$tv identify], [$tv next] and [$tv prev] are
+ *	fetched at once.  At most ROW_CACHE_SIZE rows are kept in excess
+ *	of those on screen, except for the selected and focus items, which
+ *	thus keep their id across scrolling and -rowcount changes.
+ */
+
+#define ROW_CACHE_SIZE 256
+
+/* + PinnedItem --
+ *	Returns 1 if a materialized row must be kept, 0 otherwise.
+ */
+static int PinnedItem(Treeview *tv, TreeItem *item)
+{
+    return (item->state & TTK_STATE_SELECTED)
+	|| item->selObj != NULL
+	|| item == tv->tree.focus;
+}
+
+/* + UnmapRow --
+ *	Dissociate an item from its row.
+ */
+static void UnmapRow(Treeview *tv, TreeItem *item)
+{
+    Tcl_HashEntry *entryPtr;
+
+    if (item->row >= 0) {
+	entryPtr = Tcl_FindHashEntry(&tv->tree.rowTable, INT2PTR(item->row));
+	if (entryPtr) {
+	    Tcl_DeleteHashEntry(entryPtr);
+	}
+	item->row = -1;
+    }
+}
+
+/* + ForgetRow --
+ *	Delete a materialized row.
+ */
+static void ForgetRow(Treeview *tv, TreeItem *item)
+{
+    UnmapRow(tv, item);
+    DetachItem(item);
+    Tcl_DeleteHashEntry(item->entryPtr);
+    FreeItem(item);
+}
+
+/* + FlushRows --
+ *	Forget all materialized rows, keeping pinned items without a row.
+ */
+static void FlushRows(Treeview *tv)
+{
+    TreeItem *item = tv->tree.root->children, *next;
+
+    while (item) {
+	next = item->next;
+	UnmapRow(tv, item);
+	if (!PinnedItem(tv, item)) {
+	    ForgetRow(tv, item);
+	}
+	item = next;
+    }
+    ++tv->tree.rowEpoch;
+    tv->tree.fetchFailed = 0;
+    tv->tree.rowPosNeedsUpdate = 1;
+    TtkRedisplayWidget(&tv->core);
+}
+
+/* + EvictRows --
+ *	Delete the materialized rows which are far from rows first to last,
+ *	if there are too many of them.
+ */
+static void EvictRows(Treeview *tv, int first, int last)
+{
+    TreeItem *item, *next;
+    int count = 0, margin = last - first + 1;
+
+    for (item = tv->tree.root->children; item; item = item->next) {
+	++count;
+    }
+    if (count <= ROW_CACHE_SIZE + margin) {
+	return;
+    }
+    for (item = tv->tree.root->children; item; item = next) {
+	next = item->next;
+	if (PinnedItem(tv, item)) {
+	    continue;
+	}
+	if (item->row < 0 || (item->row >= tv->tree.titleRows
+		&& (item->row < first - margin || item->row > last + margin))) {
+	    ForgetRow(tv, item);
+	}
+    }
+    tv->tree.rowPosNeedsUpdate = 1;
+}
+
+/* + FetchRow --
+ *	Materialize the specified row, calling -rowcommand if needed.
+ *	Leaves NULL in *itemPtr if the row does not exist or the widget
+ *	was reconfigured or destroyed by the command.
+ */
+static int FetchRow(
+    Tcl_Interp *interp, Treeview *tv, int row, TreeItem **itemPtr)
+{
+    Tcl_HashEntry *entryPtr, *rowEntryPtr;
+    Tcl_Obj *cmdObj, *resultObj, **elements;
+    Tcl_Size nElements;
+    TreeItem *item, *prev, *next;
+    int epoch = tv->tree.rowEpoch, code, isNew;
+
+    *itemPtr = NULL;
+    if (!tv->tree.virtualMode || row < 0 || row >= tv->tree.rowCount) {
+	return TCL_OK;
+    }
+    rowEntryPtr = Tcl_FindHashEntry(&tv->tree.rowTable, INT2PTR(row));
+    if (rowEntryPtr) {
+	*itemPtr = (TreeItem *)Tcl_GetHashValue(rowEntryPtr);
+	return TCL_OK;
+    }
+
+    cmdObj = Tcl_DuplicateObj(tv->tree.rowCommandObj);
+    Tcl_IncrRefCount(cmdObj);
+    code = Tcl_ListObjAppendElement(interp, cmdObj, Tcl_NewIntObj(row));
+    if (code == TCL_OK) {
+	code = Tcl_EvalObjEx(interp, cmdObj, TCL_EVAL_GLOBAL);
+    }
+    Tcl_DecrRefCount(cmdObj);
+    if (code != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /* The command may have done anything to the widget:
+     */
+    if ((tv->core.flags & WIDGET_DESTROYED) || epoch != tv->tree.rowEpoch) {
+	Tcl_ResetResult(interp);
+	return TCL_OK;
+    }
+    rowEntryPtr = Tcl_CreateHashEntry(
+	    &tv->tree.rowTable, INT2PTR(row), &isNew);
+    if (!isNew) {
+	*itemPtr = (TreeItem *)Tcl_GetHashValue(rowEntryPtr);
+	Tcl_ResetResult(interp);
+	return TCL_OK;
+    }
+
+    resultObj = Tcl_GetObjResult(interp);
+    Tcl_IncrRefCount(resultObj);
+    if (Tcl_ListObjGetElements(interp, resultObj, &nElements, &elements)
+	    != TCL_OK) {
+	goto error;
+    }
+    if (nElements % 2 == 0) {
+	Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		"Row %d: expected item id followed by option value pairs",
+		row));
+	Tcl_SetErrorCode(interp, "TTK", "TREE", "ROW", (char *)NULL);
+	goto error;
+    }
+
+    entryPtr = Tcl_CreateHashEntry(
+	    &tv->tree.items, Tcl_GetString(elements[0]), &isNew);
+    if (isNew) {
+	item = NewItem();
+	Tk_InitOptions(interp, item, tv->tree.itemOptionTable, tv->core.tkwin);
+	item->tagset = Ttk_GetTagSetFromObj(NULL, tv->tree.tagTable, NULL);
+	if (ConfigureItem(interp, tv, item, nElements-1, elements+1)
+		!= TCL_OK) {
+	    Tcl_DeleteHashEntry(entryPtr);
+	    FreeItem(item);
+	    goto error;
+	}
+	Tcl_SetHashValue(entryPtr, item);
+	item->entryPtr = entryPtr;
+    } else {
+	item = (TreeItem *)Tcl_GetHashValue(entryPtr);
+	if (item == tv->tree.root) {
+	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+		    "Row %d: cannot use the root item", row));
+	    Tcl_SetErrorCode(interp, "TTK", "TREE", "ROOT", (char *)NULL);
+	    goto error;
+	}
+	if (ConfigureItem(interp, tv, item, nElements-1, elements+1)
+		!= TCL_OK) {
+	    goto error;
+	}
+	/* The item moves from its former row, if any */
+	UnmapRow(tv, item);
+	DetachItem(item);
+    }
+    Tcl_DecrRefCount(resultObj);
+
+    /* Rows are a flat list of single-height items, in row order:
+     */
+    item->height = 1;
+    item->row = row;
+    Tcl_SetHashValue(rowEntryPtr, item);
+    prev = NULL;
+    for (next = tv->tree.root->children; next && next->row < row;
+	    next = next->next) {
+	prev = next;
+    }
+    InsertItem(tv->tree.root, prev, item);
+
+    tv->tree.rowPosNeedsUpdate = 1;
+    Tcl_ResetResult(interp);
+    *itemPtr = item;
+    return TCL_OK;
+
+error:
+    Tcl_DeleteHashEntry(rowEntryPtr);
+    Tcl_DecrRefCount(resultObj);
+    return TCL_ERROR;
+}
+
+/* + FetchRowAt --
+ *	Materialize the row at the specified y position, if any.
+ */
+static int FetchRowAt(Tcl_Interp *interp, Treeview *tv, int y)
+{
+    TreeItem *unused;
+
+    if (!tv->tree.virtualMode) {
+	return TCL_OK;
+    }
+    return FetchRow(interp, tv, IdentifyRow(tv, y), &unused);
+}
+
+/* + FetchRowsProc --
+ *	Idle handler materializing the rows on screen, scheduled by
+ *	DrawRows().  Errors in -rowcommand are background errors;
+ *	after one, rows are not fetched in the background again until
+ *	the rows are flushed, or every redisplay would fail again.
+ */
+static void FetchRowsProc(void *clientData)
+{
+    Treeview *tv = (Treeview *)clientData;
+    Tcl_Interp *interp = tv->core.interp;
+    TreeItem *item;
+    int row, first, last;
+
+    tv->tree.fetchPending = 0;
+    if (!tv->tree.virtualMode) {
+	return;
+    }
+
+    Tcl_Preserve(clientData);
+    VisibleRowRange(tv, &first, &last);
+    for (row = 0; row <= last; ++row) {
+	if (row == tv->tree.titleRows) {
+	    row = first;
+	    if (row > last) {
+		break;
+	    }
+	}
+	if (FetchRow(interp, tv, row, &item) != TCL_OK) {
+	    tv->tree.fetchFailed = 1;
+	    Tcl_BackgroundException(interp, TCL_ERROR);
+	    break;
+	}
+	if (!item) {
+	    /* Reconfigured or destroyed meanwhile */
+	    break;
+	}
+    }
+    if (!(tv->core.flags & WIDGET_DESTROYED) && !tv->tree.fetchFailed) {
+	EvictRows(tv, first, last);
+	TtkRedisplayWidget(&tv->core);
+    }
+    Tcl_Release(clientData);
+}
+
+/* + SetItemValue --
+ *	Set the value of an item in the specified data column.
+ */
+static void SetItemValue(
+    Treeview *tv, TreeItem *item, Tcl_Size columnNumber, Tcl_Obj *valueObj)
+{
+    Tcl_Size length;
+
+    /* Make sure -values exists and is fully populated:
+     */
+    if (!item->valuesObj) {
+	item->valuesObj = Tcl_NewListObj(0,0);
+	Tcl_IncrRefCount(item->valuesObj);
+    }
+    item->valuesObj = unshareObj(item->valuesObj);
+    Tcl_ListObjLength(NULL, item->valuesObj, &length);
+    while (length < tv->tree.nColumns) {
+	Tcl_Obj *empty = Tcl_NewStringObj("",0);
+	Tcl_ListObjAppendElement(NULL, item->valuesObj, empty);
+	++length;
+    }
+
+    /* Set value:
+     */
+    Tcl_ListObjReplace(NULL, item->valuesObj, columnNumber, 1, 1, &valueObj);
+}
+
 /*------------------------------------------------------------------------
  * +++ Widget commands -- item inquiry.
  */
@@ -2649,10 +3558,14 @@ static int TreeviewChildrenCommand(
 	}
 	Tcl_SetObjResult(interp, result);
     } else {
-	TreeItem **newChildren = GetItemListFromObj(interp, tv, objv[3]);
+	TreeItem **newChildren;
 	TreeItem *child;
 	int i;
 
+	if (!VirtualCheck(interp, tv)) {
+	    return TCL_ERROR;
+	}
+	newChildren = GetItemListFromObj(interp, tv, objv[3]);
 	if (!newChildren)
 	    return TCL_ERROR;
 
@@ -2750,7 +3663,17 @@ static int TreeviewNextCommand(
 	return TCL_ERROR;
     }
 
-    if (item->next) {
+    if (tv->tree.virtualMode) {
+	/* Rows are materialized on demand */
+	TreeItem *sibling = NULL;
+	if (item->row >= 0 && FetchRow(
+		interp, tv, item->row + 1, &sibling) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (sibling) {
+	    Tcl_SetObjResult(interp, ItemID(tv, sibling));
+	}
+    } else if (item->next) {
 	Tcl_SetObjResult(interp, ItemID(tv, item->next));
     } /* else -- leave interp-result empty */
 
@@ -2775,7 +3698,17 @@ static int TreeviewPrevCommand(
 	return TCL_ERROR;
     }
 
-    if (item->prev) {
+    if (tv->tree.virtualMode) {
+	/* Rows are materialized on demand */
+	TreeItem *sibling = NULL;
+	if (item->row >= 0 && FetchRow(
+		interp, tv, item->row - 1, &sibling) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (sibling) {
+	    Tcl_SetObjResult(interp, ItemID(tv, sibling));
+	}
+    } else if (item->prev) {
 	Tcl_SetObjResult(interp, ItemID(tv, item->prev));
     } /* else -- leave interp-result empty */
 
@@ -2801,9 +3734,10 @@ static int TreeviewIndexCommand(
 	return TCL_ERROR;
     }
 
-    while (item->prev) {
-	++index;
-	item = item->prev;
+    if (tv->tree.virtualMode && item->row >= 0) {
+	index = item->row;
+    } else {
+	index = ItemIndex(item);
     }
 
     Tcl_SetObjResult(interp, TkNewIndexObj(index));
@@ -2886,9 +3820,13 @@ static int TreeviewHorribleIdentify(
     /* ASSERT: objc == 4 */
 
     if (Tk_GetPixelsFromObj(interp, tv->core.tkwin, objv[2], &x) != TCL_OK
-	    || Tk_GetPixelsFromObj(interp, tv->core.tkwin, objv[3], &y) != TCL_OK) {
+	    || Tk_GetPixelsFromObj(interp, tv->core.tkwin, objv[3], &y) != TCL_OK
+	    || FetchRowAt(interp, tv, y) != TCL_OK) {
 	return TCL_ERROR;
     }
+    if (tv->core.flags & WIDGET_DESTROYED) {
+	return TCL_OK;
+    }
 
     dColumnNumber = IdentifyDisplayColumn(tv, x, &x1);
     if (dColumnNumber < 0) {
@@ -2985,6 +3923,13 @@ static int TreeviewIdentifyCommand(
     TtkUpdateScrollInfo(tv->tree.xscrollHandle);
     TtkUpdateScrollInfo(tv->tree.yscrollHandle);
 
+    if (FetchRowAt(interp, tv, y) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (tv->core.flags & WIDGET_DESTROYED) {
+	return TCL_OK;
+    }
+
     region = IdentifyRegion(tv, x, y);
     item = IdentifyItem(tv, y);
     colno = IdentifyDisplayColumn(tv, x, &x1);
@@ -3224,69 +4169,87 @@ static int TreeviewSetCommand(
 	Tcl_SetObjResult(interp, result);
 	return TCL_OK;
     } else {		/* set column */
-	Tcl_Size length;
-
-	item->valuesObj = unshareObj(item->valuesObj);
-
-	/* Make sure -values is fully populated:
-	 */
-	Tcl_ListObjLength(interp, item->valuesObj, &length);
-	while (length < tv->tree.nColumns) {
-	    Tcl_Obj *empty = Tcl_NewStringObj("",0);
-	    Tcl_ListObjAppendElement(interp, item->valuesObj, empty);
-	    ++length;
-	}
-
-	/* Set value:
-	 */
-	Tcl_ListObjReplace(interp,item->valuesObj,columnNumber,1,1,objv+4);
+	SetItemValue(tv, item, columnNumber, objv[4]);
 	TtkRedisplayWidget(&tv->core);
 	return TCL_OK;
     }
 }
 
-/*------------------------------------------------------------------------
- * +++ Widget commands -- tree modification.
- */
-
-/* + $tv insert $parent $index ?-id id? ?-option value ...?
- *	Insert a new item.
+/* + $tv setmany {$item $column $value ...} --
+ *	Set the values of many cells at once; nothing is set if any
+ *	item or column is invalid.
  */
-static int TreeviewInsertCommand(
+static int TreeviewSetManyCommand(
     void *recordPtr, Tcl_Interp *interp, Tcl_Size objc, Tcl_Obj *const objv[])
 {
     Treeview *tv = (Treeview *)recordPtr;
-    TreeItem *parent, *sibling, *newItem;
-    Tcl_HashEntry *entryPtr;
-    int isNew;
+    TreeCell *cells;
+    Tcl_Obj **elements;
+    Tcl_Size nElements, i;
 
-    if (objc < 4) {
-	Tcl_WrongNumArgs(interp, 2, objv, "parent index ?-id id? -options...");
+    if (objc != 3) {
+	Tcl_WrongNumArgs(interp, 2, objv, "{item column value ...}");
 	return TCL_ERROR;
     }
-
-    /* Get parent node:
-     */
-    if ((parent = FindItem(interp, tv, objv[2])) == NULL) {
+    if (Tcl_ListObjGetElements(interp, objv[2], &nElements, &elements)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (nElements % 3 != 0) {
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"list must contain item, column and value triples", -1));
+	Tcl_SetErrorCode(interp, "TTK", "TREE", "SETMANY", (char *)NULL);
 	return TCL_ERROR;
     }
 
-    /* Locate previous sibling based on $index:
+    /* Look up all cells before setting any of them:
      */
-    if (!strcmp(Tcl_GetString(objv[3]), "end")) {
-	sibling = EndPosition(tv, parent);
-    } else {
-	int index;
-	if (Tcl_GetIntFromObj(interp, objv[3], &index) != TCL_OK)
+    cells = (TreeCell *)ckalloc((nElements / 3 + 1) * sizeof(TreeCell));
+    for (i = 0; i < nElements / 3; ++i) {
+	if (!(cells[i].item = FindItem(interp, tv, elements[3*i]))
+		|| !(cells[i].column = FindColumn(interp, tv, elements[3*i+1]))) {
+	    ckfree(cells);
+	    return TCL_ERROR;
+	}
+	if (cells[i].column == &tv->tree.column0) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "Display column #0 cannot be set", -1));
+	    Tcl_SetErrorCode(interp, "TTK", "TREE", "COLUMN_0", (char *)NULL);
+	    ckfree(cells);
 	    return TCL_ERROR;
-	sibling = InsertPosition(parent, index);
+	}
+    }
+
+    for (i = 0; i < nElements / 3; ++i) {
+	SetItemValue(tv, cells[i].item, cells[i].column - tv->tree.columns,
+		elements[3*i+2]);
     }
+    ckfree(cells);
+
+    TtkRedisplayWidget(&tv->core);
+    return TCL_OK;
+}
+
+/*------------------------------------------------------------------------
+ * +++ Widget commands -- tree modification.
+ */
+
+/* + CreateItem --
+ *	Create a new, unlinked item from a ?-id id? ?-option value ...?
+ *	list, for [$tv insert] and [$tv insertmany].
+ *	Returns NULL and leaves an error message in interp on error.
+ */
+static TreeItem *CreateItem(
+    Tcl_Interp *interp, Treeview *tv, Tcl_Size objc, Tcl_Obj *const objv[])
+{
+    TreeItem *newItem;
+    Tcl_HashEntry *entryPtr;
+    int isNew;
 
     /* Get node name:
      *     If -id supplied and does not already exist, use that;
      *     Otherwise autogenerate new one.
      */
-    objc -= 4; objv += 4;
     if (objc >= 2 && !strcmp("-id", Tcl_GetString(objv[0]))) {
 	const char *itemName = Tcl_GetString(objv[1]);
 
@@ -3295,7 +4258,7 @@ static int TreeviewInsertCommand(
 	    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
 		"Item %s already exists", itemName));
 	    Tcl_SetErrorCode(interp, "TTK", "TREE", "ITEM_EXISTS", (char *)NULL);
-	    return TCL_ERROR;
+	    return NULL;
 	}
 	objc -= 2; objv += 2;
     } else {
@@ -3316,13 +4279,73 @@ static int TreeviewInsertCommand(
     if (ConfigureItem(interp, tv, newItem, objc, objv) != TCL_OK) {
 	Tcl_DeleteHashEntry(entryPtr);
 	FreeItem(newItem);
-	return TCL_ERROR;
+	return NULL;
     }
 
-    /* Store in hash table, link into tree:
+    /* Store in hash table:
      */
     Tcl_SetHashValue(entryPtr, newItem);
     newItem->entryPtr = entryPtr;
+    return newItem;
+}
+
+/* + GetInsertPosition --
+ *	Locate the previous sibling for [$tv insert] and [$tv insertmany]
+ *	from a parent and an index argument.
+ */
+static int GetInsertPosition(
+    Tcl_Interp *interp, Treeview *tv, Tcl_Obj *parentObj, Tcl_Obj *indexObj,
+    TreeItem **parentPtr, TreeItem **siblingPtr)
+{
+    TreeItem *parent;
+
+    if (!VirtualCheck(interp, tv)) {
+	return TCL_ERROR;
+    }
+
+    /* Get parent node:
+     */
+    if ((parent = FindItem(interp, tv, parentObj)) == NULL) {
+	return TCL_ERROR;
+    }
+
+    /* Locate previous sibling based on $index:
+     */
+    if (!strcmp(Tcl_GetString(indexObj), "end")) {
+	*siblingPtr = EndPosition(parent);
+    } else {
+	int index;
+	if (Tcl_GetIntFromObj(interp, indexObj, &index) != TCL_OK)
+	    return TCL_ERROR;
+	*siblingPtr = InsertPosition(parent, index);
+    }
+    *parentPtr = parent;
+    return TCL_OK;
+}
+
+/* + $tv insert $parent $index ?-id id? ?-option value ...?
+ *	Insert a new item.
+ */
+static int TreeviewInsertCommand(
+    void *recordPtr, Tcl_Interp *interp, Tcl_Size objc, Tcl_Obj *const objv[])
+{
+    Treeview *tv = (Treeview *)recordPtr;
+    TreeItem *parent, *sibling, *newItem;
+
+    if (objc < 4) {
+	Tcl_WrongNumArgs(interp, 2, objv, "parent index ?-id id? -options...");
+	return TCL_ERROR;
+    }
+    if (GetInsertPosition(interp, tv, objv[2], objv[3], &parent, &sibling)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if (!(newItem = CreateItem(interp, tv, objc - 4, objv + 4))) {
+	return TCL_ERROR;
+    }
+
+    /* Link into tree:
+     */
     InsertItem(parent, sibling, newItem);
     tv->tree.rowPosNeedsUpdate = 1;
     TtkRedisplayWidget(&tv->core);
@@ -3331,6 +4354,62 @@ static int TreeviewInsertCommand(
     return TCL_OK;
 }
 
+/* + $tv insertmany $parent $index $rows --
+ *	Insert a list of new items, each described by a list of
+ *	?-id id? ?-option value ...?; either all of them are inserted,
+ *	or none.
+ */
+static int TreeviewInsertManyCommand(
+    void *recordPtr, Tcl_Interp *interp, Tcl_Size objc, Tcl_Obj *const objv[])
+{
+    Treeview *tv = (Treeview *)recordPtr;
+    TreeItem *parent, *sibling, **newItems;
+    Tcl_Obj **rows, **elements, *result;
+    Tcl_Size nRows, nElements, i;
+
+    if (objc != 5) {
+	Tcl_WrongNumArgs(interp, 2, objv, "parent index rows");
+	return TCL_ERROR;
+    }
+    if (GetInsertPosition(interp, tv, objv[2], objv[3], &parent, &sibling)
+	    != TCL_OK
+	    || Tcl_ListObjGetElements(interp, objv[4], &nRows, &rows)
+	    != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    /* Create all items before linking any of them:
+     */
+    newItems = (TreeItem **)ckalloc((nRows + 1) * sizeof(TreeItem *));
+    for (i = 0; i < nRows; ++i) {
+	if (Tcl_ListObjGetElements(interp, rows[i], &nElements, &elements)
+		!= TCL_OK
+		|| !(newItems[i] = CreateItem(interp, tv, nElements, elements))) {
+	    while (i-- > 0) {
+		Tcl_DeleteHashEntry(newItems[i]->entryPtr);
+		FreeItem(newItems[i]);
+	    }
+	    ckfree(newItems);
+	    return TCL_ERROR;
+	}
+    }
+
+    /* Link them into the tree:
+     */
+    result = Tcl_NewListObj(0, 0);
+    for (i = 0; i < nRows; ++i) {
+	InsertItem(parent, sibling, newItems[i]);
+	sibling = newItems[i];
+	Tcl_ListObjAppendElement(NULL, result, ItemID(tv, newItems[i]));
+    }
+    ckfree(newItems);
+
+    tv->tree.rowPosNeedsUpdate = 1;
+    TtkRedisplayWidget(&tv->core);
+    Tcl_SetObjResult(interp, result);
+    return TCL_OK;
+}
+
 /* + $tv detach $items --
  *	Unlink each item in $items from the tree.
  */
@@ -3345,7 +4424,8 @@ static int TreeviewDetachCommand(
 	Tcl_WrongNumArgs(interp, 2, objv, "item");
 	return TCL_ERROR;
     }
-    if (!(items = GetItemListFromObj(interp, tv, objv[2]))) {
+    if (!VirtualCheck(interp, tv)
+	    || !(items = GetItemListFromObj(interp, tv, objv[2]))) {
 	return TCL_ERROR;
     }
 
@@ -3432,7 +4512,8 @@ static int TreeviewDeleteCommand(
 	return TCL_ERROR;
     }
 
-    if (!(items = GetItemListFromObj(interp, tv, objv[2]))) {
+    if (!VirtualCheck(interp, tv)
+	    || !(items = GetItemListFromObj(interp, tv, objv[2]))) {
 	return TCL_ERROR;
     }
 
@@ -3470,8 +4551,6 @@ static int TreeviewDeleteCommand(
 	TreeItem *next = delq->next;
 	if (tv->tree.focus == delq)
 	    tv->tree.focus = 0;
-	if (tv->tree.endPtr == delq)
-	    tv->tree.endPtr = 0;
 	FreeItem(delq);
 	delq = next;
     }
@@ -3499,6 +4578,9 @@ static int TreeviewMoveCommand(
 	Tcl_WrongNumArgs(interp, 2, objv, "item parent index");
 	return TCL_ERROR;
     }
+    if (!VirtualCheck(interp, tv)) {
+	return TCL_ERROR;
+    }
     if ((item = FindItem(interp, tv, objv[2])) == 0
 	    || (parent = FindItem(interp, tv, objv[3])) == 0) {
 	return TCL_ERROR;
@@ -3507,21 +4589,29 @@ static int TreeviewMoveCommand(
     /* Locate previous sibling based on $index:
      */
     if (!strcmp(Tcl_GetString(objv[4]), "end")) {
-	sibling = EndPosition(tv, parent);
+	sibling = EndPosition(parent);
     } else {
-	TreeItem *p;
 	int index;
 
 	if (Tcl_GetIntFromObj(interp, objv[4], &index) != TCL_OK) {
 	    return TCL_ERROR;
 	}
 
+	/* The new sibling is the index'th child other than item itself,
+	 * or the last child if there are fewer:
+	 */
 	sibling = 0;
-	for (p = parent->children; p != NULL && index > 0; p = p->next) {
-	    if (p != item) {
-		--index;
-	    } /* else -- moving node forward, count index+1 nodes  */
-	    sibling = p;
+	if (index > 0) {
+	    Tcl_Size n = TSUM(parent->tRoot, tItems);
+	    Tcl_Size i = index - 1;
+
+	    if (item->parent == parent) {
+		--n;
+		if (i >= ItemIndex(item)) {
+		    ++i;	/* moving node forward, skip it */
+		}
+	    }
+	    sibling = (index > n) ? EndPosition(parent) : NthChild(parent, i);
 	}
     }
 
@@ -3547,6 +4637,429 @@ static int TreeviewMoveCommand(
     return TCL_OK;
 }
 
+/*------------------------------------------------------------------------
+ * +++ Widget commands -- sorting.
+ *
+ * [$tv sort] reorders the children of an item in place with a stable
+ * merge sort, and then rebuilds their sibling list and treap in one pass.
+ * The sort keys are taken from the items once per sort; -integer and
+ * -real keys are converted up front, and the conversion is cached in
+ * the value objects themselves, so that sorting again by the same
+ * column does not parse the values again.
+ */
+
+enum { SORT_ASCII, SORT_DICTIONARY, SORT_INTEGER, SORT_REAL, SORT_COMMAND };
+
+typedef struct {
+    TreeItem *item;
+    Tcl_Obj *valueObj;		/* Sort key */
+    Tcl_Obj *idObj;		/* Item ID, kept with -command only */
+    Tcl_WideInt intValue;	/* Key converted for -integer */
+    double realValue;		/* Key converted for -real */
+} SortElement;
+
+typedef struct {
+    Tcl_Interp *interp;
+    int mode;			/* SORT_* */
+    int decreasing;
+    Tcl_Obj **cmdv;		/* -command words, plus two arguments */
+    Tcl_Size cmdc;
+    int code;			/* Result of the -command calls */
+} SortInfo;
+
+/* + DictionaryCompare --
+ *	Compare two strings the way [lsort -dictionary] does: embedded
+ *	numbers compare as integers, and case only breaks ties.
+ */
+static int DictionaryCompare(const char *left, const char *right)
+{
+    int uniLeft = 0, uniRight = 0, lowerLeft, lowerRight;
+    int diff, zeros, secondaryDiff = 0;
+
+    while (1) {
+	if (isdigit(UCHAR(*right)) && isdigit(UCHAR(*left))) {
+	    /* Skip leading zeros, which only break ties; then the longer
+	     * number is the larger, else the first differing digit decides.
+	     */
+	    zeros = 0;
+	    while (*right == '0' && isdigit(UCHAR(right[1]))) {
+		right++;
+		zeros--;
+	    }
+	    while (*left == '0' && isdigit(UCHAR(left[1]))) {
+		left++;
+		zeros++;
+	    }
+	    if (secondaryDiff == 0) {
+		secondaryDiff = zeros;
+	    }
+	    diff = 0;
+	    while (1) {
+		if (diff == 0) {
+		    diff = UCHAR(*left) - UCHAR(*right);
+		}
+		right++;
+		left++;
+		if (!isdigit(UCHAR(*right))) {
+		    if (isdigit(UCHAR(*left))) {
+			return 1;
+		    }
+		    if (diff != 0) {
+			return diff;
+		    }
+		    break;
+		} else if (!isdigit(UCHAR(*left))) {
+		    return -1;
+		}
+	    }
+	    continue;
+	}
+	if (*left == '\0' || *right == '\0') {
+	    diff = UCHAR(*left) - UCHAR(*right);
+	    break;
+	}
+
+	left += Tcl_UtfToUniChar(left, &uniLeft);
+	right += Tcl_UtfToUniChar(right, &uniRight);
+	lowerLeft = Tcl_UniCharToLower(uniLeft);
+	lowerRight = Tcl_UniCharToLower(uniRight);
+	if (lowerLeft != lowerRight) {
+	    diff = lowerLeft - lowerRight;
+	    break;
+	}
+	if (secondaryDiff == 0) {
+	    if (Tcl_UniCharIsUpper(uniLeft) && Tcl_UniCharIsLower(uniRight)) {
+		secondaryDiff = -1;
+	    } else if (Tcl_UniCharIsUpper(uniRight)
+		    && Tcl_UniCharIsLower(uniLeft)) {
+		secondaryDiff = 1;
+	    }
+	}
+    }
+    return diff ? diff : secondaryDiff;
+}
+
+/* + CompareElements --
+ *	Compare two sort elements.  Once a -command call has failed,
+ *	all elements compare equal.
+ */
+static int CompareElements(SortInfo *info, SortElement *a, SortElement *b)
+{
+    int order = 0;
+
+    if (info->code != TCL_OK) {
+	return 0;
+    }
+    switch (info->mode) {
+    case SORT_ASCII:
+	order = strcmp(Tcl_GetString(a->valueObj), Tcl_GetString(b->valueObj));
+	break;
+    case SORT_DICTIONARY:
+	order = DictionaryCompare(
+		Tcl_GetString(a->valueObj), Tcl_GetString(b->valueObj));
+	break;
+    case SORT_INTEGER:
+	order = (a->intValue > b->intValue) - (a->intValue < b->intValue);
+	break;
+    case SORT_REAL:
+	order = (a->realValue > b->realValue) - (a->realValue < b->realValue);
+	break;
+    case SORT_COMMAND:
+	info->cmdv[info->cmdc - 2] = a->valueObj;
+	info->cmdv[info->cmdc - 1] = b->valueObj;
+	info->code = Tcl_EvalObjv(
+		info->interp, info->cmdc, info->cmdv, TCL_EVAL_GLOBAL);
+	if (info->code == TCL_OK) {
+	    info->code = Tcl_GetIntFromObj(
+		    info->interp, Tcl_GetObjResult(info->interp), &order);
+	}
+	if (info->code != TCL_OK) {
+	    return 0;
+	}
+	break;
+    }
+    order = (order > 0) - (order < 0);
+    return info->decreasing ? -order : order;
+}
+
+/* + MergeSort --
+ *	Stable bottom-up merge sort of an array of sort elements.
+ *	Runs that are already in order are copied without merging,
+ *	so sorting a sorted array takes linear time.
+ */
+static void MergeSort(SortInfo *info, SortElement *elements, Tcl_Size n)
+{
+    SortElement *buffer = (SortElement *)ckalloc(n * sizeof(SortElement));
+    SortElement *src = elements, *dst = buffer, *tmp;
+    Tcl_Size width, lo, mid, hi, i, j, k;
+
+    for (width = 1; width < n; width *= 2) {
+	for (lo = 0; lo < n; lo += 2 * width) {
+	    mid = (width < n - lo) ? lo + width : n;
+	    hi = (width < n - mid) ? mid + width : n;
+	    i = lo;
+	    j = mid;
+	    k = lo;
+	    if (j < hi && CompareElements(info, &src[j - 1], &src[j]) > 0) {
+		while (i < mid && j < hi) {
+		    if (CompareElements(info, &src[i], &src[j]) > 0) {
+			dst[k++] = src[j++];
+		    } else {
+			dst[k++] = src[i++];
+		    }
+		}
+	    }
+	    while (i < mid) {
+		dst[k++] = src[i++];
+	    }
+	    while (j < hi) {
+		dst[k++] = src[j++];
+	    }
+	}
+	tmp = src;
+	src = dst;
+	dst = tmp;
+    }
+    if (src != elements) {
+	memcpy(elements, src, n * sizeof(SortElement));
+    }
+    ckfree(buffer);
+}
+
+/* + RelinkChildren --
+ *	Rebuild the sibling list and the treap of the children of an item
+ *	in the specified order.  The treap is built left to right along
+ *	its right spine, so this takes linear time.
+ */
+static void RelinkChildren(TreeItem *parent, SortElement *elements, Tcl_Size n)
+{
+    TreeItem **spine = (TreeItem **)ckalloc(n * sizeof(TreeItem *));
+    TreeItem *item, *prev = NULL, *last;
+    Tcl_Size depth = 0, i;
+
+    for (i = 0; i < n; ++i) {
+	item = elements[i].item;
+
+	item->prev = prev;
+	item->next = NULL;
+	if (prev) {
+	    prev->next = item;
+	} else {
+	    parent->children = item;
+	}
+	prev = item;
+
+	/* Items popped off the spine become the left subtree of item;
+	 * their subtrees are complete, so their sums can be updated.
+	 */
+	last = NULL;
+	while (depth > 0 && spine[depth - 1]->priority < item->priority) {
+	    last = spine[--depth];
+	    UpdateSums(last);
+	}
+	item->tLeft = last;
+	item->tRight = NULL;
+	if (last) {
+	    last->tUp = item;
+	}
+	if (depth > 0) {
+	    spine[depth - 1]->tRight = item;
+	    item->tUp = spine[depth - 1];
+	} else {
+	    item->tUp = NULL;
+	}
+	spine[depth++] = item;
+    }
+    parent->tRoot = spine[0];
+    while (depth > 0) {
+	UpdateSums(spine[--depth]);
+    }
+    ckfree(spine);
+}
+
+/* + $tv sort $item ?-option value ...? --
+ *	Sort the children of an item.
+ */
+static int TreeviewSortCommand(
+    void *recordPtr, Tcl_Interp *interp, Tcl_Size objc, Tcl_Obj *const objv[])
+{
+    static const char *const optionStrings[] = {
+	"-ascii", "-column", "-command", "-decreasing", "-dictionary",
+	"-increasing", "-integer", "-real", NULL
+    };
+    enum {
+	OPT_ASCII, OPT_COLUMN, OPT_COMMAND, OPT_DECREASING, OPT_DICTIONARY,
+	OPT_INCREASING, OPT_INTEGER, OPT_REAL
+    };
+    Treeview *tv = (Treeview *)recordPtr;
+    TreeItem *parent, *item;
+    TreeColumn *column = &tv->tree.column0;
+    Tcl_Obj *commandObj = NULL, *parentIdObj = NULL, *emptyObj, **words;
+    SortElement *elements;
+    SortInfo info;
+    Tcl_Size n, nInit = 0, nWords, columnNumber, i;
+    int index, code = TCL_OK;
+
+    if (objc < 3) {
+	Tcl_WrongNumArgs(interp, 2, objv, "item ?-option value ...?");
+	return TCL_ERROR;
+    }
+    if (!VirtualCheck(interp, tv)
+	    || !(parent = FindItem(interp, tv, objv[2]))) {
+	return TCL_ERROR;
+    }
+
+    info.interp = interp;
+    info.mode = SORT_ASCII;
+    info.decreasing = 0;
+    info.cmdv = NULL;
+    info.cmdc = 0;
+    info.code = TCL_OK;
+    for (i = 3; i < objc; ++i) {
+	if (Tcl_GetIndexFromObjStruct(interp, objv[i], optionStrings,
+		sizeof(char *), "option", 0, &index) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	switch (index) {
+	case OPT_ASCII:		info.mode = SORT_ASCII; break;
+	case OPT_DICTIONARY:	info.mode = SORT_DICTIONARY; break;
+	case OPT_INTEGER:	info.mode = SORT_INTEGER; break;
+	case OPT_REAL:		info.mode = SORT_REAL; break;
+	case OPT_INCREASING:	info.decreasing = 0; break;
+	case OPT_DECREASING:	info.decreasing = 1; break;
+	case OPT_COLUMN:
+	case OPT_COMMAND:
+	    if (++i >= objc) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+			"missing value for %s option", optionStrings[index]));
+		Tcl_SetErrorCode(interp, "TTK", "TREE", "SORT", (char *)NULL);
+		return TCL_ERROR;
+	    }
+	    if (index == OPT_COMMAND) {
+		info.mode = SORT_COMMAND;
+		commandObj = objv[i];
+	    } else if (!(column = FindColumn(interp, tv, objv[i]))) {
+		return TCL_ERROR;
+	    }
+	    break;
+	}
+    }
+
+    n = TSUM(parent->tRoot, tItems);
+    if (n < 2) {
+	return TCL_OK;
+    }
+
+    if (info.mode == SORT_COMMAND) {
+	if (Tcl_ListObjGetElements(interp, commandObj, &nWords, &words)
+		!= TCL_OK) {
+	    return TCL_ERROR;
+	}
+	info.cmdc = nWords + 2;
+	info.cmdv = (Tcl_Obj **)ckalloc(info.cmdc * sizeof(Tcl_Obj *));
+	for (i = 0; i < nWords; ++i) {
+	    info.cmdv[i] = words[i];
+	    Tcl_IncrRefCount(words[i]);
+	}
+	parentIdObj = ItemID(tv, parent);
+	Tcl_IncrRefCount(parentIdObj);
+    }
+
+    /* Collect the sort keys:
+     */
+    columnNumber = column - tv->tree.columns;
+    emptyObj = Tcl_NewObj();
+    Tcl_IncrRefCount(emptyObj);
+    elements = (SortElement *)ckalloc(n * sizeof(SortElement));
+    for (item = parent->children; item; item = item->next) {
+	SortElement *element = &elements[nInit++];
+	Tcl_Obj *valueObj = NULL;
+
+	if (column == &tv->tree.column0) {
+	    valueObj = item->textObj;
+	} else if (item->valuesObj) {
+	    Tcl_ListObjIndex(NULL, item->valuesObj, columnNumber, &valueObj);
+	}
+	if (!valueObj) {
+	    valueObj = emptyObj;
+	}
+	Tcl_IncrRefCount(valueObj);
+	element->item = item;
+	element->valueObj = valueObj;
+	element->idObj = NULL;
+
+	if (info.mode == SORT_INTEGER) {
+	    code = Tcl_GetWideIntFromObj(interp, valueObj, &element->intValue);
+	} else if (info.mode == SORT_REAL) {
+	    code = Tcl_GetDoubleFromObj(interp, valueObj, &element->realValue);
+	} else if (info.mode == SORT_COMMAND) {
+	    element->idObj = ItemID(tv, item);
+	    Tcl_IncrRefCount(element->idObj);
+	}
+	if (code != TCL_OK) {
+	    goto done;
+	}
+    }
+
+    MergeSort(&info, elements, n);
+    code = info.code;
+
+    /* -command may have done anything to the widget; make sure that
+     * the items are still there, and still the children of parent:
+     */
+    if (code == TCL_OK && info.mode == SORT_COMMAND) {
+	Tcl_HashEntry *entryPtr;
+
+	Tcl_ResetResult(interp);
+	if ((tv->core.flags & WIDGET_DESTROYED) || !VirtualCheck(interp, tv)) {
+	    code = TCL_ERROR;
+	}
+	for (i = -1; code == TCL_OK && i < n; ++i) {
+	    Tcl_Obj *idObj = (i < 0) ? parentIdObj : elements[i].idObj;
+	    TreeItem *expected = (i < 0) ? parent : elements[i].item;
+
+	    entryPtr = Tcl_FindHashEntry(&tv->tree.items, Tcl_GetString(idObj));
+	    if (!entryPtr || Tcl_GetHashValue(entryPtr) != expected
+		    || (i >= 0 && expected->parent != parent)) {
+		code = TCL_ERROR;
+	    }
+	}
+	if (code == TCL_OK && TSUM(parent->tRoot, tItems) != n) {
+	    code = TCL_ERROR;
+	}
+	if (code != TCL_OK && !(tv->core.flags & WIDGET_DESTROYED)
+		&& !tv->tree.virtualMode) {
+	    Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		    "Items changed during sort", -1));
+	    Tcl_SetErrorCode(interp, "TTK", "TREE", "SORT", (char *)NULL);
+	}
+    }
+
+    if (code == TCL_OK) {
+	RelinkChildren(parent, elements, n);
+	tv->tree.rowPosNeedsUpdate = 1;
+	TtkRedisplayWidget(&tv->core);
+    }
+
+done:
+    for (i = 0; i < nInit; ++i) {
+	Tcl_DecrRefCount(elements[i].valueObj);
+	if (elements[i].idObj) {
+	    Tcl_DecrRefCount(elements[i].idObj);
+	}
+    }
+    ckfree(elements);
+    Tcl_DecrRefCount(emptyObj);
+    if (info.cmdv) {
+	for (i = 0; i < info.cmdc - 2; ++i) {
+	    Tcl_DecrRefCount(info.cmdv[i]);
+	}
+	ckfree(info.cmdv);
+	Tcl_DecrRefCount(parentIdObj);
+    }
+    return code;
+}
+
 /*------------------------------------------------------------------------
  * +++ Widget commands -- scrolling
  */
@@ -3573,7 +5086,7 @@ static int TreeviewSeeCommand(
 {
     Treeview *tv = (Treeview *)recordPtr;
     TreeItem *item, *parent;
-    int scrollRow1, scrollRow2, visibleRows;
+    int row, scrollRow1, scrollRow2, visibleRows;
 
     if (objc != 3) {
 	Tcl_WrongNumArgs(interp, 2, objv, "item");
@@ -3596,6 +5109,7 @@ static int TreeviewSeeCommand(
 	    parent->openObj = unshareObj(parent->openObj);
 	    Tcl_SetBooleanObj(parent->openObj, 1);
 	    parent->state |= TTK_STATE_OPEN;
+	    UpdateExtent(parent);
 	    tv->tree.rowPosNeedsUpdate = 1;
 	    TtkRedisplayWidget(&tv->core);
 	}
@@ -3609,12 +5123,13 @@ static int TreeviewSeeCommand(
 
     /* Make sure item is visible:
      */
-    if (item->rowPos < tv->tree.titleRows) {
+    row = ItemRow(tv, item, NULL);
+    if (row < tv->tree.titleRows) {
 	return TCL_OK;
     }
     visibleRows = tv->tree.treeArea.height / tv->tree.rowHeight
 	    - tv->tree.titleRows;
-    scrollRow1 = item->rowPos - tv->tree.titleRows;
+    scrollRow1 = row - tv->tree.titleRows;
     scrollRow2 = scrollRow1 + item->height - 1;
 
     if (scrollRow2 >= tv->tree.yscroll.first + visibleRows) {
@@ -3894,10 +5409,7 @@ static int CellSelectionRange(
 
     /* Correct order.
      */
-    if (tv->tree.rowPosNeedsUpdate) {
-	UpdatePositionTree(tv);
-    }
-    if (cellFrom.item->itemPos > cellTo.item->itemPos) {
+    if (CompareItems(tv, cellFrom.item, cellTo.item) > 0) {
 	item = cellFrom.item;
 	cellFrom.item = cellTo.item;
 	cellTo.item = item;
@@ -4545,6 +6057,7 @@ static const Ttk_Ensemble TreeviewCommands[] = {
     { "identify",	TreeviewIdentifyCommand,0 },
     { "index",	TreeviewIndexCommand,0 },
     { "insert",	TreeviewInsertCommand,0 },
+    { "insertmany",	TreeviewInsertManyCommand,0 },
     { "instate",	TtkWidgetInstateCommand,0 },
     { "item",		TreeviewItemCommand,0 },
     { "move",		TreeviewMoveCommand,0 },
@@ -4554,6 +6067,8 @@ static const Ttk_Ensemble TreeviewCommands[] = {
     { "see",		TreeviewSeeCommand,0 },
     { "selection",	TreeviewSelectionCommand,0 },
     { "set",		TreeviewSetCommand,0 },
+    { "setmany",	TreeviewSetManyCommand,0 },
+    { "sort",		TreeviewSortCommand,0 },
     { "state",	TtkWidgetStateCommand,0 },
     { "style",		TtkWidgetStyleCommand,0 },
     { "tag",	0,TreeviewTagCommands },